@@ -0,0 +1,406 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "AmbientOcclusion.h"
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// World space radius of the sampled hemisphere, in meters
+#define AO_RADIUS 0.75f
+#define AO_INTENSITY 1.0f
+
+// Share of the previous frames in the accumulated result
+#define AO_HISTORY_WEIGHT 0.9f
+
+const char* aoQualityName(AoQuality quality) {
+	switch (quality) {
+		case AoQuality::Off: return "off";
+		case AoQuality::Low: return "low";
+		case AoQuality::Medium: return "medium";
+		case AoQuality::High: return "high";
+	}
+	return "?";
+}
+
+static int downsampleFactor(AoQuality quality) {
+	return quality == AoQuality::Low ? 4 : 2;
+}
+
+static int sampleCount(AoQuality quality) {
+	return quality == AoQuality::Low ? 6 : quality == AoQuality::Medium ? 8 : 16;
+}
+
+///////////
+// Shaders
+// All of them are drawn with drawFullscreenQuad and read the camera from
+// the fixed function matrices. Linear depth is the distance along the
+// view axis; sky pixels get SKY_DEPTH.
+
+static const char* fullscreenVertex = R"(
+#version 130
+void main() {
+	gl_Position = gl_Vertex;
+}
+)";
+
+// Prepended to every fragment shader
+static const char* shaderCommon = R"(
+#version 130
+const float SKY_DEPTH = 60000.0;
+float linearDepth(float depth) {
+	if (depth >= 1.0)
+		return SKY_DEPTH;
+	return gl_ProjectionMatrix[3][2] / (depth * 2.0 - 1.0 + gl_ProjectionMatrix[2][2]);
+}
+vec3 viewPosition(vec2 uv, float depth) {
+	vec2 ndc = uv * 2.0 - 1.0;
+	return vec3(ndc.x * depth / gl_ProjectionMatrix[0][0], ndc.y * depth / gl_ProjectionMatrix[1][1], -depth);
+}
+)";
+
+// Closest of the top left 2x2 texels of each block
+static const char* downsampleFragment = R"(
+uniform sampler2D depth;
+uniform int factor;
+void main() {
+	ivec2 texel = ivec2(gl_FragCoord.xy) * factor;
+	ivec2 next = min(texel + 1, textureSize(depth, 0) - 1);
+	float closest = min(min(texelFetch(depth, texel, 0).r, texelFetch(depth, ivec2(next.x, texel.y), 0).r),
+		min(texelFetch(depth, ivec2(texel.x, next.y), 0).r, texelFetch(depth, next, 0).r));
+	gl_FragColor = vec4(linearDepth(closest));
+}
+)";
+
+// Alchemy AO (McGuire et al. 2011) in the form of Scalable AO (2012)
+static const char* occlusionFragment = R"(
+uniform sampler2D depths;
+uniform int sampleCount;
+uniform float radius;
+uniform float intensity;
+uniform int frame;
+
+ivec2 size;
+vec3 fetchPosition(ivec2 texel) {
+	texel = clamp(texel, ivec2(0), size - 1);
+	return viewPosition((vec2(texel) + 0.5) / vec2(size), texelFetch(depths, texel, 0).r);
+}
+
+void main() {
+	size = textureSize(depths, 0);
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	vec3 p = fetchPosition(texel);
+
+	// Pixels per meter at this depth
+	float screenRadius = radius * gl_ProjectionMatrix[1][1] * 0.5 * float(size.y) / -p.z;
+	if (-p.z >= SKY_DEPTH || screenRadius < 1.0) {
+		gl_FragColor = vec4(1.0);
+		return;
+	}
+
+	// Normal from the neighbour on the same surface along each axis
+	vec3 left = fetchPosition(texel - ivec2(1, 0)), right = fetchPosition(texel + ivec2(1, 0));
+	vec3 down = fetchPosition(texel - ivec2(0, 1)), up = fetchPosition(texel + ivec2(0, 1));
+	vec3 dx = abs(right.z - p.z) < abs(p.z - left.z) ? right - p : p - left;
+	vec3 dy = abs(up.z - p.z) < abs(p.z - down.z) ? up - p : p - down;
+	vec3 n = normalize(cross(dx, dy));
+
+	// Interleaved gradient noise, shifted every frame so the
+	// temporal accumulation sees new directions
+	float noise = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+	float angle = (noise + float(frame) * 0.618034) * 6.2831853;
+
+	float radius2 = radius * radius;
+	float sum = 0.0;
+	for (int i = 0; i < sampleCount; i++) {
+		float t = (float(i) + 0.5) / float(sampleCount);
+		float a = angle + float(i) * 2.39996323;
+		vec3 v = fetchPosition(texel + ivec2(vec2(cos(a), sin(a)) * t * screenRadius)) - p;
+
+		float vv = dot(v, v);
+		float f = max(radius2 - vv, 0.0);
+		sum += f * f * f * max((dot(v, n) - 0.01 * -p.z) / (vv + 0.01), 0.0);
+	}
+
+	float occlusion = max(0.0, 1.0 - sum * intensity / (radius2 * radius2 * radius2) * (5.0 / float(sampleCount)));
+	gl_FragColor = vec4(occlusion);
+}
+)";
+
+// Blends with where this pixel was last frame, unless that was
+// another surface (disocclusion) or off screen
+static const char* temporalFragment = R"(
+uniform sampler2D current;
+uniform sampler2D depths;
+uniform sampler2D history;
+uniform mat4 previousViewProjection;
+uniform float historyWeight;
+void main() {
+	ivec2 size = textureSize(depths, 0);
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	float occlusion = texelFetch(current, texel, 0).r;
+	float depth = texelFetch(depths, texel, 0).r;
+
+	float result = occlusion;
+	if (depth < SKY_DEPTH && historyWeight > 0.0) {
+		vec4 view = vec4(viewPosition((vec2(texel) + 0.5) / vec2(size), depth), 1.0);
+		vec4 clip = previousViewProjection * (gl_ModelViewMatrixInverse * view);
+		vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+
+		if (clip.w > 0.0 && all(greaterThanEqual(uv, vec2(0.0))) && all(lessThanEqual(uv, vec2(1.0)))) {
+			vec2 previous = texture(history, uv).rg;
+			if (abs(previous.g - clip.w) < 0.05 * clip.w)
+				result = mix(occlusion, previous.r, historyWeight);
+		}
+	}
+
+	gl_FragColor = vec4(result, depth, 0.0, 1.0);
+}
+)";
+
+// Joint bilateral upsample: bilinear weights, cut down across depth edges
+static const char* upsampleFragment = R"(
+uniform sampler2D depth;
+uniform sampler2D occlusion;
+uniform float factor;
+void main() {
+	float d = texelFetch(depth, ivec2(gl_FragCoord.xy), 0).r;
+	if (d >= 1.0)
+		discard;
+	float z = linearDepth(d);
+
+	ivec2 size = textureSize(occlusion, 0);
+	vec2 low = gl_FragCoord.xy / factor - 0.5;
+	ivec2 base = ivec2(floor(low));
+	vec2 f = low - vec2(base);
+
+	float sum = 0.0, weightSum = 0.0;
+	for (int i = 0; i < 4; i++) {
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		vec2 s = texelFetch(occlusion, clamp(base + offset, ivec2(0), size - 1), 0).rg;
+		float w = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y) + 1e-3;
+		w /= 1e-3 + abs(s.g - z) / z;
+		sum += s.r * w;
+		weightSum += w;
+	}
+
+	gl_FragColor = vec4(vec3(sum / weightSum), 1.0);
+}
+)";
+
+// Column major, as OpenGL stores them
+static void multiplyMatrices(const float a[16], const float b[16], float result[16]) {
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 4; row++) {
+			float sum = 0;
+			for (int k = 0; k < 4; k++)
+				sum += a[k * 4 + row] * b[column * 4 + k];
+			result[column * 4 + row] = sum;
+		}
+	}
+}
+
+/////////////////
+// ScreenSpaceAO
+
+ScreenSpaceAO::ScreenSpaceAO() {
+}
+
+bool ScreenSpaceAO::init() {
+	this->supported = hasFramebuffers() && hasShaders()
+		&& this->downsampleShader.build("ssao downsample", fullscreenVertex, (string(shaderCommon) + downsampleFragment).c_str())
+		&& this->occlusionShader.build("ssao", fullscreenVertex, (string(shaderCommon) + occlusionFragment).c_str())
+		&& this->temporalShader.build("ssao temporal", fullscreenVertex, (string(shaderCommon) + temporalFragment).c_str())
+		&& this->upsampleShader.build("ssao upsample", fullscreenVertex, (string(shaderCommon) + upsampleFragment).c_str());
+
+	if (this->supported) {
+		this->downsampleShader.use();
+		glUniform1i(this->downsampleShader.uniform("depth"), 0);
+
+		this->occlusionShader.use();
+		glUniform1i(this->occlusionShader.uniform("depths"), 0);
+		glUniform1f(this->occlusionShader.uniform("radius"), AO_RADIUS);
+		glUniform1f(this->occlusionShader.uniform("intensity"), AO_INTENSITY);
+
+		this->temporalShader.use();
+		glUniform1i(this->temporalShader.uniform("current"), 0);
+		glUniform1i(this->temporalShader.uniform("depths"), 1);
+		glUniform1i(this->temporalShader.uniform("history"), 2);
+
+		this->upsampleShader.use();
+		glUniform1i(this->upsampleShader.uniform("depth"), 0);
+		glUniform1i(this->upsampleShader.uniform("occlusion"), 1);
+		glUseProgram(0);
+	}
+
+	return this->supported;
+}
+
+void ScreenSpaceAO::resize(int width, int height) {
+	this->width = width;
+	this->height = height;
+	createTargets();
+}
+
+void ScreenSpaceAO::setQuality(AoQuality quality) {
+	bool resized = downsampleFactor(quality) != downsampleFactor(this->quality);
+	this->quality = quality;
+	if (resized)
+		createTargets();
+}
+
+AoQuality ScreenSpaceAO::getQuality() const {
+	return this->quality;
+}
+
+void ScreenSpaceAO::createTargets() {
+	if (!this->supported || this->width == 0)
+		return;
+
+	// Only the history outlives a frame, the graph provides the rest
+	int factor = downsampleFactor(this->quality);
+	int lowWidth = (this->width + factor - 1) / factor;
+	int lowHeight = (this->height + factor - 1) / factor;
+
+	// The old history is deleted, and its names may come back
+	if (this->graph) {
+		for (RenderTarget& target : this->history) {
+			if (target.isValid())
+				this->graph->releaseTexture(target.getColorTexture(0));
+		}
+	}
+
+	bool created = this->history[0].create(lowWidth, lowHeight, { GL_RG16F }, 0)
+		&& this->history[1].create(lowWidth, lowHeight, { GL_RG16F }, 0);
+
+	if (!created) {
+		cout << "Ambient occlusion disabled" << endl;
+		this->supported = false;
+	}
+	this->historyValid = false;
+}
+
+// Every pass draws a fullscreen quad without depth, blending or lighting
+static void beginFullscreenPass(const Shader& shader) {
+	glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_ENABLE_BIT);
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	glDisable(GL_BLEND);
+	glDisable(GL_LIGHTING);
+	shader.use();
+}
+
+static void endFullscreenPass(int textureUnits) {
+	glUseProgram(0);
+	for (int unit = textureUnits - 1; unit >= 0; unit--) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	glPopAttrib();
+}
+
+GraphTexture ScreenSpaceAO::addPasses(RenderGraph& graph, GraphTexture sceneColor, GraphTexture sceneDepth) {
+	if (!this->supported || this->quality == AoQuality::Off || !this->history[0].isValid())
+		return sceneColor;
+
+	int factor = downsampleFactor(this->quality);
+	GraphTextureDesc lowDesc = { this->history[0].getWidth(), this->history[0].getHeight(), GL_R32F };
+	GraphTexture depths = graph.createTexture("ssao depths", lowDesc);
+	lowDesc.format = GL_R8;
+	GraphTexture occlusion = graph.createTexture("ssao occlusion", lowDesc);
+
+	int previous = this->current;
+	int next = 1 - this->current;
+	lowDesc.format = GL_RG16F;
+	this->graph = &graph;
+	GraphTexture previousHistory = graph.importTexture("ssao history", this->history[previous].getColorTexture(0), lowDesc);
+	GraphTexture nextHistory = graph.importTexture("ssao history", this->history[next].getColorTexture(0), lowDesc);
+
+	// Linear depth at the reduced resolution
+	graph.addPass("ssao downsample", [&](RenderPassBuilder& pass) {
+		pass.read(sceneDepth);
+		depths = pass.write(depths);
+		pass.setGpuSection("ssao");
+	}, [=](const RenderPassContext& context) {
+		beginFullscreenPass(this->downsampleShader);
+		glUniform1i(this->downsampleShader.uniform("factor"), factor);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, context.getTexture(sceneDepth));
+		drawFullscreenQuad();
+		endFullscreenPass(1);
+	});
+
+	// Raw occlusion
+	graph.addPass("ssao occlusion", [&](RenderPassBuilder& pass) {
+		pass.read(depths);
+		occlusion = pass.write(occlusion);
+		pass.setGpuSection("ssao");
+	}, [=](const RenderPassContext& context) {
+		beginFullscreenPass(this->occlusionShader);
+		glUniform1i(this->occlusionShader.uniform("sampleCount"), sampleCount(this->quality));
+		glUniform1i(this->occlusionShader.uniform("frame"), (GLint)(this->frame++ % 64));
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, context.getTexture(depths));
+		drawFullscreenQuad();
+		endFullscreenPass(1);
+	});
+
+	// Accumulated over frames
+	graph.addPass("ssao temporal", [&](RenderPassBuilder& pass) {
+		pass.read(occlusion);
+		pass.read(depths);
+		pass.read(previousHistory);
+		nextHistory = pass.write(nextHistory);
+		pass.setGpuSection("ssao");
+	}, [=](const RenderPassContext& context) {
+		beginFullscreenPass(this->temporalShader);
+		glUniformMatrix4fv(this->temporalShader.uniform("previousViewProjection"), 1, GL_FALSE, this->previousViewProjection);
+		glUniform1f(this->temporalShader.uniform("historyWeight"), this->historyValid ? AO_HISTORY_WEIGHT : 0.0f);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, context.getTexture(occlusion));
+		glActiveTexture(GL_TEXTURE0 + 1);
+		glBindTexture(GL_TEXTURE_2D, context.getTexture(depths));
+		glActiveTexture(GL_TEXTURE0 + 2);
+		glBindTexture(GL_TEXTURE_2D, context.getTexture(previousHistory));
+		drawFullscreenQuad();
+		endFullscreenPass(3);
+	});
+
+	// Upsampled and multiplied onto the scene, whose depth is read
+	// rather than attached
+	graph.addPass("ssao upsample", [&](RenderPassBuilder& pass) {
+		pass.read(nextHistory);
+		pass.read(sceneDepth);
+		sceneColor = pass.write(sceneColor);
+		pass.setGpuSection("ssao");
+	}, [=](const RenderPassContext& context) {
+		beginFullscreenPass(this->upsampleShader);
+		glUniform1f(this->upsampleShader.uniform("factor"), (float)factor);
+		glActiveTexture(GL_TEXTURE0 + 1);
+		glBindTexture(GL_TEXTURE_2D, context.getTexture(nextHistory));
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, context.getTexture(sceneDepth));
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ZERO, GL_SRC_COLOR);
+		drawFullscreenQuad();
+		endFullscreenPass(2);
+
+		// This frame's camera, for the next one to reproject through
+		float projection[16], modelView[16];
+		glGetFloatv(GL_PROJECTION_MATRIX, projection);
+		glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
+		multiplyMatrices(projection, modelView, this->previousViewProjection);
+		this->current = next;
+		this->historyValid = true;
+	});
+
+	return sceneColor;
+}
+
+bool ScreenSpaceAO::isSupported() const {
+	return this->supported;
+}
@@ -0,0 +1,66 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "GLExtensions.h"
+#include "RenderTarget.h"
+#include "RenderGraph.h"
+#include "Shader.h"
+
+// Cost/quality trade off of the ambient occlusion
+enum class AoQuality {
+	Off,
+	Low,    // Quarter resolution, 6 samples
+	Medium, // Half resolution, 8 samples
+	High    // Half resolution, 16 samples
+};
+
+const char* aoQualityName(AoQuality quality);
+
+// Screen-space ambient occlusion for scenes without baked AO, cheap
+// enough for kiosk hardware. The depth buffer is linearized and
+// downsampled, occlusion is estimated at that resolution (Alchemy AO
+// with a per pixel rotated spiral of samples), accumulated over frames
+// by reprojecting the previous result, then upsampled with weights that
+// respect depth edges and multiplied onto the opaque image.
+class ScreenSpaceAO {
+public:
+	ScreenSpaceAO();
+	ScreenSpaceAO(const ScreenSpaceAO&) = delete;
+	ScreenSpaceAO& operator=(const ScreenSpaceAO&) = delete;
+
+	// Builds the shaders, returning false if AO is unavailable
+	bool init();
+
+	// Size of the scene, to keep the history at the matching resolution
+	void resize(int width, int height);
+
+	void setQuality(AoQuality quality);
+	AoQuality getQuality() const;
+
+	// Adds the passes darkening sceneColor, returning its new version.
+	// They use the fixed function matrices current when the graph runs
+	// as the camera, and their GPU time goes to the "ssao" section.
+	GraphTexture addPasses(RenderGraph& graph, GraphTexture sceneColor, GraphTexture sceneDepth);
+
+	bool isSupported() const;
+
+private:
+	void createTargets();
+
+	Shader downsampleShader, occlusionShader, temporalShader, upsampleShader;
+	RenderTarget history[2];
+	RenderGraph* graph = nullptr; // Last given the history, which caches framebuffers for it
+	int width = 0, height = 0;
+	AoQuality quality = AoQuality::Medium;
+	bool supported = false;
+
+	// Reprojection state
+	int current = 0; // history target holding the latest result
+	bool historyValid = false;
+	float previousViewProjection[16] = {};
+	unsigned frame = 0;
+};
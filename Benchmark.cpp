@@ -0,0 +1,378 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "JobSystem.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+using namespace std;
+
+volatile uint64_t benchmarkSink = 0;
+
+bool pinCurrentThread(int cpu) {
+	if (cpu < 0)
+		return false;
+#ifdef _WIN32
+	if (cpu >= 64)
+		return false;
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#else
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#endif
+}
+
+static void summarize(BenchmarkResult& result) {
+	vector<double> sorted = result.samples;
+	sort(sorted.begin(), sorted.end());
+	size_t count = sorted.size();
+	if (count == 0)
+		return;
+
+	double sum = 0;
+	for (double sample : sorted)
+		sum += sample;
+	result.mean = sum / count;
+	result.median = count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+	result.min = sorted.front();
+	result.max = sorted.back();
+
+	double squares = 0;
+	for (double sample : sorted)
+		squares += (sample - result.mean) * (sample - result.mean);
+	result.stddev = count > 1 ? sqrt(squares / (count - 1)) : 0;
+}
+
+//////////////////
+// BenchmarkSuite
+
+BenchmarkSuite::BenchmarkSuite(const BenchmarkSettings& settings) : settings(settings) {
+}
+
+bool BenchmarkSuite::isSelected(const string& name) const {
+	return name.find(this->settings.filter) != string::npos;
+}
+
+void BenchmarkSuite::add(const string& name, const function<void()>& body, size_t bytes) {
+	if (isSelected(name))
+		this->entries.push_back({ name, body, bytes });
+}
+
+void BenchmarkSuite::run() {
+	typedef chrono::steady_clock Clock;
+
+	if (this->settings.cpu >= 0 && !pinCurrentThread(this->settings.cpu))
+		printf("Could not pin to cpu %d, timings may be noisier\n", this->settings.cpu);
+	printf("%-32s %10s %12s %12s %8s %9s\n", "benchmark", "iterations", "median", "mean", "cv", "GB/s");
+
+	this->results.clear();
+	for (const Entry& entry : this->entries) {
+		// One iteration's time decides how many make a repetition
+		auto start = Clock::now();
+		entry.body();
+		double once = chrono::duration<double>(Clock::now() - start).count();
+		size_t iterations = max((size_t)1, (size_t)ceil(this->settings.minSeconds / max(once, 1e-9)));
+
+		BenchmarkResult result;
+		result.name = entry.name;
+		result.iterations = iterations;
+		result.bytes = entry.bytes;
+		for (int repetition = -this->settings.warmup; repetition < this->settings.repetitions; repetition++) {
+			start = Clock::now();
+			for (size_t i = 0; i < iterations; i++)
+				entry.body();
+			double nanoseconds = chrono::duration<double, nano>(Clock::now() - start).count();
+			if (repetition >= 0)
+				result.samples.push_back(nanoseconds / iterations);
+		}
+
+		summarize(result);
+		printf("%-32s %10zu %9.3f us %9.3f us %7.1f%%", result.name.c_str(), result.iterations,
+			result.median / 1e3, result.mean / 1e3, 100 * result.stddev / max(result.mean, 1e-9));
+		// Bytes per nanosecond are GB/s
+		if (result.bytes > 0)
+			printf(" %9.2f", result.bytes / max(result.median, 1e-9));
+		printf("\n");
+		this->results.push_back(move(result));
+	}
+}
+
+const vector<BenchmarkResult>& BenchmarkSuite::getResults() const {
+	return this->results;
+}
+
+static string escapeJson(const string& text) {
+	string escaped;
+	for (char c : text) {
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+	return escaped;
+}
+
+bool BenchmarkSuite::writeJson(const string& filename) const {
+	ofstream file(filename, ofstream::out | ofstream::trunc);
+	if (!file.is_open())
+		return false;
+
+	file.precision(17);
+	file << "{\n\t\"version\": 1,\n\t\"cpu\": " << this->settings.cpu << ",\n\t\"threads\": " << getJobSystem().getThreadCount()
+		<< ",\n\t\"warmup\": " << this->settings.warmup << ",\n\t\"repetitions\": " << this->settings.repetitions
+		<< ",\n\t\"benchmarks\": [";
+	for (size_t i = 0; i < this->results.size(); i++) {
+		const BenchmarkResult& result = this->results[i];
+		file << (i > 0 ? "," : "") << "\n\t\t{\"name\": \"" << escapeJson(result.name) << "\", \"iterations\": " << result.iterations
+			<< ", \"bytes\": " << result.bytes << ", \"mean_ns\": " << result.mean << ", \"median_ns\": " << result.median
+			<< ", \"stddev_ns\": " << result.stddev << ", \"min_ns\": " << result.min << ", \"max_ns\": " << result.max << ", \"samples_ns\": [";
+		for (size_t s = 0; s < result.samples.size(); s++)
+			file << (s > 0 ? ", " : "") << result.samples[s];
+		file << "]}";
+	}
+	file << "\n\t]\n}\n";
+	return (bool)file;
+}
+
+////////
+// JSON
+// Just enough of it to read the files written above back
+
+struct JsonValue {
+	enum Type { Null, Boolean, Number, String, Array, Object } type = Null;
+	double number = 0;
+	string text;
+	vector<JsonValue> items;
+	vector<pair<string, JsonValue>> members;
+
+	const JsonValue* find(const char* key) const {
+		for (const auto& member : this->members) {
+			if (member.first == key)
+				return &member.second;
+		}
+		return nullptr;
+	}
+};
+
+static void skipSpace(const char*& p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+		p++;
+}
+
+static bool parseString(const char*& p, const char* end, string& text) {
+	if (p >= end || *p != '"')
+		return false;
+	for (p++; p < end && *p != '"'; p++) {
+		if (*p == '\\' && ++p >= end)
+			return false;
+		text += *p;
+	}
+	return p++ < end;
+}
+
+static bool parseJson(const char*& p, const char* end, JsonValue& value) {
+	skipSpace(p, end);
+	if (p >= end)
+		return false;
+
+	if (*p == '{' || *p == '[') {
+		bool object = *p == '{';
+		char close = object ? '}' : ']';
+		value.type = object ? JsonValue::Object : JsonValue::Array;
+		p++;
+		skipSpace(p, end);
+		if (p < end && *p == close)
+			return ++p, true;
+
+		while (true) {
+			JsonValue item;
+			string key;
+			if (object) {
+				skipSpace(p, end);
+				if (!parseString(p, end, key))
+					return false;
+				skipSpace(p, end);
+				if (p >= end || *p++ != ':')
+					return false;
+			}
+			if (!parseJson(p, end, item))
+				return false;
+			if (object)
+				value.members.push_back({ key, move(item) });
+			else
+				value.items.push_back(move(item));
+
+			skipSpace(p, end);
+			if (p < end && *p == ',') {
+				p++;
+				continue;
+			}
+			return p < end && *p++ == close;
+		}
+	}
+
+	if (*p == '"') {
+		value.type = JsonValue::String;
+		return parseString(p, end, value.text);
+	}
+
+	for (const char* word : { "true", "false", "null" }) {
+		size_t length = string(word).size();
+		if ((size_t)(end - p) >= length && string(p, length) == word) {
+			value.type = word[0] == 'n' ? JsonValue::Null : JsonValue::Boolean;
+			value.number = word[0] == 't';
+			p += length;
+			return true;
+		}
+	}
+
+	char* after;
+	value.type = JsonValue::Number;
+	value.number = strtod(p, &after);
+	if (after == p)
+		return false;
+	p = after;
+	return true;
+}
+
+bool readBenchmarkJson(const string& filename, vector<BenchmarkResult>& results) {
+	ifstream file(filename);
+	if (!file.is_open())
+		return false;
+	stringstream contents;
+	contents << file.rdbuf();
+	string text = contents.str();
+
+	JsonValue root;
+	const char* p = text.data();
+	if (!parseJson(p, text.data() + text.size(), root) || root.type != JsonValue::Object)
+		return false;
+	const JsonValue* benchmarks = root.find("benchmarks");
+	if (!benchmarks || benchmarks->type != JsonValue::Array)
+		return false;
+
+	results.clear();
+	for (const JsonValue& entry : benchmarks->items) {
+		const JsonValue* name = entry.find("name");
+		const JsonValue* iterations = entry.find("iterations");
+		const JsonValue* samples = entry.find("samples_ns");
+		if (!name || !samples || samples->type != JsonValue::Array)
+			return false;
+
+		BenchmarkResult result;
+		result.name = name->text;
+		result.iterations = iterations ? (size_t)iterations->number : 0;
+		const JsonValue* bytes = entry.find("bytes");
+		result.bytes = bytes ? (size_t)bytes->number : 0;
+		for (const JsonValue& sample : samples->items)
+			result.samples.push_back(sample.number);
+		summarize(result);
+		results.push_back(move(result));
+	}
+	return true;
+}
+
+//////////////
+// Comparison
+
+// Continued fraction of the incomplete beta function, by Lentz's method
+static double betaFraction(double a, double b, double x) {
+	const double tiny = 1e-300;
+	double c = 1, d = 1 - (a + b) * x / (a + 1);
+	d = 1 / (fabs(d) < tiny ? tiny : d);
+	double fraction = d;
+
+	for (int m = 1; m <= 300; m++) {
+		for (int half = 0; half < 2; half++) {
+			double numerator = half == 0 ? m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m))
+				: -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1));
+			d = 1 + numerator * d;
+			d = 1 / (fabs(d) < tiny ? tiny : d);
+			c = 1 + numerator / c;
+			c = fabs(c) < tiny ? tiny : c;
+			fraction *= d * c;
+			if (half == 1 && fabs(d * c - 1) < 1e-12)
+				return fraction;
+		}
+	}
+	return fraction;
+}
+
+// Regularized incomplete beta function I_x(a, b)
+static double incompleteBeta(double a, double b, double x) {
+	if (x <= 0)
+		return 0;
+	if (x >= 1)
+		return 1;
+	double front = exp(lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) + b * log(1 - x));
+	if (x < (a + 1) / (a + b + 2))
+		return front * betaFraction(a, b, x) / a;
+	return 1 - front * betaFraction(b, a, 1 - x) / b;
+}
+
+// Two sided p-value of Welch's t-test, for samples of unequal variance
+static double welchPValue(const BenchmarkResult& a, const BenchmarkResult& b) {
+	double na = (double)a.samples.size(), nb = (double)b.samples.size();
+	if (na < 2 || nb < 2)
+		return 1;
+
+	double va = a.stddev * a.stddev / na, vb = b.stddev * b.stddev / nb;
+	if (va + vb == 0)
+		return a.mean == b.mean ? 1 : 0;
+
+	double t = (b.mean - a.mean) / sqrt(va + vb);
+	double df = (va + vb) * (va + vb) / (va * va / (na - 1) + vb * vb / (nb - 1));
+	return incompleteBeta(df / 2, 0.5, df / (df + t * t));
+}
+
+bool compareBenchmarks(const string& baselineFile, const string& currentFile) {
+	vector<BenchmarkResult> baseline, current;
+	if (!readBenchmarkJson(baselineFile, baseline)) {
+		printf("Could not read %s\n", baselineFile.c_str());
+		return false;
+	}
+	if (!readBenchmarkJson(currentFile, current)) {
+		printf("Could not read %s\n", currentFile.c_str());
+		return false;
+	}
+
+	printf("%-32s %12s %12s %9s %9s\n", "benchmark", "baseline", "current", "change", "p");
+	int regressions = 0;
+	for (const BenchmarkResult& after : current) {
+		auto before = find_if(baseline.begin(), baseline.end(), [&](const BenchmarkResult& result) {
+			return result.name == after.name;
+		});
+		if (before == baseline.end()) {
+			printf("%-32s %12s %9.3f us   (new)\n", after.name.c_str(), "-", after.mean / 1e3);
+			continue;
+		}
+
+		double change = before->mean > 0 ? after.mean / before->mean - 1 : 0;
+		double p = welchPValue(*before, after);
+		bool significant = p < BENCH_SIGNIFICANCE && fabs(change) > BENCH_MIN_CHANGE;
+		const char* verdict = !significant ? "" : change > 0 ? "  REGRESSION" : "  faster";
+		regressions += significant && change > 0;
+
+		printf("%-32s %9.3f us %9.3f us %+8.1f%% %9.4f%s\n", after.name.c_str(), before->mean / 1e3, after.mean / 1e3,
+			100 * change, p, verdict);
+	}
+
+	printf("%d significant regression%s\n", regressions, regressions == 1 ? "" : "s");
+	return regressions == 0;
+}
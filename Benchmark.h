@@ -0,0 +1,87 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#define BENCH_WARMUP 3
+#define BENCH_REPETITIONS 15
+// Iterations per repetition grow until one takes at least this long
+#define BENCH_MIN_SECONDS 0.02
+
+// A slowdown is flagged when Welch's t-test gives a p-value under
+// BENCH_SIGNIFICANCE and the mean grew by more than BENCH_MIN_CHANGE,
+// so tiny but consistent shifts do not fail the gate
+#define BENCH_SIGNIFICANCE 0.01
+#define BENCH_MIN_CHANGE 0.03
+
+struct BenchmarkSettings {
+	int warmup = BENCH_WARMUP;             // Repetitions run and thrown away
+	int repetitions = BENCH_REPETITIONS;
+	double minSeconds = BENCH_MIN_SECONDS;
+	int cpu = 0;                           // Core the timing thread is pinned to, -1 for none
+	std::string filter;                    // Only benchmarks whose name contains it
+};
+
+struct BenchmarkResult {
+	std::string name;
+	size_t iterations = 0;       // Per repetition
+	size_t bytes = 0;            // Processed per iteration, 0 where throughput means nothing
+	std::vector<double> samples; // Nanoseconds per iteration, one per repetition
+	double mean = 0, median = 0, stddev = 0, min = 0, max = 0;
+};
+
+// Named benchmarks run one after another on a pinned thread. Each is
+// warmed up, then timed over several repetitions of enough iterations
+// to dwarf the clock's resolution, keeping every repetition's time so
+// runs can be compared statistically rather than by a single number.
+class BenchmarkSuite {
+public:
+	explicit BenchmarkSuite(const BenchmarkSettings& settings);
+
+	// Whether name passes the filter, to skip expensive setup
+	bool isSelected(const std::string& name) const;
+	// body runs one iteration over bytes of input, reported as GB/s
+	// when given. Ignored unless selected.
+	void add(const std::string& name, const std::function<void()>& body, size_t bytes = 0);
+
+	// Runs every benchmark added, printing each summary as it finishes
+	void run();
+
+	const std::vector<BenchmarkResult>& getResults() const;
+	bool writeJson(const std::string& filename) const;
+
+private:
+	struct Entry {
+		std::string name;
+		std::function<void()> body;
+		size_t bytes;
+	};
+
+	BenchmarkSettings settings;
+	std::vector<Entry> entries;
+	std::vector<BenchmarkResult> results;
+};
+
+bool readBenchmarkJson(const std::string& filename, std::vector<BenchmarkResult>& results);
+
+// Prints every benchmark found in both files with its change and
+// p-value. Returns false if any of them regressed significantly.
+bool compareBenchmarks(const std::string& baselineFile, const std::string& currentFile);
+
+// Returns false where affinity is unsupported or cpu does not exist
+bool pinCurrentThread(int cpu);
+
+// Stops the compiler from optimizing away a result nobody reads
+extern volatile uint64_t benchmarkSink;
+
+template <typename T>
+void keepResult(const T& value) {
+	benchmarkSink = benchmarkSink + *(const unsigned char*)&value;
+}
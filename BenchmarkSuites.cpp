@@ -0,0 +1,501 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "BenchmarkSuites.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <gl/glut.h>
+#include "Obj.h"
+#include "ObjParsing.h"
+#include "GLExtensions.h"
+#include "GeometryStreams.h"
+#include "GpuMesh.h"
+#include "Bvh.h"
+#include "Boundaries.h"
+#include "Collision.h"
+#include "Frustum.h"
+#include "IncrementalCulling.h"
+#include "Pvs.h"
+#include "RenderTarget.h"
+#include "GoldenImages.h"
+
+using namespace std;
+
+// Uploads object as the scene is drawn, optionally through quantized positions
+static void appendObject(GpuMesh& mesh, const Obj& object, bool quantize) {
+	// Every face as the quad Obj::toBuffer() draws
+	PositionStreams positions, normals;
+	for (const Face& face : object.faces) {
+		for (int j = 0; j < 4; j++) {
+			positions.push_back(object.vertices[face.vertexIds[j] - 1]);
+			normals.push_back(object.normals[face.normalIds[j] - 1]);
+		}
+	}
+
+	// Through 16 bit positions and back, as a compressed vertex format would store them
+	if (quantize) {
+		QuantizedPositions quantized;
+		quantizePositions(positions, computeBounds(positions), quantized);
+		for (size_t i = 0; i < positions.size(); i++) {
+			Point3 point = quantized.get(i);
+			positions.x[i] = point.x;
+			positions.y[i] = point.y;
+			positions.z[i] = point.z;
+		}
+	}
+
+	mesh.append(positions, normals);
+}
+
+//////////////////
+// Microbenchmarks
+
+bool runBenchmarks(const SuiteScene& scene, const BenchmarkSettings& settings, const string& outputFile) {
+	// Timing a parser that reads numbers wrong would be pointless
+	if (!checkFloatParsing())
+		return false;
+
+	BenchmarkSuite suite(settings);
+	mt19937 random(42);
+	uniform_real_distribution<float> unit(0, 1);
+
+	vector<Obj> models;
+	for (const string& filename : scene.filenames)
+		models.push_back(Obj(filename.c_str()));
+
+	// Camera positions over both floors and the stairs, in camera
+	// coordinates as correctForBoundaries() sees them
+	vector<Point3> cameras(4096);
+	for (Point3& camera : cameras)
+		camera = Point3(-12 + 24 * unit(random), unit(random) < 0.5f ? -2 : -7.53f, -11 + 22 * unit(random));
+
+	// Loader
+	suite.add("loader/parse_scene", [&]() {
+		// Without the parser's logging, which would dominate the time
+		streambuf* console = cout.rdbuf(nullptr);
+		for (const string& filename : scene.filenames)
+			keepResult(Obj(filename.c_str()).faces.size());
+		cout.rdbuf(console);
+	});
+	addParsingBenchmarks(suite, scene.filenames);
+
+	// Math kernels, over enough points to leave the caches
+	PositionStreams points, normals;
+	for (int i = 0; i < 1 << 16; i++) {
+		points.push_back(Point3(unit(random), unit(random), unit(random)) * 20);
+		normals.push_back(normalize(Point3(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f)));
+	}
+	Bounds pointBounds = computeBounds(points);
+	QuantizedPositions quantized;
+	vector<float> interleaved(points.size() * 6);
+	suite.add("math/compute_bounds", [&]() {
+		keepResult(computeBounds(points).max.x);
+	});
+	suite.add("math/quantize_positions", [&]() {
+		quantizePositions(points, pointBounds, quantized);
+		keepResult(quantized.x[0]);
+	});
+	suite.add("math/interleave_vertices", [&]() {
+		interleaveVertices(points, normals, interleaved.data());
+		keepResult(interleaved[0]);
+	});
+
+	Bvh bvh;
+	for (const Obj& object : models)
+		bvh.addObject(object, Point3(1, 1, 1));
+	bvh.build();
+	suite.add("math/bvh_build", [&]() {
+		Bvh rebuilt;
+		for (const Obj& object : models)
+			rebuilt.addObject(object, Point3(1, 1, 1));
+		rebuilt.build();
+		keepResult(rebuilt.getTriangleCount());
+	});
+	suite.add("math/bvh_rays", [&]() {
+		size_t hits = 0;
+		RayHit hit;
+		for (const Point3& camera : cameras) {
+			Point3 direction = normalize(Point3(camera.z, 0.3f, -camera.x));
+			hits += bvh.intersect(-camera, direction, 100, hit);
+		}
+		keepResult(hits);
+	});
+
+	// Collision, the pure functions and the hulls behind correctForBoundaries()
+	suite.add("collision/clamp_to_walkable", [&]() {
+		float sum = 0;
+		for (const Point3& camera : cameras)
+			sum += clampToWalkable(camera).x;
+		keepResult(sum);
+	});
+	suite.add("collision/find_teleport", [&]() {
+		int teleports = 0;
+		Point3 destination;
+		for (const Point3& camera : cameras)
+			teleports += findTeleport(camera, destination);
+		keepResult(teleports);
+	});
+	suite.add("collision/build_hulls", [&]() {
+		CollisionMesh mesh;
+		mesh.build(models[1]);
+		keepResult(mesh.getHulls().size());
+	});
+	CollisionWorld world;
+	if (suite.isSelected("collision/resolve_capsule")) {
+		for (const Obj& object : models) {
+			CollisionMesh mesh;
+			mesh.build(object);
+			world.addMesh(mesh);
+		}
+		suite.add("collision/resolve_capsule", [&]() {
+			int moved = 0;
+			for (const Point3& camera : cameras) {
+				Point3 knees(-camera.x, -camera.y - scene.kneeDepth, -camera.z);
+				moved += world.resolveCapsule(knees, scene.kneeDepth, scene.radius);
+			}
+			keepResult(moved);
+		});
+	}
+
+	// Culling, a frustum looking down the room against boxes around it
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	gluPerspective(45, (double)scene.width / scene.height, 0.1, 500);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	gluLookAt(0, 2, 0, 0, 2, 20, 0, 1, 0);
+	Frustum frustum = Frustum::fromCurrentMatrices();
+	vector<Bounds> boxes(4096);
+	for (Bounds& box : boxes) {
+		Point3 center(-12 + 24 * unit(random), 8 * unit(random), -11 + 22 * unit(random));
+		box = Bounds(center - Point3(0.5, 0.5, 0.5), center + Point3(0.5, 0.5, 0.5));
+	}
+	suite.add("culling/frustum_boxes", [&]() {
+		int inside = 0;
+		for (const Bounds& box : boxes)
+			inside += frustum.intersectsBox(box.min, box.max);
+		keepResult(inside);
+	});
+	PotentiallyVisibleSet visibility;
+	if (suite.isSelected("culling/pvs_lookup")) {
+		// From the same cache as the application, baking it if missing
+		visibility.loadOrBake(bvh, scene.floors, scene.eyeHeight, "mezzanine.pvs");
+		suite.add("culling/pvs_lookup", [&]() {
+			int inside = 0;
+			for (size_t i = 0; i < cameras.size(); i++) {
+				const VisibleTiles* visible = visibility.find(-cameras[i]);
+				inside += visible && visible->intersectsBox(boxes[i].min, boxes[i].max);
+			}
+			keepResult(inside);
+		});
+	}
+
+	// Headless rendering of the models into an offscreen target, each
+	// iteration waiting for the GPU to finish
+	RenderTarget target;
+	vector<GpuMesh*> meshes;
+	IncrementalCulling culling;
+	if (suite.isSelected("render/") && hasFramebuffers() && target.create(scene.width, scene.height, { GL_RGBA8 }, GL_DEPTH_COMPONENT24)) {
+		for (const Obj& object : models) {
+			meshes.push_back(new GpuMesh());
+			appendObject(*meshes.back(), object, false);
+		}
+
+		auto render = [&](IncrementalCulling* incremental) {
+			target.bind();
+			glEnable(GL_DEPTH_TEST);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			if (incremental)
+				incremental->beginFrame(nullptr);
+			for (GpuMesh* mesh : meshes)
+				mesh->draw(&frustum, nullptr, incremental);
+			glFinish();
+		};
+		suite.add("render/scene_offscreen", [&]() {
+			render(nullptr);
+		});
+		suite.add("render/scene_incremental_culling", [&]() {
+			render(&culling);
+		});
+	}
+	else if (suite.isSelected("render/"))
+		cout << "Framebuffers unavailable, skipping the render benchmarks" << endl;
+
+	suite.run();
+	bindDefaultFramebuffer(scene.width, scene.height);
+	for (GpuMesh* mesh : meshes)
+		delete mesh;
+
+	if (!suite.writeJson(outputFile)) {
+		cout << "Could not write " << outputFile << endl;
+		return false;
+	}
+	cout << "Results written to " << outputFile << endl;
+	return true;
+}
+
+void addParsingBenchmarks(BenchmarkSuite& suite, const vector<string>& filenames) {
+	string text;
+	for (const string& filename : filenames) {
+		ifstream file(filename, ifstream::binary);
+		text.append(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+	}
+	const char* begin = text.data();
+	const char* end = begin + text.size();
+
+	// Every number of the vertex lines, one per line so strtof stops where parseFloat does
+	string floats, integers;
+	for (const char* line = begin; line < end;) {
+		const char* lineEnd = findNewline(line, end);
+		bool vertex = line[0] == 'v', face = line[0] == 'f';
+		const char* token = findTokenEnd(line, lineEnd);
+		while ((vertex || face) && token < lineEnd) {
+			token = skipBlanks(token, lineEnd);
+			const char* tokenEnd = findTokenEnd(token, lineEnd);
+			if (vertex && token < tokenEnd)
+				floats.append(token, tokenEnd).push_back('\n');
+			// The vertex index of each corner
+			if (face && token < tokenEnd)
+				integers.append(token, find(token, tokenEnd, '/')).push_back('\n');
+			token = tokenEnd;
+		}
+		line = lineEnd + 1;
+	}
+
+	struct Scanner {
+		const char* name;
+		const char* (*findNewline)(const char*, const char*);
+		const char* (*findTokenEnd)(const char*, const char*);
+		bool supported;
+	};
+	SimdLevel level = detectSimdLevel();
+	Scanner scanners[] = {
+		{ "scalar", findNewlineScalar, findTokenEndScalar, true },
+		{ "sse2", findNewlineSSE2, findTokenEndSSE2, level >= SimdLevel::SSE2 },
+		{ "avx2", findNewlineAVX2, findTokenEndAVX2, level >= SimdLevel::AVX2 },
+	};
+	for (const Scanner& scanner : scanners) {
+		if (!scanner.supported)
+			continue;
+		suite.add(string("parsing/find_newline_") + scanner.name, [=]() {
+			size_t lines = 0;
+			for (const char* p = begin; p < end; p = scanner.findNewline(p, end) + 1)
+				lines++;
+			keepResult(lines);
+		}, text.size());
+		suite.add(string("parsing/find_token_end_") + scanner.name, [=]() {
+			size_t tokens = 0;
+			for (const char* p = begin; p < end; tokens++) {
+				p = scanner.findTokenEnd(p, end);
+				while (p < end && (unsigned char)*p <= ' ')
+					p++;
+			}
+			keepResult(tokens);
+		}, text.size());
+	}
+
+	const char* floatsBegin = floats.data();
+	const char* floatsEnd = floatsBegin + floats.size();
+	suite.add("parsing/parse_float", [=]() {
+		float sum = 0, value;
+		for (const char* p = floatsBegin; p < floatsEnd; p++) {
+			if (!(p = parseFloat(p, floatsEnd, &value)))
+				break;
+			sum += value;
+		}
+		keepResult(sum);
+	}, floats.size());
+	suite.add("parsing/strtof", [=]() {
+		float sum = 0;
+		char* next;
+		for (const char* p = floatsBegin; p < floatsEnd; p = next + 1)
+			sum += strtof(p, &next);
+		keepResult(sum);
+	}, floats.size());
+
+	const char* integersBegin = integers.data();
+	const char* integersEnd = integersBegin + integers.size();
+	suite.add("parsing/parse_int", [=]() {
+		int sum = 0, value;
+		for (const char* p = integersBegin; p < integersEnd; p++) {
+			if (!(p = parseInt(p, integersEnd, &value)))
+				break;
+			sum += value;
+		}
+		keepResult(sum);
+	}, integers.size());
+
+	// The lambdas point into them, and run after this returns
+	static vector<string> buffers;
+	buffers.push_back(move(text));
+	buffers.push_back(move(floats));
+	buffers.push_back(move(integers));
+}
+
+bool checkFloatParsing() {
+	int checked = 0, mismatches = 0;
+	auto check = [&](const string& text) {
+		float expected, parsed;
+		char* expectedEnd;
+		expected = strtof(text.c_str(), &expectedEnd);
+		const char* parsedEnd = parseFloat(text.data(), text.data() + text.size(), &parsed);
+		if (!parsedEnd)
+			parsedEnd = text.data();
+
+		uint32_t expectedBits, parsedBits;
+		memcpy(&expectedBits, &expected, sizeof(float));
+		memcpy(&parsedBits, &parsed, sizeof(float));
+		bool bothNan = isnan(expected) && isnan(parsed);
+		// Where nothing was read, strtof's value means nothing either
+		bool same = parsedEnd == expectedEnd && (parsedEnd == text.data() || bothNan || parsedBits == expectedBits);
+		if (!same && mismatches++ < 20)
+			printf("parseFloat(\"%s\") = %.9g (0x%08x, %d chars), strtof gives %.9g (0x%08x, %d chars)\n", text.c_str(), parsed,
+				parsedBits, (int)(parsedEnd - text.data()), expected, expectedBits, (int)(expectedEnd - text.c_str()));
+		checked++;
+	};
+
+	const char* edgeCases[] = {
+		"0", "-0", "+0", "0.0", "00000", "1", "-1", "+1.5", ".5", "5.", "-.5", "1e5", "1E5", "1e+5", "1e-5", "1.e5",
+		"-2.595336", "0.1", "0.2", "0.3", "3.14159265358979323846", "123456.789", "1e", "1e+", "-", ".", "e5", "+.e1",
+		// Largest float, halfway to the next binade (rounding to infinity) and just under it
+		"3.4028234664e38", "3.40282346638528859811704183484516925440e38", "3.40282356779733661637539395458142568448e38",
+		"3.40282356779733661637539395458142568447e38", "3.5e38", "1e39", "-1e39", "1e400", "1e2147483648",
+		"1e99999999999999999999", "0.000001e44",
+		// Smallest normal, subnormals, halfway below the smallest subnormal and underflow
+		"1.17549435e-38", "1.1754942e-38", "1.17549421e-38", "5e-39", "1e-40", "1.4e-45", "1.401298464e-45",
+		"7.00649232162408535461864791644958065640e-46", "7.00649232162408535461864791644958065641e-46", "7e-46",
+		"2.1e-45", "2.10194769649e-45", "1e-46", "1e-50", "1e-400", "1e-2147483649", "1e-99999999999999999999",
+		"100000000000000000000000000000000000000000000e-90",
+		// Integers halfway between two floats round to even
+		"16777216", "16777217", "16777218", "16777219", "33554434", "33554435", "33554438", "9007199254740993",
+		"0.500000029802322387695312", "0.500000029802322387695313", "1.00000005960464477539062",
+		"1.000000059604644775390625", "1.000000059604644775390625000000000000000000001", "1.00000017881393432617187499",
+		"1.000000178813934326171875",
+		// Long mantissas, past the 19 digits a uint64_t holds
+		"1.00000000000000000000000000000000000000000000000000000000001", "9999999999999999999", "99999999999999999999",
+		"18446744073709551615", "18446744073709551616", "0.0000000000000000000000000000000000000000000000001234",
+		"1234567890123456789012345678901234567890", "0.1000000000000000055511151231257827021181583404541015625",
+		"3.0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000001e-38",
+		"inf", "-inf", "INF", "infinity", "nan", "-nan", "NaN",
+	};
+	for (const char* text : edgeCases)
+		check(text);
+
+	mt19937_64 random(7);
+	char text[64];
+	for (int i = 0; i < 1000000; i++) {
+		// Any float, finite ones printed as many ways as text files hold them
+		uint32_t bits = (uint32_t)random();
+		float value;
+		memcpy(&value, &bits, sizeof(float));
+		if (!isfinite(value))
+			continue;
+		snprintf(text, sizeof(text), "%.*g", 1 + (int)(random() % 12), value);
+		check(text);
+		snprintf(text, sizeof(text), "%.*e", (int)(random() % 12), value);
+		check(text);
+		snprintf(text, sizeof(text), "%.*f", (int)(random() % 10), (double)(value - (int64_t)value) + random() % 1000);
+		check(text);
+		// Exactly halfway between value and the next float up
+		float next = nextafterf(value, INFINITY);
+		if (isfinite(next)) {
+			snprintf(text, sizeof(text), "%.40g", ((double)value + next) / 2);
+			check(text);
+		}
+	}
+	for (int i = 0; i < 200000; i++) {
+		// Random digit strings, mostly past what fits in 64 bits
+		string digits = random() % 2 ? "-" : "";
+		int length = 1 + random() % 40, point = random() % (length + 1);
+		for (int d = 0; d < length; d++) {
+			if (d == point)
+				digits += '.';
+			digits += (char)('0' + random() % 10);
+		}
+		if (random() % 2)
+			digits += "e" + to_string((int)(random() % 100) - 60);
+		check(digits);
+	}
+
+	printf("parseFloat: %d of %d inputs differ from strtof\n", mismatches, checked);
+	return mismatches == 0;
+}
+
+/////////////////
+// Golden images
+
+bool runGoldenImages(const SuiteScene& scene, bool update) {
+	GoldenSettings settings;
+	settings.update = update;
+	GoldenImageTest test(settings);
+
+	// Across the base, up the stairs and over the mezzanine
+	test.addPose("entrance", Point3(0, 2, 0), Point3(0, 2, 20));
+	test.addPose("stairs", Point3(-6, 2, -6), Point3(9, 3, 2));
+	test.addPose("mezzanine", Point3(-8, 7.53, 8), Point3(4, 3, -4));
+	test.addPose("overview", Point3(10, 9, -9), Point3(-2, 1, 2));
+	// Most of the models just outside the frustum, where culling has to be exact
+	test.addPose("edge", Point3(9, 2, 8), Point3(-12, 2, 30));
+
+	vector<Obj> models;
+	for (const string& filename : scene.filenames)
+		models.push_back(Obj(filename.c_str()));
+
+	vector<GpuMesh*> meshes, quantizedMeshes;
+	Bvh bvh;
+	for (const Obj& object : models) {
+		meshes.push_back(new GpuMesh());
+		appendObject(*meshes.back(), object, false);
+		quantizedMeshes.push_back(new GpuMesh());
+		appendObject(*quantizedMeshes.back(), object, true);
+		bvh.addObject(object, Point3(1, 1, 1));
+	}
+	bvh.build();
+	PotentiallyVisibleSet visibility;
+	visibility.loadOrBake(bvh, scene.floors, scene.eyeHeight, "mezzanine.pvs");
+	IncrementalCulling culling;
+
+	// What every optimized path has to reproduce
+	test.addPath("immediate", [&](const GoldenView& view) {
+		for (Obj& object : models)
+			object.toBuffer();
+	});
+	test.addPath("vbo", [&](const GoldenView& view) {
+		for (GpuMesh* mesh : meshes)
+			mesh->draw();
+	});
+	test.addPath("culled", [&](const GoldenView& view) {
+		for (GpuMesh* mesh : meshes)
+			mesh->draw(&view.frustum);
+	});
+	test.addPath("incremental", [&](const GoldenView& view) {
+		culling.beginFrame(nullptr);
+		for (GpuMesh* mesh : meshes)
+			mesh->draw(&view.frustum, nullptr, &culling);
+	});
+	test.addPath("pvs", [&](const GoldenView& view) {
+		const VisibleTiles* visible = visibility.find(view.eye);
+		for (GpuMesh* mesh : meshes)
+			mesh->draw(&view.frustum, visible);
+	});
+	test.addPath("quantized", [&](const GoldenView& view) {
+		for (GpuMesh* mesh : quantizedMeshes)
+			mesh->draw(&view.frustum);
+	});
+
+	bool passed = test.run();
+	bindDefaultFramebuffer(scene.width, scene.height);
+	for (GpuMesh* mesh : meshes)
+		delete mesh;
+	for (GpuMesh* mesh : quantizedMeshes)
+		delete mesh;
+	return passed;
+}
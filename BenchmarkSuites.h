@@ -0,0 +1,34 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Benchmark.h"
+#include "Coverage.h"
+
+// What the suites need to know of the application's scene and camera
+struct SuiteScene {
+	std::vector<std::string> filenames; // Models, loaded afresh by each suite
+	std::vector<FloorPlan> floors;      // Walkable areas, for the visibility cache
+	float eyeHeight = 2;                // Of the camera above its floor
+	float kneeDepth = 1.5f, radius = 0.25f; // Of the capsule colliding with the hulls
+	int width = 800, height = 600;      // Of the window and offscreen targets
+};
+
+// The microbenchmarks of --bench, written to outputFile. Checks the
+// float parser first, failing without timing anything if it is wrong.
+bool runBenchmarks(const SuiteScene& scene, const BenchmarkSettings& settings, const std::string& outputFile);
+// The text kernels behind the OBJ loader, over the scene's own files
+void addParsingBenchmarks(BenchmarkSuite& suite, const std::vector<std::string>& filenames);
+// Compares parseFloat with strtof bit for bit, and where they stop,
+// over the inputs most likely to differ and millions of random ones.
+// Prints every mismatch and returns whether there were none.
+bool checkFloatParsing();
+// Renders the scene through every draw path against the reference
+// images of --golden, first rewriting them from the reference path
+// when update is set. Needs a current context with lighting set up.
+bool runGoldenImages(const SuiteScene& scene, bool update);
@@ -0,0 +1,78 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Boundaries.h"
+
+Point3 clampToWalkable(const Point3& cameraPos) {
+	Point3 result = cameraPos;
+
+	// Base
+	result.x = clampFloat(result.x, -11.5, 11.5);
+	result.z = clampFloat(result.z, -10, 10);
+
+	// Mezzanine
+	if (result.y < -7.53) {
+		if (between(result.z, -10, -4.64)) {
+			// in front of the stairs
+			result.x = clampFloat(result.x, -5.45, 11.5);
+			if (between(result.x, -5.45, 4.5)) {
+				// beside the hole
+				result.z = clampFloat(result.z, -10, -4.64);
+			}
+		}
+		else if (between(result.z, 4.76, 10)) {
+			// opposite to the first stretch
+			result.x = clampFloat(result.x, -2.6, 11.5);
+			if (between(result.x, -2.6, 4.5)) {
+				// beside the hole
+				result.z = clampFloat(result.z, 4.76, 10);
+			}
+		}
+		else if (between(result.z, -4.64, 4.76)) {
+			// in front of the hole
+			result.x = clampFloat(result.x, 4.5, 11.5);
+		}
+	}
+
+	return result;
+}
+
+bool findTeleport(const Point3& cameraPos, Point3& destination) {
+	Point3 position = cameraPos;
+	bool moved = false;
+
+	// Lower stair step -> upper floor
+	if (between(position.x, -11.5, -7.5)
+		&& between(position.z, -2.5, -1.5)
+		&& between(position.y, -2.01, -1.99)) {
+
+		position = Point3(1.86, -7.54, -9.9);
+		moved = true;
+	}
+
+	// Upper stair step -> lower floor
+	if (between(position.x, -3.32, -2.32)
+		&& between(position.z, -10, -7.5)
+		&& between(position.y, -7.55, -7.53)) {
+
+		position = Point3(-9.35, -2, 0);
+		moved = true;
+	}
+
+	destination = position;
+	return moved;
+}
+
+float clampFloat(float value, float min, float max) {
+	if (value < min)
+		return min;
+	if (value > max)
+		return max;
+	return value;
+}
+
+bool between(float value, float min, float max) {
+	return value >= min && value <= max;
+}
@@ -0,0 +1,21 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "Point3.h"
+
+// Where the camera may walk and where the stairs take it. Positions are
+// in camera coordinates, as main.cpp keeps them: the negated eye.
+
+// Keeps cameraPos on the floors and out of the hole in the mezzanine
+Point3 clampToWalkable(const Point3& cameraPos);
+
+// Where the stair triggers send cameraPos, returning false when it is
+// in none of them
+bool findTeleport(const Point3& cameraPos, Point3& destination);
+
+float clampFloat(float value, float min, float max);
+bool between(float value, float min, float max);
@@ -0,0 +1,271 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Bvh.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// Candidate split planes per axis when building
+#define BVH_BINS 16
+
+// Leaves stop splitting at this many triangles
+#define BVH_LEAF_TRIANGLES 4
+
+// Traversal stack entries, which also bounds the depth of the tree
+#define BVH_STACK_SIZE 64
+
+static float surfaceArea(const Bounds& bounds) {
+	if (bounds.isEmpty())
+		return 0;
+	Point3 size = bounds.getSize();
+	return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static float axis(const Point3& point, int index) {
+	return index == 0 ? point.x : index == 1 ? point.y : point.z;
+}
+
+Bvh::Bvh() {
+}
+
+void Bvh::addObject(const Obj& object, const Point3& albedo) {
+	uint32_t material = (uint32_t)this->materials.size();
+	this->materials.push_back(albedo);
+
+	for (const Face& face : object.faces) {
+		Point3 corners[4];
+		for (int j = 0; j < 4; j++)
+			corners[j] = object.vertices[face.vertexIds[j] - 1];
+
+		// A triangle stored as a quad repeats its last corner
+		int count = face.vertexIds[3] == face.vertexIds[2] ? 1 : 2;
+		for (int t = 0; t < count; t++) {
+			Triangle triangle;
+			triangle.a = corners[0];
+			triangle.edge1 = corners[t + 1] - corners[0];
+			triangle.edge2 = corners[t + 2] - corners[0];
+			triangle.normal = normalize(cross(triangle.edge1, triangle.edge2));
+			triangle.material = material;
+
+			// Degenerate ones can never be hit
+			if (length(triangle.normal) > 0)
+				this->triangles.push_back(triangle);
+		}
+	}
+}
+
+void Bvh::build() {
+	this->nodes.clear();
+	if (this->triangles.empty())
+		return;
+
+	vector<Bounds> triangleBounds(this->triangles.size());
+	vector<Point3> centroids(this->triangles.size());
+	for (size_t i = 0; i < this->triangles.size(); i++) {
+		const Triangle& triangle = this->triangles[i];
+		Bounds& bounds = triangleBounds[i];
+		bounds.extend(triangle.a);
+		bounds.extend(triangle.a + triangle.edge1);
+		bounds.extend(triangle.a + triangle.edge2);
+		centroids[i] = bounds.getCenter();
+	}
+
+	this->nodes.reserve(this->triangles.size() * 2);
+	buildNode(0, (uint32_t)this->triangles.size(), 0, triangleBounds, centroids);
+}
+
+uint32_t Bvh::buildNode(uint32_t begin, uint32_t end, int depth, vector<Bounds>& triangleBounds, vector<Point3>& centroids) {
+	uint32_t index = (uint32_t)this->nodes.size();
+	this->nodes.push_back(Node());
+
+	Bounds bounds, centroidBounds;
+	for (uint32_t i = begin; i < end; i++) {
+		bounds.extend(triangleBounds[i]);
+		centroidBounds.extend(centroids[i]);
+	}
+	this->nodes[index].bounds = bounds;
+
+	uint32_t count = end - begin;
+	int bestAxis = -1;
+	int bestSplit = 0;
+	// Splitting must beat intersecting every triangle here
+	float bestCost = count * surfaceArea(bounds);
+
+	if (count > BVH_LEAF_TRIANGLES && depth < BVH_STACK_SIZE - 2) {
+		for (int a = 0; a < 3; a++) {
+			float low = axis(centroidBounds.min, a), high = axis(centroidBounds.max, a);
+			if (high <= low)
+				continue;
+
+			Bounds binBounds[BVH_BINS];
+			uint32_t binCounts[BVH_BINS] = {};
+			float scale = BVH_BINS / (high - low);
+			for (uint32_t i = begin; i < end; i++) {
+				int bin = min((int)((axis(centroids[i], a) - low) * scale), BVH_BINS - 1);
+				binBounds[bin].extend(triangleBounds[i]);
+				binCounts[bin]++;
+			}
+
+			// Sweep from the right, then from the left, pricing each plane
+			float rightArea[BVH_BINS];
+			uint32_t rightCount[BVH_BINS];
+			Bounds sweep;
+			uint32_t sum = 0;
+			for (int b = BVH_BINS - 1; b > 0; b--) {
+				sweep.extend(binBounds[b]);
+				sum += binCounts[b];
+				rightArea[b] = surfaceArea(sweep);
+				rightCount[b] = sum;
+			}
+
+			sweep = Bounds();
+			sum = 0;
+			for (int b = 0; b < BVH_BINS - 1; b++) {
+				sweep.extend(binBounds[b]);
+				sum += binCounts[b];
+				float cost = sum * surfaceArea(sweep) + rightCount[b + 1] * rightArea[b + 1];
+				if (sum > 0 && rightCount[b + 1] > 0 && cost < bestCost) {
+					bestCost = cost;
+					bestAxis = a;
+					bestSplit = b + 1;
+				}
+			}
+		}
+	}
+
+	if (bestAxis < 0) {
+		this->nodes[index].first = begin;
+		this->nodes[index].count = count;
+		return index;
+	}
+
+	// Partition triangles, and their bounds and centroids, around the plane
+	float low = axis(centroidBounds.min, bestAxis);
+	float scale = BVH_BINS / (axis(centroidBounds.max, bestAxis) - low);
+	uint32_t middle = begin;
+	for (uint32_t i = begin; i < end; i++) {
+		int bin = min((int)((axis(centroids[i], bestAxis) - low) * scale), BVH_BINS - 1);
+		if (bin < bestSplit) {
+			swap(this->triangles[i], this->triangles[middle]);
+			swap(triangleBounds[i], triangleBounds[middle]);
+			swap(centroids[i], centroids[middle]);
+			middle++;
+		}
+	}
+
+	buildNode(begin, middle, depth + 1, triangleBounds, centroids);
+	uint32_t right = buildNode(middle, end, depth + 1, triangleBounds, centroids);
+	this->nodes[index].first = right;
+	this->nodes[index].count = 0;
+	return index;
+}
+
+static bool hitsBounds(const Bounds& bounds, const Point3& origin, const Point3& inverse, float maxDistance) {
+	// Slab test
+	float t0 = (bounds.min.x - origin.x) * inverse.x, t1 = (bounds.max.x - origin.x) * inverse.x;
+	float tEntry = min(t0, t1), tExit = max(t0, t1);
+	t0 = (bounds.min.y - origin.y) * inverse.y;
+	t1 = (bounds.max.y - origin.y) * inverse.y;
+	tEntry = max(tEntry, min(t0, t1));
+	tExit = min(tExit, max(t0, t1));
+	t0 = (bounds.min.z - origin.z) * inverse.z;
+	t1 = (bounds.max.z - origin.z) * inverse.z;
+	tEntry = max(tEntry, min(t0, t1));
+	tExit = min(tExit, max(t0, t1));
+	return tEntry <= tExit && tExit >= 0 && tEntry <= maxDistance;
+}
+
+template <bool AnyHit>
+bool Bvh::traverse(const Point3& origin, const Point3& direction, float maxDistance, RayHit* hit) const {
+	if (this->nodes.empty())
+		return false;
+
+	Point3 inverse(1 / direction.x, 1 / direction.y, 1 / direction.z);
+	const Triangle* closest = nullptr;
+	float closestDistance = maxDistance;
+
+	uint32_t stack[BVH_STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const Node& node = this->nodes[stack[--top]];
+		if (!hitsBounds(node.bounds, origin, inverse, closestDistance))
+			continue;
+
+		if (node.count == 0) {
+			uint32_t left = (uint32_t)(&node - this->nodes.data()) + 1;
+			stack[top++] = node.first;
+			stack[top++] = left;
+			continue;
+		}
+
+		for (uint32_t i = node.first; i < node.first + node.count; i++) {
+			// Moller-Trumbore, two sided
+			const Triangle& triangle = this->triangles[i];
+			Point3 p = cross(direction, triangle.edge2);
+			float determinant = dot(triangle.edge1, p);
+			if (fabsf(determinant) < 1e-12f)
+				continue;
+
+			float inverseDeterminant = 1 / determinant;
+			Point3 s = origin - triangle.a;
+			float u = dot(s, p) * inverseDeterminant;
+			if (u < 0 || u > 1)
+				continue;
+
+			Point3 q = cross(s, triangle.edge1);
+			float v = dot(direction, q) * inverseDeterminant;
+			if (v < 0 || u + v > 1)
+				continue;
+
+			float t = dot(triangle.edge2, q) * inverseDeterminant;
+			if (t <= 0 || t >= closestDistance)
+				continue;
+
+			if (AnyHit)
+				return true;
+			closest = &triangle;
+			closestDistance = t;
+		}
+	}
+
+	if (!closest)
+		return false;
+
+	if (hit) {
+		hit->distance = closestDistance;
+		hit->backFace = dot(closest->normal, direction) > 0;
+		hit->normal = hit->backFace ? -closest->normal : closest->normal;
+		hit->albedo = this->materials[closest->material];
+	}
+	return true;
+}
+
+bool Bvh::intersect(const Point3& origin, const Point3& direction, float maxDistance, RayHit& hit) const {
+	return traverse<false>(origin, direction, maxDistance, &hit);
+}
+
+bool Bvh::occluded(const Point3& origin, const Point3& direction, float maxDistance) const {
+	return traverse<true>(origin, direction, maxDistance, nullptr);
+}
+
+const Bounds& Bvh::getBounds() const {
+	static const Bounds empty;
+	return this->nodes.empty() ? empty : this->nodes[0].bounds;
+}
+
+size_t Bvh::getTriangleCount() const {
+	return this->triangles.size();
+}
+
+void Bvh::getTriangle(size_t i, Point3& a, Point3& b, Point3& c) const {
+	const Triangle& triangle = this->triangles[i];
+	a = triangle.a;
+	b = triangle.a + triangle.edge1;
+	c = triangle.a + triangle.edge2;
+}
@@ -0,0 +1,66 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Obj.h"
+#include "Point3.h"
+#include "GeometryStreams.h"
+
+// Closest intersection found by Bvh::intersect
+struct RayHit {
+	float distance = 0;
+	Point3 normal;   // Geometric, facing against the ray
+	Point3 albedo;
+	bool backFace = false; // The ray came from behind the face's winding
+};
+
+// Bounding volume hierarchy over the triangles of static objects,
+// for the CPU side ray queries of bakes and visibility tools.
+// Built once with binned SAH and flattened depth first, so the left
+// child of a node always directly follows it.
+class Bvh {
+public:
+	Bvh();
+
+	// Quads are split in two triangles; albedo is reported on hits
+	void addObject(const Obj& object, const Point3& albedo);
+	void build();
+
+	// Both are safe to call from many threads at once after build()
+	bool intersect(const Point3& origin, const Point3& direction, float maxDistance, RayHit& hit) const;
+	bool occluded(const Point3& origin, const Point3& direction, float maxDistance) const;
+
+	const Bounds& getBounds() const;
+	size_t getTriangleCount() const;
+	// Corners of triangle i, in whatever order build() left them
+	void getTriangle(size_t i, Point3& a, Point3& b, Point3& c) const;
+
+private:
+	struct Triangle {
+		Point3 a, edge1, edge2;
+		Point3 normal;
+		uint32_t material;
+	};
+
+	struct Node {
+		Bounds bounds;
+		// Leaves: first triangle and count. Inner nodes: index of the
+		// right child in first, count 0.
+		uint32_t first;
+		uint32_t count;
+	};
+
+	template <bool AnyHit>
+	bool traverse(const Point3& origin, const Point3& direction, float maxDistance, RayHit* hit) const;
+
+	uint32_t buildNode(uint32_t begin, uint32_t end, int depth, std::vector<Bounds>& triangleBounds, std::vector<Point3>& centroids);
+
+	std::vector<Triangle> triangles;
+	std::vector<Point3> materials;
+	std::vector<Node> nodes;
+};
@@ -0,0 +1,323 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ByteSource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#include "JobSystem.h"
+#endif
+
+// Compressed bytes read from disk at a time
+#define INPUT_CHUNK_SIZE (256 * 1024)
+// Decompressed bytes per chunk handed to the parser
+#define OUTPUT_CHUNK_SIZE (1 << 20)
+
+using namespace std;
+
+unique_ptr<ByteSource> openByteSource(const char* filename) {
+	ifstream file;
+	file.open(filename, ifstream::in | ifstream::binary);
+	if (!file.is_open())
+		return nullptr;
+
+	unsigned char magic[4] = { 0, 0, 0, 0 };
+	file.read((char*)magic, sizeof(magic));
+	file.clear();
+	file.seekg(0);
+
+	if (magic[0] == 0x1F && magic[1] == 0x8B) {
+#ifdef HAVE_ZLIB
+		return unique_ptr<ByteSource>(new GzipSource(move(file)));
+#else
+		cout << filename << " is gzip compressed, but this build has no zlib" << endl;
+		return nullptr;
+#endif
+	}
+
+	if (magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD) {
+#ifdef HAVE_ZSTD
+		return unique_ptr<ByteSource>(new ZstdSource(move(file)));
+#else
+		cout << filename << " is zstd compressed, but this build has no zstd" << endl;
+		return nullptr;
+#endif
+	}
+
+	return unique_ptr<ByteSource>(new FileSource(move(file)));
+}
+
+//////////////
+// FileSource
+
+FileSource::FileSource(ifstream&& file) : file(move(file)) {
+}
+
+size_t FileSource::read(char* destination, size_t capacity) {
+	this->file.read(destination, capacity);
+	size_t count = (size_t)this->file.gcount();
+	this->bytesRead += count;
+	return count;
+}
+
+size_t FileSource::getBytesFromDisk() const {
+	return this->bytesRead;
+}
+
+///////////////////
+// PipelinedSource
+
+PipelinedSource::~PipelinedSource() {
+	stop();
+}
+
+void PipelinedSource::start(ifstream&& file) {
+	this->file = move(file);
+	this->producer = thread([this]() {
+		produce(this->file);
+		this->produced.store(true, memory_order_release);
+	});
+}
+
+void PipelinedSource::stop() {
+	this->stopping.store(true);
+	if (this->producer.joinable())
+		this->producer.join();
+}
+
+bool PipelinedSource::emit(vector<char>&& chunk) {
+	while (!this->chunks.tryPush(move(chunk))) {
+		if (this->stopping.load())
+			return false;
+		this_thread::yield();
+	}
+	return !this->stopping.load();
+}
+
+size_t PipelinedSource::read(char* destination, size_t capacity) {
+	size_t written = 0;
+
+	while (written < capacity) {
+		if (this->currentOffset == this->current.size()) {
+			this->current.clear();
+			this->currentOffset = 0;
+
+			if (!this->chunks.tryPop(this->current)) {
+				// Check the flag before trying again, or the last
+				// chunk could be pushed in between and missed
+				bool done = this->produced.load(memory_order_acquire);
+				if (this->chunks.tryPop(this->current))
+					continue;
+				if (done || written > 0)
+					break;
+
+				this_thread::yield();
+				continue;
+			}
+		}
+
+		size_t count = min(capacity - written, this->current.size() - this->currentOffset);
+		memcpy(destination + written, this->current.data() + this->currentOffset, count);
+		this->currentOffset += count;
+		written += count;
+	}
+
+	return written;
+}
+
+size_t PipelinedSource::getBytesFromDisk() const {
+	return this->bytesFromDisk.load();
+}
+
+//////////////
+// GzipSource
+
+#ifdef HAVE_ZLIB
+
+GzipSource::GzipSource(ifstream&& file) {
+	start(move(file));
+}
+
+GzipSource::~GzipSource() {
+	stop();
+}
+
+void GzipSource::produce(ifstream& file) {
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+	// 15 window bits, +32 to accept both gzip and zlib headers
+	if (inflateInit2(&stream, 15 + 32) != Z_OK)
+		return;
+
+	vector<char> input(INPUT_CHUNK_SIZE);
+
+	while (true) {
+		if (stream.avail_in == 0) {
+			file.read(input.data(), input.size());
+			size_t count = (size_t)file.gcount();
+			if (count == 0)
+				break;
+
+			this->bytesFromDisk += count;
+			stream.next_in = (Bytef*)input.data();
+			stream.avail_in = (uInt)count;
+		}
+
+		vector<char> output(OUTPUT_CHUNK_SIZE);
+		stream.next_out = (Bytef*)output.data();
+		stream.avail_out = (uInt)output.size();
+
+		int status = inflate(&stream, Z_NO_FLUSH);
+		if (status == Z_STREAM_END) {
+			// Concatenated gzip members (as made by pigz or cat) just continue
+			inflateReset(&stream);
+		}
+		else if (status != Z_OK && status != Z_BUF_ERROR) {
+			cout << "Corrupt gzip stream: " << (stream.msg ? stream.msg : "unknown error") << endl;
+			break;
+		}
+
+		output.resize(output.size() - stream.avail_out);
+		if (!output.empty() && !emit(move(output)))
+			break;
+	}
+
+	inflateEnd(&stream);
+}
+
+#endif
+
+//////////////
+// ZstdSource
+
+#ifdef HAVE_ZSTD
+
+// Decompresses one frame a chunk at a time, handing each chunk to sink.
+// Stops early if sink returns false.
+static void streamZstdFrame(const char* frame, size_t size, const function<bool(vector<char>&&)>& sink) {
+	ZSTD_DStream* stream = ZSTD_createDStream();
+	ZSTD_initDStream(stream);
+
+	ZSTD_inBuffer in = { frame, size, 0 };
+	while (true) {
+		vector<char> output(OUTPUT_CHUNK_SIZE);
+		ZSTD_outBuffer out = { output.data(), output.size(), 0 };
+		size_t result = ZSTD_decompressStream(stream, &out, &in);
+		output.resize(out.pos);
+
+		if (ZSTD_isError(result)) {
+			cout << "Corrupt zstd frame: " << ZSTD_getErrorName(result) << endl;
+			break;
+		}
+		if (!output.empty() && !sink(move(output)))
+			break;
+		if (result == 0 || (in.pos == in.size && out.pos < out.size))
+			break;
+	}
+
+	ZSTD_freeDStream(stream);
+}
+
+static vector<char> decompressZstdFrame(const char* frame, size_t size) {
+	vector<char> output;
+
+	unsigned long long contentSize = ZSTD_getFrameContentSize(frame, size);
+	if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN && contentSize != ZSTD_CONTENTSIZE_ERROR) {
+		output.resize((size_t)contentSize);
+		size_t result = ZSTD_decompress(output.data(), output.size(), frame, size);
+		if (ZSTD_isError(result)) {
+			cout << "Corrupt zstd frame: " << ZSTD_getErrorName(result) << endl;
+			output.clear();
+		}
+		return output;
+	}
+
+	// No size in the header, grow as we go
+	streamZstdFrame(frame, size, [&output](vector<char>&& chunk) {
+		output.insert(output.end(), chunk.begin(), chunk.end());
+		return true;
+	});
+	return output;
+}
+
+ZstdSource::ZstdSource(ifstream&& file) {
+	start(move(file));
+}
+
+ZstdSource::~ZstdSource() {
+	stop();
+}
+
+void ZstdSource::produce(ifstream& file) {
+	// Frames have to be located before they can be handed out,
+	// so the compressed file is read whole
+	file.seekg(0, ifstream::end);
+	size_t size = (size_t)file.tellg();
+	file.seekg(0);
+
+	vector<char> compressed(size);
+	file.read(compressed.data(), size);
+	size = (size_t)file.gcount();
+	this->bytesFromDisk += size;
+
+	vector<pair<size_t, size_t>> frames;
+	for (size_t offset = 0; offset < size;) {
+		size_t frameSize = ZSTD_findFrameCompressedSize(compressed.data() + offset, size - offset);
+		if (ZSTD_isError(frameSize)) {
+			cout << "Corrupt zstd stream: " << ZSTD_getErrorName(frameSize) << endl;
+			break;
+		}
+
+		frames.push_back({ offset, frameSize });
+		offset += frameSize;
+	}
+
+	if (frames.size() == 1) {
+		// Nothing to split up, but the parser can still start
+		// before the whole frame is decompressed
+		streamZstdFrame(compressed.data(), frames[0].second, [this](vector<char>&& chunk) {
+			return emit(move(chunk));
+		});
+		return;
+	}
+
+	// Keep a couple of frames per thread in flight, so memory stays
+	// bounded while the parser is slower than decompression
+	JobSystem& jobs = getJobSystem();
+	size_t window = 2 * (size_t)jobs.getThreadCount();
+	deque<future<vector<char>>> inFlight;
+	size_t next = 0;
+
+	for (size_t i = 0; i < frames.size(); i++) {
+		for (; next < frames.size() && next < i + window; next++) {
+			const char* frame = compressed.data() + frames[next].first;
+			size_t frameSize = frames[next].second;
+			inFlight.push_back(jobs.async([frame, frameSize]() {
+				return decompressZstdFrame(frame, frameSize);
+			}));
+		}
+
+		vector<char> output = inFlight.front().get();
+		inFlight.pop_front();
+		if (!output.empty() && !emit(move(output)))
+			break;
+	}
+
+	// Jobs still running read from compressed
+	for (future<vector<char>>& frame : inFlight)
+		frame.wait();
+}
+
+#endif
@@ -0,0 +1,108 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "SpscQueue.h"
+
+// Compressed formats are opt-in: defining HAVE_ZLIB or HAVE_ZSTD
+// must come with linking zlib or zstd, which the project does when
+// built with /p:MezzanineZlib=true or /p:MezzanineZstd=true
+
+// Sequential stream of bytes the OBJ loader reads from
+class ByteSource {
+public:
+	virtual ~ByteSource() {
+	}
+
+	// Fills up to capacity bytes, returning how many were written.
+	// 0 means the stream is over.
+	virtual size_t read(char* destination, size_t capacity) = 0;
+
+	// Bytes taken from disk so far, compressed or not
+	virtual size_t getBytesFromDisk() const = 0;
+};
+
+// Opens filename, picking a decompressor from the first bytes of the
+// file: gzip (.obj.gz), zstd (.obj.zst) or plain text.
+// Returns nullptr if the file cannot be read.
+std::unique_ptr<ByteSource> openByteSource(const char* filename);
+
+class FileSource : public ByteSource {
+public:
+	FileSource(std::ifstream&& file);
+
+	size_t read(char* destination, size_t capacity) override;
+	size_t getBytesFromDisk() const override;
+
+private:
+	std::ifstream file;
+	size_t bytesRead = 0;
+};
+
+// Decompresses on a thread of its own, so decompression and parsing
+// overlap. Decompressed chunks are handed to read() through a queue.
+class PipelinedSource : public ByteSource {
+public:
+	~PipelinedSource();
+
+	size_t read(char* destination, size_t capacity) override;
+	size_t getBytesFromDisk() const override;
+
+protected:
+	// Subclasses call start() last thing in their constructor
+	// and stop() first thing in their destructor
+	void start(std::ifstream&& file);
+	void stop();
+
+	// Producer thread: decompresses the whole file through emit()
+	virtual void produce(std::ifstream& file) = 0;
+
+	// Hands a decompressed chunk over to the reader, waiting while the
+	// queue is full. Returns false when the reader went away.
+	bool emit(std::vector<char>&& chunk);
+
+	std::atomic<size_t> bytesFromDisk{ 0 };
+
+private:
+	std::thread producer;
+	std::ifstream file;
+	std::atomic<bool> produced{ false };
+	std::atomic<bool> stopping{ false };
+
+	SpscQueue<std::vector<char>, 16> chunks;
+	std::vector<char> current;
+	size_t currentOffset = 0;
+};
+
+#ifdef HAVE_ZLIB
+class GzipSource : public PipelinedSource {
+public:
+	GzipSource(std::ifstream&& file);
+	~GzipSource();
+
+protected:
+	void produce(std::ifstream& file) override;
+};
+#endif
+
+#ifdef HAVE_ZSTD
+// Files made of several zstd frames (zstd -T0, pzstd) have their frames
+// decompressed in parallel on the job system, then emitted in order.
+class ZstdSource : public PipelinedSource {
+public:
+	ZstdSource(std::ifstream&& file);
+	~ZstdSource();
+
+protected:
+	void produce(std::ifstream& file) override;
+};
+#endif
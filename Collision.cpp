@@ -0,0 +1,544 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Collision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <tuple>
+#include "Metrics.h"
+
+using namespace std;
+
+// Pieces with more faces than this are split without measuring their
+// concavity, which takes time proportional to faces times corners
+#define COLLISION_MEASURE_FACES 2048
+
+// Iterations before GJK settles for its current estimate
+#define GJK_MAX_ITERATIONS 32
+// Relative to the squared distance, how little a new support point may
+// bring the estimate closer before GJK stops. Much smaller than this is
+// lost to float rounding.
+#define GJK_TOLERANCE 1e-4f
+
+static float axis(const Point3& point, int index) {
+	return index == 0 ? point.x : index == 1 ? point.y : point.z;
+}
+
+///////////////
+// ConvexHull
+Point3 ConvexHull::support(const Point3& direction) const {
+	Point3 best = this->points[0];
+	float bestDot = dot(best, direction);
+	for (size_t i = 1; i < this->points.size(); i++) {
+		float d = dot(this->points[i], direction);
+		if (d > bestDot) {
+			bestDot = d;
+			best = this->points[i];
+		}
+	}
+	return best;
+}
+
+////////
+// GJK
+
+// Closest point to the origin on a triangle, leaving in simplex only the
+// corners of the feature it lies on (Ericson 2004, 5.1.5)
+static Point3 closestOnTriangle(Point3 a, Point3 b, Point3 c, vector<Point3>& simplex) {
+	Point3 ab = b - a, ac = c - a;
+	float d1 = dot(ab, -a), d2 = dot(ac, -a);
+	if (d1 <= 0 && d2 <= 0) {
+		simplex = { a };
+		return a;
+	}
+
+	float d3 = dot(ab, -b), d4 = dot(ac, -b);
+	if (d3 >= 0 && d4 <= d3) {
+		simplex = { b };
+		return b;
+	}
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+		simplex = { a, b };
+		return a + ab * (d1 / (d1 - d3));
+	}
+
+	float d5 = dot(ab, -c), d6 = dot(ac, -c);
+	if (d6 >= 0 && d5 <= d6) {
+		simplex = { c };
+		return c;
+	}
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+		simplex = { a, c };
+		return a + ac * (d2 / (d2 - d6));
+	}
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+		simplex = { b, c };
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+
+	float denominator = 1 / (va + vb + vc);
+	simplex = { a, b, c };
+	return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// Closest point to the origin on the simplex, which shrinks to the
+// feature holding it. Zero, keeping all four, when the origin is inside.
+static Point3 closestOnSimplex(vector<Point3>& simplex) {
+	if (simplex.size() == 1)
+		return simplex[0];
+
+	if (simplex.size() == 2) {
+		Point3 a = simplex[0], b = simplex[1], ab = b - a;
+		float lengthSquared = dot(ab, ab);
+		float t = lengthSquared > 0 ? dot(-a, ab) / lengthSquared : 0;
+		if (t <= 0) {
+			simplex = { a };
+			return a;
+		}
+		if (t >= 1) {
+			simplex = { b };
+			return b;
+		}
+		return a + ab * t;
+	}
+
+	if (simplex.size() == 3)
+		return closestOnTriangle(simplex[0], simplex[1], simplex[2], simplex);
+
+	// Tetrahedron: the closest of the faces the origin is outside of
+	static const int faces[4][4] = { { 0, 1, 2, 3 }, { 0, 2, 3, 1 }, { 0, 3, 1, 2 }, { 1, 3, 2, 0 } };
+	Point3 best;
+	float bestDistance = INFINITY;
+	vector<Point3> bestSimplex, faceSimplex;
+	for (const int* face : faces) {
+		Point3 a = simplex[face[0]], b = simplex[face[1]], c = simplex[face[2]], d = simplex[face[3]];
+		Point3 normal = cross(b - a, c - a);
+		float origin = dot(-a, normal), opposite = dot(d - a, normal);
+		// Flat tetrahedra have no inside, so every face counts
+		bool outside = fabsf(opposite) < 1e-12f || origin * opposite < 0;
+		if (!outside)
+			continue;
+
+		Point3 closest = closestOnTriangle(a, b, c, faceSimplex);
+		float distance = dot(closest, closest);
+		if (distance < bestDistance) {
+			bestDistance = distance;
+			best = closest;
+			bestSimplex = faceSimplex;
+		}
+	}
+
+	if (bestDistance == INFINITY)
+		return Point3();
+	simplex = bestSimplex;
+	return best;
+}
+
+float segmentDistance(const ConvexHull& hull, const Point3& a, const Point3& b, Point3& separation) {
+	// Closest point to the origin of the Minkowski difference hull - segment
+	auto support = [&](const Point3& direction) {
+		Point3 segment = dot(a, direction) <= dot(b, direction) ? a : b;
+		return hull.support(direction) - segment;
+	};
+
+	vector<Point3> simplex = { support(Point3(1, 0, 0)) };
+	Point3 v = simplex[0];
+	for (int i = 0; i < GJK_MAX_ITERATIONS; i++) {
+		float distanceSquared = dot(v, v);
+		if (distanceSquared < 1e-10f)
+			break;
+
+		// No support point gets meaningfully closer than v, or the one
+		// found is already in the simplex and adding it again would only
+		// make it degenerate
+		Point3 w = support(-v);
+		if (distanceSquared - dot(v, w) <= GJK_TOLERANCE * distanceSquared)
+			break;
+		bool repeated = false;
+		for (const Point3& corner : simplex)
+			repeated = repeated || dot(w - corner, w - corner) <= 1e-12f * max(distanceSquared, 1.0f);
+		if (repeated)
+			break;
+
+		// Rounding on a nearly flat simplex can land further away, in
+		// which case the closest point so far is the answer
+		simplex.push_back(w);
+		Point3 next = closestOnSimplex(simplex);
+		if (dot(next, next) >= distanceSquared)
+			break;
+		v = next;
+	}
+
+	separation = -v;
+	float distance = length(v);
+	return distance < 1e-5f ? 0 : distance;
+}
+
+//////////////////
+// CollisionMesh
+void CollisionMesh::build(const Obj& object) {
+	this->hulls.clear();
+
+	// Faces sharing a corner belong to the same connected part
+	size_t faceCount = object.faces.size();
+	vector<size_t> parent(faceCount);
+	for (size_t i = 0; i < faceCount; i++)
+		parent[i] = i;
+	auto find = [&](size_t i) {
+		while (parent[i] != i)
+			i = parent[i] = parent[parent[i]];
+		return i;
+	};
+
+	map<tuple<long, long, long>, size_t> cornerFaces;
+	vector<Point3> corners(faceCount * 4);
+	for (size_t i = 0; i < faceCount; i++) {
+		for (int j = 0; j < 4; j++) {
+			Point3 corner = object.vertices[object.faces[i].vertexIds[j] - 1];
+			corners[i * 4 + j] = corner;
+
+			auto key = make_tuple(lroundf(corner.x * 1e4f), lroundf(corner.y * 1e4f), lroundf(corner.z * 1e4f));
+			auto found = cornerFaces.find(key);
+			if (found == cornerFaces.end())
+				cornerFaces.insert({ key, i });
+			else
+				parent[find(i)] = find(found->second);
+		}
+	}
+
+	map<size_t, Piece> parts;
+	for (size_t i = 0; i < faceCount; i++) {
+		const Point3* face = &corners[i * 4];
+		// Diagonals, which also works for triangles repeating a corner
+		Point3 normal = normalize(cross(face[2] - face[0], face[3] - face[1]));
+		if (length(normal) == 0)
+			continue;
+
+		Piece& piece = parts[find(i)];
+		piece.corners.insert(piece.corners.end(), face, face + 4);
+		piece.normals.push_back(normal);
+	}
+
+	for (auto& part : parts)
+		decompose(part.second, 0);
+}
+
+void CollisionMesh::decompose(Piece& piece, int depth) {
+	size_t faceCount = piece.normals.size();
+	if (faceCount == 0)
+		return;
+
+	vector<Point3> centroids(faceCount);
+	Bounds bounds;
+	for (size_t i = 0; i < faceCount; i++) {
+		const Point3* face = &piece.corners[i * 4];
+		centroids[i] = (face[0] + face[1] + face[2] + face[3]) * 0.25f;
+		bounds.extend(centroids[i]);
+	}
+
+	// How far the faces sit inside the hull. On a convex piece every
+	// face lies on its support plane, on one side or the other, which
+	// also spares relying on the winding.
+	bool convex = false;
+	if (faceCount <= COLLISION_MEASURE_FACES || depth >= COLLISION_MAX_DEPTH) {
+		float concavity = 0;
+		for (size_t i = 0; i < faceCount && concavity <= COLLISION_CONCAVITY; i++) {
+			const Point3& normal = piece.normals[i];
+			float front = -INFINITY, back = -INFINITY;
+			for (const Point3& corner : piece.corners) {
+				front = max(front, dot(corner, normal));
+				back = max(back, -dot(corner, normal));
+			}
+			float along = dot(centroids[i], normal);
+			concavity = max(concavity, min(front - along, back + along));
+		}
+		convex = concavity <= COLLISION_CONCAVITY;
+	}
+
+	if (convex || depth >= COLLISION_MAX_DEPTH || faceCount == 1) {
+		addHull(piece);
+		return;
+	}
+
+	// Halves at the median face along the longest side
+	Point3 size = bounds.getSize();
+	int longest = size.x >= size.y && size.x >= size.z ? 0 : size.y >= size.z ? 1 : 2;
+	vector<float> positions(faceCount);
+	for (size_t i = 0; i < faceCount; i++)
+		positions[i] = axis(centroids[i], longest);
+	nth_element(positions.begin(), positions.begin() + faceCount / 2, positions.end());
+	float split = positions[faceCount / 2];
+
+	Piece halves[2];
+	for (size_t i = 0; i < faceCount; i++) {
+		Piece& half = halves[axis(centroids[i], longest) < split ? 0 : 1];
+		half.corners.insert(half.corners.end(), piece.corners.begin() + i * 4, piece.corners.begin() + i * 4 + 4);
+		half.normals.push_back(piece.normals[i]);
+	}
+
+	if (halves[0].normals.empty() || halves[1].normals.empty()) {
+		addHull(piece);
+		return;
+	}
+
+	piece = Piece();
+	decompose(halves[0], depth + 1);
+	decompose(halves[1], depth + 1);
+}
+
+void CollisionMesh::addHull(const Piece& piece) {
+	ConvexHull hull;
+
+	vector<Point3> points = piece.corners;
+	auto less = [](const Point3& a, const Point3& b) {
+		return tie(a.x, a.y, a.z) < tie(b.x, b.y, b.z);
+	};
+	auto equal = [](const Point3& a, const Point3& b) {
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	};
+	sort(points.begin(), points.end(), less);
+	points.erase(unique(points.begin(), points.end(), equal), points.end());
+	hull.points = points;
+
+	// Axes of either sign are the same to the separating axis test
+	for (const Point3& normal : piece.normals) {
+		bool known = false;
+		for (const Point3& other : hull.normals)
+			known = known || fabsf(dot(normal, other)) > 0.999f;
+		if (!known)
+			hull.normals.push_back(normal);
+	}
+
+	if (hull.points.size() > COLLISION_HULL_MAX_POINTS || hull.normals.size() > COLLISION_HULL_MAX_POINTS) {
+		// Extremes along the 26 directions to the corners, edges and
+		// faces of a cube, which keeps the shape within a few percent
+		vector<Point3> directions;
+		for (int x = -1; x <= 1; x++) {
+			for (int y = -1; y <= 1; y++) {
+				for (int z = -1; z <= 1; z++) {
+					if (x != 0 || y != 0 || z != 0)
+						directions.push_back(normalize(Point3((float)x, (float)y, (float)z)));
+				}
+			}
+		}
+
+		ConvexHull full = hull;
+		hull.points.clear();
+		for (const Point3& direction : directions)
+			hull.points.push_back(full.support(direction));
+		sort(hull.points.begin(), hull.points.end(), less);
+		hull.points.erase(unique(hull.points.begin(), hull.points.end(), equal), hull.points.end());
+
+		hull.normals.assign(directions.begin(), directions.begin() + directions.size() / 2);
+	}
+
+	for (const Point3& point : hull.points)
+		hull.bounds.extend(point);
+	this->hulls.push_back(move(hull));
+}
+
+// FNV-1a over the geometry the hulls were built from
+static uint64_t fingerprint(const Obj& object) {
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&](const void* data, size_t size) {
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+	};
+
+	if (!object.vertices.empty())
+		add(object.vertices.data(), object.vertices.size() * sizeof(Point3));
+	for (const Face& face : object.faces)
+		add(face.vertexIds, sizeof(face.vertexIds));
+	return hash;
+}
+
+void CollisionMesh::loadOrBuild(const Obj& object, const string& cacheFile) {
+	static Counter& hits = getMetrics().counter("mezzanine_cache_requests_total", "Baked data looked up in its cache file",
+		metricLabel("cache", "hulls") + "," + metricLabel("result", "hit"));
+	static Counter& misses = getMetrics().counter("mezzanine_cache_requests_total", "Baked data looked up in its cache file",
+		metricLabel("cache", "hulls") + "," + metricLabel("result", "miss"));
+
+	if (load(object, cacheFile)) {
+		hits.add();
+		return;
+	}
+	misses.add();
+
+	build(object);
+	save(object, cacheFile);
+}
+
+bool CollisionMesh::load(const Obj& object, const string& cacheFile) {
+	ifstream file(cacheFile, ifstream::in | ifstream::binary);
+	if (!file.is_open())
+		return false;
+
+	auto read = [&](void* data, size_t size) {
+		return (bool)file.read((char*)data, size);
+	};
+
+	char magic[4];
+	uint32_t version, hullCount;
+	uint64_t hash;
+	if (!read(magic, 4) || memcmp(magic, "MZCH", 4) != 0 || !read(&version, 4) || version != COLLISION_CACHE_VERSION
+		|| !read(&hash, 8) || hash != fingerprint(object) || !read(&hullCount, 4))
+		return false;
+
+	vector<ConvexHull> loaded(hullCount);
+	for (ConvexHull& hull : loaded) {
+		uint32_t pointCount, normalCount;
+		if (!read(&pointCount, 4) || pointCount == 0 || pointCount > COLLISION_HULL_MAX_POINTS)
+			return false;
+		hull.points.resize(pointCount);
+		if (!read(hull.points.data(), pointCount * sizeof(Point3)))
+			return false;
+
+		if (!read(&normalCount, 4) || normalCount > COLLISION_HULL_MAX_POINTS)
+			return false;
+		hull.normals.resize(normalCount);
+		if (normalCount > 0 && !read(hull.normals.data(), normalCount * sizeof(Point3)))
+			return false;
+
+		for (const Point3& point : hull.points)
+			hull.bounds.extend(point);
+	}
+
+	this->hulls = move(loaded);
+	return true;
+}
+
+bool CollisionMesh::save(const Obj& object, const string& cacheFile) const {
+	ofstream file(cacheFile, ofstream::out | ofstream::binary | ofstream::trunc);
+	if (!file.is_open())
+		return false;
+
+	auto write = [&](const void* data, size_t size) {
+		file.write((const char*)data, size);
+	};
+
+	uint32_t version = COLLISION_CACHE_VERSION, hullCount = (uint32_t)this->hulls.size();
+	uint64_t hash = fingerprint(object);
+	write("MZCH", 4);
+	write(&version, 4);
+	write(&hash, 8);
+	write(&hullCount, 4);
+	for (const ConvexHull& hull : this->hulls) {
+		uint32_t pointCount = (uint32_t)hull.points.size(), normalCount = (uint32_t)hull.normals.size();
+		write(&pointCount, 4);
+		write(hull.points.data(), pointCount * sizeof(Point3));
+		write(&normalCount, 4);
+		if (normalCount > 0)
+			write(hull.normals.data(), normalCount * sizeof(Point3));
+	}
+	return (bool)file;
+}
+
+const vector<ConvexHull>& CollisionMesh::getHulls() const {
+	return this->hulls;
+}
+
+///////////////////
+// CollisionWorld
+void CollisionWorld::addMesh(const CollisionMesh& mesh) {
+	const vector<ConvexHull>& hulls = mesh.getHulls();
+	this->hulls.insert(this->hulls.end(), hulls.begin(), hulls.end());
+}
+
+// Shortest sideways move taking an upright capsule around center out of
+// an overlapping hull, over the hull's own face directions
+static Point3 separatingPush(const ConvexHull& hull, const Point3& center, float radius) {
+	Point3 best;
+	float bestDistance = INFINITY;
+	auto tryAxis = [&](Point3 direction) {
+		direction.y = 0;
+		if (length(direction) < 0.1f)
+			return;
+		direction = normalize(direction);
+
+		float hullMin = dot(hull.support(-direction), direction);
+		float hullMax = dot(hull.support(direction), direction);
+		float along = dot(center, direction);
+		float forward = hullMax - (along - radius), backward = (along + radius) - hullMin;
+		if (forward < bestDistance) {
+			bestDistance = forward;
+			best = direction * forward;
+		}
+		if (backward < bestDistance) {
+			bestDistance = backward;
+			best = direction * -backward;
+		}
+	};
+
+	tryAxis(Point3(1, 0, 0));
+	tryAxis(Point3(0, 0, 1));
+	for (const Point3& normal : hull.normals)
+		tryAxis(normal);
+
+	return bestDistance > 0 && bestDistance < INFINITY ? best : Point3();
+}
+
+bool CollisionWorld::resolveCapsule(Point3& base, float height, float radius) {
+	this->lastTests = 0;
+	bool moved = false;
+
+	for (int iteration = 0; iteration < COLLISION_ITERATIONS; iteration++) {
+		bool pushed = false;
+		for (const ConvexHull& hull : this->hulls) {
+			Point3 top = base + Point3(0, height, 0);
+			if (hull.bounds.max.x < base.x - radius || hull.bounds.min.x > base.x + radius
+				|| hull.bounds.max.z < base.z - radius || hull.bounds.min.z > base.z + radius
+				|| hull.bounds.max.y < base.y - radius || hull.bounds.min.y > top.y + radius)
+				continue;
+
+			this->lastTests++;
+			Point3 separation;
+			float distance = segmentDistance(hull, base, top, separation);
+			if (distance >= radius)
+				continue;
+
+			Point3 push;
+			if (distance > 0) {
+				Point3 sideways(separation.x, 0, separation.z);
+				float sidewaysLength = length(sideways);
+				// Touching from above or below, which is for the floors to handle
+				if (sidewaysLength < 1e-4f)
+					continue;
+				push = sideways * ((radius - distance) / sidewaysLength);
+			}
+			else {
+				push = separatingPush(hull, base, radius);
+			}
+
+			if (length(push) > 0) {
+				base = base + push;
+				pushed = moved = true;
+			}
+		}
+
+		if (!pushed)
+			break;
+	}
+
+	return moved;
+}
+
+size_t CollisionWorld::getHullCount() const {
+	return this->hulls.size();
+}
+
+size_t CollisionWorld::getLastTestCount() const {
+	return this->lastTests;
+}
@@ -0,0 +1,86 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Obj.h"
+#include "Point3.h"
+#include "GeometryStreams.h"
+
+// Pieces whose faces sit further than this inside their hull are split
+#define COLLISION_CONCAVITY 0.05f
+// Splits per connected component, at most
+#define COLLISION_MAX_DEPTH 10
+// Hulls with more points are reduced to their extremes along 26 directions
+#define COLLISION_HULL_MAX_POINTS 64
+// Bumped whenever the cache layout or the decomposition changes
+#define COLLISION_CACHE_VERSION 1
+// Passes resolveCapsule makes over the overlapping hulls
+#define COLLISION_ITERATIONS 4
+
+// Convex piece of an object, queried through its support mapping
+struct ConvexHull {
+	std::vector<Point3> points;
+	// Directions of its faces, for the separating axis test once GJK
+	// finds the shapes overlapping
+	std::vector<Point3> normals;
+	Bounds bounds;
+
+	// Point of the hull furthest along direction
+	Point3 support(const Point3& direction) const;
+};
+
+// Distance between hull and the segment from a to b, found with GJK.
+// separation points from the hull's closest point to the segment's,
+// and is zero when they overlap.
+float segmentDistance(const ConvexHull& hull, const Point3& a, const Point3& b, Point3& separation);
+
+// Simplified collision geometry of one object: an approximate convex
+// decomposition, splitting each connected part of the mesh until every
+// piece is close to its own hull (Lien and Amato 2004, roughly).
+class CollisionMesh {
+public:
+	void build(const Obj& object);
+
+	// Reads cacheFile if it was built from this same object, and
+	// otherwise builds the hulls and writes them there
+	void loadOrBuild(const Obj& object, const std::string& cacheFile);
+	bool load(const Obj& object, const std::string& cacheFile);
+	bool save(const Obj& object, const std::string& cacheFile) const;
+
+	const std::vector<ConvexHull>& getHulls() const;
+
+private:
+	struct Piece {
+		std::vector<Point3> corners; // 4 per face
+		std::vector<Point3> normals; // 1 per face
+	};
+
+	void decompose(Piece& piece, int depth);
+	void addHull(const Piece& piece);
+
+	std::vector<ConvexHull> hulls;
+};
+
+// Every hull the camera collides with
+class CollisionWorld {
+public:
+	void addMesh(const CollisionMesh& mesh);
+
+	// Pushes an upright capsule, the segment from base up height plus
+	// radius around it, out of every hull it overlaps. Only moves it
+	// sideways, as the floors decide its height. Returns true if moved.
+	bool resolveCapsule(Point3& base, float height, float radius);
+
+	size_t getHullCount() const;
+	// Narrow phase queries made by the last resolveCapsule()
+	size_t getLastTestCount() const;
+
+private:
+	std::vector<ConvexHull> hulls;
+	size_t lastTests = 0;
+};
@@ -0,0 +1,168 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Coverage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include "JobSystem.h"
+
+using namespace std;
+
+// Floor points sit this far above the surface, so rays do not graze it
+#define COVERAGE_SURFACE_OFFSET 0.02f
+
+bool FloorPlan::contains(float x, float z) const {
+	for (const Bounds& area : this->areas) {
+		if (x >= area.min.x && x <= area.max.x && z >= area.min.z && z <= area.max.z)
+			return true;
+	}
+	return false;
+}
+
+// Grid of spacing over floor's areas: fills the map size and returns the
+// positions of the cells on the floor, with their index in the map
+static vector<pair<Point3, size_t>> placeGrid(const FloorPlan& floor, float spacing, float height, float& minX, float& minZ, int& width, int& depth) {
+	Bounds extent;
+	for (const Bounds& area : floor.areas)
+		extent.extend(area);
+	minX = extent.min.x;
+	minZ = extent.min.z;
+	width = max(1, (int)ceilf((extent.max.x - extent.min.x) / spacing));
+	depth = max(1, (int)ceilf((extent.max.z - extent.min.z) / spacing));
+
+	vector<pair<Point3, size_t>> points;
+	for (int z = 0; z < depth; z++) {
+		for (int x = 0; x < width; x++) {
+			Point3 position(minX + (x + 0.5f) * spacing, height, minZ + (z + 0.5f) * spacing);
+			if (floor.contains(position.x, position.z))
+				points.push_back({ position, (size_t)z * width + x });
+		}
+	}
+	return points;
+}
+
+void CoverageAnalysis::run(const Bvh& scene, const vector<FloorPlan>& floors, const CoverageSettings& settings) {
+	auto start = chrono::steady_clock::now();
+
+	struct Target {
+		Point3 position;
+		size_t floor, cell;
+	};
+	struct Viewpoint {
+		Point3 position;
+		size_t floor, index;
+	};
+
+	vector<Target> targets;
+	vector<Viewpoint> viewpoints;
+	this->floors.assign(floors.size(), FloorCoverage());
+	for (size_t f = 0; f < floors.size(); f++) {
+		FloorCoverage& coverage = this->floors[f];
+		coverage.name = floors[f].name;
+
+		for (auto& cell : placeGrid(floors[f], settings.cellSize, floors[f].height + COVERAGE_SURFACE_OFFSET,
+				coverage.minX, coverage.minZ, coverage.width, coverage.depth))
+			targets.push_back({ cell.first, f, cell.second });
+		coverage.seenBy.assign((size_t)coverage.width * coverage.depth, -1);
+
+		float viewMinX, viewMinZ;
+		for (auto& view : placeGrid(floors[f], settings.viewSpacing, floors[f].height + settings.eyeHeight,
+				viewMinX, viewMinZ, coverage.viewWidth, coverage.viewDepth))
+			viewpoints.push_back({ view.first, f, view.second });
+		coverage.isovistArea.assign((size_t)coverage.viewWidth * coverage.viewDepth, -1);
+	}
+
+	// Cells seen, counted per thread and summed afterwards
+	JobSystem& jobs = getJobSystem();
+	vector<vector<uint32_t>> counts(jobs.getThreadCount());
+	vector<float> areas(viewpoints.size());
+	float cellArea = settings.cellSize * settings.cellSize;
+
+	jobs.parallelFor(viewpoints.size(), 1, [&](size_t begin, size_t end, unsigned thread) {
+		vector<uint32_t>& seen = counts[thread];
+		if (seen.empty())
+			seen.assign(targets.size(), 0);
+
+		for (size_t v = begin; v < end; v++) {
+			const Point3& eye = viewpoints[v].position;
+			size_t visible = 0;
+			for (size_t t = 0; t < targets.size(); t++) {
+				Point3 toTarget = targets[t].position - eye;
+				float distance = length(toTarget);
+				if (distance > 0 && scene.occluded(eye, toTarget * (1 / distance), distance))
+					continue;
+				seen[t]++;
+				visible++;
+			}
+			areas[v] = visible * cellArea;
+		}
+	});
+
+	for (size_t t = 0; t < targets.size(); t++) {
+		int total = 0;
+		for (const vector<uint32_t>& seen : counts)
+			total += seen.empty() ? 0 : (int)seen[t];
+		this->floors[targets[t].floor].seenBy[targets[t].cell] = total;
+	}
+	for (size_t v = 0; v < viewpoints.size(); v++)
+		this->floors[viewpoints[v].floor].isovistArea[viewpoints[v].index] = areas[v];
+
+	this->viewpointCount = viewpoints.size();
+	this->rayCount = viewpoints.size() * targets.size();
+	this->seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+const vector<FloorCoverage>& CoverageAnalysis::getFloors() const {
+	return this->floors;
+}
+
+size_t CoverageAnalysis::getViewpointCount() const {
+	return this->viewpointCount;
+}
+
+size_t CoverageAnalysis::getRayCount() const {
+	return this->rayCount;
+}
+
+double CoverageAnalysis::getSeconds() const {
+	return this->seconds;
+}
+
+// Binary greyscale, values above maximum saturating. Negative values
+// are black, the rest from dark grey up to white.
+template <typename T>
+static bool writePgm(const string& filename, const vector<T>& values, int width, int depth, float maximum) {
+	ofstream file(filename, ofstream::out | ofstream::binary | ofstream::trunc);
+	if (!file.is_open())
+		return false;
+
+	file << "P5\n" << width << " " << depth << "\n255\n";
+	vector<uint8_t> row(width);
+	for (int z = 0; z < depth; z++) {
+		for (int x = 0; x < width; x++) {
+			float value = (float)values[(size_t)z * width + x];
+			row[x] = value < 0 ? 0 : (uint8_t)(32 + 223 * min(value / max(maximum, 1e-6f), 1.0f));
+		}
+		file.write((const char*)row.data(), width);
+	}
+	return (bool)file;
+}
+
+bool CoverageAnalysis::writeMaps(const string& prefix) const {
+	bool written = true;
+	for (const FloorCoverage& floor : this->floors) {
+		float maxArea = 0;
+		for (float area : floor.isovistArea)
+			maxArea = max(maxArea, area);
+
+		written &= writePgm(prefix + "coverage_" + floor.name + ".pgm", floor.seenBy, floor.width, floor.depth, (float)this->viewpointCount);
+		written &= writePgm(prefix + "isovist_" + floor.name + ".pgm", floor.isovistArea, floor.viewWidth, floor.viewDepth, maxArea);
+	}
+	return written;
+}
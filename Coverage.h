@@ -0,0 +1,64 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Point3.h"
+#include "Bvh.h"
+#include "GeometryStreams.h"
+
+// Walkable part of one floor
+struct FloorPlan {
+	std::string name;
+	float height = 0;          // Of the walking surface
+	std::vector<Bounds> areas; // Only their x and z are used
+
+	bool contains(float x, float z) const;
+};
+
+struct CoverageSettings {
+	float cellSize = 0.1f;    // Meters between the floor points checked
+	float viewSpacing = 1.0f; // Meters between viewpoints
+	float eyeHeight = 2.0f;   // Of the viewpoints above their floor, as the camera's
+};
+
+// Maps of one floor over the rectangle bounding its areas, rows along z
+struct FloorCoverage {
+	std::string name;
+	float minX = 0, minZ = 0;
+	// Per cell: viewpoints seeing it, -1 off the floor
+	int width = 0, depth = 0;
+	std::vector<int> seenBy;
+	// Per viewpoint: square meters of floor it sees on every floor
+	// (its isovist), -1 off the floor
+	int viewWidth = 0, viewDepth = 0;
+	std::vector<float> isovistArea;
+};
+
+// Which parts of the floors can be seen from where, for sightline and
+// camera placement studies. Every viewpoint sends a batch of shadow rays,
+// one to each floor point, and the batches run on all cores.
+class CoverageAnalysis {
+public:
+	void run(const Bvh& scene, const std::vector<FloorPlan>& floors, const CoverageSettings& settings);
+
+	const std::vector<FloorCoverage>& getFloors() const;
+	size_t getViewpointCount() const;
+	size_t getRayCount() const;
+	double getSeconds() const;
+
+	// Writes <prefix>coverage_<floor>.pgm, brighter for cells seen from
+	// more viewpoints, and <prefix>isovist_<floor>.pgm, brighter for
+	// viewpoints seeing more floor. Off the floor is black.
+	bool writeMaps(const std::string& prefix) const;
+
+private:
+	std::vector<FloorCoverage> floors;
+	size_t viewpointCount = 0;
+	size_t rayCount = 0;
+	double seconds = 0;
+};
@@ -0,0 +1,185 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "DebugDraw.h"
+
+#if DEBUG_DRAW
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "GLExtensions.h"
+#include "FrameStats.h"
+#include "Hud.h"
+
+using namespace std;
+
+// Floats per line vertex: position, then color
+#define DEBUG_VERTEX_FLOATS 6
+
+// Segments of each of a sphere's three circles
+#define DEBUG_SPHERE_SEGMENTS 16
+
+struct DebugLabel {
+	Point3 position;
+	string text;
+	Point3 color;
+};
+
+// What one thread submitted this frame. Its lock is only ever contended
+// while the render thread takes the contents.
+struct DebugBuffer {
+	mutex lock;
+	vector<float> lines;
+	vector<DebugLabel> labels;
+};
+
+static mutex registryMutex;
+static vector<shared_ptr<DebugBuffer>> buffers;
+
+// Render thread state
+static vector<float> frameLines;
+static vector<DebugLabel> frameLabels;
+static GLuint lineBuffer = 0;
+
+static DebugBuffer& getThreadBuffer() {
+	thread_local shared_ptr<DebugBuffer> buffer;
+	if (!buffer) {
+		buffer = make_shared<DebugBuffer>();
+		lock_guard<mutex> lock(registryMutex);
+		buffers.push_back(buffer);
+	}
+	return *buffer;
+}
+
+static void addVertex(vector<float>& lines, const Point3& point, const Point3& color) {
+	float vertex[DEBUG_VERTEX_FLOATS] = { point.x, point.y, point.z, color.x, color.y, color.z };
+	lines.insert(lines.end(), vertex, vertex + DEBUG_VERTEX_FLOATS);
+}
+
+void debugLine(const Point3& a, const Point3& b, const Point3& color) {
+	DebugBuffer& buffer = getThreadBuffer();
+	lock_guard<mutex> lock(buffer.lock);
+	addVertex(buffer.lines, a, color);
+	addVertex(buffer.lines, b, color);
+}
+
+void debugBox(const Point3& min, const Point3& max, const Point3& color) {
+	Point3 corners[8];
+	for (int i = 0; i < 8; i++)
+		corners[i] = Point3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+
+	// Corners differing in one bit share an edge
+	static const int edges[12][2] = {
+		{ 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },
+		{ 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+		{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+	};
+
+	DebugBuffer& buffer = getThreadBuffer();
+	lock_guard<mutex> lock(buffer.lock);
+	for (const int* edge : edges) {
+		addVertex(buffer.lines, corners[edge[0]], color);
+		addVertex(buffer.lines, corners[edge[1]], color);
+	}
+}
+
+void debugSphere(const Point3& center, float radius, const Point3& color) {
+	// One circle around each axis
+	DebugBuffer& buffer = getThreadBuffer();
+	lock_guard<mutex> lock(buffer.lock);
+	for (int axis = 0; axis < 3; axis++) {
+		for (int i = 0; i < DEBUG_SPHERE_SEGMENTS; i++) {
+			for (int j = i; j <= i + 1; j++) {
+				float angle = 6.2831853f * j / DEBUG_SPHERE_SEGMENTS;
+				float c = cosf(angle) * radius, s = sinf(angle) * radius;
+				Point3 offset = axis == 0 ? Point3(0, c, s) : axis == 1 ? Point3(c, 0, s) : Point3(c, s, 0);
+				addVertex(buffer.lines, center + offset, color);
+			}
+		}
+	}
+}
+
+void debugText(const Point3& position, const string& text, const Point3& color) {
+	DebugBuffer& buffer = getThreadBuffer();
+	lock_guard<mutex> lock(buffer.lock);
+	buffer.labels.push_back({ position, text, color });
+}
+
+void renderDebugDraw(Hud& hud, int width, int height) {
+	frameLines.clear();
+	frameLabels.clear();
+
+	{
+		lock_guard<mutex> registryLock(registryMutex);
+		for (size_t i = 0; i < buffers.size();) {
+			DebugBuffer& buffer = *buffers[i];
+			{
+				lock_guard<mutex> lock(buffer.lock);
+				frameLines.insert(frameLines.end(), buffer.lines.begin(), buffer.lines.end());
+				frameLabels.insert(frameLabels.end(), buffer.labels.begin(), buffer.labels.end());
+				buffer.lines.clear();
+				buffer.labels.clear();
+			}
+
+			// Only the registry holds the buffers of threads that have ended
+			if (buffers[i].use_count() == 1)
+				buffers.erase(buffers.begin() + i);
+			else
+				i++;
+		}
+	}
+
+	if (!frameLines.empty()) {
+		glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+		glDisable(GL_LIGHTING);
+		glDisable(GL_DEPTH_TEST);
+
+		// Seen through walls, which is the point
+		const float* base = frameLines.data();
+		if (hasBufferObjects()) {
+			if (lineBuffer == 0)
+				glGenBuffers(1, &lineBuffer);
+			glBindBuffer(GL_ARRAY_BUFFER, lineBuffer);
+			glBufferData(GL_ARRAY_BUFFER, frameLines.size() * sizeof(float), base, GL_DYNAMIC_DRAW);
+			base = nullptr;
+		}
+
+		const GLsizei stride = DEBUG_VERTEX_FLOATS * sizeof(float);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+		glVertexPointer(3, GL_FLOAT, stride, base);
+		glColorPointer(3, GL_FLOAT, stride, base + 3);
+		glDrawArrays(GL_LINES, 0, (GLsizei)(frameLines.size() / DEBUG_VERTEX_FLOATS));
+		countDrawCalls();
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+
+		if (hasBufferObjects())
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glPopAttrib();
+	}
+
+	if (!frameLabels.empty()) {
+		GLdouble modelView[16], projection[16];
+		GLint viewport[4] = { 0, 0, width, height };
+		glGetDoublev(GL_MODELVIEW_MATRIX, modelView);
+		glGetDoublev(GL_PROJECTION_MATRIX, projection);
+
+		for (const DebugLabel& label : frameLabels) {
+			GLdouble x, y, z;
+			if (!gluProject(label.position.x, label.position.y, label.position.z, modelView, projection, viewport, &x, &y, &z))
+				continue;
+			// Behind the camera
+			if (z < 0 || z > 1)
+				continue;
+
+			const float color[4] = { label.color.x, label.color.y, label.color.z, 1 };
+			hud.text((float)x, (float)(height - y), label.text, color);
+		}
+	}
+}
+
+#endif
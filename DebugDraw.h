@@ -0,0 +1,57 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// Immediate debug drawing of lines, boxes, spheres and text in world
+// space, callable from any thread. Primitives last one frame: each
+// thread appends to its own buffer, and the render thread gathers every
+// buffer once a frame and draws all the lines in a single draw, with the
+// text going through the HUD's batch.
+//
+// Use the DEBUG_* macros: with DEBUG_DRAW 0, the default when NDEBUG is
+// defined, they expand to nothing and none of this is compiled in.
+
+#pragma once
+
+#include "Point3.h"
+
+#ifndef DEBUG_DRAW
+#ifdef NDEBUG
+#define DEBUG_DRAW 0
+#else
+#define DEBUG_DRAW 1
+#endif
+#endif
+
+#if DEBUG_DRAW
+
+#include <string>
+
+class Hud;
+
+void debugLine(const Point3& a, const Point3& b, const Point3& color);
+void debugBox(const Point3& min, const Point3& max, const Point3& color);
+void debugSphere(const Point3& center, float radius, const Point3& color);
+void debugText(const Point3& position, const std::string& text, const Point3& color);
+
+// Render thread only: draws what every thread submitted since the last
+// call with the current matrices, and forgets it. Labels are projected
+// to the window and handed to hud, which must be between begin and draw.
+void renderDebugDraw(Hud& hud, int width, int height);
+
+#define DEBUG_LINE(a, b, color) debugLine(a, b, color)
+#define DEBUG_BOX(min, max, color) debugBox(min, max, color)
+#define DEBUG_SPHERE(center, radius, color) debugSphere(center, radius, color)
+#define DEBUG_TEXT(position, text, color) debugText(position, text, color)
+#define DEBUG_RENDER(hud, width, height) renderDebugDraw(hud, width, height)
+
+#else
+
+#define DEBUG_LINE(a, b, color) ((void)0)
+#define DEBUG_BOX(min, max, color) ((void)0)
+#define DEBUG_SPHERE(center, radius, color) ((void)0)
+#define DEBUG_TEXT(position, text, color) ((void)0)
+#define DEBUG_RENDER(hud, width, height) ((void)0)
+
+#endif
@@ -0,0 +1,308 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "DistanceField.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include "JobSystem.h"
+
+using namespace std;
+
+// Index entries of bricks with no samples
+#define SDF_FAR_OUTSIDE 0xFFFFFFFFu
+#define SDF_FAR_INSIDE 0xFFFFFFFEu
+
+// Odd direction for the inside test, so rays rarely graze edges
+static const Point3 insideRay = normalize(Point3(0.31f, 0.89f, 0.27f));
+
+// Closest point of the triangle to p (Ericson 2004, 5.1.5)
+static Point3 closestOnTriangle(const Point3& p, const Point3& a, const Point3& b, const Point3& c) {
+	Point3 ab = b - a, ac = c - a, ap = p - a;
+	float d1 = dot(ab, ap), d2 = dot(ac, ap);
+	if (d1 <= 0 && d2 <= 0)
+		return a;
+
+	Point3 bp = p - b;
+	float d3 = dot(ab, bp), d4 = dot(ac, bp);
+	if (d3 >= 0 && d4 <= d3)
+		return b;
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0)
+		return a + ab * (d1 / (d1 - d3));
+
+	Point3 cp = p - c;
+	float d5 = dot(ab, cp), d6 = dot(ac, cp);
+	if (d6 >= 0 && d5 <= d6)
+		return c;
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0)
+		return a + ac * (d2 / (d2 - d6));
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	float denominator = 1 / (va + vb + vc);
+	return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// Inside when the first surface along a ray is seen from behind
+static bool isInside(const Bvh& scene, const Point3& position) {
+	RayHit hit;
+	return scene.intersect(position, insideRay, INFINITY, hit) && hit.backFace;
+}
+
+DistanceField::DistanceField() {
+}
+
+DistanceField::~DistanceField() {
+	if (this->atlasTexture != 0)
+		glDeleteTextures(1, &this->atlasTexture);
+	if (this->indirectionTexture != 0)
+		glDeleteTextures(1, &this->indirectionTexture);
+}
+
+void DistanceField::bake(const Bvh& scene, const Bounds& volume, const DistanceFieldSettings& settings) {
+	auto start = chrono::steady_clock::now();
+
+	this->settings = settings;
+	Point3 margin(settings.band, settings.band, settings.band);
+	this->origin = volume.min - margin;
+	Point3 size = volume.getSize() + margin * 2;
+	float brickSize = settings.voxelSize * SDF_BRICK_CELLS;
+	this->bricks[0] = max(1, (int)ceilf(size.x / brickSize));
+	this->bricks[1] = max(1, (int)ceilf(size.y / brickSize));
+	this->bricks[2] = max(1, (int)ceilf(size.z / brickSize));
+	size_t brickCount = (size_t)this->bricks[0] * this->bricks[1] * this->bricks[2];
+
+	// Each triangle goes to every brick within the band of it
+	struct Triangle {
+		Point3 a, b, c;
+	};
+	vector<Triangle> triangles(scene.getTriangleCount());
+	vector<vector<uint32_t>> binned(brickCount);
+	for (size_t i = 0; i < triangles.size(); i++) {
+		Triangle& triangle = triangles[i];
+		scene.getTriangle(i, triangle.a, triangle.b, triangle.c);
+
+		Bounds bounds;
+		bounds.extend(triangle.a);
+		bounds.extend(triangle.b);
+		bounds.extend(triangle.c);
+		Point3 low = (bounds.min - margin - this->origin) * (1 / brickSize);
+		Point3 high = (bounds.max + margin - this->origin) * (1 / brickSize);
+		int x0 = max(0, (int)floorf(low.x)), x1 = min(this->bricks[0] - 1, (int)floorf(high.x));
+		int y0 = max(0, (int)floorf(low.y)), y1 = min(this->bricks[1] - 1, (int)floorf(high.y));
+		int z0 = max(0, (int)floorf(low.z)), z1 = min(this->bricks[2] - 1, (int)floorf(high.z));
+		for (int z = z0; z <= z1; z++) {
+			for (int y = y0; y <= y1; y++) {
+				for (int x = x0; x <= x1; x++)
+					binned[brickIndex(x, y, z)].push_back((uint32_t)i);
+			}
+		}
+	}
+
+	// Bricks in the band get samples, the rest only a side
+	vector<vector<int16_t>> brickSamples(brickCount);
+	vector<uint32_t> index(brickCount);
+	getJobSystem().parallelFor(brickCount, 4, [&](size_t begin, size_t end, unsigned thread) {
+		for (size_t i = begin; i < end; i++) {
+			int bx = (int)(i % this->bricks[0]);
+			int by = (int)(i / this->bricks[0] % this->bricks[1]);
+			int bz = (int)(i / ((size_t)this->bricks[0] * this->bricks[1]));
+			Point3 corner = this->origin + Point3((float)bx, (float)by, (float)bz) * brickSize;
+
+			if (binned[i].empty()) {
+				Point3 center = corner + Point3(brickSize, brickSize, brickSize) * 0.5f;
+				index[i] = isInside(scene, center) ? SDF_FAR_INSIDE : SDF_FAR_OUTSIDE;
+				continue;
+			}
+
+			vector<int16_t> values(SDF_BRICK_VOLUME);
+			bool nearSurface = false, inside = false;
+			for (int s = 0; s < SDF_BRICK_VOLUME; s++) {
+				int sx = s % SDF_BRICK_SAMPLES, sy = s / SDF_BRICK_SAMPLES % SDF_BRICK_SAMPLES, sz = s / (SDF_BRICK_SAMPLES * SDF_BRICK_SAMPLES);
+				Point3 position = corner + Point3((float)sx, (float)sy, (float)sz) * settings.voxelSize;
+
+				float distanceSquared = INFINITY;
+				for (uint32_t t : binned[i]) {
+					const Triangle& triangle = triangles[t];
+					Point3 offset = position - closestOnTriangle(position, triangle.a, triangle.b, triangle.c);
+					distanceSquared = min(distanceSquared, dot(offset, offset));
+				}
+
+				float distance = min(sqrtf(distanceSquared), settings.band);
+				inside = isInside(scene, position);
+				if (inside)
+					distance = -distance;
+				nearSurface = nearSurface || fabsf(distance) < settings.band;
+				values[s] = (int16_t)lroundf(distance / settings.band * 32767);
+			}
+
+			if (nearSurface)
+				brickSamples[i] = move(values);
+			else
+				index[i] = inside ? SDF_FAR_INSIDE : SDF_FAR_OUTSIDE;
+		}
+	});
+
+	this->samples.clear();
+	uint32_t stored = 0;
+	for (size_t i = 0; i < brickCount; i++) {
+		if (brickSamples[i].empty())
+			continue;
+		index[i] = stored++;
+		this->samples.insert(this->samples.end(), brickSamples[i].begin(), brickSamples[i].end());
+	}
+	this->index = move(index);
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "Distance field: " << stored << " of " << brickCount << " bricks (" << settings.voxelSize << " m voxels), "
+		<< getMemoryBytes() / 1e6 << " MB (" << getDenseBytes() / 1e6 << " MB dense), baked in " << seconds << " s" << endl;
+}
+
+float DistanceField::sample(const Point3& position) const {
+	if (this->index.empty())
+		return this->settings.band;
+
+	// Cell coordinates, clamped to the grid
+	Point3 cell = (position - this->origin) * (1 / this->settings.voxelSize);
+	float coordinates[3] = { cell.x, cell.y, cell.z };
+	int brick[3], base[3];
+	float fraction[3];
+	for (int k = 0; k < 3; k++) {
+		float limit = (float)(this->bricks[k] * SDF_BRICK_CELLS);
+		float c = min(max(coordinates[k], 0.0f), limit);
+		brick[k] = min((int)(c / SDF_BRICK_CELLS), this->bricks[k] - 1);
+		float local = c - brick[k] * SDF_BRICK_CELLS;
+		base[k] = min((int)local, SDF_BRICK_CELLS - 1);
+		fraction[k] = local - base[k];
+	}
+
+	uint32_t entry = this->index[brickIndex(brick[0], brick[1], brick[2])];
+	if (entry == SDF_FAR_OUTSIDE)
+		return this->settings.band;
+	if (entry == SDF_FAR_INSIDE)
+		return -this->settings.band;
+
+	const int16_t* values = &this->samples[(size_t)entry * SDF_BRICK_VOLUME];
+	auto at = [&](int x, int y, int z) {
+		return decode(values[(base[2] + z) * SDF_BRICK_SAMPLES * SDF_BRICK_SAMPLES + (base[1] + y) * SDF_BRICK_SAMPLES + base[0] + x]);
+	};
+
+	float fx = fraction[0], fy = fraction[1], fz = fraction[2];
+	float x00 = at(0, 0, 0) + (at(1, 0, 0) - at(0, 0, 0)) * fx;
+	float x10 = at(0, 1, 0) + (at(1, 1, 0) - at(0, 1, 0)) * fx;
+	float x01 = at(0, 0, 1) + (at(1, 0, 1) - at(0, 0, 1)) * fx;
+	float x11 = at(0, 1, 1) + (at(1, 1, 1) - at(0, 1, 1)) * fx;
+	float y0 = x00 + (x10 - x00) * fy;
+	float y1 = x01 + (x11 - x01) * fy;
+	return y0 + (y1 - y0) * fz;
+}
+
+Point3 DistanceField::gradient(const Point3& position) const {
+	float h = this->settings.voxelSize * 0.5f;
+	return normalize(Point3(
+		sample(position + Point3(h, 0, 0)) - sample(position - Point3(h, 0, 0)),
+		sample(position + Point3(0, h, 0)) - sample(position - Point3(0, h, 0)),
+		sample(position + Point3(0, 0, h)) - sample(position - Point3(0, 0, h))));
+}
+
+bool DistanceField::upload() {
+	if (!hasTexture3D() || this->index.empty())
+		return false;
+
+	// Bricks laid out in a cube of bricks
+	size_t brickCount = this->samples.size() / SDF_BRICK_VOLUME;
+	int side = max(1, (int)ceil(cbrt((double)brickCount)));
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxSize);
+	if (side * SDF_BRICK_SAMPLES > maxSize || side > 256)
+		return false;
+
+	int atlasSize = side * SDF_BRICK_SAMPLES;
+	vector<float> atlas((size_t)atlasSize * atlasSize * atlasSize, this->settings.band);
+	for (size_t b = 0; b < brickCount; b++) {
+		int ax = (int)(b % side), ay = (int)(b / side % side), az = (int)(b / ((size_t)side * side));
+		for (int s = 0; s < SDF_BRICK_VOLUME; s++) {
+			int sx = s % SDF_BRICK_SAMPLES, sy = s / SDF_BRICK_SAMPLES % SDF_BRICK_SAMPLES, sz = s / (SDF_BRICK_SAMPLES * SDF_BRICK_SAMPLES);
+			size_t x = ax * SDF_BRICK_SAMPLES + sx, y = ay * SDF_BRICK_SAMPLES + sy, z = az * SDF_BRICK_SAMPLES + sz;
+			atlas[(z * atlasSize + y) * atlasSize + x] = decode(this->samples[b * SDF_BRICK_VOLUME + s]);
+		}
+	}
+
+	vector<uint8_t> indirection(this->index.size() * 4, 0);
+	for (size_t i = 0; i < this->index.size(); i++) {
+		uint32_t entry = this->index[i];
+		uint8_t* texel = &indirection[i * 4];
+		if (entry == SDF_FAR_INSIDE) {
+			texel[3] = 128;
+		}
+		else if (entry != SDF_FAR_OUTSIDE) {
+			texel[0] = (uint8_t)(entry % side);
+			texel[1] = (uint8_t)(entry / side % side);
+			texel[2] = (uint8_t)(entry / ((size_t)side * side));
+			texel[3] = 255;
+		}
+	}
+
+	auto create = [](GLuint& texture, GLint filter) {
+		if (texture == 0)
+			glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_3D, texture);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	};
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	create(this->atlasTexture, GL_LINEAR);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_R16F, atlasSize, atlasSize, atlasSize, 0, GL_RED, GL_FLOAT, atlas.data());
+	create(this->indirectionTexture, GL_NEAREST);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, this->bricks[0], this->bricks[1], this->bricks[2], 0, GL_RGBA, GL_UNSIGNED_BYTE, indirection.data());
+	glBindTexture(GL_TEXTURE_3D, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	return true;
+}
+
+GLuint DistanceField::getAtlasTexture() const {
+	return this->atlasTexture;
+}
+
+GLuint DistanceField::getIndirectionTexture() const {
+	return this->indirectionTexture;
+}
+
+bool DistanceField::isBaked() const {
+	return !this->index.empty();
+}
+
+size_t DistanceField::getBrickCount() const {
+	return this->samples.size() / SDF_BRICK_VOLUME;
+}
+
+size_t DistanceField::getMemoryBytes() const {
+	return this->index.size() * sizeof(uint32_t) + this->samples.size() * sizeof(int16_t);
+}
+
+size_t DistanceField::getDenseBytes() const {
+	size_t cells = (size_t)this->bricks[0] * this->bricks[1] * this->bricks[2] * SDF_BRICK_CELLS * SDF_BRICK_CELLS * SDF_BRICK_CELLS;
+	return cells * sizeof(float);
+}
+
+size_t DistanceField::brickIndex(int x, int y, int z) const {
+	return ((size_t)z * this->bricks[1] + y) * this->bricks[0] + x;
+}
+
+float DistanceField::decode(int16_t value) const {
+	return value * (this->settings.band / 32767);
+}
@@ -0,0 +1,71 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Point3.h"
+#include "Bvh.h"
+#include "GLExtensions.h"
+#include "GeometryStreams.h"
+
+// Cells along each side of a brick. Bricks store one sample more per
+// side, repeating their neighbours' border, so any lookup reads one brick.
+#define SDF_BRICK_CELLS 7
+#define SDF_BRICK_SAMPLES (SDF_BRICK_CELLS + 1)
+#define SDF_BRICK_VOLUME (SDF_BRICK_SAMPLES * SDF_BRICK_SAMPLES * SDF_BRICK_SAMPLES)
+
+struct DistanceFieldSettings {
+	float voxelSize = 0.1f; // Meters between samples
+	float band = 0.5f;      // Distances are exact up to this, clamped beyond
+};
+
+// Signed distance to the static scene, negative inside closed objects.
+// Only bricks within the narrow band of a surface store samples; the
+// rest record whether they are inside or out, so memory follows the
+// surface area rather than the volume. Bricks bake in parallel on the
+// job system, each measuring against the triangles binned near it.
+class DistanceField {
+public:
+	DistanceField();
+	~DistanceField();
+	DistanceField(const DistanceField&) = delete;
+	DistanceField& operator=(const DistanceField&) = delete;
+
+	void bake(const Bvh& scene, const Bounds& volume, const DistanceFieldSettings& settings);
+
+	// Trilinear distance at position, ±band beyond the band or the volume
+	float sample(const Point3& position) const;
+	// Direction of steepest increase, away from the nearest surface
+	Point3 gradient(const Point3& position) const;
+
+	// Copies the bricks into a 3D texture atlas of GL_R16F distances and
+	// a GL_RGBA8 indirection texture with one texel per brick: its
+	// atlas position in bricks in rgb, and alpha 1 for a stored brick,
+	// 0.5 for one wholly inside and 0 for one wholly outside.
+	// Returns false without 3D texture support or if the atlas is too big.
+	bool upload();
+	GLuint getAtlasTexture() const;
+	GLuint getIndirectionTexture() const;
+
+	bool isBaked() const;
+	size_t getBrickCount() const;
+	// Of the brick index and the samples, and of a dense float grid
+	size_t getMemoryBytes() const;
+	size_t getDenseBytes() const;
+
+private:
+	size_t brickIndex(int x, int y, int z) const;
+	float decode(int16_t value) const;
+
+	DistanceFieldSettings settings;
+	Point3 origin;
+	int bricks[3] = { 0, 0, 0 };
+	// Per brick: offset into samples in bricks, or one of the far markers
+	std::vector<uint32_t> index;
+	std::vector<int16_t> samples;
+	GLuint atlasTexture = 0, indirectionTexture = 0;
+};
@@ -0,0 +1,89 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "DrawCommands.h"
+
+#include <cstring>
+#include "FrameStats.h"
+
+using namespace std;
+
+// Ranges copied by each compaction job
+#define COMPACTION_GRAIN 16
+
+DrawCommandList::DrawCommandList() {
+}
+
+DrawCommandList::~DrawCommandList() {
+	if (this->buffer != 0)
+		glDeleteBuffers(1, &this->buffer);
+}
+
+void DrawCommandList::compact(size_t rangeCount) {
+	// Exclusive prefix sum: offsets[i] becomes where range i starts
+	for (size_t i = 0; i < rangeCount; i++)
+		this->offsets[i + 1] += this->offsets[i];
+
+	this->commands.resize(this->offsets[rangeCount]);
+	this->uploaded = false;
+
+	getJobSystem().parallelFor(rangeCount, COMPACTION_GRAIN, [this](size_t begin, size_t end, unsigned thread) {
+		for (size_t range = begin; range < end; range++) {
+			size_t count = this->offsets[range + 1] - this->offsets[range];
+			if (count > 0)
+				memcpy(&this->commands[this->offsets[range]], &this->scratch[range * this->grain], count * sizeof(DrawArraysCommand));
+		}
+	});
+}
+
+size_t DrawCommandList::countBefore(size_t item) const {
+	return this->offsets[(item + this->grain - 1) / this->grain];
+}
+
+size_t DrawCommandList::getCommandCount() const {
+	return this->commands.size();
+}
+
+const DrawArraysCommand* DrawCommandList::getCommands() const {
+	return this->commands.data();
+}
+
+void DrawCommandList::draw(GLenum mode, size_t begin, size_t end) {
+	if (begin >= end)
+		return;
+
+	if (hasIndirectDraw() && hasBufferObjects()) {
+		// Uploaded once, on the first draw after each generate()
+		if (this->buffer == 0)
+			glGenBuffers(1, &this->buffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->buffer);
+		if (!this->uploaded) {
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, this->commands.size() * sizeof(DrawArraysCommand), this->commands.data(), GL_DYNAMIC_DRAW);
+			this->uploaded = true;
+		}
+
+		glMultiDrawArraysIndirect(mode, (const void*)(begin * sizeof(DrawArraysCommand)), (GLsizei)(end - begin), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		countDrawCalls();
+		return;
+	}
+
+	this->firsts.clear();
+	this->counts.clear();
+	for (size_t i = begin; i < end; i++) {
+		this->firsts.push_back((GLint)this->commands[i].first);
+		this->counts.push_back((GLsizei)this->commands[i].count);
+	}
+
+	if (hasMultiDraw()) {
+		glMultiDrawArrays(mode, this->firsts.data(), this->counts.data(), (GLsizei)(end - begin));
+		countDrawCalls();
+	}
+	else {
+		for (size_t i = 0; i < this->firsts.size(); i++)
+			glDrawArrays(mode, this->firsts[i], this->counts[i]);
+		countDrawCalls((unsigned)this->firsts.size());
+	}
+}
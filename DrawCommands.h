@@ -0,0 +1,77 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <vector>
+#include "GLExtensions.h"
+#include "JobSystem.h"
+
+// Layout glMultiDrawArraysIndirect reads
+struct DrawArraysCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint first;
+	GLuint baseInstance;
+};
+
+// Draw commands for many items, generated in parallel. Each job writes
+// the commands of its range of items into its own region of a scratch
+// array, without any locking, and an exclusive prefix sum over the
+// ranges' counts then gives every region its place in one compacted
+// array, kept in item order. The array is drawn with a single indirect
+// multi-draw, or glMultiDrawArrays where that is unavailable.
+class DrawCommandList {
+public:
+	DrawCommandList();
+	~DrawCommandList();
+	DrawCommandList(const DrawCommandList&) = delete;
+	DrawCommandList& operator=(const DrawCommandList&) = delete;
+
+	// Calls emit(item, command) for every item in [0, itemCount), in
+	// ranges of grain items spread over the job system. Items for which
+	// it returns true, such as those passing culling, keep their command.
+	template <typename Emit>
+	void generate(size_t itemCount, size_t grain, Emit emit) {
+		size_t rangeCount = (itemCount + grain - 1) / grain;
+		this->scratch.resize(itemCount);
+		this->offsets.assign(rangeCount + 1, 0);
+		this->grain = grain;
+
+		JobSystem& jobs = getJobSystem();
+		jobs.parallelFor(itemCount, grain, [&](size_t begin, size_t end, unsigned thread) {
+			DrawArraysCommand* region = this->scratch.data() + begin;
+			size_t count = 0;
+			for (size_t item = begin; item < end; item++) {
+				if (emit(item, region[count]))
+					count++;
+			}
+			this->offsets[begin / grain + 1] = count;
+		});
+
+		compact(rangeCount);
+	}
+
+	// Commands of the items before item, which must be a multiple
+	// of the grain given to generate() or the item count
+	size_t countBefore(size_t item) const;
+	size_t getCommandCount() const;
+	const DrawArraysCommand* getCommands() const;
+
+	// Draws commands [begin, end) from the vertex arrays currently set
+	void draw(GLenum mode, size_t begin, size_t end);
+
+private:
+	void compact(size_t rangeCount);
+
+	std::vector<DrawArraysCommand> scratch, commands;
+	std::vector<size_t> offsets;
+	size_t grain = 1;
+
+	GLuint buffer = 0;
+	bool uploaded = false;
+	std::vector<GLint> firsts;
+	std::vector<GLsizei> counts;
+};
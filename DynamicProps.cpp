@@ -0,0 +1,88 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "DynamicProps.h"
+
+#include <gl/glut.h>
+#include "FrameStats.h"
+
+using namespace std;
+
+#define PI 3.14159265f
+
+#define SPHERE_SLICES 16
+#define SPHERE_STACKS 8
+
+DynamicProps::DynamicProps() {
+	// Ground floor loops, passing under the upper floor and through the hole
+	this->props.push_back({ Point3(0, 0.5, 0), 3, 0.5, 0.5, Point3(1, 0.3, 0.3), Point3() });
+	this->props.push_back({ Point3(0, 0.5, 0), 6, -0.3, 0.5, Point3(1, 0.8, 0.2), Point3() });
+	this->props.push_back({ Point3(-2, 0.5, 0), 8.5, 0.2, 0.5, Point3(0.3, 0.9, 1), Point3() });
+	this->props.push_back({ Point3(-1, 1.5, 0), 4.5, 0.35, 0.3, Point3(0.9, 0.9, 0.9), Point3() });
+
+	// Back and forth along the upper floor
+	this->props.push_back({ Point3(-4, 6, -8), 0, 0.4, 0.4, Point3(1, 0.5, 1), Point3() });
+	this->props.push_back({ Point3(-4, 6, 8), 0, 0.6, 0.4, Point3(0.5, 1, 1), Point3() });
+
+	for (int stack = 0; stack < SPHERE_STACKS; stack++) {
+		float theta0 = PI * stack / SPHERE_STACKS, theta1 = PI * (stack + 1) / SPHERE_STACKS;
+		for (int slice = 0; slice < SPHERE_SLICES; slice++) {
+			float phi0 = 2 * PI * slice / SPHERE_SLICES, phi1 = 2 * PI * (slice + 1) / SPHERE_SLICES;
+			this->sphere.push_back(Point3(sinf(theta0) * cosf(phi0), cosf(theta0), sinf(theta0) * sinf(phi0)));
+			this->sphere.push_back(Point3(sinf(theta1) * cosf(phi0), cosf(theta1), sinf(theta1) * sinf(phi0)));
+			this->sphere.push_back(Point3(sinf(theta1) * cosf(phi1), cosf(theta1), sinf(theta1) * sinf(phi1)));
+			this->sphere.push_back(Point3(sinf(theta0) * cosf(phi1), cosf(theta0), sinf(theta0) * sinf(phi1)));
+		}
+	}
+
+	update(0);
+}
+
+void DynamicProps::update(float seconds) {
+	for (Prop& prop : this->props) {
+		if (prop.radius > 0) {
+			float angle = seconds * prop.speed;
+			prop.position = prop.center + Point3(cosf(angle), 0, sinf(angle)) * prop.radius;
+		}
+		else {
+			// 6 meters each way
+			prop.position = prop.center + Point3(sinf(seconds * prop.speed) * 6, 0, 0);
+		}
+	}
+}
+
+void DynamicProps::draw(const LightProbeGrid* probes) const {
+	bool probeLit = probes && probes->isBaked();
+
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+	if (probeLit)
+		glDisable(GL_LIGHTING);
+
+	for (const Prop& prop : this->props) {
+		// One lookup per prop, then a few multiply-adds per vertex
+		ShIrradiance irradiance;
+		if (probeLit)
+			probes->sample(prop.position, irradiance);
+
+		glBegin(GL_QUADS);
+		for (const Point3& normal : this->sphere) {
+			if (probeLit) {
+				Point3 color = prop.albedo * irradiance.evaluate(normal, probes->getOrder());
+				glColor3f(color.x, color.y, color.z);
+			}
+			else {
+				glColor3f(prop.albedo.x, prop.albedo.y, prop.albedo.z);
+				glNormal3f(normal.x, normal.y, normal.z);
+			}
+
+			Point3 vertex = prop.position + normal * prop.size;
+			glVertex3f(vertex.x, vertex.y, vertex.z);
+		}
+		glEnd();
+		countDrawCalls();
+	}
+
+	glPopAttrib();
+}
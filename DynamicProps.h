@@ -0,0 +1,37 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <vector>
+#include "Point3.h"
+#include "LightProbes.h"
+
+// Moving spheres standing in for agents and props that are not part
+// of the baked scene. They are lit either from the light probe grid
+// or by the fixed function lights, to compare the two.
+class DynamicProps {
+public:
+	DynamicProps();
+
+	// Moves every prop along its path to where it is at time
+	void update(float seconds);
+
+	// probes may be null or not baked yet, which falls back to the lights
+	void draw(const LightProbeGrid* probes) const;
+
+private:
+	struct Prop {
+		Point3 center; // Of the path
+		float radius;  // Of the path, 0 for back and forth along x
+		float speed;   // Radians or meters per second
+		float size;
+		Point3 albedo;
+		Point3 position;
+	};
+
+	std::vector<Prop> props;
+	std::vector<Point3> sphere; // Unit sphere quads, also their normals
+};
@@ -0,0 +1,175 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "FrameStats.h"
+
+#include <sstream>
+#include <fstream>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Weight of the newest frame in the smoothed values
+#define FRAME_STATS_SMOOTHING 0.1
+
+// Draw calls issued since the current frame began
+static unsigned frameDrawCalls = 0;
+
+static void smooth(double& value, double sample) {
+	value = value == 0 ? sample : value + (sample - value) * FRAME_STATS_SMOOTHING;
+}
+
+FrameStats::FrameStats() {
+	this->frameStart = this->lastFrameStart = chrono::steady_clock::now();
+}
+
+FrameStats::~FrameStats() {
+	for (Section& section : this->sections) {
+		if (section.queries[0] != 0)
+			glDeleteQueries(FRAME_STATS_LATENCY, section.queries);
+	}
+}
+
+void FrameStats::beginFrame() {
+	this->frameStart = chrono::steady_clock::now();
+	double milliseconds = chrono::duration<double, milli>(this->frameStart - this->lastFrameStart).count();
+	smooth(this->frameMilliseconds, milliseconds);
+	this->lastFrameStart = this->frameStart;
+
+	this->frame++;
+	this->history[this->frame % FRAME_STATS_HISTORY] = (float)milliseconds;
+	this->drawCalls = frameDrawCalls;
+	frameDrawCalls = 0;
+
+	if (!hasTimerQueries())
+		return;
+
+	// Collect the results of the frame whose slot is about to be reused
+	unsigned slot = this->frame % FRAME_STATS_LATENCY;
+	for (Section& section : this->sections) {
+		if (!section.pending[slot])
+			continue;
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(section.queries[slot], GL_QUERY_RESULT, &nanoseconds);
+		smooth(section.milliseconds, nanoseconds / 1e6);
+		section.pending[slot] = false;
+	}
+}
+
+void FrameStats::endFrame() {
+	smooth(this->cpuMilliseconds, chrono::duration<double, milli>(chrono::steady_clock::now() - this->frameStart).count());
+}
+
+void FrameStats::beginGpu(const char* name) {
+	if (!hasTimerQueries() || this->openSection != (size_t)-1)
+		return;
+
+	size_t index = findSection(name);
+	Section& section = this->sections[index];
+	unsigned slot = this->frame % FRAME_STATS_LATENCY;
+
+	// Timed twice in one frame: only the first counts
+	if (section.pending[slot])
+		return;
+
+	glBeginQuery(GL_TIME_ELAPSED, section.queries[slot]);
+	section.pending[slot] = true;
+	this->openSection = index;
+}
+
+void FrameStats::endGpu() {
+	if (this->openSection == (size_t)-1)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	this->openSection = (size_t)-1;
+}
+
+double FrameStats::getFrameMilliseconds() const {
+	return this->frameMilliseconds;
+}
+
+double FrameStats::getLastFrameMilliseconds() const {
+	return this->history[this->frame % FRAME_STATS_HISTORY];
+}
+
+double FrameStats::getCpuMilliseconds() const {
+	return this->cpuMilliseconds;
+}
+
+double FrameStats::getGpuMilliseconds(const char* name) const {
+	for (const Section& section : this->sections) {
+		if (section.name == name)
+			return section.milliseconds;
+	}
+	return 0;
+}
+
+vector<pair<string, double>> FrameStats::getGpuSections() const {
+	vector<pair<string, double>> sections;
+	for (const Section& section : this->sections)
+		sections.push_back({ section.name, section.milliseconds });
+	return sections;
+}
+
+void FrameStats::getFrameHistory(float* milliseconds) const {
+	for (unsigned i = 0; i < FRAME_STATS_HISTORY; i++)
+		milliseconds[i] = this->history[(this->frame + 1 + i) % FRAME_STATS_HISTORY];
+}
+
+unsigned FrameStats::getDrawCalls() const {
+	return this->drawCalls;
+}
+
+string FrameStats::format() const {
+	ostringstream line;
+	line.setf(ios::fixed);
+	line.precision(2);
+
+	line << this->frameMilliseconds << " ms/frame (cpu " << this->cpuMilliseconds << " ms)";
+	for (const Section& section : this->sections)
+		line << " | " << section.name << " " << section.milliseconds << " ms";
+	return line.str();
+}
+
+size_t FrameStats::findSection(const char* name) {
+	for (size_t i = 0; i < this->sections.size(); i++) {
+		if (this->sections[i].name == name)
+			return i;
+	}
+
+	Section section;
+	section.name = name;
+	glGenQueries(FRAME_STATS_LATENCY, section.queries);
+	this->sections.push_back(section);
+	return this->sections.size() - 1;
+}
+
+void countDrawCalls(unsigned count) {
+	frameDrawCalls += count;
+}
+
+size_t getResidentMemory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.WorkingSetSize;
+	return 0;
+#else
+	// Second field of statm, in pages
+	ifstream statm("/proc/self/statm");
+	size_t size = 0, resident = 0;
+	if (statm >> size >> resident)
+		return resident * (size_t)sysconf(_SC_PAGESIZE);
+	return 0;
+#endif
+}
@@ -0,0 +1,79 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+#include "GLExtensions.h"
+
+// Frames of GPU timings in flight. Results are read this many frames
+// late, by which time the GPU is done with them, so reading never stalls.
+#define FRAME_STATS_LATENCY 4
+
+// Frame times kept for the history graph
+#define FRAME_STATS_HISTORY 120
+
+// Per frame timings: the whole frame on the CPU, and named sections of
+// GPU work measured with timer queries. Sections may not nest, as the
+// GPU only runs one GL_TIME_ELAPSED query at a time. Values are smoothed
+// over the last few frames.
+class FrameStats {
+public:
+	FrameStats();
+	~FrameStats();
+	FrameStats(const FrameStats&) = delete;
+	FrameStats& operator=(const FrameStats&) = delete;
+
+	void beginFrame();
+	void endFrame();
+
+	// GPU time between the two goes to the section called name
+	void beginGpu(const char* name);
+	void endGpu();
+
+	double getFrameMilliseconds() const;
+	// Unsmoothed, from the previous frame's start to this one's
+	double getLastFrameMilliseconds() const;
+	double getCpuMilliseconds() const;
+	// 0 for sections never timed
+	double getGpuMilliseconds(const char* name) const;
+	// Every section timed so far, in the order they were first seen
+	std::vector<std::pair<std::string, double>> getGpuSections() const;
+	// Unsmoothed frame times, oldest first, FRAME_STATS_HISTORY of them
+	void getFrameHistory(float* milliseconds) const;
+	// Counted by countDrawCalls during the previous frame
+	unsigned getDrawCalls() const;
+
+	// One line such as "16.7 ms/frame (cpu 2.1 ms) | ssao 0.82 ms"
+	std::string format() const;
+
+private:
+	struct Section {
+		std::string name;
+		GLuint queries[FRAME_STATS_LATENCY] = {};
+		bool pending[FRAME_STATS_LATENCY] = {};
+		double milliseconds = 0;
+	};
+
+	size_t findSection(const char* name);
+
+	std::vector<Section> sections;
+	size_t openSection = (size_t)-1;
+	unsigned frame = 0;
+
+	std::chrono::steady_clock::time_point frameStart, lastFrameStart;
+	double frameMilliseconds = 0, cpuMilliseconds = 0;
+	float history[FRAME_STATS_HISTORY] = {};
+	unsigned drawCalls = 0;
+};
+
+// Called next to every draw call issued, so the stats can report them
+void countDrawCalls(unsigned count = 1);
+
+// Physical memory used by the process, 0 where unknown
+size_t getResidentMemory();
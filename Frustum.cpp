@@ -0,0 +1,83 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Frustum.h"
+
+#include <cmath>
+#include <gl/glut.h>
+
+using namespace std;
+
+Frustum::Frustum(const float m[16]) {
+	// Gribb and Hartmann: each plane is the last row of the matrix
+	// plus or minus one of the others
+	for (int i = 0; i < 6; i++) {
+		int row = i / 2;
+		float sign = i % 2 == 0 ? 1.0f : -1.0f;
+		float length = 0;
+		for (int j = 0; j < 4; j++) {
+			this->planes[i][j] = m[j * 4 + 3] + sign * m[j * 4 + row];
+			if (j < 3)
+				length += this->planes[i][j] * this->planes[i][j];
+		}
+
+		length = sqrtf(length);
+		if (length > 0) {
+			for (int j = 0; j < 4; j++)
+				this->planes[i][j] /= length;
+		}
+	}
+}
+
+Frustum::Frustum() {
+}
+
+Frustum Frustum::fromCurrentMatrices() {
+	float projection[16], modelView[16], viewProjection[16];
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
+
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 4; row++) {
+			float sum = 0;
+			for (int k = 0; k < 4; k++)
+				sum += projection[k * 4 + row] * modelView[column * 4 + k];
+			viewProjection[column * 4 + row] = sum;
+		}
+	}
+
+	return Frustum(viewProjection);
+}
+
+bool Frustum::intersectsBox(const Point3& min, const Point3& max) const {
+	for (const float* plane : this->planes) {
+		// The corner furthest along the plane's normal
+		float x = plane[0] >= 0 ? max.x : min.x;
+		float y = plane[1] >= 0 ? max.y : min.y;
+		float z = plane[2] >= 0 ? max.z : min.z;
+		if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::intersectsBox(const Point3& min, const Point3& max, float& margin) const {
+	// Inside, the nearest plane to cross; outside, every plane rejecting
+	// the box must move past it
+	float inside = INFINITY, outside = 0;
+	for (const float* plane : this->planes) {
+		float x = plane[0] >= 0 ? max.x : min.x;
+		float y = plane[1] >= 0 ? max.y : min.y;
+		float z = plane[2] >= 0 ? max.z : min.z;
+		float distance = plane[0] * x + plane[1] * y + plane[2] * z + plane[3];
+		if (distance < 0)
+			outside = fmaxf(outside, -distance);
+		else
+			inside = fminf(inside, distance);
+	}
+
+	margin = outside > 0 ? outside : inside;
+	return outside == 0;
+}
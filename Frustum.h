@@ -0,0 +1,28 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "Point3.h"
+
+// The six planes bounding what a camera sees, facing inwards
+class Frustum {
+public:
+	// From a column major projection times modelview matrix
+	Frustum(const float viewProjection[16]);
+	Frustum();
+
+	// From the current fixed function matrices
+	static Frustum fromCurrentMatrices();
+
+	// Conservative: boxes near a corner may pass without being visible
+	bool intersectsBox(const Point3& min, const Point3& max) const;
+	// Same test, also giving how far the planes would have to move
+	// before the answer could change
+	bool intersectsBox(const Point3& min, const Point3& max, float& margin) const;
+
+private:
+	float planes[6][4] = {};
+};
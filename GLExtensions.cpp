@@ -0,0 +1,171 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "GLExtensions.h"
+
+#ifndef _WIN32
+#include <GL/glx.h>
+#endif
+
+GenBuffersProc mzGenBuffers = nullptr;
+DeleteBuffersProc mzDeleteBuffers = nullptr;
+BindBufferProc mzBindBuffer = nullptr;
+BufferDataProc mzBufferData = nullptr;
+BufferSubDataProc mzBufferSubData = nullptr;
+GenFramebuffersProc mzGenFramebuffers = nullptr;
+DeleteFramebuffersProc mzDeleteFramebuffers = nullptr;
+BindFramebufferProc mzBindFramebuffer = nullptr;
+FramebufferTexture2DProc mzFramebufferTexture2D = nullptr;
+CheckFramebufferStatusProc mzCheckFramebufferStatus = nullptr;
+BlitFramebufferProc mzBlitFramebuffer = nullptr;
+DrawBuffersProc mzDrawBuffers = nullptr;
+ActiveTextureProc mzActiveTexture = nullptr;
+BlendFuncSeparateProc mzBlendFuncSeparate = nullptr;
+CreateShaderProc mzCreateShader = nullptr;
+DeleteShaderProc mzDeleteShader = nullptr;
+ShaderSourceProc mzShaderSource = nullptr;
+CompileShaderProc mzCompileShader = nullptr;
+GetShaderivProc mzGetShaderiv = nullptr;
+GetShaderInfoLogProc mzGetShaderInfoLog = nullptr;
+CreateProgramProc mzCreateProgram = nullptr;
+DeleteProgramProc mzDeleteProgram = nullptr;
+AttachShaderProc mzAttachShader = nullptr;
+BindAttribLocationProc mzBindAttribLocation = nullptr;
+LinkProgramProc mzLinkProgram = nullptr;
+GetProgramivProc mzGetProgramiv = nullptr;
+GetProgramInfoLogProc mzGetProgramInfoLog = nullptr;
+UseProgramProc mzUseProgram = nullptr;
+GetUniformLocationProc mzGetUniformLocation = nullptr;
+Uniform1iProc mzUniform1i = nullptr;
+Uniform1fProc mzUniform1f = nullptr;
+Uniform2fProc mzUniform2f = nullptr;
+Uniform3fProc mzUniform3f = nullptr;
+Uniform4fProc mzUniform4f = nullptr;
+UniformMatrix4fvProc mzUniformMatrix4fv = nullptr;
+EnableVertexAttribArrayProc mzEnableVertexAttribArray = nullptr;
+DisableVertexAttribArrayProc mzDisableVertexAttribArray = nullptr;
+VertexAttribPointerProc mzVertexAttribPointer = nullptr;
+GenQueriesProc mzGenQueries = nullptr;
+DeleteQueriesProc mzDeleteQueries = nullptr;
+BeginQueryProc mzBeginQuery = nullptr;
+EndQueryProc mzEndQuery = nullptr;
+GetQueryObjectivProc mzGetQueryObjectiv = nullptr;
+GetQueryObjectui64vProc mzGetQueryObjectui64v = nullptr;
+DrawArraysInstancedProc mzDrawArraysInstanced = nullptr;
+VertexAttribDivisorProc mzVertexAttribDivisor = nullptr;
+MultiDrawArraysProc mzMultiDrawArrays = nullptr;
+MultiDrawArraysIndirectProc mzMultiDrawArraysIndirect = nullptr;
+TexImage3DProc mzTexImage3D = nullptr;
+TexBufferProc mzTexBuffer = nullptr;
+
+static void* getProcAddress(const char* name) {
+#ifdef _WIN32
+	void* proc = (void*)wglGetProcAddress(name);
+	// Some drivers return small sentinel values instead of null
+	if (proc == (void*)0 || proc == (void*)1 || proc == (void*)2 || proc == (void*)3 || proc == (void*)-1)
+		return nullptr;
+	return proc;
+#else
+	return (void*)glXGetProcAddressARB((const GLubyte*)name);
+#endif
+}
+
+template <typename Proc>
+static void load(Proc& proc, const char* name) {
+	proc = (Proc)getProcAddress(name);
+}
+
+void loadGLExtensions() {
+	load(mzGenBuffers, "glGenBuffers");
+	load(mzDeleteBuffers, "glDeleteBuffers");
+	load(mzBindBuffer, "glBindBuffer");
+	load(mzBufferData, "glBufferData");
+	load(mzBufferSubData, "glBufferSubData");
+	load(mzGenFramebuffers, "glGenFramebuffers");
+	load(mzDeleteFramebuffers, "glDeleteFramebuffers");
+	load(mzBindFramebuffer, "glBindFramebuffer");
+	load(mzFramebufferTexture2D, "glFramebufferTexture2D");
+	load(mzCheckFramebufferStatus, "glCheckFramebufferStatus");
+	load(mzBlitFramebuffer, "glBlitFramebuffer");
+	load(mzDrawBuffers, "glDrawBuffers");
+	load(mzActiveTexture, "glActiveTexture");
+	load(mzBlendFuncSeparate, "glBlendFuncSeparate");
+	load(mzCreateShader, "glCreateShader");
+	load(mzDeleteShader, "glDeleteShader");
+	load(mzShaderSource, "glShaderSource");
+	load(mzCompileShader, "glCompileShader");
+	load(mzGetShaderiv, "glGetShaderiv");
+	load(mzGetShaderInfoLog, "glGetShaderInfoLog");
+	load(mzCreateProgram, "glCreateProgram");
+	load(mzDeleteProgram, "glDeleteProgram");
+	load(mzAttachShader, "glAttachShader");
+	load(mzBindAttribLocation, "glBindAttribLocation");
+	load(mzLinkProgram, "glLinkProgram");
+	load(mzGetProgramiv, "glGetProgramiv");
+	load(mzGetProgramInfoLog, "glGetProgramInfoLog");
+	load(mzUseProgram, "glUseProgram");
+	load(mzGetUniformLocation, "glGetUniformLocation");
+	load(mzUniform1i, "glUniform1i");
+	load(mzUniform1f, "glUniform1f");
+	load(mzUniform2f, "glUniform2f");
+	load(mzUniform3f, "glUniform3f");
+	load(mzUniform4f, "glUniform4f");
+	load(mzUniformMatrix4fv, "glUniformMatrix4fv");
+	load(mzEnableVertexAttribArray, "glEnableVertexAttribArray");
+	load(mzDisableVertexAttribArray, "glDisableVertexAttribArray");
+	load(mzVertexAttribPointer, "glVertexAttribPointer");
+	load(mzGenQueries, "glGenQueries");
+	load(mzDeleteQueries, "glDeleteQueries");
+	load(mzBeginQuery, "glBeginQuery");
+	load(mzEndQuery, "glEndQuery");
+	load(mzGetQueryObjectiv, "glGetQueryObjectiv");
+	load(mzGetQueryObjectui64v, "glGetQueryObjectui64v");
+	load(mzDrawArraysInstanced, "glDrawArraysInstanced");
+	load(mzVertexAttribDivisor, "glVertexAttribDivisor");
+	load(mzMultiDrawArrays, "glMultiDrawArrays");
+	load(mzMultiDrawArraysIndirect, "glMultiDrawArraysIndirect");
+	load(mzTexImage3D, "glTexImage3D");
+	load(mzTexBuffer, "glTexBuffer");
+}
+
+bool hasBufferObjects() {
+	return mzGenBuffers && mzDeleteBuffers && mzBindBuffer && mzBufferData && mzBufferSubData;
+}
+
+bool hasFramebuffers() {
+	return mzGenFramebuffers && mzDeleteFramebuffers && mzBindFramebuffer && mzFramebufferTexture2D && mzCheckFramebufferStatus && mzBlitFramebuffer && mzDrawBuffers && mzActiveTexture && mzBlendFuncSeparate;
+}
+
+bool hasShaders() {
+	return mzCreateShader && mzDeleteShader && mzShaderSource && mzCompileShader && mzGetShaderiv && mzGetShaderInfoLog && mzCreateProgram && mzDeleteProgram && mzAttachShader && mzBindAttribLocation && mzLinkProgram && mzGetProgramiv && mzGetProgramInfoLog && mzUseProgram && mzGetUniformLocation && mzUniform1i && mzUniform1f && mzUniform2f && mzUniform3f && mzUniform4f && mzUniformMatrix4fv && mzEnableVertexAttribArray && mzDisableVertexAttribArray && mzVertexAttribPointer;
+}
+
+bool hasTimerQueries() {
+	return mzGenQueries && mzDeleteQueries && mzBeginQuery && mzEndQuery && mzGetQueryObjectiv && mzGetQueryObjectui64v;
+}
+
+bool hasInstancing() {
+	return mzDrawArraysInstanced && mzVertexAttribDivisor;
+}
+
+bool hasMultiDraw() {
+	return mzMultiDrawArrays;
+}
+
+bool hasIndirectDraw() {
+	return mzMultiDrawArraysIndirect;
+}
+
+bool hasTexture3D() {
+	return mzTexImage3D;
+}
+
+bool hasTextureBuffers() {
+	return mzTexBuffer;
+}
@@ -0,0 +1,351 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// Entry points past OpenGL 1.1. Windows' opengl32 only exports 1.1,
+// so everything newer is fetched from the driver once a context exists.
+// The usual gl* names are mapped onto the loaded pointers, so calling
+// code reads the same as it would with the functions linked directly.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <gl/glut.h>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+#ifndef GL_VERSION_1_5
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+#endif
+#ifndef GL_VERSION_2_0
+typedef char GLchar;
+#endif
+#ifndef GL_VERSION_3_2
+typedef uint64_t GLuint64;
+#endif
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW 0x88E4
+#endif
+#ifndef GL_DYNAMIC_DRAW
+#define GL_DYNAMIC_DRAW 0x88E8
+#endif
+
+// Buffer objects (1.5)
+typedef void (APIENTRY* GenBuffersProc)(GLsizei n, GLuint* buffers);
+typedef void (APIENTRY* DeleteBuffersProc)(GLsizei n, const GLuint* buffers);
+typedef void (APIENTRY* BindBufferProc)(GLenum target, GLuint buffer);
+typedef void (APIENTRY* BufferDataProc)(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+typedef void (APIENTRY* BufferSubDataProc)(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+
+extern GenBuffersProc mzGenBuffers;
+extern DeleteBuffersProc mzDeleteBuffers;
+extern BindBufferProc mzBindBuffer;
+extern BufferDataProc mzBufferData;
+extern BufferSubDataProc mzBufferSubData;
+
+#define glGenBuffers mzGenBuffers
+#define glDeleteBuffers mzDeleteBuffers
+#define glBindBuffer mzBindBuffer
+#define glBufferData mzBufferData
+#define glBufferSubData mzBufferSubData
+
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8D40
+#endif
+#ifndef GL_READ_FRAMEBUFFER
+#define GL_READ_FRAMEBUFFER 0x8CA8
+#endif
+#ifndef GL_DRAW_FRAMEBUFFER
+#define GL_DRAW_FRAMEBUFFER 0x8CA9
+#endif
+#ifndef GL_COLOR_ATTACHMENT0
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#endif
+#ifndef GL_DEPTH_ATTACHMENT
+#define GL_DEPTH_ATTACHMENT 0x8D00
+#endif
+#ifndef GL_FRAMEBUFFER_COMPLETE
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#endif
+#ifndef GL_DEPTH_COMPONENT24
+#define GL_DEPTH_COMPONENT24 0x81A6
+#endif
+#ifndef GL_DEPTH_COMPONENT32F
+#define GL_DEPTH_COMPONENT32F 0x8CAC
+#endif
+#ifndef GL_RGBA16F
+#define GL_RGBA16F 0x881A
+#endif
+#ifndef GL_RGBA8
+#define GL_RGBA8 0x8058
+#endif
+#ifndef GL_R8
+#define GL_R8 0x8229
+#endif
+#ifndef GL_R16F
+#define GL_R16F 0x822D
+#endif
+#ifndef GL_R32F
+#define GL_R32F 0x822E
+#endif
+#ifndef GL_RG16F
+#define GL_RG16F 0x822F
+#endif
+#ifndef GL_RG
+#define GL_RG 0x8227
+#endif
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT 0x140B
+#endif
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+#ifndef GL_TEXTURE0
+#define GL_TEXTURE0 0x84C0
+#endif
+
+// Framebuffer objects (3.0)
+typedef void (APIENTRY* GenFramebuffersProc)(GLsizei n, GLuint* framebuffers);
+typedef void (APIENTRY* DeleteFramebuffersProc)(GLsizei n, const GLuint* framebuffers);
+typedef void (APIENTRY* BindFramebufferProc)(GLenum target, GLuint framebuffer);
+typedef void (APIENTRY* FramebufferTexture2DProc)(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+typedef GLenum (APIENTRY* CheckFramebufferStatusProc)(GLenum target);
+typedef void (APIENTRY* BlitFramebufferProc)(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter);
+typedef void (APIENTRY* DrawBuffersProc)(GLsizei n, const GLenum* bufs);
+typedef void (APIENTRY* ActiveTextureProc)(GLenum texture);
+typedef void (APIENTRY* BlendFuncSeparateProc)(GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha);
+
+extern GenFramebuffersProc mzGenFramebuffers;
+extern DeleteFramebuffersProc mzDeleteFramebuffers;
+extern BindFramebufferProc mzBindFramebuffer;
+extern FramebufferTexture2DProc mzFramebufferTexture2D;
+extern CheckFramebufferStatusProc mzCheckFramebufferStatus;
+extern BlitFramebufferProc mzBlitFramebuffer;
+extern DrawBuffersProc mzDrawBuffers;
+extern ActiveTextureProc mzActiveTexture;
+extern BlendFuncSeparateProc mzBlendFuncSeparate;
+
+#define glGenFramebuffers mzGenFramebuffers
+#define glDeleteFramebuffers mzDeleteFramebuffers
+#define glBindFramebuffer mzBindFramebuffer
+#define glFramebufferTexture2D mzFramebufferTexture2D
+#define glCheckFramebufferStatus mzCheckFramebufferStatus
+#define glBlitFramebuffer mzBlitFramebuffer
+#define glDrawBuffers mzDrawBuffers
+#define glActiveTexture mzActiveTexture
+#define glBlendFuncSeparate mzBlendFuncSeparate
+
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER 0x8B30
+#endif
+#ifndef GL_VERTEX_SHADER
+#define GL_VERTEX_SHADER 0x8B31
+#endif
+#ifndef GL_COMPILE_STATUS
+#define GL_COMPILE_STATUS 0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+#define GL_LINK_STATUS 0x8B82
+#endif
+#ifndef GL_INFO_LOG_LENGTH
+#define GL_INFO_LOG_LENGTH 0x8B84
+#endif
+
+// Shaders (2.0)
+typedef GLuint (APIENTRY* CreateShaderProc)(GLenum type);
+typedef void (APIENTRY* DeleteShaderProc)(GLuint shader);
+typedef void (APIENTRY* ShaderSourceProc)(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length);
+typedef void (APIENTRY* CompileShaderProc)(GLuint shader);
+typedef void (APIENTRY* GetShaderivProc)(GLuint shader, GLenum pname, GLint* params);
+typedef void (APIENTRY* GetShaderInfoLogProc)(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog);
+typedef GLuint (APIENTRY* CreateProgramProc)(void);
+typedef void (APIENTRY* DeleteProgramProc)(GLuint program);
+typedef void (APIENTRY* AttachShaderProc)(GLuint program, GLuint shader);
+typedef void (APIENTRY* BindAttribLocationProc)(GLuint program, GLuint index, const GLchar* name);
+typedef void (APIENTRY* LinkProgramProc)(GLuint program);
+typedef void (APIENTRY* GetProgramivProc)(GLuint program, GLenum pname, GLint* params);
+typedef void (APIENTRY* GetProgramInfoLogProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog);
+typedef void (APIENTRY* UseProgramProc)(GLuint program);
+typedef GLint (APIENTRY* GetUniformLocationProc)(GLuint program, const GLchar* name);
+typedef void (APIENTRY* Uniform1iProc)(GLint location, GLint v0);
+typedef void (APIENTRY* Uniform1fProc)(GLint location, GLfloat v0);
+typedef void (APIENTRY* Uniform2fProc)(GLint location, GLfloat v0, GLfloat v1);
+typedef void (APIENTRY* Uniform3fProc)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+typedef void (APIENTRY* Uniform4fProc)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+typedef void (APIENTRY* UniformMatrix4fvProc)(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+typedef void (APIENTRY* EnableVertexAttribArrayProc)(GLuint index);
+typedef void (APIENTRY* DisableVertexAttribArrayProc)(GLuint index);
+typedef void (APIENTRY* VertexAttribPointerProc)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer);
+
+extern CreateShaderProc mzCreateShader;
+extern DeleteShaderProc mzDeleteShader;
+extern ShaderSourceProc mzShaderSource;
+extern CompileShaderProc mzCompileShader;
+extern GetShaderivProc mzGetShaderiv;
+extern GetShaderInfoLogProc mzGetShaderInfoLog;
+extern CreateProgramProc mzCreateProgram;
+extern DeleteProgramProc mzDeleteProgram;
+extern AttachShaderProc mzAttachShader;
+extern BindAttribLocationProc mzBindAttribLocation;
+extern LinkProgramProc mzLinkProgram;
+extern GetProgramivProc mzGetProgramiv;
+extern GetProgramInfoLogProc mzGetProgramInfoLog;
+extern UseProgramProc mzUseProgram;
+extern GetUniformLocationProc mzGetUniformLocation;
+extern Uniform1iProc mzUniform1i;
+extern Uniform1fProc mzUniform1f;
+extern Uniform2fProc mzUniform2f;
+extern Uniform3fProc mzUniform3f;
+extern Uniform4fProc mzUniform4f;
+extern UniformMatrix4fvProc mzUniformMatrix4fv;
+extern EnableVertexAttribArrayProc mzEnableVertexAttribArray;
+extern DisableVertexAttribArrayProc mzDisableVertexAttribArray;
+extern VertexAttribPointerProc mzVertexAttribPointer;
+
+#define glCreateShader mzCreateShader
+#define glDeleteShader mzDeleteShader
+#define glShaderSource mzShaderSource
+#define glCompileShader mzCompileShader
+#define glGetShaderiv mzGetShaderiv
+#define glGetShaderInfoLog mzGetShaderInfoLog
+#define glCreateProgram mzCreateProgram
+#define glDeleteProgram mzDeleteProgram
+#define glAttachShader mzAttachShader
+#define glBindAttribLocation mzBindAttribLocation
+#define glLinkProgram mzLinkProgram
+#define glGetProgramiv mzGetProgramiv
+#define glGetProgramInfoLog mzGetProgramInfoLog
+#define glUseProgram mzUseProgram
+#define glGetUniformLocation mzGetUniformLocation
+#define glUniform1i mzUniform1i
+#define glUniform1f mzUniform1f
+#define glUniform2f mzUniform2f
+#define glUniform3f mzUniform3f
+#define glUniform4f mzUniform4f
+#define glUniformMatrix4fv mzUniformMatrix4fv
+#define glEnableVertexAttribArray mzEnableVertexAttribArray
+#define glDisableVertexAttribArray mzDisableVertexAttribArray
+#define glVertexAttribPointer mzVertexAttribPointer
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+
+// Timer queries (OpenGL 3.3 / ARB_timer_query)
+typedef void (APIENTRY* GenQueriesProc)(GLsizei n, GLuint* ids);
+typedef void (APIENTRY* DeleteQueriesProc)(GLsizei n, const GLuint* ids);
+typedef void (APIENTRY* BeginQueryProc)(GLenum target, GLuint id);
+typedef void (APIENTRY* EndQueryProc)(GLenum target);
+typedef void (APIENTRY* GetQueryObjectivProc)(GLuint id, GLenum pname, GLint* params);
+typedef void (APIENTRY* GetQueryObjectui64vProc)(GLuint id, GLenum pname, GLuint64* params);
+
+extern GenQueriesProc mzGenQueries;
+extern DeleteQueriesProc mzDeleteQueries;
+extern BeginQueryProc mzBeginQuery;
+extern EndQueryProc mzEndQuery;
+extern GetQueryObjectivProc mzGetQueryObjectiv;
+extern GetQueryObjectui64vProc mzGetQueryObjectui64v;
+
+#define glGenQueries mzGenQueries
+#define glDeleteQueries mzDeleteQueries
+#define glBeginQuery mzBeginQuery
+#define glEndQuery mzEndQuery
+#define glGetQueryObjectiv mzGetQueryObjectiv
+#define glGetQueryObjectui64v mzGetQueryObjectui64v
+
+// Instanced drawing (OpenGL 3.3 / ARB_instanced_arrays)
+typedef void (APIENTRY* DrawArraysInstancedProc)(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount);
+typedef void (APIENTRY* VertexAttribDivisorProc)(GLuint index, GLuint divisor);
+
+extern DrawArraysInstancedProc mzDrawArraysInstanced;
+extern VertexAttribDivisorProc mzVertexAttribDivisor;
+
+#define glDrawArraysInstanced mzDrawArraysInstanced
+#define glVertexAttribDivisor mzVertexAttribDivisor
+
+// Multi-draw (OpenGL 1.4)
+typedef void (APIENTRY* MultiDrawArraysProc)(GLenum mode, const GLint* first, const GLsizei* count, GLsizei drawCount);
+
+extern MultiDrawArraysProc mzMultiDrawArrays;
+
+#define glMultiDrawArrays mzMultiDrawArrays
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// Indirect multi-draw (OpenGL 4.3 / ARB_multi_draw_indirect)
+typedef void (APIENTRY* MultiDrawArraysIndirectProc)(GLenum mode, const void* indirect, GLsizei drawCount, GLsizei stride);
+
+extern MultiDrawArraysIndirectProc mzMultiDrawArraysIndirect;
+
+#define glMultiDrawArraysIndirect mzMultiDrawArraysIndirect
+
+#ifndef GL_TEXTURE_3D
+#define GL_TEXTURE_3D 0x806F
+#endif
+#ifndef GL_TEXTURE_WRAP_R
+#define GL_TEXTURE_WRAP_R 0x8072
+#endif
+#ifndef GL_MAX_3D_TEXTURE_SIZE
+#define GL_MAX_3D_TEXTURE_SIZE 0x8073
+#endif
+
+// 3D textures (OpenGL 1.2)
+typedef void (APIENTRY* TexImage3DProc)(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels);
+
+extern TexImage3DProc mzTexImage3D;
+
+#define glTexImage3D mzTexImage3D
+
+#ifndef GL_TEXTURE_BUFFER
+#define GL_TEXTURE_BUFFER 0x8C2A
+#endif
+#ifndef GL_RGBA32F
+#define GL_RGBA32F 0x8814
+#endif
+#ifndef GL_RG32UI
+#define GL_RG32UI 0x823C
+#endif
+#ifndef GL_RG_INTEGER
+#define GL_RG_INTEGER 0x8228
+#endif
+#ifndef GL_SAMPLES_PASSED
+#define GL_SAMPLES_PASSED 0x8914
+#endif
+
+// Texture buffers (3.1)
+typedef void (APIENTRY* TexBufferProc)(GLenum target, GLenum internalformat, GLuint buffer);
+
+extern TexBufferProc mzTexBuffer;
+
+#define glTexBuffer mzTexBuffer
+
+// Loads every entry point above. Must be called with a current context.
+void loadGLExtensions();
+
+// Whether the driver provided each group of entry points
+bool hasBufferObjects();
+bool hasFramebuffers();
+bool hasShaders();
+bool hasTimerQueries();
+bool hasInstancing();
+bool hasMultiDraw();
+bool hasIndirectDraw();
+bool hasTexture3D();
+bool hasTextureBuffers();
@@ -0,0 +1,447 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "GeometryStreams.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <utility>
+#include "ObjParsing.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define GEOMETRY_STREAMS_X86
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+using namespace std;
+
+static const bool useAVX2 = detectSimdLevel() == SimdLevel::AVX2;
+
+///////////////
+// FloatStream
+
+static float* allocateFloats(size_t count) {
+	return (float*)::operator new(count * sizeof(float), align_val_t(STREAM_ALIGNMENT));
+}
+
+static void freeFloats(float* values) {
+	if (values)
+		::operator delete(values, align_val_t(STREAM_ALIGNMENT));
+}
+
+FloatStream::FloatStream() {
+}
+
+FloatStream::FloatStream(const FloatStream& other) {
+	reserve(other.count);
+	if (other.count > 0)
+		memcpy(this->values, other.values, other.count * sizeof(float));
+	this->count = other.count;
+}
+
+FloatStream::FloatStream(FloatStream&& other) noexcept {
+	swap(this->values, other.values);
+	swap(this->count, other.count);
+	swap(this->capacity, other.capacity);
+}
+
+FloatStream::~FloatStream() {
+	freeFloats(this->values);
+}
+
+FloatStream& FloatStream::operator=(FloatStream other) noexcept {
+	swap(this->values, other.values);
+	swap(this->count, other.count);
+	swap(this->capacity, other.capacity);
+	return *this;
+}
+
+void FloatStream::push_back(float value) {
+	if (this->count == this->capacity)
+		reserve(max(this->capacity * 2, (size_t)64));
+	this->values[this->count++] = value;
+}
+
+void FloatStream::resize(size_t count) {
+	reserve(count);
+	if (count > this->count)
+		memset(this->values + this->count, 0, (count - this->count) * sizeof(float));
+	this->count = count;
+}
+
+void FloatStream::reserve(size_t count) {
+	if (count <= this->capacity)
+		return;
+
+	// Padded so vector loops may run over a whole last register
+	const size_t floatsPerAlignment = STREAM_ALIGNMENT / sizeof(float);
+	size_t capacity = (count + floatsPerAlignment - 1) / floatsPerAlignment * floatsPerAlignment;
+
+	float* values = allocateFloats(capacity);
+	if (this->count > 0)
+		memcpy(values, this->values, this->count * sizeof(float));
+	freeFloats(this->values);
+
+	this->values = values;
+	this->capacity = capacity;
+}
+
+void FloatStream::clear() {
+	this->count = 0;
+}
+
+size_t FloatStream::size() const {
+	return this->count;
+}
+
+float* FloatStream::data() {
+	return this->values;
+}
+
+const float* FloatStream::data() const {
+	return this->values;
+}
+
+float& FloatStream::operator[](size_t i) {
+	return this->values[i];
+}
+
+float FloatStream::operator[](size_t i) const {
+	return this->values[i];
+}
+
+///////////////////
+// PositionStreams
+
+PositionStreams::PositionStreams() {
+}
+
+PositionStreams::PositionStreams(const vector<Point3>& points) {
+	resize(points.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		this->x[i] = points[i].x;
+		this->y[i] = points[i].y;
+		this->z[i] = points[i].z;
+	}
+}
+
+void PositionStreams::push_back(const Point3& point) {
+	this->x.push_back(point.x);
+	this->y.push_back(point.y);
+	this->z.push_back(point.z);
+}
+
+void PositionStreams::resize(size_t count) {
+	this->x.resize(count);
+	this->y.resize(count);
+	this->z.resize(count);
+}
+
+void PositionStreams::reserve(size_t count) {
+	this->x.reserve(count);
+	this->y.reserve(count);
+	this->z.reserve(count);
+}
+
+void PositionStreams::clear() {
+	this->x.clear();
+	this->y.clear();
+	this->z.clear();
+}
+
+size_t PositionStreams::size() const {
+	return this->x.size();
+}
+
+Point3 PositionStreams::get(size_t i) const {
+	return Point3(this->x[i], this->y[i], this->z[i]);
+}
+
+//////////
+// Bounds
+
+Bounds::Bounds() : min(INFINITY, INFINITY, INFINITY), max(-INFINITY, -INFINITY, -INFINITY) {
+}
+
+Bounds::Bounds(const Point3& min, const Point3& max) : min(min), max(max) {
+}
+
+void Bounds::extend(const Point3& point) {
+	this->min = Point3(std::min(this->min.x, point.x), std::min(this->min.y, point.y), std::min(this->min.z, point.z));
+	this->max = Point3(std::max(this->max.x, point.x), std::max(this->max.y, point.y), std::max(this->max.z, point.z));
+}
+
+void Bounds::extend(const Bounds& other) {
+	if (other.isEmpty())
+		return;
+	extend(other.min);
+	extend(other.max);
+}
+
+bool Bounds::isEmpty() const {
+	return this->min.x > this->max.x;
+}
+
+Point3 Bounds::getCenter() const {
+	return Point3((this->min.x + this->max.x) / 2, (this->min.y + this->max.y) / 2, (this->min.z + this->max.z) / 2);
+}
+
+Point3 Bounds::getSize() const {
+	return Point3(this->max.x - this->min.x, this->max.y - this->min.y, this->max.z - this->min.z);
+}
+
+Point3 QuantizedPositions::get(size_t i) const {
+	Point3 size = this->bounds.getSize();
+	return Point3(
+		this->bounds.min.x + this->x[i] * (size.x / 65535),
+		this->bounds.min.y + this->y[i] * (size.y / 65535),
+		this->bounds.min.z + this->z[i] * (size.z / 65535));
+}
+
+///////////
+// Kernels
+// Each kernel runs whole registers and finishes the tail in scalar code.
+
+static void boundsScalar(const float* values, size_t begin, size_t end, float& low, float& high) {
+	for (size_t i = begin; i < end; i++) {
+		low = min(low, values[i]);
+		high = max(high, values[i]);
+	}
+}
+
+#if defined(GEOMETRY_STREAMS_X86)
+
+static float horizontalMin(__m128 v) {
+	v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(v);
+}
+
+static float horizontalMax(__m128 v) {
+	v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(v);
+}
+
+static size_t boundsSSE(const float* values, size_t count, float& low, float& high) {
+	__m128 lows = _mm_set1_ps(low), highs = _mm_set1_ps(high);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 v = _mm_load_ps(values + i);
+		lows = _mm_min_ps(lows, v);
+		highs = _mm_max_ps(highs, v);
+	}
+	low = horizontalMin(lows);
+	high = horizontalMax(highs);
+	return i;
+}
+
+TARGET_AVX2 static size_t boundsAVX(const float* values, size_t count, float& low, float& high) {
+	__m256 lows = _mm256_set1_ps(low), highs = _mm256_set1_ps(high);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 v = _mm256_load_ps(values + i);
+		lows = _mm256_min_ps(lows, v);
+		highs = _mm256_max_ps(highs, v);
+	}
+	low = horizontalMin(_mm_min_ps(_mm256_castps256_ps128(lows), _mm256_extractf128_ps(lows, 1)));
+	high = horizontalMax(_mm_max_ps(_mm256_castps256_ps128(highs), _mm256_extractf128_ps(highs, 1)));
+	return i;
+}
+
+#endif
+
+static void streamBounds(const FloatStream& stream, float& low, float& high) {
+	low = INFINITY;
+	high = -INFINITY;
+	size_t done = 0;
+#if defined(GEOMETRY_STREAMS_X86)
+	done = useAVX2 ? boundsAVX(stream.data(), stream.size(), low, high) : boundsSSE(stream.data(), stream.size(), low, high);
+#endif
+	boundsScalar(stream.data(), done, stream.size(), low, high);
+}
+
+Bounds computeBounds(const PositionStreams& points) {
+	Bounds bounds;
+	if (points.size() == 0)
+		return bounds;
+
+	streamBounds(points.x, bounds.min.x, bounds.max.x);
+	streamBounds(points.y, bounds.min.y, bounds.max.y);
+	streamBounds(points.z, bounds.min.z, bounds.max.z);
+	return bounds;
+}
+
+static void transformScalar(const float* x, const float* y, const float* z, const float m[16], float w,
+	float* outX, float* outY, float* outZ, size_t begin, size_t end) {
+	for (size_t i = begin; i < end; i++) {
+		float px = x[i], py = y[i], pz = z[i];
+		outX[i] = m[0] * px + m[4] * py + m[8] * pz + m[12] * w;
+		outY[i] = m[1] * px + m[5] * py + m[9] * pz + m[13] * w;
+		outZ[i] = m[2] * px + m[6] * py + m[10] * pz + m[14] * w;
+	}
+}
+
+#if defined(GEOMETRY_STREAMS_X86)
+
+static size_t transformSSE(const float* x, const float* y, const float* z, const float m[16], float w,
+	float* outX, float* outY, float* outZ, size_t count) {
+	__m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]);
+	__m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]);
+	__m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]);
+	__m128 t0 = _mm_set1_ps(m[12] * w), t1 = _mm_set1_ps(m[13] * w), t2 = _mm_set1_ps(m[14] * w);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 px = _mm_load_ps(x + i), py = _mm_load_ps(y + i), pz = _mm_load_ps(z + i);
+		__m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, px), _mm_mul_ps(m4, py)), _mm_add_ps(_mm_mul_ps(m8, pz), t0));
+		__m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, px), _mm_mul_ps(m5, py)), _mm_add_ps(_mm_mul_ps(m9, pz), t1));
+		__m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, px), _mm_mul_ps(m6, py)), _mm_add_ps(_mm_mul_ps(m10, pz), t2));
+		_mm_store_ps(outX + i, rx);
+		_mm_store_ps(outY + i, ry);
+		_mm_store_ps(outZ + i, rz);
+	}
+	return i;
+}
+
+TARGET_AVX2 static size_t transformAVX(const float* x, const float* y, const float* z, const float m[16], float w,
+	float* outX, float* outY, float* outZ, size_t count) {
+	__m256 m0 = _mm256_set1_ps(m[0]), m1 = _mm256_set1_ps(m[1]), m2 = _mm256_set1_ps(m[2]);
+	__m256 m4 = _mm256_set1_ps(m[4]), m5 = _mm256_set1_ps(m[5]), m6 = _mm256_set1_ps(m[6]);
+	__m256 m8 = _mm256_set1_ps(m[8]), m9 = _mm256_set1_ps(m[9]), m10 = _mm256_set1_ps(m[10]);
+	__m256 t0 = _mm256_set1_ps(m[12] * w), t1 = _mm256_set1_ps(m[13] * w), t2 = _mm256_set1_ps(m[14] * w);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 px = _mm256_load_ps(x + i), py = _mm256_load_ps(y + i), pz = _mm256_load_ps(z + i);
+		__m256 rx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, px), _mm256_mul_ps(m4, py)), _mm256_add_ps(_mm256_mul_ps(m8, pz), t0));
+		__m256 ry = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m1, px), _mm256_mul_ps(m5, py)), _mm256_add_ps(_mm256_mul_ps(m9, pz), t1));
+		__m256 rz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m2, px), _mm256_mul_ps(m6, py)), _mm256_add_ps(_mm256_mul_ps(m10, pz), t2));
+		_mm256_store_ps(outX + i, rx);
+		_mm256_store_ps(outY + i, ry);
+		_mm256_store_ps(outZ + i, rz);
+	}
+	return i;
+}
+
+#endif
+
+static void transformStreams(const PositionStreams& points, const float matrix[16], float w, PositionStreams& output) {
+	size_t count = points.size();
+	if (&output != &points)
+		output.resize(count);
+
+	const float* x = points.x.data();
+	const float* y = points.y.data();
+	const float* z = points.z.data();
+	float* outX = output.x.data();
+	float* outY = output.y.data();
+	float* outZ = output.z.data();
+
+	size_t done = 0;
+#if defined(GEOMETRY_STREAMS_X86)
+	done = useAVX2 ? transformAVX(x, y, z, matrix, w, outX, outY, outZ, count) : transformSSE(x, y, z, matrix, w, outX, outY, outZ, count);
+#endif
+	transformScalar(x, y, z, matrix, w, outX, outY, outZ, done, count);
+}
+
+void transformPositions(const PositionStreams& points, const float matrix[16], PositionStreams& output) {
+	transformStreams(points, matrix, 1, output);
+}
+
+void transformDirections(const PositionStreams& directions, const float matrix[16], PositionStreams& output) {
+	transformStreams(directions, matrix, 0, output);
+}
+
+static void quantizeStream(const FloatStream& values, float low, float high, vector<uint16_t>& output) {
+	size_t count = values.size();
+	output.resize(count);
+
+	float scale = high > low ? 65535 / (high - low) : 0;
+	size_t i = 0;
+
+#if defined(GEOMETRY_STREAMS_X86)
+	__m128 lows = _mm_set1_ps(low), scales = _mm_set1_ps(scale);
+	__m128 limit = _mm_set1_ps(65535);
+	__m128i bias = _mm_set1_epi32(32768);
+	__m128i flip = _mm_set1_epi16((short)0x8000);
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 a = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(values.data() + i), lows), scales);
+		__m128 b = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(values.data() + i + 4), lows), scales);
+		a = _mm_min_ps(_mm_max_ps(a, _mm_setzero_ps()), limit);
+		b = _mm_min_ps(_mm_max_ps(b, _mm_setzero_ps()), limit);
+
+		// SSE2 only packs signed values: shift into the signed range,
+		// pack, then flip the sign bit back
+		__m128i ia = _mm_sub_epi32(_mm_cvtps_epi32(a), bias);
+		__m128i ib = _mm_sub_epi32(_mm_cvtps_epi32(b), bias);
+		__m128i packed = _mm_xor_si128(_mm_packs_epi32(ia, ib), flip);
+		_mm_storeu_si128((__m128i*)(output.data() + i), packed);
+	}
+#endif
+
+	for (; i < count; i++) {
+		float q = min(max((values[i] - low) * scale, 0.0f), 65535.0f);
+		output[i] = (uint16_t)nearbyintf(q);
+	}
+}
+
+void quantizePositions(const PositionStreams& points, const Bounds& bounds, QuantizedPositions& output) {
+	output.bounds = bounds;
+	quantizeStream(points.x, bounds.min.x, bounds.max.x, output.x);
+	quantizeStream(points.y, bounds.min.y, bounds.max.y, output.y);
+	quantizeStream(points.z, bounds.min.z, bounds.max.z, output.z);
+}
+
+void interleaveVertices(const PositionStreams& positions, const PositionStreams& normals, float* output) {
+	size_t count = positions.size();
+	size_t i = 0;
+
+#if defined(GEOMETRY_STREAMS_X86)
+	// Four vertices at a time: transposing (x, y, z, nx) gives the first
+	// four floats of each vertex, ny and nz follow as a pair
+	for (; i + 4 <= count; i += 4) {
+		__m128 r0 = _mm_load_ps(positions.x.data() + i);
+		__m128 r1 = _mm_load_ps(positions.y.data() + i);
+		__m128 r2 = _mm_load_ps(positions.z.data() + i);
+		__m128 r3 = _mm_load_ps(normals.x.data() + i);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		__m128 ny = _mm_load_ps(normals.y.data() + i);
+		__m128 nz = _mm_load_ps(normals.z.data() + i);
+		__m128 low = _mm_unpacklo_ps(ny, nz);  // ny0 nz0 ny1 nz1
+		__m128 high = _mm_unpackhi_ps(ny, nz); // ny2 nz2 ny3 nz3
+
+		float* out = output + i * 6;
+		_mm_storeu_ps(out + 0, r0);
+		_mm_storel_pi((__m64*)(out + 4), low);
+		_mm_storeu_ps(out + 6, r1);
+		_mm_storeh_pi((__m64*)(out + 10), low);
+		_mm_storeu_ps(out + 12, r2);
+		_mm_storel_pi((__m64*)(out + 16), high);
+		_mm_storeu_ps(out + 18, r3);
+		_mm_storeh_pi((__m64*)(out + 22), high);
+	}
+#endif
+
+	for (; i < count; i++) {
+		float* out = output + i * 6;
+		out[0] = positions.x[i];
+		out[1] = positions.y[i];
+		out[2] = positions.z[i];
+		out[3] = normals.x[i];
+		out[4] = normals.y[i];
+		out[5] = normals.z[i];
+	}
+}
@@ -0,0 +1,104 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// Structure-of-arrays geometry and the bulk kernels that run over it.
+// Keeping x, y and z in separate aligned streams lets each kernel load
+// four or eight values of the same coordinate at once, where an array
+// of Point3 would need shuffles to pull them apart.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Point3.h"
+
+// Stream allocations are aligned to, and padded to a multiple of, this
+#define STREAM_ALIGNMENT 32
+
+// Aligned, growable array of floats
+class FloatStream {
+public:
+	FloatStream();
+	FloatStream(const FloatStream& other);
+	FloatStream(FloatStream&& other) noexcept;
+	~FloatStream();
+	FloatStream& operator=(FloatStream other) noexcept;
+
+	void push_back(float value);
+	void resize(size_t count);
+	void reserve(size_t count);
+	void clear();
+
+	size_t size() const;
+	float* data();
+	const float* data() const;
+	float& operator[](size_t i);
+	float operator[](size_t i) const;
+
+private:
+	float* values = nullptr;
+	size_t count = 0;
+	size_t capacity = 0;
+};
+
+// Points split into x[], y[] and z[] streams
+class PositionStreams {
+public:
+	FloatStream x, y, z;
+
+	PositionStreams();
+	PositionStreams(const std::vector<Point3>& points);
+
+	void push_back(const Point3& point);
+	void resize(size_t count);
+	void reserve(size_t count);
+	void clear();
+
+	size_t size() const;
+	Point3 get(size_t i) const;
+};
+
+// Axis aligned bounding box
+class Bounds {
+public:
+	Point3 min, max;
+
+	// An empty box, min above max, so any point extends it
+	Bounds();
+	Bounds(const Point3& min, const Point3& max);
+
+	void extend(const Point3& point);
+	void extend(const Bounds& other);
+	bool isEmpty() const;
+
+	Point3 getCenter() const;
+	Point3 getSize() const;
+};
+
+// Positions stored as 16 bit integers across the given bounds
+class QuantizedPositions {
+public:
+	std::vector<uint16_t> x, y, z;
+	Bounds bounds;
+
+	Point3 get(size_t i) const;
+};
+
+Bounds computeBounds(const PositionStreams& points);
+
+// output[i] = matrix * (points[i], 1), with matrix column major as in OpenGL.
+// output may be the same object as points.
+void transformPositions(const PositionStreams& points, const float matrix[16], PositionStreams& output);
+
+// Only the rotation/scale part of matrix, for directions such as normals
+void transformDirections(const PositionStreams& directions, const float matrix[16], PositionStreams& output);
+
+// Rounds every point to the nearest of 65536 steps across bounds
+void quantizePositions(const PositionStreams& points, const Bounds& bounds, QuantizedPositions& output);
+
+// Interleaves positions and normals into the GPU vertex layout
+// (x, y, z, nx, ny, nz), writing 6 * positions.size() floats
+void interleaveVertices(const PositionStreams& positions, const PositionStreams& normals, float* output);
@@ -0,0 +1,204 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "GoldenImages.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <gl/glut.h>
+
+using namespace std;
+
+//////////
+// Images
+
+bool readPpm(const string& filename, Image& image) {
+	ifstream file(filename, ifstream::in | ifstream::binary);
+	if (!file.is_open())
+		return false;
+
+	string magic;
+	int maximum = 0;
+	file >> magic >> image.width >> image.height >> maximum;
+	file.get();
+	if (!file || magic != "P6" || maximum != 255 || image.width <= 0 || image.height <= 0)
+		return false;
+
+	image.rgb.resize((size_t)image.width * image.height * 3);
+	file.read((char*)image.rgb.data(), image.rgb.size());
+	return (bool)file;
+}
+
+bool writePpm(const string& filename, const Image& image) {
+	ofstream file(filename, ofstream::out | ofstream::binary | ofstream::trunc);
+	if (!file.is_open())
+		return false;
+
+	file << "P6\n" << image.width << " " << image.height << "\n255\n";
+	file.write((const char*)image.rgb.data(), image.rgb.size());
+	return (bool)file;
+}
+
+ImageDifference compareImages(const Image& a, const Image& b, int channelTolerance) {
+	ImageDifference difference;
+	if (a.width != b.width || a.height != b.height || a.rgb.size() != b.rgb.size()) {
+		difference.rmse = 255;
+		difference.maxError = 255;
+		difference.wrongPixels = 1;
+		return difference;
+	}
+
+	double squares = 0;
+	size_t wrong = 0;
+	for (size_t i = 0; i < a.rgb.size(); i += 3) {
+		int pixelError = 0;
+		for (size_t c = i; c < i + 3; c++) {
+			int error = abs((int)a.rgb[c] - (int)b.rgb[c]);
+			squares += error * error;
+			pixelError = max(pixelError, error);
+		}
+		difference.maxError = max(difference.maxError, pixelError);
+		wrong += pixelError > channelTolerance;
+	}
+
+	size_t pixels = a.rgb.size() / 3;
+	difference.rmse = pixels > 0 ? sqrt(squares / a.rgb.size()) : 0;
+	difference.wrongPixels = pixels > 0 ? (double)wrong / pixels : 0;
+	return difference;
+}
+
+// Brighter where the images differ more, for looking at what broke
+static Image differenceImage(const Image& a, const Image& b) {
+	Image image = a;
+	for (size_t i = 0; i < image.rgb.size() && i < b.rgb.size(); i++)
+		image.rgb[i] = (uint8_t)min(255, 4 * abs((int)a.rgb[i] - (int)b.rgb[i]));
+	return image;
+}
+
+///////////////////
+// GoldenImageTest
+
+GoldenImageTest::GoldenImageTest(const GoldenSettings& settings) : settings(settings) {
+}
+
+void GoldenImageTest::addPose(const string& name, const Point3& eye, const Point3& target) {
+	this->poses.push_back({ name, eye, target });
+}
+
+void GoldenImageTest::addPath(const string& name, const function<void(const GoldenView&)>& draw) {
+	this->paths.push_back({ name, draw });
+}
+
+GoldenView GoldenImageTest::setCamera(const Pose& pose) const {
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	gluPerspective(this->settings.fovY, (double)this->settings.width / this->settings.height, 0.1, 500);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	gluLookAt(pose.eye.x, pose.eye.y, pose.eye.z, pose.target.x, pose.target.y, pose.target.z, 0, 1, 0);
+
+	GoldenView view;
+	view.eye = pose.eye;
+	view.frustum = Frustum::fromCurrentMatrices();
+	return view;
+}
+
+void GoldenImageTest::render(const Path& path, const GoldenView& view) {
+	this->target.bind();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	path.draw(view);
+}
+
+Image GoldenImageTest::readBack() const {
+	Image image;
+	image.width = this->settings.width;
+	image.height = this->settings.height;
+	image.rgb.resize((size_t)image.width * image.height * 3);
+
+	// GL's rows run bottom to top
+	size_t rowBytes = (size_t)image.width * 3;
+	vector<uint8_t> pixels(image.rgb.size());
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, image.width, image.height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+	for (int y = 0; y < image.height; y++)
+		copy_n(pixels.data() + (size_t)(image.height - 1 - y) * rowBytes, rowBytes, image.rgb.data() + (size_t)y * rowBytes);
+	return image;
+}
+
+bool GoldenImageTest::run() {
+	if (this->paths.empty())
+		return true;
+	if (!hasFramebuffers() || !this->target.create(this->settings.width, this->settings.height, { GL_RGBA8 }, GL_DEPTH_COMPONENT24)) {
+		printf("Golden images need framebuffer objects\n");
+		return false;
+	}
+
+	printf("%d poses at %dx%d against %s, at most %.2f%% of pixels off by over %d\n", (int)this->poses.size(),
+		this->settings.width, this->settings.height, this->paths[0].name.c_str(), 100 * this->settings.maxWrongPixels,
+		this->settings.channelTolerance);
+	printf("%-12s %-14s %10s %8s %5s %9s\n", "pose", "path", "ms/frame", "rmse", "max", "wrong");
+
+	bool passed = true;
+	vector<double> totalMilliseconds(this->paths.size(), 0);
+	vector<int> failures(this->paths.size(), 0);
+	for (const Pose& pose : this->poses) {
+		string referenceFile = this->settings.prefix + pose.name + ".ppm";
+		Image reference;
+		bool haveReference = !this->settings.update && readPpm(referenceFile, reference);
+
+		for (size_t p = 0; p < this->paths.size(); p++) {
+			const Path& path = this->paths[p];
+			GoldenView view = setCamera(pose);
+
+			// The first frame uploads and warms whatever the path caches
+			render(path, view);
+			glFinish();
+			auto start = chrono::steady_clock::now();
+			for (int frame = 0; frame < this->settings.timedFrames; frame++)
+				render(path, view);
+			glFinish();
+			double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()
+				/ max(this->settings.timedFrames, 1);
+			totalMilliseconds[p] += milliseconds;
+			Image image = readBack();
+
+			const char* note = "";
+			if (p == 0 && !haveReference) {
+				if (!writePpm(referenceFile, image)) {
+					printf("Could not write %s\n", referenceFile.c_str());
+					passed = false;
+				}
+				reference = image;
+				haveReference = true;
+				note = "  (new reference)";
+			}
+
+			ImageDifference difference = compareImages(reference, image, this->settings.channelTolerance);
+			if (difference.wrongPixels > this->settings.maxWrongPixels) {
+				string differenceFile = this->settings.prefix + pose.name + "_" + path.name + "_diff.ppm";
+				writePpm(differenceFile, differenceImage(reference, image));
+				failures[p]++;
+				passed = false;
+				note = "  FAIL";
+			}
+
+			printf("%-12s %-14s %10.3f %8.3f %5d %8.3f%%%s\n", pose.name.c_str(), path.name.c_str(), milliseconds,
+				difference.rmse, difference.maxError, 100 * difference.wrongPixels, note);
+		}
+	}
+
+	printf("%-14s %10s %9s\n", "path", "ms/frame", "failures");
+	for (size_t p = 0; p < this->paths.size(); p++) {
+		printf("%-14s %10.3f %5d/%d\n", this->paths[p].name.c_str(), totalMilliseconds[p] / max((int)this->poses.size(), 1),
+			failures[p], (int)this->poses.size());
+	}
+
+	this->target.destroy();
+	return passed;
+}
@@ -0,0 +1,85 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Frustum.h"
+#include "Point3.h"
+#include "RenderTarget.h"
+
+struct GoldenSettings {
+	int width = 320, height = 240;
+	float fovY = 45;                    // As the application's camera
+	std::string prefix = "golden_";     // Reference images are <prefix><pose>.ppm
+	bool update = false;                // Rewrite the references from the reference path
+	int channelTolerance = 8;           // Of 255, a pixel differing by more is wrong
+	double maxWrongPixels = 0.002;      // Fraction of the image allowed to be wrong
+	int timedFrames = 20;               // Per path and pose, for the frame cost
+};
+
+struct Image {
+	int width = 0, height = 0;
+	std::vector<uint8_t> rgb; // Rows top to bottom
+};
+
+bool readPpm(const std::string& filename, Image& image);
+bool writePpm(const std::string& filename, const Image& image);
+
+struct ImageDifference {
+	double rmse = 0;             // Over every channel, in 0-255 units
+	int maxError = 0;            // Largest channel difference
+	double wrongPixels = 0;      // Fraction differing by more than the tolerance
+};
+
+// Images of different sizes differ everywhere
+ImageDifference compareImages(const Image& a, const Image& b, int channelTolerance);
+
+// Where a path draws from, with the projection and modelview already set
+struct GoldenView {
+	Point3 eye;
+	Frustum frustum;
+};
+
+// Renders fixed camera poses through every registered path into an
+// offscreen target and compares each image against the stored reference
+// for that pose, rendered by the first path. Prints a table of image
+// error next to each path's frame cost, so a faster path only gets
+// switched on once it draws the same picture. Needs a current context
+// with framebuffers, and the fixed function state the paths draw with.
+class GoldenImageTest {
+public:
+	explicit GoldenImageTest(const GoldenSettings& settings);
+
+	void addPose(const std::string& name, const Point3& eye, const Point3& target);
+	// The first path added is the reference
+	void addPath(const std::string& name, const std::function<void(const GoldenView&)>& draw);
+
+	// Returns false if any path is outside the tolerance or a reference
+	// could not be read or written. Missing references are rendered.
+	bool run();
+
+private:
+	struct Pose {
+		std::string name;
+		Point3 eye, target;
+	};
+	struct Path {
+		std::string name;
+		std::function<void(const GoldenView&)> draw;
+	};
+
+	GoldenView setCamera(const Pose& pose) const;
+	void render(const Path& path, const GoldenView& view);
+	Image readBack() const;
+
+	GoldenSettings settings;
+	std::vector<Pose> poses;
+	std::vector<Path> paths;
+	RenderTarget target;
+};
@@ -0,0 +1,191 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "GpuMesh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "FrameStats.h"
+
+using namespace std;
+
+#define VERTEX_BYTES (GPU_VERTEX_FLOATS * sizeof(float))
+
+#define BLOCK_CLUSTERS (GPU_BLOCK_VERTICES / GPU_CLUSTER_VERTICES)
+
+static_assert(GPU_BLOCK_VERTICES % GPU_CLUSTER_VERTICES == 0 && GPU_CLUSTER_VERTICES % 4 == 0, "Clusters must tile blocks with whole quads");
+static_assert(BLOCK_CLUSTERS % GPU_CULL_GRAIN == 0, "Culling ranges must not straddle blocks");
+
+GpuMesh::GpuMesh() {
+}
+
+GpuMesh::~GpuMesh() {
+	for (Block& block : this->blocks) {
+		if (block.buffer != 0)
+			glDeleteBuffers(1, &block.buffer);
+	}
+}
+
+void GpuMesh::append(const float* vertices, size_t vertexCount) {
+	if (!this->clusters.empty())
+		this->firstChanged = min(this->firstChanged, this->clusters.size() - 1);
+
+	while (vertexCount > 0) {
+		if (this->blocks.empty() || this->blocks.back().vertexCount == GPU_BLOCK_VERTICES) {
+			Block block;
+			if (hasBufferObjects()) {
+				glGenBuffers(1, &block.buffer);
+				glBindBuffer(GL_ARRAY_BUFFER, block.buffer);
+				glBufferData(GL_ARRAY_BUFFER, GPU_BLOCK_VERTICES * VERTEX_BYTES, nullptr, GL_STATIC_DRAW);
+			}
+			else {
+				block.clientVertices.reserve(GPU_BLOCK_VERTICES * GPU_VERTEX_FLOATS);
+			}
+			this->blocks.push_back(move(block));
+		}
+
+		Block& block = this->blocks.back();
+		size_t count = min(vertexCount, (size_t)GPU_BLOCK_VERTICES - block.vertexCount);
+
+		if (block.buffer != 0) {
+			// Only the new range travels to the GPU
+			glBindBuffer(GL_ARRAY_BUFFER, block.buffer);
+			glBufferSubData(GL_ARRAY_BUFFER, block.vertexCount * VERTEX_BYTES, count * VERTEX_BYTES, vertices);
+		}
+		else {
+			block.clientVertices.insert(block.clientVertices.end(), vertices, vertices + count * GPU_VERTEX_FLOATS);
+		}
+
+		// Grow the bounds of the clusters the vertices land in
+		for (size_t i = 0; i < count; i++) {
+			size_t index = this->vertexCount + i;
+			if (index % GPU_CLUSTER_VERTICES == 0) {
+				Cluster cluster;
+				cluster.min = Point3(FLT_MAX, FLT_MAX, FLT_MAX);
+				cluster.max = Point3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+				this->clusters.push_back(cluster);
+			}
+
+			Cluster& cluster = this->clusters.back();
+			const float* position = vertices + i * GPU_VERTEX_FLOATS;
+			cluster.min = Point3(min(cluster.min.x, position[0]), min(cluster.min.y, position[1]), min(cluster.min.z, position[2]));
+			cluster.max = Point3(max(cluster.max.x, position[0]), max(cluster.max.y, position[1]), max(cluster.max.z, position[2]));
+			cluster.vertexCount++;
+		}
+
+		block.vertexCount += count;
+		this->vertexCount += count;
+		vertices += count * GPU_VERTEX_FLOATS;
+		vertexCount -= count;
+	}
+
+	if (hasBufferObjects())
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GpuMesh::append(const PositionStreams& positions, const PositionStreams& normals) {
+	this->staging.resize(positions.size() * GPU_VERTEX_FLOATS);
+	interleaveVertices(positions, normals, this->staging.data());
+	append(this->staging.data(), positions.size());
+}
+
+void GpuMesh::draw(const Frustum* frustum, const VisibleTiles* visible, IncrementalCulling* incremental) const {
+	if (this->blocks.empty())
+		return;
+
+	bool culled = frustum || visible;
+	if (culled) {
+		const Cluster* clusters = this->clusters.data();
+		bool tracked = incremental && frustum;
+		this->history.resize(this->clusters.size());
+		this->rangeTests.assign((this->clusters.size() + GPU_CULL_GRAIN - 1) / GPU_CULL_GRAIN, 0);
+		ClusterHistory* history = this->history.data();
+		uint32_t* rangeTests = this->rangeTests.data();
+		size_t reusableEnd = tracked && !incremental->isFullPass() ? this->firstChanged : 0;
+
+		this->commands.generate(this->clusters.size(), GPU_CULL_GRAIN, [=](size_t index, DrawArraysCommand& command) {
+			const Cluster& cluster = clusters[index];
+			ClusterHistory& past = history[index];
+			bool passes;
+			// Kept from last frame while the motion since cannot reach the margin
+			if (index < reusableEnd && past.margin >= 0
+				&& incremental->getPlaneMotion(past.translation, past.rotation, past.radius) <= past.margin) {
+				passes = past.visible;
+			}
+			else if (tracked) {
+				rangeTests[index / GPU_CULL_GRAIN]++;
+				passes = frustum->intersectsBox(cluster.min, cluster.max, past.margin)
+					&& (!visible || visible->intersectsBox(cluster.min, cluster.max));
+
+				const Point3& eye = incremental->getEye();
+				Point3 furthest(fmaxf(fabsf(cluster.min.x - eye.x), fabsf(cluster.max.x - eye.x)),
+					fmaxf(fabsf(cluster.min.y - eye.y), fabsf(cluster.max.y - eye.y)),
+					fmaxf(fabsf(cluster.min.z - eye.z), fabsf(cluster.max.z - eye.z)));
+				past.visible = passes;
+				past.radius = length(furthest);
+				past.translation = incremental->getTranslation();
+				past.rotation = incremental->getRotation();
+			}
+			else {
+				rangeTests[index / GPU_CULL_GRAIN]++;
+				passes = (!frustum || frustum->intersectsBox(cluster.min, cluster.max))
+					&& (!visible || visible->intersectsBox(cluster.min, cluster.max));
+			}
+			if (!passes)
+				return false;
+
+			command.count = cluster.vertexCount;
+			command.instanceCount = 1;
+			command.first = (GLuint)(index % BLOCK_CLUSTERS * GPU_CLUSTER_VERTICES);
+			command.baseInstance = 0;
+			return true;
+		});
+
+		if (incremental) {
+			size_t tested = 0;
+			for (uint32_t count : this->rangeTests)
+				tested += count;
+			incremental->addTests(tested, this->clusters.size());
+		}
+		if (tracked)
+			this->firstChanged = this->clusters.size();
+	}
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+
+	for (const Block& block : this->blocks) {
+		const float* base = nullptr;
+		if (block.buffer != 0)
+			glBindBuffer(GL_ARRAY_BUFFER, block.buffer);
+		else
+			base = block.clientVertices.data();
+
+		glVertexPointer(3, GL_FLOAT, VERTEX_BYTES, base);
+		glNormalPointer(GL_FLOAT, VERTEX_BYTES, base + 3);
+
+		if (culled) {
+			// The commands of this block's clusters are contiguous
+			size_t firstCluster = (&block - this->blocks.data()) * BLOCK_CLUSTERS;
+			size_t endCluster = min(firstCluster + BLOCK_CLUSTERS, this->clusters.size());
+			this->commands.draw(GL_QUADS, this->commands.countBefore(firstCluster), this->commands.countBefore(endCluster));
+		}
+		else {
+			glDrawArrays(GL_QUADS, 0, (GLsizei)block.vertexCount);
+			countDrawCalls();
+		}
+	}
+
+	if (hasBufferObjects())
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+size_t GpuMesh::getVertexCount() const {
+	return this->vertexCount;
+}
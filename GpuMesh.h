@@ -0,0 +1,81 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "GLExtensions.h"
+#include "GeometryStreams.h"
+#include "DrawCommands.h"
+#include "Frustum.h"
+#include "Pvs.h"
+#include "IncrementalCulling.h"
+
+// Floats per vertex: position (x, y, z) followed by normal (x, y, z)
+#define GPU_VERTEX_FLOATS 6
+
+// Vertices per storage block, a multiple of 4 so quads never straddle two
+#define GPU_BLOCK_VERTICES (64 * 1024)
+
+// Vertices per culled cluster, a multiple of 4 dividing GPU_BLOCK_VERTICES
+#define GPU_CLUSTER_VERTICES 256
+
+// Clusters culled by each job, dividing the clusters of a block
+#define GPU_CULL_GRAIN 64
+
+// Quads stored on the GPU that can keep growing.
+// Storage is a list of fixed size buffers, so appending never moves
+// or re-uploads what was sent before. Without buffer objects the
+// blocks stay in client memory and are drawn as vertex arrays.
+// Runs of quads are bounded as clusters, which are frustum and
+// visibility culled in parallel and drawn with one multi-draw per block.
+class GpuMesh {
+public:
+	GpuMesh();
+	~GpuMesh();
+	GpuMesh(const GpuMesh&) = delete;
+	GpuMesh& operator=(const GpuMesh&) = delete;
+
+	// Appends interleaved vertices, GPU_VERTEX_FLOATS floats each
+	void append(const float* vertices, size_t vertexCount);
+	// Interleaves the streams into the vertex layout on the way
+	void append(const PositionStreams& positions, const PositionStreams& normals);
+	// Every cluster possibly inside frustum and touching a visible tile,
+	// skipping either test when it is null. With incremental, clusters
+	// the frustum cannot have crossed since last tested keep their answer.
+	void draw(const Frustum* frustum = nullptr, const VisibleTiles* visible = nullptr, IncrementalCulling* incremental = nullptr) const;
+
+	size_t getVertexCount() const;
+
+private:
+	struct Block {
+		GLuint buffer = 0;
+		std::vector<float> clientVertices;
+		size_t vertexCount = 0;
+	};
+
+	struct Cluster {
+		Point3 min, max;
+		GLuint vertexCount = 0;
+	};
+
+	// Outcome of a cluster's last test, and the camera motion totals then
+	struct ClusterHistory {
+		bool visible = false;
+		float margin = -1; // Negative until tested
+		float radius = 0;  // From the eye to the furthest corner
+		double translation = 0, rotation = 0;
+	};
+
+	std::vector<Block> blocks;
+	std::vector<Cluster> clusters;
+	mutable DrawCommandList commands;
+	mutable std::vector<ClusterHistory> history;
+	mutable std::vector<uint32_t> rangeTests; // Per culling range, so jobs need no atomics
+	mutable size_t firstChanged = 0; // Clusters from here on grew since they were culled
+	size_t vertexCount = 0;
+	std::vector<float> staging;
+};
@@ -0,0 +1,335 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Hud.h"
+
+#include <cstring>
+#include "FrameStats.h"
+
+using namespace std;
+
+// GLUT_BITMAP_8_BY_13, laid out as 16 x 6 cells for characters 32 to 127.
+// 127 (delete) has no glyph, so its cell is filled to draw solid rectangles.
+#define GLYPH_W 8
+#define GLYPH_H 13
+#define GLYPH_DESCENT 3
+#define LINE_HEIGHT 14
+#define ATLAS_COLUMNS 16
+#define ATLAS_ROWS 6
+#define ATLAS_W (ATLAS_COLUMNS * GLYPH_W)
+#define ATLAS_H (ATLAS_ROWS * GLYPH_H)
+#define SOLID_CHARACTER 127
+
+static const char* hudVertex = R"(
+#version 130
+in vec2 corner;
+in vec4 rect;
+in vec4 atlasRect;
+in vec4 color;
+uniform vec2 screenSize;
+out vec2 uv;
+out vec4 tint;
+void main() {
+	vec2 pixel = rect.xy + corner * rect.zw;
+	gl_Position = vec4(pixel.x / screenSize.x * 2.0 - 1.0, 1.0 - pixel.y / screenSize.y * 2.0, 0.0, 1.0);
+	// The atlas is upright, with v growing upwards
+	uv = mix(atlasRect.xy, atlasRect.zw, vec2(corner.x, 1.0 - corner.y));
+	tint = color;
+}
+)";
+
+static const char* hudFragment = R"(
+#version 130
+uniform sampler2D atlas;
+in vec2 uv;
+in vec4 tint;
+void main() {
+	gl_FragColor = vec4(tint.rgb, tint.a * texture(atlas, uv).r);
+}
+)";
+
+static void addInstance(vector<float>& instances, float x, float y, float width, float height, const float atlasRect[4], const float color[4]) {
+	float instance[HUD_INSTANCE_FLOATS] = {
+		x, y, width, height,
+		atlasRect[0], atlasRect[1], atlasRect[2], atlasRect[3],
+		color[0], color[1], color[2], color[3]
+	};
+	instances.insert(instances.end(), instance, instance + HUD_INSTANCE_FLOATS);
+}
+
+static void glyphRect(unsigned char character, float atlasRect[4]) {
+	int cell = character - 32;
+	int column = cell % ATLAS_COLUMNS, row = cell / ATLAS_COLUMNS;
+	atlasRect[0] = (float)(column * GLYPH_W) / ATLAS_W;
+	atlasRect[1] = (float)(row * GLYPH_H) / ATLAS_H;
+	atlasRect[2] = (float)((column + 1) * GLYPH_W) / ATLAS_W;
+	atlasRect[3] = (float)((row + 1) * GLYPH_H) / ATLAS_H;
+}
+
+static void solidRect(float atlasRect[4]) {
+	// The middle of the filled cell, away from any filtering at its edges
+	glyphRect(SOLID_CHARACTER, atlasRect);
+	float u = (atlasRect[0] + atlasRect[2]) / 2, v = (atlasRect[1] + atlasRect[3]) / 2;
+	atlasRect[0] = atlasRect[2] = u;
+	atlasRect[1] = atlasRect[3] = v;
+}
+
+Hud::Hud() {
+}
+
+Hud::~Hud() {
+	if (this->quadBuffer != 0)
+		glDeleteBuffers(1, &this->quadBuffer);
+	if (this->instanceBuffer != 0)
+		glDeleteBuffers(1, &this->instanceBuffer);
+}
+
+bool Hud::init() {
+	this->supported = hasBufferObjects() && hasInstancing()
+		&& this->shader.build("hud", hudVertex, hudFragment, { "corner", "rect", "atlasRect", "color" })
+		&& this->atlas.create(ATLAS_W, ATLAS_H, { GL_R8 }, 0);
+	if (!this->supported)
+		return false;
+
+	// Glyphs are drawn once with GLUT, into the atlas
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_VIEWPORT_BIT | GL_CURRENT_BIT);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_BLEND);
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	gluOrtho2D(0, ATLAS_W, 0, ATLAS_H);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	this->atlas.bind();
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glColor3f(1, 1, 1);
+
+	for (int character = 32; character < SOLID_CHARACTER; character++) {
+		int cell = character - 32;
+		glRasterPos2i(cell % ATLAS_COLUMNS * GLYPH_W, cell / ATLAS_COLUMNS * GLYPH_H + GLYPH_DESCENT);
+		glutBitmapCharacter(GLUT_BITMAP_8_BY_13, character);
+	}
+
+	int solid = SOLID_CHARACTER - 32;
+	glRecti(solid % ATLAS_COLUMNS * GLYPH_W, solid / ATLAS_COLUMNS * GLYPH_H,
+		(solid % ATLAS_COLUMNS + 1) * GLYPH_W, (solid / ATLAS_COLUMNS + 1) * GLYPH_H);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopAttrib();
+
+	// Glyphs are drawn at their size, texel for pixel
+	glBindTexture(GL_TEXTURE_2D, this->atlas.getColorTexture(0));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// The quad every instance stretches, as a triangle strip
+	const float corners[8] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+	glGenBuffers(1, &this->quadBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, this->quadBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glGenBuffers(1, &this->instanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	this->shader.use();
+	glUniform1i(this->shader.uniform("atlas"), 0);
+	glUseProgram(0);
+
+	return true;
+}
+
+void Hud::resize(int width, int height) {
+	this->width = width;
+	this->height = height;
+}
+
+void Hud::begin() {
+	this->blockCount = 0;
+	this->shapes.clear();
+}
+
+void Hud::text(float x, float y, const string& text, const float color[4]) {
+	if (this->blockCount == this->blocks.size()) {
+		this->blocks.push_back(TextBlock());
+		this->blocksChanged = true;
+	}
+
+	TextBlock& block = this->blocks[this->blockCount++];
+	if (block.text == text && block.x == x && block.y == y && memcmp(block.color, color, sizeof(block.color)) == 0)
+		return;
+
+	block.text = text;
+	block.x = x;
+	block.y = y;
+	memcpy(block.color, color, sizeof(block.color));
+	layout(block);
+	this->blocksChanged = true;
+}
+
+void Hud::layout(TextBlock& block) const {
+	block.instances.clear();
+	float x = block.x, y = block.y;
+	float atlasRect[4];
+
+	for (unsigned char character : block.text) {
+		if (character == '\n') {
+			x = block.x;
+			y += LINE_HEIGHT;
+			continue;
+		}
+
+		if (character > ' ' && character < SOLID_CHARACTER) {
+			glyphRect(character, atlasRect);
+			addInstance(block.instances, x, y, GLYPH_W, GLYPH_H, atlasRect, block.color);
+		}
+		x += GLYPH_W;
+	}
+}
+
+void Hud::rect(float x, float y, float width, float height, const float color[4]) {
+	float atlasRect[4];
+	solidRect(atlasRect);
+	addInstance(this->shapes, x, y, width, height, atlasRect, color);
+}
+
+void Hud::graph(float x, float y, float width, float height, const float* values, size_t count, float maxValue, const float color[4]) {
+	if (count == 0 || maxValue <= 0)
+		return;
+
+	float barWidth = width / count;
+	for (size_t i = 0; i < count; i++) {
+		float barHeight = min(values[i] / maxValue, 1.0f) * height;
+		rect(x + i * barWidth, y + height - barHeight, barWidth, barHeight, color);
+	}
+}
+
+void Hud::draw() {
+	if (!this->supported) {
+		drawFallback();
+		return;
+	}
+
+	// Blocks not given this frame are dropped
+	if (this->blockCount != this->blocks.size()) {
+		this->blocks.resize(this->blockCount);
+		this->blocksChanged = true;
+	}
+
+	// Only upload when something moved or changed
+	if (this->blocksChanged || this->shapes != this->previousShapes) {
+		this->instances = this->shapes;
+		for (const TextBlock& block : this->blocks)
+			this->instances.insert(this->instances.end(), block.instances.begin(), block.instances.end());
+
+		glBindBuffer(GL_ARRAY_BUFFER, this->instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, this->instances.size() * sizeof(float), this->instances.data(), GL_DYNAMIC_DRAW);
+
+		swap(this->shapes, this->previousShapes);
+		this->blocksChanged = false;
+	}
+
+	size_t count = this->instances.size() / HUD_INSTANCE_FLOATS;
+	if (count == 0)
+		return;
+
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	this->shader.use();
+	glUniform2f(this->shader.uniform("screenSize"), (float)this->width, (float)this->height);
+	glBindTexture(GL_TEXTURE_2D, this->atlas.getColorTexture(0));
+
+	glBindBuffer(GL_ARRAY_BUFFER, this->quadBuffer);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+	const GLsizei stride = HUD_INSTANCE_FLOATS * sizeof(float);
+	glBindBuffer(GL_ARRAY_BUFFER, this->instanceBuffer);
+	for (GLuint attribute = 1; attribute <= 3; attribute++) {
+		glEnableVertexAttribArray(attribute);
+		glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, stride, (const void*)((attribute - 1) * 4 * sizeof(float)));
+		glVertexAttribDivisor(attribute, 1);
+	}
+
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)count);
+	countDrawCalls();
+
+	for (GLuint attribute = 0; attribute <= 3; attribute++) {
+		glVertexAttribDivisor(attribute, 0);
+		glDisableVertexAttribArray(attribute);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+	glPopAttrib();
+}
+
+void Hud::drawFallback() const {
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_CURRENT_BIT);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	gluOrtho2D(0, this->width, this->height, 0);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	for (size_t i = 0; i < this->shapes.size(); i += HUD_INSTANCE_FLOATS) {
+		const float* shape = &this->shapes[i];
+		glColor4fv(shape + 8);
+		glRectf(shape[0], shape[1], shape[0] + shape[2], shape[1] + shape[3]);
+		countDrawCalls();
+	}
+
+	for (size_t i = 0; i < this->blockCount; i++) {
+		const TextBlock& block = this->blocks[i];
+		glColor4fv(block.color);
+
+		float y = block.y;
+		size_t lineStart = 0;
+		while (lineStart <= block.text.size()) {
+			size_t lineEnd = block.text.find('\n', lineStart);
+			if (lineEnd == string::npos)
+				lineEnd = block.text.size();
+
+			glRasterPos2f(block.x, y + GLYPH_H - GLYPH_DESCENT);
+			for (size_t j = lineStart; j < lineEnd; j++) {
+				glutBitmapCharacter(GLUT_BITMAP_8_BY_13, block.text[j]);
+				countDrawCalls();
+			}
+
+			lineStart = lineEnd + 1;
+			y += LINE_HEIGHT;
+		}
+	}
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopAttrib();
+}
+
+bool Hud::isSupported() const {
+	return this->supported;
+}
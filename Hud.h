@@ -0,0 +1,68 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "GLExtensions.h"
+#include "RenderTarget.h"
+#include "Shader.h"
+
+// Floats per instance: screen rectangle (x, y, width, height) in pixels
+// from the top left, atlas rectangle (u0, v0, u1, v1), then RGBA
+#define HUD_INSTANCE_FLOATS 12
+
+// Overlay of text, rectangles and graphs drawn over the finished frame.
+// GLUT's bitmap font is rendered once into a glyph atlas, and every
+// glyph and rectangle of the frame becomes an instance of one quad, so
+// the whole overlay is a single instanced draw. Text blocks keep their
+// layout between frames and are only laid out again when they change.
+// Without shaders, framebuffers or instancing it falls back to drawing
+// with GLUT directly, which is much slower.
+class Hud {
+public:
+	Hud();
+	~Hud();
+	Hud(const Hud&) = delete;
+	Hud& operator=(const Hud&) = delete;
+
+	// Builds the atlas and shader, returning false if the fallback will be used
+	bool init();
+	void resize(int width, int height);
+
+	// Content is given again every frame, between begin() and draw()
+	void begin();
+	void text(float x, float y, const std::string& text, const float color[4]);
+	void rect(float x, float y, float width, float height, const float color[4]);
+	// Vertical bars, one per value, scaled so maxValue fills the height
+	void graph(float x, float y, float width, float height, const float* values, size_t count, float maxValue, const float color[4]);
+	void draw();
+
+	bool isSupported() const;
+
+private:
+	struct TextBlock {
+		std::string text;
+		float x, y;
+		float color[4];
+		std::vector<float> instances;
+	};
+
+	void layout(TextBlock& block) const;
+	void drawFallback() const;
+
+	std::vector<TextBlock> blocks;
+	size_t blockCount = 0; // Used this frame
+	bool blocksChanged = true;
+	std::vector<float> shapes, previousShapes; // Rectangles and graphs, given every frame
+	std::vector<float> instances; // All of the above, as uploaded
+
+	RenderTarget atlas;
+	Shader shader;
+	GLuint quadBuffer = 0, instanceBuffer = 0;
+	int width = 0, height = 0;
+	bool supported = false;
+};
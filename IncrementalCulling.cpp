@@ -0,0 +1,100 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "IncrementalCulling.h"
+
+#include <cmath>
+#include <cstring>
+#include <gl/glut.h>
+#include "Tunables.h"
+
+using namespace std;
+
+Tunable<int> cullFullPassInterval("culling.full_pass_interval", CULL_FULL_PASS_INTERVAL, 1, 10000,
+	"Frames between passes testing every cluster");
+
+void IncrementalCulling::beginFrame(const VisibleTiles* visible) {
+	float projection[16], modelView[16];
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
+
+	// The modelview is rigid: eye = -R^T t
+	float rotation[9];
+	for (int column = 0; column < 3; column++) {
+		for (int row = 0; row < 3; row++)
+			rotation[column * 3 + row] = modelView[column * 4 + row];
+	}
+	Point3 eye;
+	eye.x = -(rotation[0] * modelView[12] + rotation[1] * modelView[13] + rotation[2] * modelView[14]);
+	eye.y = -(rotation[3] * modelView[12] + rotation[4] * modelView[13] + rotation[5] * modelView[14]);
+	eye.z = -(rotation[6] * modelView[12] + rotation[7] * modelView[13] + rotation[8] * modelView[14]);
+
+	int visibleSet = visible ? visible->getSet() : -1;
+	this->fullPass = !this->enabled || this->frame % cullFullPassInterval == 0 || visibleSet != this->visibleSet
+		|| memcmp(projection, this->projection, sizeof(projection)) != 0;
+
+	if (this->frame > 0) {
+		// The relative rotation's trace gives its angle, 2 sin(angle / 2) = sqrt(3 - trace)
+		float trace = 0;
+		for (int i = 0; i < 9; i++)
+			trace += rotation[i] * this->rotation[i];
+		this->translationTotal += length(eye - this->eye);
+		this->rotationTotal += sqrtf(fmaxf(0.0f, 3 - trace));
+	}
+
+	memcpy(this->projection, projection, sizeof(projection));
+	memcpy(this->rotation, rotation, sizeof(rotation));
+	this->visibleSet = visibleSet;
+	this->eye = eye;
+	this->frame++;
+
+	this->lastTests = this->tests;
+	this->lastClusters = this->clusters;
+	this->tests = 0;
+	this->clusters = 0;
+}
+
+void IncrementalCulling::setEnabled(bool enabled) {
+	this->enabled = enabled;
+}
+
+bool IncrementalCulling::isEnabled() const {
+	return this->enabled;
+}
+
+bool IncrementalCulling::isFullPass() const {
+	return this->fullPass;
+}
+
+const Point3& IncrementalCulling::getEye() const {
+	return this->eye;
+}
+
+double IncrementalCulling::getTranslation() const {
+	return this->translationTotal;
+}
+
+double IncrementalCulling::getRotation() const {
+	return this->rotationTotal;
+}
+
+float IncrementalCulling::getPlaneMotion(double translation, double rotation, float radius) const {
+	// The point is at most radius plus the translation from the eye on the way
+	double moved = this->translationTotal - translation;
+	return (float)(moved + (this->rotationTotal - rotation) * (radius + moved));
+}
+
+void IncrementalCulling::addTests(size_t tested, size_t clusters) {
+	this->tests += tested;
+	this->clusters += clusters;
+}
+
+size_t IncrementalCulling::getTestCount() const {
+	return this->lastTests;
+}
+
+size_t IncrementalCulling::getClusterCount() const {
+	return this->lastClusters;
+}
@@ -0,0 +1,61 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstddef>
+#include "Point3.h"
+#include "Pvs.h"
+
+// Frames between passes testing every cluster regardless of motion,
+// by default. Tunable as culling.full_pass_interval.
+#define CULL_FULL_PASS_INTERVAL 30
+
+// Camera motion shared by the meshes culled each frame, so they can keep
+// last frame's answer for clusters the frustum cannot have crossed.
+// Any frustum plane moves across a point by at most the eye's
+// translation plus its rotation (the chord 2 sin(angle / 2)) times the
+// point's distance from the eye. Both are summed over the frames, and a
+// cluster is tested again once the motion since its last test could
+// cover the margin it had then. Every cluster is tested when the
+// projection or the visible set changes, and every few frames anyway.
+class IncrementalCulling {
+public:
+	// From the current fixed function matrices, before the meshes draw
+	void beginFrame(const VisibleTiles* visible);
+
+	// Disabled, every frame is a full pass
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+	bool isFullPass() const;
+
+	const Point3& getEye() const;
+	double getTranslation() const;
+	double getRotation() const;
+
+	// How far the planes can have moved across a point radius away from
+	// where the eye was when the totals read translation and rotation
+	float getPlaneMotion(double translation, double rotation, float radius) const;
+
+	// Meshes add the clusters they tested out of all those they culled
+	void addTests(size_t tested, size_t clusters);
+	// Of the last complete frame
+	size_t getTestCount() const;
+	size_t getClusterCount() const;
+
+private:
+	bool enabled = true;
+	bool fullPass = true;
+	unsigned frame = 0;
+	float projection[16] = {};
+	float rotation[9] = {};
+	int visibleSet = -1;
+
+	Point3 eye;
+	double translationTotal = 0, rotationTotal = 0;
+
+	size_t tests = 0, clusters = 0;
+	size_t lastTests = 0, lastClusters = 0;
+};
@@ -0,0 +1,121 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include "SamplingProfiler.h"
+#include "Tunables.h"
+
+using namespace std;
+
+Tunable<int> jobWorkers("jobs.workers", 0, 0, 256, "Worker threads, 0 for one per core but the main one. Read at startup.");
+
+// Index of the calling thread inside parallelFor: 0 for any thread
+// that is not a worker, i + 1 for worker i
+static thread_local unsigned threadIndex = 0;
+
+JobSystem::JobSystem(unsigned workerCount) {
+	if (workerCount == 0) {
+		unsigned cores = thread::hardware_concurrency();
+		workerCount = cores > 1 ? cores - 1 : 1;
+	}
+
+	for (unsigned i = 0; i < workerCount; i++)
+		this->workers.push_back(thread(&JobSystem::workerLoop, this, i));
+}
+
+JobSystem::~JobSystem() {
+	{
+		lock_guard<mutex> lock(this->jobsMutex);
+		this->stopping = true;
+	}
+	this->wakeUp.notify_all();
+
+	for (thread& worker : this->workers)
+		worker.join();
+}
+
+void JobSystem::submit(function<void()> job) {
+	{
+		lock_guard<mutex> lock(this->jobsMutex);
+		this->jobs.push_back(move(job));
+	}
+	this->wakeUp.notify_one();
+}
+
+void JobSystem::workerLoop(unsigned index) {
+	threadIndex = index + 1;
+	setProfilerThreadName("worker");
+
+	while (true) {
+		function<void()> job;
+		{
+			unique_lock<mutex> lock(this->jobsMutex);
+			this->wakeUp.wait(lock, [this]() { return this->stopping || !this->jobs.empty(); });
+			if (this->jobs.empty())
+				return;
+
+			job = move(this->jobs.front());
+			this->jobs.pop_front();
+		}
+		job();
+	}
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const function<void(size_t begin, size_t end, unsigned thread)>& body) {
+	if (count == 0)
+		return;
+	grain = max(grain, (size_t)1);
+
+	size_t rangeCount = (count + grain - 1) / grain;
+	if (rangeCount == 1) {
+		body(0, count, threadIndex);
+		return;
+	}
+
+	struct Shared {
+		atomic<size_t> nextRange{ 0 };
+		atomic<size_t> doneRanges{ 0 };
+		mutex doneMutex;
+		condition_variable done;
+	};
+	auto shared = make_shared<Shared>();
+
+	auto run = [shared, &body, count, grain, rangeCount]() {
+		size_t finished = 0;
+		size_t range;
+		while ((range = shared->nextRange.fetch_add(1)) < rangeCount) {
+			size_t begin = range * grain;
+			body(begin, min(begin + grain, count), threadIndex);
+			finished++;
+		}
+
+		if (finished > 0 && shared->doneRanges.fetch_add(finished) + finished == rangeCount) {
+			lock_guard<mutex> lock(shared->doneMutex);
+			shared->done.notify_all();
+		}
+	};
+
+	// The caller takes ranges too, so this never waits on
+	// workers that are all busy elsewhere
+	unsigned helpers = (unsigned)min((size_t)this->workers.size(), rangeCount - 1);
+	for (unsigned i = 0; i < helpers; i++)
+		submit(run);
+	run();
+
+	unique_lock<mutex> lock(shared->doneMutex);
+	shared->done.wait(lock, [&]() { return shared->doneRanges.load() == rangeCount; });
+}
+
+unsigned JobSystem::getThreadCount() const {
+	return (unsigned)this->workers.size() + 1;
+}
+
+JobSystem& getJobSystem() {
+	static JobSystem jobSystem((unsigned)jobWorkers.get());
+	return jobSystem;
+}
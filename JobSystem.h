@@ -0,0 +1,60 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads shared by everything that wants to
+// spread work over the cores (decompression, bakes, culling...).
+class JobSystem {
+public:
+	// 0 picks one worker per core, minus the calling thread
+	JobSystem(unsigned workerCount = 0);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	void submit(std::function<void()> job);
+
+	// Runs job on a worker and returns a future for its result
+	template <typename Job>
+	auto async(Job job) -> std::future<decltype(job())> {
+		typedef decltype(job()) Result;
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+		std::future<Result> result = task->get_future();
+		submit([task]() { (*task)(); });
+		return result;
+	}
+
+	// Calls body(begin, end, thread) over [0, count) in ranges of at most
+	// grain items, on the workers and the calling thread, and returns once
+	// every range is done. thread is below getThreadCount() and no two
+	// ranges running at the same time share it, provided only one thread
+	// outside the pool calls parallelFor at a time.
+	void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end, unsigned thread)>& body);
+
+	// Workers plus the thread calling parallelFor
+	unsigned getThreadCount() const;
+
+private:
+	void workerLoop(unsigned index);
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex jobsMutex;
+	std::condition_variable wakeUp;
+	bool stopping = false;
+};
+
+// Process wide pool, created on first use
+JobSystem& getJobSystem();
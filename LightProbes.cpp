@@ -0,0 +1,283 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "LightProbes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include "JobSystem.h"
+
+using namespace std;
+
+#define PI 3.14159265f
+
+// Probes whose rays hit more back faces than this are inside geometry
+#define PROBE_BACKFACE_LIMIT 0.25f
+
+// Weight left to invalid probes when blending
+#define INVALID_PROBE_WEIGHT 1e-3f
+
+// Offset along the normal for rays leaving a surface
+#define RAY_EPSILON 1e-3f
+
+// Real spherical harmonics basis up to band 2
+static void shBasis(const Point3& n, float basis[SH_COEFFICIENTS]) {
+	basis[0] = 0.282095f;
+	basis[1] = 0.488603f * n.y;
+	basis[2] = 0.488603f * n.z;
+	basis[3] = 0.488603f * n.x;
+	basis[4] = 1.092548f * n.x * n.y;
+	basis[5] = 1.092548f * n.y * n.z;
+	basis[6] = 0.315392f * (3 * n.z * n.z - 1);
+	basis[7] = 1.092548f * n.x * n.z;
+	basis[8] = 0.546274f * (n.x * n.x - n.y * n.y);
+}
+
+// Cosine lobe convolution per band (Ramamoorthi and Hanrahan 2001)
+static const float cosineLobe[SH_COEFFICIENTS] = {
+	PI,
+	2 * PI / 3, 2 * PI / 3, 2 * PI / 3,
+	PI / 4, PI / 4, PI / 4, PI / 4, PI / 4
+};
+
+////////////////
+// ShIrradiance
+
+void ShIrradiance::add(const ShIrradiance& other, float weight) {
+	for (int i = 0; i < SH_COEFFICIENTS; i++)
+		this->coefficients[i] = this->coefficients[i] + other.coefficients[i] * weight;
+}
+
+Point3 ShIrradiance::evaluate(const Point3& normal, int order) const {
+	float basis[SH_COEFFICIENTS];
+	shBasis(normal, basis);
+
+	int count = order == 1 ? 4 : SH_COEFFICIENTS;
+	Point3 result;
+	for (int i = 0; i < count; i++)
+		result = result + this->coefficients[i] * basis[i];
+
+	// Ringing can dip below zero opposite bright lights
+	return Point3(max(result.x, 0.0f), max(result.y, 0.0f), max(result.z, 0.0f));
+}
+
+//////////////////
+// LightProbeGrid
+
+LightProbeGrid::LightProbeGrid() {
+}
+
+void LightProbeGrid::bake(const Bvh& scene, const Bounds& volume, const ProbeBakeLight& light, const ProbeBakeSettings& settings) {
+	auto start = chrono::steady_clock::now();
+
+	this->light = light;
+	this->settings = settings;
+	this->origin = volume.min;
+
+	Point3 size = volume.getSize();
+	this->resolution[0] = max(2, (int)ceilf(size.x / settings.spacing) + 1);
+	this->resolution[1] = max(2, (int)ceilf(size.y / settings.spacing) + 1);
+	this->resolution[2] = max(2, (int)ceilf(size.z / settings.spacing) + 1);
+
+	size_t count = (size_t)this->resolution[0] * this->resolution[1] * this->resolution[2];
+	vector<ShIrradiance> probes(count);
+	vector<uint8_t> valid(count);
+
+	getJobSystem().parallelFor(count, 16, [&](size_t begin, size_t end, unsigned thread) {
+		for (size_t i = begin; i < end; i++) {
+			int x = (int)(i % this->resolution[0]);
+			int y = (int)(i / this->resolution[0] % this->resolution[1]);
+			int z = (int)(i / ((size_t)this->resolution[0] * this->resolution[1]));
+			Point3 position = this->origin + Point3((float)x, (float)y, (float)z) * settings.spacing;
+
+			bool probeValid;
+			probes[i] = bakeProbe(scene, position, (uint32_t)i, probeValid);
+			valid[i] = probeValid;
+		}
+	});
+
+	this->probes = move(probes);
+	this->valid = move(valid);
+	dilateInvalidProbes();
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "Light probes: " << this->resolution[0] << "x" << this->resolution[1] << "x" << this->resolution[2]
+		<< " (L" << settings.order << ", " << settings.raysPerProbe << " rays each) baked in " << seconds << " s" << endl;
+}
+
+ShIrradiance LightProbeGrid::bakeProbe(const Bvh& scene, const Point3& position, uint32_t seed, bool& valid) const {
+	// Stratified directions on a spiral, randomly rotated per probe
+	// so neighbouring probes do not share the same banding
+	mt19937 random(seed);
+	uniform_real_distribution<float> unit(0, 1);
+	float rotation = unit(random) * 2 * PI;
+
+	float radiance[SH_COEFFICIENTS][3] = {};
+	int count = this->settings.raysPerProbe;
+	int backFaces = 0;
+	float basis[SH_COEFFICIENTS];
+
+	for (int i = 0; i < count; i++) {
+		float z = 1 - (2 * i + 1) / (float)count;
+		float r = sqrtf(max(0.0f, 1 - z * z));
+		float phi = i * 2.39996323f + rotation; // Golden angle
+		Point3 direction(r * cosf(phi), r * sinf(phi), z);
+
+		Point3 color = this->settings.skyColor;
+		RayHit hit;
+		if (scene.intersect(position, direction, INFINITY, hit)) {
+			if (hit.backFace)
+				backFaces++;
+
+			// Light leaving the hit point: its albedo times what reaches it
+			Point3 point = position + direction * hit.distance + hit.normal * RAY_EPSILON;
+			Point3 toLight = this->light.position - point;
+			float distance = length(toLight);
+			toLight = toLight * (1 / distance);
+
+			Point3 irradiance = this->light.ambient;
+			float cosine = dot(hit.normal, toLight);
+			if (cosine > 0 && !scene.occluded(point, toLight, distance))
+				irradiance = irradiance + this->light.diffuse * cosine;
+
+			color = hit.albedo * irradiance;
+		}
+
+		shBasis(direction, basis);
+		for (int j = 0; j < SH_COEFFICIENTS; j++) {
+			radiance[j][0] += color.x * basis[j];
+			radiance[j][1] += color.y * basis[j];
+			radiance[j][2] += color.z * basis[j];
+		}
+	}
+
+	valid = backFaces <= count * PROBE_BACKFACE_LIMIT;
+
+	ShIrradiance result;
+	int coefficients = this->settings.order == 1 ? 4 : SH_COEFFICIENTS;
+	// Monte Carlo projection over the sphere, 4 pi / count per ray,
+	// of the radiance, which is color / pi for a diffuse surface
+	float weight = 4.0f / count;
+	for (int j = 0; j < coefficients; j++)
+		result.coefficients[j] = Point3(radiance[j][0], radiance[j][1], radiance[j][2]) * (weight * cosineLobe[j]);
+
+	// Direct light, as a delta in its direction when the probe sees it
+	Point3 toLight = this->light.position - position;
+	float distance = length(toLight);
+	toLight = toLight * (1 / distance);
+	if (!scene.occluded(position, toLight, distance)) {
+		shBasis(toLight, basis);
+		for (int j = 0; j < coefficients; j++)
+			result.coefficients[j] = result.coefficients[j] + this->light.diffuse * (basis[j] * cosineLobe[j]);
+	}
+
+	// Ambient is the same from every direction, so only band 0 holds it
+	result.coefficients[0] = result.coefficients[0] + this->light.ambient * (1 / 0.282095f);
+
+	return result;
+}
+
+size_t LightProbeGrid::probeIndex(int x, int y, int z) const {
+	return ((size_t)z * this->resolution[1] + y) * this->resolution[0] + x;
+}
+
+void LightProbeGrid::dilateInvalidProbes() {
+	// Invalid probes take the average of their valid neighbours, growing
+	// inwards, so a lookup surrounded only by them still gets something
+	vector<uint8_t> filled = this->valid;
+	bool changed = true;
+
+	while (changed) {
+		changed = false;
+		vector<uint8_t> next = filled;
+
+		for (int z = 0; z < this->resolution[2]; z++) {
+			for (int y = 0; y < this->resolution[1]; y++) {
+				for (int x = 0; x < this->resolution[0]; x++) {
+					size_t index = probeIndex(x, y, z);
+					if (filled[index])
+						continue;
+
+					static const int offsets[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+					ShIrradiance sum;
+					int count = 0;
+					for (const int* offset : offsets) {
+						int nx = x + offset[0], ny = y + offset[1], nz = z + offset[2];
+						if (nx < 0 || ny < 0 || nz < 0 || nx >= this->resolution[0] || ny >= this->resolution[1] || nz >= this->resolution[2])
+							continue;
+
+						size_t neighbour = probeIndex(nx, ny, nz);
+						if (filled[neighbour]) {
+							sum.add(this->probes[neighbour], 1);
+							count++;
+						}
+					}
+
+					if (count > 0) {
+						this->probes[index] = ShIrradiance();
+						this->probes[index].add(sum, 1.0f / count);
+						next[index] = 1;
+						changed = true;
+					}
+				}
+			}
+		}
+
+		filled = move(next);
+	}
+}
+
+bool LightProbeGrid::sample(const Point3& position, ShIrradiance& irradiance) const {
+	if (this->probes.empty())
+		return false;
+
+	// Grid coordinates, clamped so the 8 corners always exist
+	Point3 local = (position - this->origin) * (1 / this->settings.spacing);
+	float coords[3] = { local.x, local.y, local.z };
+	int cell[3];
+	float fraction[3];
+	for (int a = 0; a < 3; a++) {
+		float c = min(max(coords[a], 0.0f), (float)(this->resolution[a] - 1));
+		cell[a] = min((int)c, this->resolution[a] - 2);
+		fraction[a] = c - cell[a];
+	}
+
+	irradiance = ShIrradiance();
+	float totalWeight = 0;
+	for (int corner = 0; corner < 8; corner++) {
+		int dx = corner & 1, dy = (corner >> 1) & 1, dz = corner >> 2;
+		size_t index = probeIndex(cell[0] + dx, cell[1] + dy, cell[2] + dz);
+
+		float weight = (dx ? fraction[0] : 1 - fraction[0])
+			* (dy ? fraction[1] : 1 - fraction[1])
+			* (dz ? fraction[2] : 1 - fraction[2]);
+		if (!this->valid[index])
+			weight *= INVALID_PROBE_WEIGHT;
+
+		irradiance.add(this->probes[index], weight);
+		totalWeight += weight;
+	}
+
+	if (totalWeight > 0) {
+		ShIrradiance blended;
+		blended.add(irradiance, 1 / totalWeight);
+		irradiance = blended;
+	}
+	return true;
+}
+
+bool LightProbeGrid::isBaked() const {
+	return !this->probes.empty();
+}
+
+size_t LightProbeGrid::getProbeCount() const {
+	return this->probes.size();
+}
+
+int LightProbeGrid::getOrder() const {
+	return this->settings.order;
+}
@@ -0,0 +1,79 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Point3.h"
+#include "Bvh.h"
+#include "GeometryStreams.h"
+
+// Coefficients of second order (L2) spherical harmonics; L1 uses the first 4
+#define SH_COEFFICIENTS 9
+
+// Irradiance stored as spherical harmonics, one RGB triple (in x, y, z)
+// per coefficient, already convolved with the cosine lobe. Evaluating it
+// for a normal gives the light a diffuse surface facing that way receives,
+// in the same units as the fixed function lighting: color = albedo * E.
+class ShIrradiance {
+public:
+	Point3 coefficients[SH_COEFFICIENTS];
+
+	// this += other * weight
+	void add(const ShIrradiance& other, float weight);
+
+	// order 1 reads only the first 4 coefficients
+	Point3 evaluate(const Point3& normal, int order = 2) const;
+};
+
+// The static lighting the bake reproduces, mirroring the scene's light 0
+struct ProbeBakeLight {
+	Point3 position;
+	Point3 diffuse;
+	// Added everywhere, unshadowed, like OpenGL's ambient terms
+	Point3 ambient;
+};
+
+struct ProbeBakeSettings {
+	float spacing = 1;         // Meters between neighbouring probes
+	int raysPerProbe = 256;
+	int order = 2;             // 1 for L1 (4 coefficients), 2 for L2 (9)
+	Point3 skyColor = Point3(0.1, 0.1, 0.1); // What rays escaping the scene see
+};
+
+// Regular grid of irradiance probes over a volume of a static scene.
+// The bake traces rays from every probe in parallel on the job system:
+// direct light with shadows plus one diffuse bounce off the geometry.
+// At runtime a dynamic object blends the 8 probes around it and then
+// evaluates the result per normal, a handful of multiply-adds instead
+// of evaluating every light.
+class LightProbeGrid {
+public:
+	LightProbeGrid();
+
+	void bake(const Bvh& scene, const Bounds& volume, const ProbeBakeLight& light, const ProbeBakeSettings& settings);
+
+	// Trilinear blend of the probes around position, which is clamped to
+	// the grid. Probes buried inside geometry barely count, so light does
+	// not leak through walls. Returns false while nothing is baked.
+	bool sample(const Point3& position, ShIrradiance& irradiance) const;
+
+	bool isBaked() const;
+	size_t getProbeCount() const;
+	int getOrder() const;
+
+private:
+	ShIrradiance bakeProbe(const Bvh& scene, const Point3& position, uint32_t seed, bool& valid) const;
+	size_t probeIndex(int x, int y, int z) const;
+	void dilateInvalidProbes();
+
+	ProbeBakeLight light;
+	ProbeBakeSettings settings;
+	Point3 origin;
+	int resolution[3] = { 0, 0, 0 };
+	std::vector<ShIrradiance> probes;
+	std::vector<uint8_t> valid;
+};
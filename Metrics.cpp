@@ -0,0 +1,388 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "Metrics.h"
+#include "SamplingProfiler.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+#ifdef _WIN32
+typedef SOCKET Socket;
+static void closeSocket(Socket socket) {
+	closesocket(socket);
+}
+#else
+typedef int Socket;
+#define INVALID_SOCKET (-1)
+static void closeSocket(Socket socket) {
+	close(socket);
+}
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Label lists joined, either may be empty
+static string joinLabels(const string& labels, const string& more) {
+	if (labels.empty() || more.empty())
+		return labels + more;
+	return labels + "," + more;
+}
+
+// Backslashes and newlines escaped, and double quotes too for label values
+static string escapeText(const string& text, bool quotes) {
+	string escaped;
+	for (char c : text) {
+		if (c == '\\' || (quotes && c == '"'))
+			escaped += '\\';
+		if (c == '\n')
+			escaped += "\\n";
+		else
+			escaped += c;
+	}
+	return escaped;
+}
+
+static void writeSample(ostream& out, const string& name, const string& labels, double value) {
+	out << name;
+	if (!labels.empty())
+		out << "{" << labels << "}";
+	// Streams print these as "inf" and "nan", which scrapers reject
+	if (isnan(value))
+		out << " NaN\n";
+	else if (isinf(value))
+		out << (value > 0 ? " +Inf\n" : " -Inf\n");
+	else
+		out << " " << value << "\n";
+}
+
+///////////
+// Metrics
+
+void Counter::add(uint64_t amount) {
+	this->value.fetch_add(amount, memory_order_relaxed);
+}
+
+uint64_t Counter::get() const {
+	return this->value.load(memory_order_relaxed);
+}
+
+void Counter::write(ostream& out, const string& name, const string& labels) const {
+	writeSample(out, name, labels, (double)get());
+}
+
+void Gauge::set(double value) {
+	this->value.store(value, memory_order_relaxed);
+}
+
+double Gauge::get() const {
+	return this->value.load(memory_order_relaxed);
+}
+
+void Gauge::write(ostream& out, const string& name, const string& labels) const {
+	writeSample(out, name, labels, get());
+}
+
+Histogram::Histogram(const vector<double>& bounds) : bounds(bounds), counts(new atomic<uint64_t>[bounds.size() + 1]) {
+	for (size_t i = 0; i <= bounds.size(); i++)
+		this->counts[i].store(0, memory_order_relaxed);
+}
+
+void Histogram::observe(double value) {
+	size_t bucket = 0;
+	while (bucket < this->bounds.size() && value > this->bounds[bucket])
+		bucket++;
+	this->counts[bucket].fetch_add(1, memory_order_relaxed);
+
+	double sum = this->sum.load(memory_order_relaxed);
+	while (!this->sum.compare_exchange_weak(sum, sum + value, memory_order_relaxed))
+		;
+}
+
+void Histogram::write(ostream& out, const string& name, const string& labels) const {
+	// Read while others may be observing, so the count is taken from
+	// the buckets to stay consistent with them
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i <= this->bounds.size(); i++) {
+		cumulative += this->counts[i].load(memory_order_relaxed);
+		stringstream bound;
+		bound.precision(15);
+		if (i < this->bounds.size())
+			bound << this->bounds[i];
+		else
+			bound << "+Inf";
+		writeSample(out, name + "_bucket", joinLabels(labels, metricLabel("le", bound.str())), (double)cumulative);
+	}
+	writeSample(out, name + "_sum", labels, this->sum.load(memory_order_relaxed));
+	writeSample(out, name + "_count", labels, (double)cumulative);
+}
+
+string metricLabel(const string& name, const string& value) {
+	return name + "=\"" + escapeText(value, true) + "\"";
+}
+
+///////////////////
+// MetricsRegistry
+
+MetricsRegistry& getMetrics() {
+	static MetricsRegistry registry;
+	return registry;
+}
+
+template <typename T, typename Create>
+T& MetricsRegistry::find(const string& name, const string& help, const char* type, const string& labels, Create create) {
+	lock_guard<mutex> lock(this->familiesMutex);
+
+	Family* family = nullptr;
+	for (auto& existing : this->families) {
+		if (existing->name == name)
+			family = existing.get();
+	}
+	if (!family) {
+		this->families.push_back(unique_ptr<Family>(new Family{ name, help, type, {} }));
+		family = this->families.back().get();
+	}
+
+	// Casting another type's series would be undefined, so such calls get
+	// a series of their own that is never written
+	if (family->type != type) {
+		cout << "Metric " << name << " is a " << family->type << ", not a " << type << endl;
+		this->unlisted.push_back(unique_ptr<Metric>(create()));
+		return *(T*)this->unlisted.back().get();
+	}
+
+	for (auto& series : family->series) {
+		if (series.first == labels)
+			return *(T*)series.second.get();
+	}
+	family->series.push_back({ labels, unique_ptr<Metric>(create()) });
+	return *(T*)family->series.back().second.get();
+}
+
+Counter& MetricsRegistry::counter(const string& name, const string& help, const string& labels) {
+	return find<Counter>(name, help, "counter", labels, []() { return new Counter(); });
+}
+
+Gauge& MetricsRegistry::gauge(const string& name, const string& help, const string& labels) {
+	return find<Gauge>(name, help, "gauge", labels, []() { return new Gauge(); });
+}
+
+Histogram& MetricsRegistry::histogram(const string& name, const string& help, const vector<double>& bounds, const string& labels) {
+	return find<Histogram>(name, help, "histogram", labels, [&]() { return new Histogram(bounds); });
+}
+
+string MetricsRegistry::format() const {
+	lock_guard<mutex> lock(this->familiesMutex);
+
+	stringstream out;
+	out.precision(15);
+	for (const auto& family : this->families) {
+		out << "# HELP " << family->name << " " << escapeText(family->help, false) << "\n";
+		out << "# TYPE " << family->name << " " << family->type << "\n";
+		for (const auto& series : family->series)
+			series.second->write(out, family->name, series.first);
+	}
+	return out.str();
+}
+
+///////////////////
+// MetricsExporter
+
+MetricsExporter::MetricsExporter() {
+}
+
+MetricsExporter::~MetricsExporter() {
+	stop();
+}
+
+bool MetricsExporter::start(int port, const string& textfile, double intervalSeconds) {
+	stop();
+	this->textfile = textfile;
+	this->interval = intervalSeconds > 0 ? intervalSeconds : METRICS_TEXTFILE_INTERVAL;
+
+	if (port > 0) {
+#ifdef _WIN32
+		WSADATA data;
+		if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+			return false;
+#endif
+		Socket listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (listener == INVALID_SOCKET) {
+#ifdef _WIN32
+			WSACleanup();
+#endif
+			return false;
+		}
+
+		int reuse = 1;
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+		// Only this machine can scrape it
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons((uint16_t)port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (::bind(listener, (const sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 8) != 0) {
+			closeSocket(listener);
+#ifdef _WIN32
+			WSACleanup();
+#endif
+			return false;
+		}
+		this->listener = (intptr_t)listener;
+	}
+
+	if (this->listener == -1 && this->textfile.empty())
+		return true;
+
+	this->stopping = false;
+	this->worker = thread(&MetricsExporter::run, this);
+	return true;
+}
+
+void MetricsExporter::stop() {
+	this->stopping = true;
+	if (this->worker.joinable())
+		this->worker.join();
+
+	if (this->listener != -1) {
+		closeSocket((Socket)this->listener);
+		this->listener = -1;
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+}
+
+void MetricsExporter::run() {
+	typedef chrono::steady_clock Clock;
+	auto nextWrite = Clock::now();
+	setProfilerThreadName("metrics");
+
+	while (!this->stopping) {
+		if (this->listener != -1) {
+			Socket listener = (Socket)this->listener;
+			fd_set readable;
+			FD_ZERO(&readable);
+			FD_SET(listener, &readable);
+			timeval timeout = { 0, METRICS_POLL_MILLISECONDS * 1000 };
+			if (select((int)listener + 1, &readable, nullptr, nullptr, &timeout) > 0) {
+				Socket connection = accept(listener, nullptr, nullptr);
+				if (connection != INVALID_SOCKET)
+					serveConnection((intptr_t)connection);
+			}
+		}
+		else
+			this_thread::sleep_for(chrono::milliseconds(METRICS_POLL_MILLISECONDS));
+
+		if (!this->textfile.empty() && Clock::now() >= nextWrite) {
+			if (!writeTextfile())
+				cout << "Could not write metrics to " << this->textfile << endl;
+			nextWrite = Clock::now() + chrono::duration_cast<Clock::duration>(chrono::duration<double>(this->interval));
+		}
+	}
+}
+
+// Milliseconds left before deadline, 0 once it has passed
+static long millisecondsUntil(chrono::steady_clock::time_point deadline) {
+	auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+	return left > 0 ? (long)left : 0;
+}
+
+void MetricsExporter::serveConnection(intptr_t connection) {
+	Socket client = (Socket)connection;
+	auto deadline = chrono::steady_clock::now() + chrono::milliseconds(METRICS_CONNECTION_MILLISECONDS);
+
+	// The request line and headers, giving up on slow or huge requests
+	string request;
+	char buffer[1024];
+	while (request.find("\r\n\r\n") == string::npos && request.size() < 8192) {
+		long left = millisecondsUntil(deadline);
+		if (left == 0)
+			break;
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET(client, &readable);
+		timeval timeout = { left / 1000, left % 1000 * 1000 };
+		if (select((int)client + 1, &readable, nullptr, nullptr, &timeout) <= 0)
+			break;
+		int received = (int)recv(client, buffer, sizeof(buffer), 0);
+		if (received <= 0)
+			break;
+		request.append(buffer, received);
+	}
+
+	string status = "200 OK", body;
+	if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0)
+		body = getMetrics().format();
+	else if (request.compare(0, 4, "GET ") == 0) {
+		status = "404 Not Found";
+		body = "Metrics are at /metrics\n";
+	}
+	else {
+		status = "405 Method Not Allowed";
+		body = "Only GET is served\n";
+	}
+
+	stringstream response;
+	response << "HTTP/1.0 " << status << "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: "
+		<< body.size() << "\r\nConnection: close\r\n\r\n" << body;
+	string bytes = response.str();
+	for (size_t sent = 0; sent < bytes.size();) {
+		// A client that stops reading blocks send only until the deadline
+		long left = millisecondsUntil(deadline);
+		if (left == 0)
+			break;
+#ifdef _WIN32
+		DWORD sendTimeout = (DWORD)left;
+#else
+		timeval sendTimeout = { left / 1000, left % 1000 * 1000 };
+#endif
+		setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char*)&sendTimeout, sizeof(sendTimeout));
+
+		// A scraper hanging up early must not raise SIGPIPE
+		int count = (int)send(client, bytes.data() + sent, (int)(bytes.size() - sent), MSG_NOSIGNAL);
+		if (count <= 0)
+			break;
+		sent += count;
+	}
+	closeSocket(client);
+}
+
+bool MetricsExporter::writeTextfile() const {
+	// Renamed into place, so the collector never reads half a file
+	string temporary = this->textfile + ".tmp";
+	{
+		ofstream file(temporary, ofstream::out | ofstream::trunc);
+		if (!file.is_open())
+			return false;
+		file << getMetrics().format();
+		if (!file)
+			return false;
+	}
+#ifdef _WIN32
+	remove(this->textfile.c_str());
+#endif
+	return rename(temporary.c_str(), this->textfile.c_str()) == 0;
+}
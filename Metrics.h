@@ -0,0 +1,128 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Seconds between rewrites of the textfile, by default
+#define METRICS_TEXTFILE_INTERVAL 15.0
+// How long the exporter waits on its socket before checking for work
+#define METRICS_POLL_MILLISECONDS 100
+// How long one scrape may take to send its request and read the
+// response, so a slow or stuck client cannot hold the exporter
+#define METRICS_CONNECTION_MILLISECONDS 2000
+
+// One series of a metric family, updated with relaxed atomics so any
+// thread can record into it while the exporter thread reads it
+class Metric {
+public:
+	virtual ~Metric() = default;
+	// Its sample lines in the Prometheus text format, labels being
+	// "" or such as cache="pvs"
+	virtual void write(std::ostream& out, const std::string& name, const std::string& labels) const = 0;
+};
+
+class Counter : public Metric {
+public:
+	void add(uint64_t amount = 1);
+	uint64_t get() const;
+	void write(std::ostream& out, const std::string& name, const std::string& labels) const override;
+
+private:
+	std::atomic<uint64_t> value{ 0 };
+};
+
+class Gauge : public Metric {
+public:
+	void set(double value);
+	double get() const;
+	void write(std::ostream& out, const std::string& name, const std::string& labels) const override;
+
+private:
+	std::atomic<double> value{ 0 };
+};
+
+// Counts observations under each upper bound, cumulated when written
+class Histogram : public Metric {
+public:
+	explicit Histogram(const std::vector<double>& bounds);
+	void observe(double value);
+	void write(std::ostream& out, const std::string& name, const std::string& labels) const override;
+
+private:
+	std::vector<double> bounds;
+	std::unique_ptr<std::atomic<uint64_t>[]> counts; // One per bound, then one above them all
+	std::atomic<double> sum{ 0 };
+};
+
+// name="value", with value escaped
+std::string metricLabel(const std::string& name, const std::string& value);
+
+// Every metric, by family. The first call for a name and labels creates
+// the series and later ones return it; references stay valid for good,
+// so code on a hot path looks its series up once and keeps it. Asking
+// for a family as another type than it was created with logs it and
+// returns a new series that is never exported.
+class MetricsRegistry {
+public:
+	Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+	Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+	// bounds only matter to the first call for a series
+	Histogram& histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds,
+		const std::string& labels = "");
+
+	// Every family in the Prometheus text exposition format
+	std::string format() const;
+
+private:
+	struct Family {
+		std::string name, help, type;
+		std::vector<std::pair<std::string, std::unique_ptr<Metric>>> series;
+	};
+
+	template <typename T, typename Create>
+	T& find(const std::string& name, const std::string& help, const char* type, const std::string& labels, Create create);
+
+	mutable std::mutex familiesMutex;
+	std::vector<std::unique_ptr<Family>> families;
+	std::vector<std::unique_ptr<Metric>> unlisted; // Given out on type mismatches
+};
+
+MetricsRegistry& getMetrics();
+
+// Publishes the registry from a background thread, so the frame never
+// waits on a scrape: over HTTP on 127.0.0.1, and/or as a textfile for
+// node_exporter's textfile collector, replaced atomically each time.
+class MetricsExporter {
+public:
+	MetricsExporter();
+	~MetricsExporter();
+	MetricsExporter(const MetricsExporter&) = delete;
+	MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+	// port 0 serves nothing, an empty textfile writes nothing. Returns
+	// false, exporting nothing, if the port cannot be listened on.
+	bool start(int port, const std::string& textfile, double intervalSeconds);
+	void stop();
+
+private:
+	void run();
+	void serveConnection(intptr_t connection);
+	bool writeTextfile() const;
+
+	std::thread worker;
+	std::atomic<bool> stopping{ false };
+	intptr_t listener = -1;
+	std::string textfile;
+	double interval = METRICS_TEXTFILE_INTERVAL;
+};
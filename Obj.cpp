@@ -0,0 +1,370 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Obj.h"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <gl/glut.h>
+#include "ObjParsing.h"
+#include "ByteSource.h"
+#include "FrameStats.h"
+
+// Size of each read from the source. Lines are never copied out of
+// this buffer, only the incomplete one at the end of a chunk.
+#define READ_CHUNK_SIZE (1 << 20)
+
+using namespace std;
+
+static bool isKeyword(const char* begin, const char* end, const char* keyword) {
+	size_t length = strlen(keyword);
+	return (size_t)(end - begin) == length && memcmp(begin, keyword, length) == 0;
+}
+
+static const char* parseFloats(const char* p, const char* end, float* values, int count) {
+	for (int i = 0; i < count && p; i++)
+		p = parseFloat(skipBlanks(p, end), end, &values[i]);
+	return p;
+}
+
+////////////////
+// Face parsing
+// Faces come in four forms: "v", "v/vt", "v//vn" and "v/vt/vn". The form
+// and corner count are detected on the first face of each object, and a
+// parser specialized for both reads the following faces, so the loop over
+// corners never checks which form it is in.
+
+enum class FaceForm {
+	V,
+	VT,
+	VN,
+	VTN
+};
+
+// Largest polygon accepted
+#define MAX_FACE_CORNERS 64
+
+struct FaceCorner {
+	int vertexId;
+	int texCoordId;
+	int normalId;
+};
+
+// 1-based position of an index among the count elements read so far,
+// or 0 if it falls outside them, which makes the face invalid
+static int resolveIndex(int index, size_t count) {
+	// Negative indices count back from the last element read so far
+	if (index < 0)
+		index += (int)count + 1;
+	return index >= 1 && (size_t)index <= count ? index : 0;
+}
+
+template <FaceForm Form>
+static const char* parseCorner(const char* p, const char* end, const Obj& obj, FaceCorner& corner) {
+	int index;
+	corner.texCoordId = 0;
+	corner.normalId = 0;
+
+	p = parseInt(p, end, &index);
+	if (!p)
+		return nullptr;
+	corner.vertexId = resolveIndex(index, obj.vertices.size());
+	if (!corner.vertexId)
+		return nullptr;
+
+	if constexpr (Form == FaceForm::VT || Form == FaceForm::VTN) {
+		if (p == end || *p != '/' || !(p = parseInt(p + 1, end, &index)))
+			return nullptr;
+		corner.texCoordId = resolveIndex(index, obj.texCoords.size());
+		if (!corner.texCoordId)
+			return nullptr;
+	}
+
+	if constexpr (Form == FaceForm::VN) {
+		if (end - p < 2 || p[0] != '/' || p[1] != '/' || !(p = parseInt(p + 2, end, &index)))
+			return nullptr;
+		if (!(corner.normalId = obj.resolveNormalId(index)))
+			return nullptr;
+	}
+	else if constexpr (Form == FaceForm::VTN) {
+		if (p == end || *p != '/' || !(p = parseInt(p + 1, end, &index)))
+			return nullptr;
+		if (!(corner.normalId = obj.resolveNormalId(index)))
+			return nullptr;
+	}
+
+	// Anything but a blank here means the corner is in another form
+	if (p < end && *p != ' ' && *p != '\t')
+		return nullptr;
+	return p;
+}
+
+static Point3 polygonNormal(const Obj& obj, const FaceCorner* corners, int count) {
+	// Newell's method, which also copes with slightly non planar polygons
+	Point3 normal;
+	for (int i = 0; i < count; i++) {
+		size_t a = (size_t)(corners[i].vertexId - 1);
+		size_t b = (size_t)(corners[(i + 1) % count].vertexId - 1);
+		if (a >= obj.vertices.size() || b >= obj.vertices.size())
+			continue;
+
+		const Point3& p = obj.vertices[a];
+		const Point3& q = obj.vertices[b];
+		normal.x += (p.y - q.y) * (p.z + q.z);
+		normal.y += (p.z - q.z) * (p.x + q.x);
+		normal.z += (p.x - q.x) * (p.y + q.y);
+	}
+
+	float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+	if (length > 0)
+		normal = Point3(normal.x / length, normal.y / length, normal.z / length);
+	return normal;
+}
+
+template <bool HasNormals>
+static void addPolygon(Obj& obj, const FaceCorner* corners, int count) {
+	int generatedNormalId = 0;
+	if constexpr (!HasNormals) {
+		// Flat shading for faces that come without normals
+		obj.normals.push_back(polygonNormal(obj, corners, count));
+		generatedNormalId = (int)obj.normals.size();
+	}
+
+	// Fan of quads around the first corner, the last one
+	// possibly a triangle repeating its last corner
+	for (int first = 1; first + 1 < count; first += 2) {
+		int ids[4] = { 0, first, first + 1, min(first + 2, count - 1) };
+
+		Face face;
+		for (int j = 0; j < 4; j++) {
+			const FaceCorner& corner = corners[ids[j]];
+			face.vertexIds[j] = corner.vertexId;
+			face.texCoordIds[j] = corner.texCoordId;
+			face.normalIds[j] = HasNormals ? corner.normalId : generatedNormalId;
+		}
+		obj.faces.push_back(face);
+	}
+}
+
+// Arity 0 accepts any number of corners
+template <FaceForm Form, int Arity>
+static bool parseFace(Obj& obj, const char* p, const char* end) {
+	FaceCorner corners[Arity > 0 ? Arity : MAX_FACE_CORNERS];
+	int count = 0;
+
+	if constexpr (Arity > 0) {
+		for (; count < Arity; count++) {
+			p = parseCorner<Form>(skipBlanks(p, end), end, obj, corners[count]);
+			if (!p)
+				return false;
+		}
+		if (skipBlanks(p, end) != end)
+			return false;
+	}
+	else {
+		for (p = skipBlanks(p, end); p < end; p = skipBlanks(p, end)) {
+			if (count == MAX_FACE_CORNERS)
+				return false;
+			p = parseCorner<Form>(p, end, obj, corners[count++]);
+			if (!p)
+				return false;
+		}
+		if (count < 3)
+			return false;
+	}
+
+	addPolygon<Form == FaceForm::VN || Form == FaceForm::VTN>(obj, corners, count);
+	return true;
+}
+
+static const FaceParser faceParsers[4][3] = {
+	{ parseFace<FaceForm::V, 3>, parseFace<FaceForm::V, 4>, parseFace<FaceForm::V, 0> },
+	{ parseFace<FaceForm::VT, 3>, parseFace<FaceForm::VT, 4>, parseFace<FaceForm::VT, 0> },
+	{ parseFace<FaceForm::VN, 3>, parseFace<FaceForm::VN, 4>, parseFace<FaceForm::VN, 0> },
+	{ parseFace<FaceForm::VTN, 3>, parseFace<FaceForm::VTN, 4>, parseFace<FaceForm::VTN, 0> }
+};
+
+static FaceParser selectFaceParser(const char* p, const char* end) {
+	// The form comes from the slashes in the first corner
+	p = skipBlanks(p, end);
+	const char* cornerEnd = findTokenEnd(p, end);
+	const char* slash = find(p, cornerEnd, '/');
+
+	FaceForm form;
+	if (slash == cornerEnd)
+		form = FaceForm::V;
+	else if (slash + 1 < cornerEnd && slash[1] == '/')
+		form = FaceForm::VN;
+	else if (find(slash + 1, cornerEnd, '/') != cornerEnd)
+		form = FaceForm::VTN;
+	else
+		form = FaceForm::VT;
+
+	int corners = 0;
+	for (; p < end && corners < 5; corners++)
+		p = skipBlanks(findTokenEnd(p, end), end);
+
+	int arity = corners == 3 ? 0 : corners == 4 ? 1 : 2;
+	return faceParsers[(int)form][arity];
+}
+
+///////
+// Obj
+
+Obj::Obj(const char* filename) {
+	readFile(filename);
+}
+
+Obj::Obj() {
+}
+
+void Obj::readFile(const char* filename) {
+	// Reads a single object, plain or compressed
+
+	auto start = chrono::steady_clock::now();
+
+	unique_ptr<ByteSource> source = openByteSource(filename);
+	if (!source) {
+		cout << "Could not open " << filename << endl;
+		return;
+	}
+
+	vector<char> buffer(READ_CHUNK_SIZE);
+	size_t pending = 0;
+	size_t totalBytes = 0;
+
+	while (true) {
+		if (pending == buffer.size()) {
+			// A single line longer than the whole buffer
+			buffer.resize(buffer.size() * 2);
+		}
+
+		size_t count = source->read(buffer.data() + pending, buffer.size() - pending);
+		if (count == 0)
+			break;
+
+		totalBytes += count;
+		const char* begin = buffer.data();
+		const char* end = begin + pending + count;
+
+		// Keep the incomplete last line for the next chunk
+		const char* rest = parseLines(begin, end);
+		pending = end - rest;
+		memmove(buffer.data(), rest, pending);
+
+		if (this->onChunkParsed)
+			this->onChunkParsed(*this);
+	}
+
+	// Last line without a trailing newline
+	if (pending > 0) {
+		parseLine(buffer.data(), buffer.data() + pending);
+
+		if (this->onChunkParsed)
+			this->onChunkParsed(*this);
+	}
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	double megabytes = totalBytes / 1e6;
+	cout << this->name << ": " << megabytes << " MB (" << source->getBytesFromDisk() / 1e6 << " MB on disk) in "
+		<< seconds << " s, " << (seconds > 0 ? megabytes / seconds : 0) << " MB/s" << endl;
+}
+
+const char* Obj::parseLines(const char* begin, const char* end) {
+	// Parses every complete line in [begin, end), returning
+	// where the trailing incomplete line starts
+
+	while (begin < end) {
+		const char* newline = findNewline(begin, end);
+		if (newline == end)
+			break;
+
+		parseLine(begin, newline);
+		begin = newline + 1;
+	}
+
+	return begin;
+}
+
+void Obj::parseLine(const char* line, const char* end) {
+	if (end > line && end[-1] == '\r')
+		end--;
+
+	const char* keyword = skipBlanks(line, end);
+	const char* keywordEnd = findTokenEnd(keyword, end);
+	const char* p = keywordEnd;
+
+	// Ignore comments and blank lines
+	if (keyword == end || *keyword == '#')
+		return;
+
+	if (isKeyword(keyword, keywordEnd, "o")) {
+		// name
+		this->name = string(skipBlanks(p, end), end);
+		this->faceParser = nullptr;
+	}
+	else if (isKeyword(keyword, keywordEnd, "v") || isKeyword(keyword, keywordEnd, "vn")) {
+		float coords[3] = { 0, 0, 0 };
+		p = parseFloats(p, end, coords, 3);
+		if (!p)
+			cout << "Invalid vertex: " << string(line, end) << endl;
+
+		Point3 point(coords[0], coords[1], coords[2]);
+
+		if (keyword[1] == 'n') {
+			// normal vector
+			this->normals.push_back(point);
+			this->fileNormalIds.push_back((int)this->normals.size());
+		}
+		else {
+			// vertex
+			this->vertices.push_back(point);
+		}
+	}
+	else if (isKeyword(keyword, keywordEnd, "vt")) {
+		// texture coordinate: u, then optionally v and w
+		float coords[3] = { 0, 0, 0 };
+		p = parseFloats(p, end, coords, 1);
+		for (int i = 1; i < 3 && p && skipBlanks(p, end) != end; i++)
+			p = parseFloats(p, end, coords + i, 1);
+		if (!p)
+			cout << "Invalid texture coordinate: " << string(line, end) << endl;
+
+		this->texCoords.push_back(Point3(coords[0], coords[1], coords[2]));
+	}
+	else if (isKeyword(keyword, keywordEnd, "f")) {
+		// face, through the parser picked for this object,
+		// picking again if the form or corner count changed
+		if (!this->faceParser || !this->faceParser(*this, p, end)) {
+			this->faceParser = selectFaceParser(p, end);
+			if (!this->faceParser(*this, p, end))
+				cout << "Invalid face: " << string(line, end) << endl;
+		}
+	}
+	else {
+		cout << "Invalid syntax or unsupported parameter: " << string(line, end) << endl;
+		//break;
+	}
+}
+
+void Obj::toBuffer() {
+	// Transfers the object to OpenGL's buffer
+
+	glBegin(GL_QUADS);
+	for (int i = 0; i < this->faces.size(); i++) {
+		for (int j = 0; j < 4; j++) {
+			Point3 vertex = this->vertices[this->faces[i].vertexIds[j] - 1];
+			Point3 normal = this->normals[this->faces[i].normalIds[j] - 1];
+			glNormal3f(normal.x, normal.y, normal.z);
+			glVertex3f(vertex.x, vertex.y, vertex.z);
+		}
+	}
+	glEnd();
+	countDrawCalls();
+}
@@ -0,0 +1,65 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "Point3.h"
+
+// A quad, as 1-based indices into the vectors of its Obj.
+// Triangles repeat their last corner and bigger polygons are split into
+// a fan of quads while parsing, so every face can be drawn as a quad.
+// texCoordIds are 0 for faces without texture coordinates.
+class Face {
+public:
+	int vertexIds[4];
+	int normalIds[4];
+	int texCoordIds[4];
+};
+
+class Obj;
+
+// Parses the corners of an "f" line into faces of obj.
+// Returns false, adding nothing, if the line is not in its form.
+typedef bool (*FaceParser)(Obj& obj, const char* corners, const char* end);
+
+class Obj {
+public:
+	std::string name;
+	std::vector<Point3> vertices = std::vector<Point3>();
+	std::vector<Point3> normals = std::vector<Point3>();
+	std::vector<Point3> texCoords = std::vector<Point3>();
+	std::vector<Face> faces = std::vector<Face>();
+
+	// Called by readFile after each chunk of the file is parsed,
+	// on whichever thread is reading
+	std::function<void(Obj&)> onChunkParsed;
+
+	Obj(const char* filename);
+	Obj();
+
+	void readFile(const char* filename);
+	void toBuffer();
+
+	// Maps a normal index as written in the file (negative ones counting
+	// back from the last normal read) to its 1-based position in normals,
+	// which also holds the flat normals generated for faces without any
+	int resolveNormalId(int index) const {
+		int count = (int)this->fileNormalIds.size();
+		if (index < 0)
+			index += count + 1;
+		return index >= 1 && index <= count ? this->fileNormalIds[index - 1] : 0;
+	}
+
+private:
+	// Picked from the first face of each object
+	FaceParser faceParser = nullptr;
+	std::vector<int> fileNormalIds = std::vector<int>();
+
+	const char* parseLines(const char* begin, const char* end);
+	void parseLine(const char* line, const char* end);
+};
@@ -0,0 +1,566 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ObjParsing.h"
+
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define OBJ_PARSING_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC lets any function use AVX2 intrinsics
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+using namespace std;
+
+///////////////////
+// CPU dispatching
+
+SimdLevel detectSimdLevel() {
+#if defined(OBJ_PARSING_X86)
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osxsave && avx) {
+		// The OS must also save the YMM registers on context switches
+		bool ymmEnabled = (_xgetbv(0) & 6) == 6;
+		__cpuidex(info, 7, 0);
+		avx2 = ymmEnabled && (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool sse2 = __builtin_cpu_supports("sse2");
+	bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+	if (avx2)
+		return SimdLevel::AVX2;
+	if (sse2)
+		return SimdLevel::SSE2;
+#endif
+	return SimdLevel::Scalar;
+}
+
+const char* simdLevelName(SimdLevel level) {
+	switch (level) {
+		case SimdLevel::AVX2:
+			return "AVX2";
+		case SimdLevel::SSE2:
+			return "SSE2";
+		default:
+			return "scalar";
+	}
+}
+
+static int countTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+static int countLeadingZeros64(uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return 63 - (int)index;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanReverse(&index, (unsigned long)(value >> 32)))
+		return 31 - (int)index;
+	_BitScanReverse(&index, (unsigned long)value);
+	return 63 - (int)index;
+#else
+	return __builtin_clzll(value);
+#endif
+}
+
+////////////
+// Scanners
+
+static bool isBlank(char c) {
+	return (unsigned char)c <= ' ';
+}
+
+const char* findNewlineScalar(const char* begin, const char* end) {
+	const void* found = memchr(begin, '\n', end - begin);
+	return found ? (const char*)found : end;
+}
+
+const char* findTokenEndScalar(const char* begin, const char* end) {
+	while (begin < end && !isBlank(*begin))
+		begin++;
+	return begin;
+}
+
+#if defined(OBJ_PARSING_X86)
+
+const char* findNewlineSSE2(const char* begin, const char* end) {
+	const __m128i newline = _mm_set1_epi8('\n');
+
+	while (end - begin >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)begin);
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+		if (mask != 0)
+			return begin + countTrailingZeros(mask);
+		begin += 16;
+	}
+
+	return findNewlineScalar(begin, end);
+}
+
+const char* findTokenEndSSE2(const char* begin, const char* end) {
+	const __m128i space = _mm_set1_epi8(' ');
+
+	while (end - begin >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)begin);
+		// c <= ' ' (unsigned) <=> min(c, ' ') == c
+		__m128i blank = _mm_cmpeq_epi8(_mm_min_epu8(chunk, space), chunk);
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(blank);
+		if (mask != 0)
+			return begin + countTrailingZeros(mask);
+		begin += 16;
+	}
+
+	return findTokenEndScalar(begin, end);
+}
+
+TARGET_AVX2 const char* findNewlineAVX2(const char* begin, const char* end) {
+	const __m256i newline = _mm256_set1_epi8('\n');
+
+	while (end - begin >= 32) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i*)begin);
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+		if (mask != 0)
+			return begin + countTrailingZeros(mask);
+		begin += 32;
+	}
+
+	return findNewlineSSE2(begin, end);
+}
+
+TARGET_AVX2 const char* findTokenEndAVX2(const char* begin, const char* end) {
+	const __m256i space = _mm256_set1_epi8(' ');
+
+	while (end - begin >= 32) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i*)begin);
+		__m256i blank = _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, space), chunk);
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(blank);
+		if (mask != 0)
+			return begin + countTrailingZeros(mask);
+		begin += 32;
+	}
+
+	return findTokenEndSSE2(begin, end);
+}
+
+#else
+
+const char* findNewlineSSE2(const char* begin, const char* end) {
+	return findNewlineScalar(begin, end);
+}
+
+const char* findTokenEndSSE2(const char* begin, const char* end) {
+	return findTokenEndScalar(begin, end);
+}
+
+const char* findNewlineAVX2(const char* begin, const char* end) {
+	return findNewlineScalar(begin, end);
+}
+
+const char* findTokenEndAVX2(const char* begin, const char* end) {
+	return findTokenEndScalar(begin, end);
+}
+
+#endif
+
+typedef const char* (*ScanFunction)(const char*, const char*);
+
+static ScanFunction pickScanner(ScanFunction scalar, ScanFunction sse2, ScanFunction avx2) {
+	switch (detectSimdLevel()) {
+		case SimdLevel::AVX2:
+			return avx2;
+		case SimdLevel::SSE2:
+			return sse2;
+		default:
+			return scalar;
+	}
+}
+
+static const ScanFunction newlineScanner = pickScanner(findNewlineScalar, findNewlineSSE2, findNewlineAVX2);
+static const ScanFunction tokenEndScanner = pickScanner(findTokenEndScalar, findTokenEndSSE2, findTokenEndAVX2);
+
+const char* findNewline(const char* begin, const char* end) {
+	return newlineScanner(begin, end);
+}
+
+const char* findTokenEnd(const char* begin, const char* end) {
+	return tokenEndScanner(begin, end);
+}
+
+//////////////////
+// Number parsing
+
+static bool isDigit(char c) {
+	return (unsigned char)(c - '0') <= 9;
+}
+
+static bool isAlpha(char c) {
+	return (unsigned char)((c | 0x20) - 'a') < 26;
+}
+
+// 5^q normalized to 128 bits, truncated, for every q a float can need
+#define SMALLEST_POWER_OF_TEN -65
+#define LARGEST_POWER_OF_TEN 38
+
+static const uint64_t powersOfFive[LARGEST_POWER_OF_TEN - SMALLEST_POWER_OF_TEN + 1][2] = {
+	{ 0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL }, // 5^-65
+	{ 0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL }, // 5^-64
+	{ 0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL }, // 5^-63
+	{ 0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL }, // 5^-62
+	{ 0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL }, // 5^-61
+	{ 0xcdb02555653131b6ULL, 0x3792f412cb06794dULL }, // 5^-60
+	{ 0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL }, // 5^-59
+	{ 0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL }, // 5^-58
+	{ 0xc8de047564d20a8bULL, 0xf245825a5a445275ULL }, // 5^-57
+	{ 0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL }, // 5^-56
+	{ 0x9ced737bb6c4183dULL, 0x55464dd69685606bULL }, // 5^-55
+	{ 0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL }, // 5^-54
+	{ 0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL }, // 5^-53
+	{ 0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL }, // 5^-52
+	{ 0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL }, // 5^-51
+	{ 0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL }, // 5^-50
+	{ 0x95a8637627989aadULL, 0xdde7001379a44aa8ULL }, // 5^-49
+	{ 0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL }, // 5^-48
+	{ 0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL }, // 5^-47
+	{ 0x9226712162ab070dULL, 0xcab3961304ca70e8ULL }, // 5^-46
+	{ 0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL }, // 5^-45
+	{ 0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL }, // 5^-44
+	{ 0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL }, // 5^-43
+	{ 0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL }, // 5^-42
+	{ 0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL }, // 5^-41
+	{ 0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL }, // 5^-40
+	{ 0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL }, // 5^-39
+	{ 0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL }, // 5^-38
+	{ 0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL }, // 5^-37
+	{ 0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL }, // 5^-36
+	{ 0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL }, // 5^-35
+	{ 0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL }, // 5^-34
+	{ 0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL }, // 5^-33
+	{ 0xcfb11ead453994baULL, 0x67de18eda5814af2ULL }, // 5^-32
+	{ 0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL }, // 5^-31
+	{ 0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL }, // 5^-30
+	{ 0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL }, // 5^-29
+	{ 0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL }, // 5^-28
+	{ 0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL }, // 5^-27
+	{ 0xc612062576589ddaULL, 0x95364afe032a819eULL }, // 5^-26
+	{ 0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL }, // 5^-25
+	{ 0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL }, // 5^-24
+	{ 0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL }, // 5^-23
+	{ 0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL }, // 5^-22
+	{ 0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL }, // 5^-21
+	{ 0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL }, // 5^-20
+	{ 0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL }, // 5^-19
+	{ 0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL }, // 5^-18
+	{ 0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL }, // 5^-17
+	{ 0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL }, // 5^-16
+	{ 0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL }, // 5^-15
+	{ 0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL }, // 5^-14
+	{ 0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL }, // 5^-13
+	{ 0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL }, // 5^-12
+	{ 0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL }, // 5^-11
+	{ 0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL }, // 5^-10
+	{ 0x89705f4136b4a597ULL, 0x31680a88f8953031ULL }, // 5^-9
+	{ 0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL }, // 5^-8
+	{ 0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL }, // 5^-7
+	{ 0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL }, // 5^-6
+	{ 0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL }, // 5^-5
+	{ 0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL }, // 5^-4
+	{ 0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL }, // 5^-3
+	{ 0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL }, // 5^-2
+	{ 0xccccccccccccccccULL, 0xcccccccccccccccdULL }, // 5^-1
+	{ 0x8000000000000000ULL, 0x0000000000000000ULL }, // 5^0
+	{ 0xa000000000000000ULL, 0x0000000000000000ULL }, // 5^1
+	{ 0xc800000000000000ULL, 0x0000000000000000ULL }, // 5^2
+	{ 0xfa00000000000000ULL, 0x0000000000000000ULL }, // 5^3
+	{ 0x9c40000000000000ULL, 0x0000000000000000ULL }, // 5^4
+	{ 0xc350000000000000ULL, 0x0000000000000000ULL }, // 5^5
+	{ 0xf424000000000000ULL, 0x0000000000000000ULL }, // 5^6
+	{ 0x9896800000000000ULL, 0x0000000000000000ULL }, // 5^7
+	{ 0xbebc200000000000ULL, 0x0000000000000000ULL }, // 5^8
+	{ 0xee6b280000000000ULL, 0x0000000000000000ULL }, // 5^9
+	{ 0x9502f90000000000ULL, 0x0000000000000000ULL }, // 5^10
+	{ 0xba43b74000000000ULL, 0x0000000000000000ULL }, // 5^11
+	{ 0xe8d4a51000000000ULL, 0x0000000000000000ULL }, // 5^12
+	{ 0x9184e72a00000000ULL, 0x0000000000000000ULL }, // 5^13
+	{ 0xb5e620f480000000ULL, 0x0000000000000000ULL }, // 5^14
+	{ 0xe35fa931a0000000ULL, 0x0000000000000000ULL }, // 5^15
+	{ 0x8e1bc9bf04000000ULL, 0x0000000000000000ULL }, // 5^16
+	{ 0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL }, // 5^17
+	{ 0xde0b6b3a76400000ULL, 0x0000000000000000ULL }, // 5^18
+	{ 0x8ac7230489e80000ULL, 0x0000000000000000ULL }, // 5^19
+	{ 0xad78ebc5ac620000ULL, 0x0000000000000000ULL }, // 5^20
+	{ 0xd8d726b7177a8000ULL, 0x0000000000000000ULL }, // 5^21
+	{ 0x878678326eac9000ULL, 0x0000000000000000ULL }, // 5^22
+	{ 0xa968163f0a57b400ULL, 0x0000000000000000ULL }, // 5^23
+	{ 0xd3c21bcecceda100ULL, 0x0000000000000000ULL }, // 5^24
+	{ 0x84595161401484a0ULL, 0x0000000000000000ULL }, // 5^25
+	{ 0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL }, // 5^26
+	{ 0xcecb8f27f4200f3aULL, 0x0000000000000000ULL }, // 5^27
+	{ 0x813f3978f8940984ULL, 0x4000000000000000ULL }, // 5^28
+	{ 0xa18f07d736b90be5ULL, 0x5000000000000000ULL }, // 5^29
+	{ 0xc9f2c9cd04674edeULL, 0xa400000000000000ULL }, // 5^30
+	{ 0xfc6f7c4045812296ULL, 0x4d00000000000000ULL }, // 5^31
+	{ 0x9dc5ada82b70b59dULL, 0xf020000000000000ULL }, // 5^32
+	{ 0xc5371912364ce305ULL, 0x6c28000000000000ULL }, // 5^33
+	{ 0xf684df56c3e01bc6ULL, 0xc732000000000000ULL }, // 5^34
+	{ 0x9a130b963a6c115cULL, 0x3c7f400000000000ULL }, // 5^35
+	{ 0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL }, // 5^36
+	{ 0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL }, // 5^37
+	{ 0x96769950b50d88f4ULL, 0x1314448000000000ULL }, // 5^38
+};
+
+static const float exactPowersOfTen[] = {
+	1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+static void multiply128(uint64_t a, uint64_t b, uint64_t* high, uint64_t* low) {
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 product = (unsigned __int128)a * b;
+	*high = (uint64_t)(product >> 64);
+	*low = (uint64_t)product;
+#elif defined(_MSC_VER) && defined(_M_X64)
+	*low = _umul128(a, b, high);
+#else
+	uint64_t aLow = (uint32_t)a, aHigh = a >> 32;
+	uint64_t bLow = (uint32_t)b, bHigh = b >> 32;
+	uint64_t lowLow = aLow * bLow;
+	uint64_t highLow = aHigh * bLow;
+	uint64_t lowHigh = aLow * bHigh;
+	uint64_t highHigh = aHigh * bHigh;
+	uint64_t middle = (lowLow >> 32) + (uint32_t)highLow + (uint32_t)lowHigh;
+	*low = (middle << 32) | (uint32_t)lowLow;
+	*high = highHigh + (highLow >> 32) + (lowHigh >> 32) + (middle >> 32);
+#endif
+}
+
+// Computes the float nearest to w * 10^q.
+// Returns false when the result is not a normal float, leaving those
+// cases to strtof.
+static bool computeFloat(uint64_t w, int64_t q, float* result) {
+	if (w == 0) {
+		*result = 0;
+		return true;
+	}
+
+	// Clinger's fast path: both operands are exact floats, so the
+	// single rounding of the division/multiplication is the right one
+	if (w <= (1 << 24) && q >= -10 && q <= 10) {
+		float value = (float)w;
+		*result = q < 0 ? value / exactPowersOfTen[-q] : value * exactPowersOfTen[q];
+		return true;
+	}
+
+	if (q < SMALLEST_POWER_OF_TEN || q > LARGEST_POWER_OF_TEN)
+		return false;
+
+	// Eisel-Lemire: multiply the normalized mantissa by a truncated 5^q
+	// and keep enough bits to round to 24 bits of mantissa
+	int leadingZeros = countLeadingZeros64(w);
+	w <<= leadingZeros;
+
+	const uint64_t* power = powersOfFive[q - SMALLEST_POWER_OF_TEN];
+	uint64_t high, low;
+	multiply128(w, power[0], &high, &low);
+
+	const uint64_t precisionMask = 0xFFFFFFFFFFFFFFFFULL >> 26;
+	if ((high & precisionMask) == precisionMask) {
+		// The truncated product may be off by one in the bits we keep,
+		// so refine it with the lower half of 5^q
+		uint64_t secondHigh, secondLow;
+		multiply128(w, power[1], &secondHigh, &secondLow);
+		low += secondHigh;
+		if (secondHigh > low)
+			high++;
+	}
+
+	int upperBit = (int)(high >> 63);
+	int shift = upperBit + 64 - 23 - 3;
+	uint64_t mantissa = high >> shift;
+	int power2 = (int)((((152170 + 65536) * q) >> 16) + 63) + upperBit - leadingZeros + 127;
+
+	if (power2 <= 0)
+		return false; // subnormal
+
+	// Exactly halfway between two floats: round to even.
+	// Only possible when 5^q fits in 64 bits.
+	if (low <= 1 && q >= -17 && q <= 10 && (mantissa & 3) == 1) {
+		if ((mantissa << shift) == high)
+			mantissa &= ~(uint64_t)1;
+	}
+
+	mantissa += mantissa & 1;
+	mantissa >>= 1;
+	if (mantissa >= ((uint64_t)2 << 23)) {
+		mantissa = (uint64_t)1 << 23;
+		power2++;
+	}
+	mantissa &= ~((uint64_t)1 << 23);
+
+	if (power2 >= 0xFF)
+		return false; // infinity
+
+	uint32_t bits = (uint32_t)mantissa | ((uint32_t)power2 << 23);
+	memcpy(result, &bits, sizeof(bits));
+	return true;
+}
+
+static const char* parseFloatFallback(const char* begin, const char* end, float* value) {
+	char buffer[128];
+	size_t length = end - begin < (ptrdiff_t)sizeof(buffer) - 1 ? end - begin : sizeof(buffer) - 1;
+	memcpy(buffer, begin, length);
+	buffer[length] = '\0';
+
+	char* parsedEnd;
+	*value = strtof(buffer, &parsedEnd);
+	if (parsedEnd == buffer)
+		return nullptr;
+	return begin + (parsedEnd - buffer);
+}
+
+const char* parseFloat(const char* begin, const char* end, float* value) {
+	const char* p = begin;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+
+	uint64_t mantissa = 0;
+	int64_t exponent = 0;
+	int significantDigits = 0;
+	bool anyDigits = false;
+
+	while (p < end && isDigit(*p)) {
+		anyDigits = true;
+		if (mantissa != 0 || *p != '0') {
+			if (significantDigits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+			}
+			else {
+				exponent++;
+				if (*p != '0')
+					significantDigits = 20; // lost precision, let strtof decide
+			}
+			if (significantDigits < 19)
+				significantDigits++;
+		}
+		p++;
+	}
+
+	if (p < end && *p == '.') {
+		p++;
+		while (p < end && isDigit(*p)) {
+			anyDigits = true;
+			if (mantissa != 0 || *p != '0') {
+				if (significantDigits < 19) {
+					mantissa = mantissa * 10 + (*p - '0');
+					exponent--;
+					significantDigits++;
+				}
+				else if (*p != '0') {
+					significantDigits = 20;
+				}
+			}
+			else {
+				exponent--;
+			}
+			p++;
+		}
+	}
+
+	if (!anyDigits)
+		return parseFloatFallback(begin, end, value); // inf, nan or garbage
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char* e = p + 1;
+		bool negativeExponent = false;
+		if (e < end && (*e == '-' || *e == '+')) {
+			negativeExponent = *e == '-';
+			e++;
+		}
+		if (e < end && isDigit(*e)) {
+			int64_t explicitExponent = 0;
+			while (e < end && isDigit(*e)) {
+				if (explicitExponent < 100000)
+					explicitExponent = explicitExponent * 10 + (*e - '0');
+				e++;
+			}
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+			p = e;
+		}
+	}
+
+	// Hex floats and the like: not OBJ, but strtof knows them
+	if (p < end && isAlpha(*p))
+		return parseFloatFallback(begin, end, value);
+
+	float result;
+	if (significantDigits > 19 || !computeFloat(mantissa, exponent, &result))
+		return parseFloatFallback(begin, end, value);
+
+	*value = negative ? -result : result;
+	return p;
+}
+
+const char* parseInt(const char* begin, const char* end, int* value) {
+	const char* p = begin;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+
+	if (p >= end || !isDigit(*p))
+		return nullptr;
+
+	// Stops at the first digit taking it out of int's range
+	const uint64_t limit = negative ? (uint64_t)INT_MAX + 1 : (uint64_t)INT_MAX;
+	uint64_t result = 0;
+	while (p < end && isDigit(*p)) {
+		result = result * 10 + (*p - '0');
+		if (result > limit)
+			return nullptr;
+		p++;
+	}
+
+	*value = negative ? (int)-(int64_t)result : (int)result;
+	return p;
+}
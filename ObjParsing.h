@@ -0,0 +1,57 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// Low level text kernels used by the OBJ loader.
+// Every function works on a [begin, end) range that does not need
+// to be null terminated, so the loader can hand out slices of its
+// read buffer without copying lines around.
+
+#pragma once
+
+#include <cstddef>
+
+// Instruction sets the scanners can be dispatched to, picked once at runtime.
+enum class SimdLevel {
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+SimdLevel detectSimdLevel();
+const char* simdLevelName(SimdLevel level);
+
+// Returns a pointer to the first '\n' in [begin, end), or end if there is none.
+const char* findNewline(const char* begin, const char* end);
+
+// Returns a pointer to the first blank (space, tab, '\r', '\n' or any
+// other control character) in [begin, end), or end if there is none.
+const char* findTokenEnd(const char* begin, const char* end);
+
+// Skips spaces and tabs, stopping at end of line.
+inline const char* skipBlanks(const char* begin, const char* end) {
+	while (begin < end && (*begin == ' ' || *begin == '\t'))
+		begin++;
+	return begin;
+}
+
+// Parses a decimal float such as "-2.595336" or "1e-3".
+// The result is bit-identical to strtof; uncommon inputs (more than 19
+// significant digits, subnormals, inf/nan) fall back to strtof itself.
+// Returns a pointer past the number, or nullptr if none could be read.
+const char* parseFloat(const char* begin, const char* end, float* value);
+
+// Parses an optionally signed decimal integer.
+// Returns a pointer past the number, or nullptr if none could be read
+// or it does not fit in an int.
+const char* parseInt(const char* begin, const char* end, int* value);
+
+// Scalar/SSE2/AVX2 variants, exposed so they can be measured side by side.
+// The AVX2 variant must only be called when detectSimdLevel() reports it.
+const char* findNewlineScalar(const char* begin, const char* end);
+const char* findNewlineSSE2(const char* begin, const char* end);
+const char* findNewlineAVX2(const char* begin, const char* end);
+const char* findTokenEndScalar(const char* begin, const char* end);
+const char* findTokenEndSSE2(const char* begin, const char* end);
+const char* findTokenEndAVX2(const char* begin, const char* end);
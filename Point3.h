@@ -0,0 +1,67 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cmath>
+
+class Point3 {
+public:
+	float x = 0, y = 0, z = 0;
+
+	Point3(float x, float y, float z) {
+		this->x = x;
+		this->y = y;
+		this->z = z;
+	}
+	Point3() {
+	}
+};
+
+//////////////////
+// Vector algebra
+
+inline Point3 operator+(const Point3& a, const Point3& b) {
+	return Point3(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+
+inline Point3 operator-(const Point3& a, const Point3& b) {
+	return Point3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+inline Point3 operator-(const Point3& a) {
+	return Point3(-a.x, -a.y, -a.z);
+}
+
+inline Point3 operator*(const Point3& a, float s) {
+	return Point3(a.x * s, a.y * s, a.z * s);
+}
+
+inline Point3 operator*(float s, const Point3& a) {
+	return a * s;
+}
+
+// Component-wise, as for colors
+inline Point3 operator*(const Point3& a, const Point3& b) {
+	return Point3(a.x * b.x, a.y * b.y, a.z * b.z);
+}
+
+inline float dot(const Point3& a, const Point3& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Point3 cross(const Point3& a, const Point3& b) {
+	return Point3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+inline float length(const Point3& a) {
+	return sqrtf(dot(a, a));
+}
+
+// Zero vectors stay zero
+inline Point3 normalize(const Point3& a) {
+	float l = length(a);
+	return l > 0 ? a * (1 / l) : a;
+}
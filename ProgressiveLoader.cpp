@@ -0,0 +1,126 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "ProgressiveLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include "Metrics.h"
+#include "SamplingProfiler.h"
+
+using namespace std;
+
+ProgressiveLoader::ProgressiveLoader(const char* filename) {
+	string path = filename;
+
+	this->object.onChunkParsed = [this](Obj& obj) {
+		publishFaces(obj);
+	};
+
+	this->worker = thread([this, path]() {
+		setProfilerThreadName("loader");
+		auto start = chrono::steady_clock::now();
+		this->object.readFile(path.c_str());
+		this->object.onChunkParsed = nullptr;
+		this->parsed.store(true, memory_order_release);
+
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		getMetrics().gauge("mezzanine_load_seconds", "Time taken to parse each model", metricLabel("file", path)).set(seconds);
+		getMetrics().counter("mezzanine_loaded_faces_total", "Faces parsed from the models").add(this->object.faces.size());
+	});
+}
+
+ProgressiveLoader::~ProgressiveLoader() {
+	// Unblock the parser if it is waiting on a full queue
+	Batch batch;
+	while (this->worker.joinable() && !this->parsed.load(memory_order_acquire)) {
+		this->batches.tryPop(batch);
+		this_thread::yield();
+	}
+
+	if (this->worker.joinable())
+		this->worker.join();
+}
+
+void ProgressiveLoader::publishFaces(Obj& obj) {
+	// Parser thread: flattens faces parsed since the last call.
+	// Indices are resolved here, so the render thread never touches
+	// the vectors that are still growing.
+
+	while (this->publishedFaces < obj.faces.size()) {
+		size_t first = this->publishedFaces;
+		size_t count = min(obj.faces.size() - first, (size_t)PROGRESSIVE_BATCH_FACES);
+
+		Batch batch;
+		batch.positions.reserve(count * 4);
+		batch.normals.reserve(count * 4);
+
+		for (size_t i = first; i < first + count; i++) {
+			const Face& face = obj.faces[i];
+			for (int j = 0; j < 4; j++) {
+				size_t vertexId = (size_t)(face.vertexIds[j] - 1);
+				size_t normalId = (size_t)(face.normalIds[j] - 1);
+				Point3 vertex = vertexId < obj.vertices.size() ? obj.vertices[vertexId] : Point3();
+				Point3 normal = normalId < obj.normals.size() ? obj.normals[normalId] : Point3();
+
+				batch.positions.push_back(vertex);
+				batch.normals.push_back(normal);
+			}
+		}
+		batch.bounds = computeBounds(batch.positions);
+
+		while (!this->batches.tryPush(move(batch)))
+			this_thread::yield();
+
+		this->publishedFaces += count;
+	}
+}
+
+bool ProgressiveLoader::uploadPending() {
+	// Read before draining, so a batch pushed right before the
+	// parser finishes is never left behind
+	bool done = this->parsed.load(memory_order_acquire);
+
+	Batch batch;
+	while (this->batches.tryPop(batch)) {
+		this->receivedBatches++;
+		upload(batch);
+	}
+
+	return !done;
+}
+
+bool ProgressiveLoader::receivePending(vector<Batch>& pending) {
+	bool done = this->parsed.load(memory_order_acquire);
+
+	Batch batch;
+	while (this->batches.tryPop(batch)) {
+		this->receivedBatches++;
+		pending.push_back(move(batch));
+	}
+
+	return !done;
+}
+
+void ProgressiveLoader::upload(const Batch& batch) {
+	this->mesh.append(batch.positions, batch.normals);
+	this->uploadedBatches++;
+}
+
+void ProgressiveLoader::draw(const Frustum* frustum, const VisibleTiles* visible, IncrementalCulling* incremental) const {
+	this->mesh.draw(frustum, visible, incremental);
+}
+
+bool ProgressiveLoader::isFinished() const {
+	return this->parsed.load(memory_order_acquire) && this->batches.empty()
+		&& this->uploadedBatches == this->receivedBatches;
+}
+
+Obj& ProgressiveLoader::getObject() {
+	if (this->worker.joinable())
+		this->worker.join();
+	return this->object;
+}
@@ -0,0 +1,63 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "Obj.h"
+#include "GpuMesh.h"
+#include "GeometryStreams.h"
+#include "SpscQueue.h"
+
+// Faces per published batch, so big chunks still show up gradually
+#define PROGRESSIVE_BATCH_FACES 4096
+
+// Parses an OBJ file on a background thread while the renderer shows
+// what has been parsed so far. The parser flattens each run of new faces
+// into position/normal streams and hands them over through a lock-free
+// queue; the render thread interleaves and appends them to a GpuMesh.
+class ProgressiveLoader {
+public:
+	struct Batch {
+		PositionStreams positions, normals;
+		Bounds bounds;
+	};
+
+	ProgressiveLoader(const char* filename);
+	~ProgressiveLoader();
+	ProgressiveLoader(const ProgressiveLoader&) = delete;
+	ProgressiveLoader& operator=(const ProgressiveLoader&) = delete;
+
+	// Render thread: uploads every batch published so far.
+	// Returns true while there is still more to come.
+	bool uploadPending();
+	// Render thread: takes the batches published so far, for the caller
+	// to upload() in whatever order suits it. Returns true while there
+	// is still more to come.
+	bool receivePending(std::vector<Batch>& pending);
+	void upload(const Batch& batch);
+	// Culled against frustum and visible unless they are null, see GpuMesh::draw
+	void draw(const Frustum* frustum = nullptr, const VisibleTiles* visible = nullptr, IncrementalCulling* incremental = nullptr) const;
+
+	// True once the whole file is parsed and every batch received is uploaded
+	bool isFinished() const;
+
+	// The parsed object. Only valid once isFinished() is true.
+	Obj& getObject();
+
+private:
+	void publishFaces(Obj& obj);
+
+	Obj object;
+	std::thread worker;
+	std::atomic<bool> parsed{ false };
+	size_t publishedFaces = 0;
+	size_t receivedBatches = 0, uploadedBatches = 0;
+
+	SpscQueue<Batch, 64> batches;
+	GpuMesh mesh;
+};
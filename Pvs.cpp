@@ -0,0 +1,449 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Pvs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "JobSystem.h"
+#include "Metrics.h"
+
+using namespace std;
+
+// Hits mark the tiles this far either side of the surface, so surfaces
+// lying on a tile boundary count for both tiles
+#define PVS_HIT_MARGIN 0.01f
+// Fraction of a cell its border eyes are moved inside it
+#define PVS_EYE_INSET 0.01f
+static_assert(PVS_CELL_SAMPLES >= 2, "Eyes span each cell from border to border");
+
+#define PI 3.14159265f
+
+/////////////////
+// VisibleTiles
+bool VisibleTiles::intersectsBox(const Point3& min, const Point3& max) const {
+	float low[3] = { min.x - this->origin.x, min.y - this->origin.y, min.z - this->origin.z };
+	float high[3] = { max.x - this->origin.x, max.y - this->origin.y, max.z - this->origin.z };
+	int first[3], last[3];
+	for (int k = 0; k < 3; k++) {
+		first[k] = (int)floorf(low[k] / PVS_TILE_SIZE);
+		last[k] = (int)floorf(high[k] / PVS_TILE_SIZE);
+		if (first[k] < 0 || last[k] >= this->tiles[k])
+			return true;
+	}
+
+	for (int z = first[2]; z <= last[2]; z++) {
+		for (int y = first[1]; y <= last[1]; y++) {
+			for (int x = first[0]; x <= last[0]; x++) {
+				size_t tile = ((size_t)z * this->tiles[1] + y) * this->tiles[0] + x;
+				if (this->bits[tile / 64] & (1ull << (tile % 64)))
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+size_t VisibleTiles::getVisibleCount() const {
+	size_t count = 0;
+	for (uint64_t word : this->bits) {
+		for (; word != 0; word &= word - 1)
+			count++;
+	}
+	return count;
+}
+
+size_t VisibleTiles::getTileCount() const {
+	return (size_t)this->tiles[0] * this->tiles[1] * this->tiles[2];
+}
+
+int VisibleTiles::getSet() const {
+	return this->set;
+}
+
+// Alternating runs of clear and set bits, starting with clear ones,
+// each length as a little endian base 128 varint
+static vector<uint8_t> encodeRuns(const vector<uint64_t>& bits, size_t count) {
+	vector<uint8_t> runs;
+	bool value = false;
+	size_t i = 0;
+	while (i < count) {
+		size_t length = 0;
+		while (i < count && (((bits[i / 64] >> (i % 64)) & 1) != 0) == value) {
+			length++;
+			i++;
+		}
+		for (; length >= 0x80; length >>= 7)
+			runs.push_back((uint8_t)(length | 0x80));
+		runs.push_back((uint8_t)length);
+		value = !value;
+	}
+	return runs;
+}
+
+static void decodeRuns(const vector<uint8_t>& runs, vector<uint64_t>& bits, size_t count) {
+	bits.assign((count + 63) / 64, 0);
+	bool value = false;
+	size_t i = 0, byte = 0;
+	while (byte < runs.size() && i < count) {
+		size_t length = 0;
+		for (int shift = 0; byte < runs.size() && shift < 64; shift += 7) {
+			uint8_t part = runs[byte++];
+			length |= (size_t)(part & 0x7F) << shift;
+			if (!(part & 0x80))
+				break;
+		}
+
+		size_t end = min(i + length, count);
+		if (value) {
+			for (; i < end; i++)
+				bits[i / 64] |= 1ull << (i % 64);
+		}
+		i = end;
+		value = !value;
+	}
+}
+
+//////////////////////////
+// PotentiallyVisibleSet
+void PotentiallyVisibleSet::bake(const Bvh& scene, const vector<FloorPlan>& floors, float eyeHeight) {
+	auto start = chrono::steady_clock::now();
+
+	Bounds bounds = scene.getBounds();
+	Point3 margin(PVS_TILE_SIZE, PVS_TILE_SIZE, PVS_TILE_SIZE);
+	this->layout.origin = bounds.min - margin;
+	Point3 size = bounds.getSize() + margin * 2;
+	this->layout.tiles[0] = max(1, (int)ceilf(size.x / PVS_TILE_SIZE));
+	this->layout.tiles[1] = max(1, (int)ceilf(size.y / PVS_TILE_SIZE));
+	this->layout.tiles[2] = max(1, (int)ceilf(size.z / PVS_TILE_SIZE));
+	size_t tileCount = this->layout.getTileCount();
+
+	// Eye positions of each cell, those off the floor dropped. The grid
+	// spans the cell's borders and corners, where the camera can stand
+	// as well as at its center, just inside them so no eye lies on a wall.
+	struct Cell {
+		size_t floor, index;
+		vector<Point3> eyes;
+	};
+	vector<Cell> cells;
+	this->floors.clear();
+	for (size_t f = 0; f < floors.size(); f++) {
+		const FloorPlan& plan = floors[f];
+		Bounds extent;
+		for (const Bounds& area : plan.areas)
+			extent.extend(area);
+
+		Floor floor;
+		floor.height = plan.height;
+		floor.eyeHeight = eyeHeight;
+		floor.minX = extent.min.x;
+		floor.minZ = extent.min.z;
+		floor.width = max(1, (int)ceilf((extent.max.x - extent.min.x) / PVS_CELL_SIZE));
+		floor.depth = max(1, (int)ceilf((extent.max.z - extent.min.z) / PVS_CELL_SIZE));
+		floor.cells.assign((size_t)floor.width * floor.depth, -1);
+
+		for (int z = 0; z < floor.depth; z++) {
+			for (int x = 0; x < floor.width; x++) {
+				Cell cell = { f, (size_t)z * floor.width + x, {} };
+				for (int i = 0; i < PVS_CELL_SAMPLES * PVS_CELL_SAMPLES; i++) {
+					float u = PVS_EYE_INSET + (1 - 2 * PVS_EYE_INSET) * (i % PVS_CELL_SAMPLES) / (PVS_CELL_SAMPLES - 1);
+					float v = PVS_EYE_INSET + (1 - 2 * PVS_EYE_INSET) * (i / PVS_CELL_SAMPLES) / (PVS_CELL_SAMPLES - 1);
+					float ex = floor.minX + (x + u) * PVS_CELL_SIZE;
+					float ez = floor.minZ + (z + v) * PVS_CELL_SIZE;
+					if (!plan.contains(ex, ez))
+						continue;
+					// Over the heights find() accepts
+					for (float dy : { -PVS_EYE_TOLERANCE, 0.0f, PVS_EYE_TOLERANCE })
+						cell.eyes.push_back(Point3(ex, plan.height + eyeHeight + dy, ez));
+				}
+				if (!cell.eyes.empty())
+					cells.push_back(move(cell));
+			}
+		}
+		this->floors.push_back(move(floor));
+	}
+
+	// Directions spread evenly over the sphere
+	vector<Point3> directions(PVS_RAYS_PER_SAMPLE);
+	for (int i = 0; i < PVS_RAYS_PER_SAMPLE; i++) {
+		float y = 1 - (2 * i + 1) / (float)PVS_RAYS_PER_SAMPLE;
+		float r = sqrtf(max(0.0f, 1 - y * y));
+		float phi = i * 2.39996323f; // Golden angle
+		directions[i] = Point3(r * cosf(phi), y, r * sinf(phi));
+	}
+
+	// Each ray stands for the directions closer to it than to any other,
+	// so what it hits is spread over that cone's width at the hit,
+	// covering surfaces that fell between two rays
+	float coneAngle = PVS_CONE_SCALE * sqrtf(4 * PI / PVS_RAYS_PER_SAMPLE);
+
+	// Tiles seen from each cell's own eyes
+	size_t words = (tileCount + 63) / 64;
+	vector<vector<uint64_t>> hits(cells.size());
+	getJobSystem().parallelFor(cells.size(), 1, [&](size_t begin, size_t end, unsigned thread) {
+		const int* tiles = this->layout.tiles;
+		for (size_t c = begin; c < end; c++) {
+			vector<uint64_t>& bits = hits[c];
+			bits.assign(words, 0);
+			auto mark = [&](const Point3& point, float radius) {
+				Point3 low = point - this->layout.origin - Point3(radius, radius, radius);
+				Point3 high = point - this->layout.origin + Point3(radius, radius, radius);
+				int first[3] = { (int)floorf(low.x / PVS_TILE_SIZE), (int)floorf(low.y / PVS_TILE_SIZE), (int)floorf(low.z / PVS_TILE_SIZE) };
+				int last[3] = { (int)floorf(high.x / PVS_TILE_SIZE), (int)floorf(high.y / PVS_TILE_SIZE), (int)floorf(high.z / PVS_TILE_SIZE) };
+				for (int k = 0; k < 3; k++) {
+					first[k] = max(first[k], 0);
+					last[k] = min(last[k], tiles[k] - 1);
+				}
+				for (int z = first[2]; z <= last[2]; z++) {
+					for (int y = first[1]; y <= last[1]; y++) {
+						for (int x = first[0]; x <= last[0]; x++) {
+							size_t tile = ((size_t)z * tiles[1] + y) * tiles[0] + x;
+							bits[tile / 64] |= 1ull << (tile % 64);
+						}
+					}
+				}
+			};
+
+			for (const Point3& eye : cells[c].eyes) {
+				for (const Point3& direction : directions) {
+					RayHit hit;
+					if (scene.intersect(eye, direction, INFINITY, hit))
+						mark(eye + direction * hit.distance, PVS_HIT_MARGIN + hit.distance * coneAngle);
+				}
+			}
+		}
+	});
+
+	for (size_t c = 0; c < cells.size(); c++)
+		this->floors[cells[c].floor].cells[cells[c].index] = (int32_t)c;
+
+	// Each set also takes in what the neighbouring cells saw, covering
+	// what lies between two cells' eyes
+	this->sets.assign(cells.size(), vector<uint8_t>());
+	getJobSystem().parallelFor(cells.size(), 1, [&](size_t begin, size_t end, unsigned thread) {
+		vector<uint64_t> seen;
+		for (size_t c = begin; c < end; c++) {
+			const Floor& floor = this->floors[cells[c].floor];
+			int cx = (int)(cells[c].index % floor.width), cz = (int)(cells[c].index / floor.width);
+			seen.assign(words, 0);
+			for (int z = max(0, cz - PVS_NEIGHBOUR_CELLS); z <= min(floor.depth - 1, cz + PVS_NEIGHBOUR_CELLS); z++) {
+				for (int x = max(0, cx - PVS_NEIGHBOUR_CELLS); x <= min(floor.width - 1, cx + PVS_NEIGHBOUR_CELLS); x++) {
+					int32_t neighbour = floor.cells[(size_t)z * floor.width + x];
+					if (neighbour < 0)
+						continue;
+					for (size_t w = 0; w < words; w++)
+						seen[w] |= hits[neighbour][w];
+				}
+			}
+			this->sets[c] = encodeRuns(seen, tileCount);
+		}
+	});
+
+	this->current.set = -1;
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "Visibility sets: " << cells.size() << " cells over " << tileCount << " tiles, " << getCompressedBytes() / 1e3
+		<< " kB (" << getUncompressedBytes() / 1e3 << " kB as bitsets), baked in " << seconds << " s" << endl;
+}
+
+uint64_t PotentiallyVisibleSet::fingerprint(const Bvh& scene, const vector<FloorPlan>& floors, float eyeHeight) {
+	// FNV-1a over the triangles and the floors
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&](const void* data, size_t size) {
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+	};
+
+	for (size_t i = 0; i < scene.getTriangleCount(); i++) {
+		Point3 corners[3];
+		scene.getTriangle(i, corners[0], corners[1], corners[2]);
+		add(corners, sizeof(corners));
+	}
+	for (const FloorPlan& floor : floors) {
+		add(&floor.height, sizeof(floor.height));
+		for (const Bounds& area : floor.areas)
+			add(&area, sizeof(area));
+	}
+	add(&eyeHeight, sizeof(eyeHeight));
+	return hash;
+}
+
+void PotentiallyVisibleSet::loadOrBake(const Bvh& scene, const vector<FloorPlan>& floors, float eyeHeight, const string& cacheFile) {
+	static Counter& hits = getMetrics().counter("mezzanine_cache_requests_total", "Baked data looked up in its cache file",
+		metricLabel("cache", "pvs") + "," + metricLabel("result", "hit"));
+	static Counter& misses = getMetrics().counter("mezzanine_cache_requests_total", "Baked data looked up in its cache file",
+		metricLabel("cache", "pvs") + "," + metricLabel("result", "miss"));
+
+	uint64_t hash = fingerprint(scene, floors, eyeHeight);
+	if (load(cacheFile, hash)) {
+		hits.add();
+		return;
+	}
+	misses.add();
+
+	bake(scene, floors, eyeHeight);
+	save(cacheFile, hash);
+}
+
+bool PotentiallyVisibleSet::load(const string& cacheFile, uint64_t fingerprint) {
+	ifstream file(cacheFile, ifstream::in | ifstream::binary);
+	if (!file.is_open())
+		return false;
+
+	auto read = [&](void* data, size_t size) {
+		return (bool)file.read((char*)data, size);
+	};
+
+	char magic[4];
+	uint32_t version, floorCount, setCount;
+	uint64_t hash;
+	VisibleTiles layout;
+	if (!read(magic, 4) || memcmp(magic, "MZPV", 4) != 0 || !read(&version, 4) || version != PVS_CACHE_VERSION
+		|| !read(&hash, 8) || hash != fingerprint || !read(&layout.origin, sizeof(Point3)) || !read(layout.tiles, sizeof(layout.tiles))
+		|| !read(&floorCount, 4))
+		return false;
+
+	// Sizes are checked before anything is allocated from them, as the
+	// fingerprint says nothing about truncated or corrupted files
+	size_t tileCount = 1;
+	for (int k = 0; k < 3; k++) {
+		if (layout.tiles[k] <= 0 || layout.tiles[k] > PVS_MAX_TILES)
+			return false;
+		tileCount *= (size_t)layout.tiles[k];
+	}
+	if (tileCount > PVS_MAX_TILES)
+		return false;
+
+	// Read one by one, so a bad count runs into the end of the file
+	vector<Floor> floors;
+	size_t cellCount = 0;
+	for (uint32_t i = 0; i < floorCount; i++) {
+		Floor floor;
+		if (!read(&floor.height, 4) || !read(&floor.eyeHeight, 4) || !read(&floor.minX, 4) || !read(&floor.minZ, 4)
+			|| !read(&floor.width, 4) || !read(&floor.depth, 4) || floor.width <= 0 || floor.depth <= 0
+			|| (size_t)floor.width * floor.depth > PVS_MAX_CELLS)
+			return false;
+		floor.cells.resize((size_t)floor.width * floor.depth);
+		if (!read(floor.cells.data(), floor.cells.size() * sizeof(int32_t)))
+			return false;
+		cellCount += floor.cells.size();
+		floors.push_back(move(floor));
+	}
+
+	// At most a set per cell, each at most a run per tile of 4 bytes
+	if (!read(&setCount, 4) || setCount > cellCount)
+		return false;
+	vector<vector<uint8_t>> sets(setCount);
+	for (vector<uint8_t>& set : sets) {
+		uint32_t bytes;
+		if (!read(&bytes, 4) || bytes > (tileCount + 1) * 4)
+			return false;
+		set.resize(bytes);
+		if (bytes > 0 && !read(set.data(), bytes))
+			return false;
+	}
+
+	for (const Floor& floor : floors) {
+		for (int32_t cell : floor.cells) {
+			if (cell >= (int32_t)setCount)
+				return false;
+		}
+	}
+
+	this->layout = layout;
+	this->floors = move(floors);
+	this->sets = move(sets);
+	this->current.set = -1;
+	return true;
+}
+
+bool PotentiallyVisibleSet::save(const string& cacheFile, uint64_t fingerprint) const {
+	ofstream file(cacheFile, ofstream::out | ofstream::binary | ofstream::trunc);
+	if (!file.is_open())
+		return false;
+
+	auto write = [&](const void* data, size_t size) {
+		file.write((const char*)data, size);
+	};
+
+	uint32_t version = PVS_CACHE_VERSION, floorCount = (uint32_t)this->floors.size(), setCount = (uint32_t)this->sets.size();
+	write("MZPV", 4);
+	write(&version, 4);
+	write(&fingerprint, 8);
+	write(&this->layout.origin, sizeof(Point3));
+	write(this->layout.tiles, sizeof(this->layout.tiles));
+	write(&floorCount, 4);
+	for (const Floor& floor : this->floors) {
+		write(&floor.height, 4);
+		write(&floor.eyeHeight, 4);
+		write(&floor.minX, 4);
+		write(&floor.minZ, 4);
+		write(&floor.width, 4);
+		write(&floor.depth, 4);
+		write(floor.cells.data(), floor.cells.size() * sizeof(int32_t));
+	}
+	write(&setCount, 4);
+	for (const vector<uint8_t>& set : this->sets) {
+		uint32_t bytes = (uint32_t)set.size();
+		write(&bytes, 4);
+		write(set.data(), bytes);
+	}
+	return (bool)file;
+}
+
+const VisibleTiles* PotentiallyVisibleSet::find(const Point3& eye) {
+	// The floor whose eye height is closest, within the heights baked
+	const Floor* best = nullptr;
+	float bestOffset = PVS_EYE_TOLERANCE;
+	for (const Floor& floor : this->floors) {
+		float offset = fabsf(eye.y - (floor.height + floor.eyeHeight));
+		if (offset <= bestOffset) {
+			bestOffset = offset;
+			best = &floor;
+		}
+	}
+	if (!best)
+		return nullptr;
+
+	int x = (int)floorf((eye.x - best->minX) / PVS_CELL_SIZE);
+	int z = (int)floorf((eye.z - best->minZ) / PVS_CELL_SIZE);
+	if (x < 0 || z < 0 || x >= best->width || z >= best->depth)
+		return nullptr;
+	int32_t set = best->cells[(size_t)z * best->width + x];
+	if (set < 0)
+		return nullptr;
+
+	if (set != this->current.set) {
+		this->current.origin = this->layout.origin;
+		memcpy(this->current.tiles, this->layout.tiles, sizeof(this->current.tiles));
+		decodeRuns(this->sets[set], this->current.bits, this->layout.getTileCount());
+		this->current.set = set;
+	}
+	return &this->current;
+}
+
+bool PotentiallyVisibleSet::isBaked() const {
+	return !this->floors.empty();
+}
+
+size_t PotentiallyVisibleSet::getCellCount() const {
+	return this->sets.size();
+}
+
+size_t PotentiallyVisibleSet::getCompressedBytes() const {
+	size_t bytes = 0;
+	for (const vector<uint8_t>& set : this->sets)
+		bytes += set.size();
+	return bytes;
+}
+
+size_t PotentiallyVisibleSet::getUncompressedBytes() const {
+	return this->sets.size() * ((this->layout.getTileCount() + 63) / 64) * sizeof(uint64_t);
+}
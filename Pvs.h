@@ -0,0 +1,99 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Point3.h"
+#include "Bvh.h"
+#include "Coverage.h"
+#include "GeometryStreams.h"
+
+// Side of the walkable cells, and of the tiles the scene is split into
+#define PVS_CELL_SIZE 1.0f
+#define PVS_TILE_SIZE 1.0f
+// Eye positions per cell side, from border to border, and rays cast from each
+#define PVS_CELL_SAMPLES 3
+#define PVS_RAYS_PER_SAMPLE 1536
+// How far from the floor's eye height sets are looked up, and baked
+#define PVS_EYE_TOLERANCE 0.25f
+// What makes the sampled sets conservative: each hit marks the tiles
+// within its ray's cone, this many times the spacing between rays
+// wide, and each set takes in the hits of the cells this many either side
+#define PVS_CONE_SCALE 1.0f
+#define PVS_NEIGHBOUR_CELLS 1
+// Bumped whenever the cache layout or the sampling changes
+#define PVS_CACHE_VERSION 2
+// Largest tile grid, and floor, a cache file may describe, far beyond
+// any scene's so only corrupted files are turned down
+#define PVS_MAX_TILES (1 << 24)
+#define PVS_MAX_CELLS (1 << 24)
+
+// Bitset over a grid of tiles across the scene, set for the tiles
+// holding surfaces seen from one cell
+class VisibleTiles {
+public:
+	// Whether any tile the box touches is set. Boxes reaching outside
+	// the grid always count as visible.
+	bool intersectsBox(const Point3& min, const Point3& max) const;
+
+	size_t getVisibleCount() const;
+	size_t getTileCount() const;
+	// Which cell's set this is, so users can tell when it changes
+	int getSet() const;
+
+private:
+	friend class PotentiallyVisibleSet;
+
+	Point3 origin;
+	int tiles[3] = { 0, 0, 0 };
+	std::vector<uint64_t> bits;
+	int set = -1;
+};
+
+// Potentially visible sets of the static scene for every walkable cell.
+// Each cell casts rays over the whole sphere from a few eye positions
+// across it, in parallel across cells. Its set is the tiles hit from
+// it and its neighbours, widened by each ray's cone, as a run-length
+// coded bitset.
+// At runtime the camera's cell is decoded once when the camera enters
+// it, after which rejecting a cluster is a few bit tests.
+class PotentiallyVisibleSet {
+public:
+	void bake(const Bvh& scene, const std::vector<FloorPlan>& floors, float eyeHeight);
+
+	// Reads cacheFile if it was baked from this same scene and floors,
+	// and otherwise bakes and writes it
+	void loadOrBake(const Bvh& scene, const std::vector<FloorPlan>& floors, float eyeHeight, const std::string& cacheFile);
+	bool load(const std::string& cacheFile, uint64_t fingerprint);
+	bool save(const std::string& cacheFile, uint64_t fingerprint) const;
+
+	// Tiles visible from the cell around eye, or null when eye is in
+	// none of them. Not thread safe, it decodes into a shared set.
+	const VisibleTiles* find(const Point3& eye);
+
+	bool isBaked() const;
+	size_t getCellCount() const;
+	// Of the run-length coded sets, and of plain bitsets
+	size_t getCompressedBytes() const;
+	size_t getUncompressedBytes() const;
+
+private:
+	struct Floor {
+		float height, eyeHeight;
+		float minX, minZ;
+		int width, depth;
+		std::vector<int32_t> cells; // Index into sets, -1 off the floor
+	};
+
+	static uint64_t fingerprint(const Bvh& scene, const std::vector<FloorPlan>& floors, float eyeHeight);
+
+	VisibleTiles layout; // Grid of every set, bits unused
+	std::vector<Floor> floors;
+	std::vector<std::vector<uint8_t>> sets; // Run-length coded
+	VisibleTiles current; // Last set found
+};
@@ -0,0 +1,432 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <iostream>
+#include "SamplingProfiler.h"
+
+using namespace std;
+
+static size_t textureBytes(const GraphTextureDesc& desc) {
+	size_t texelBytes;
+	switch (desc.format) {
+		case GL_R8: texelBytes = 1; break;
+		case GL_R16F: texelBytes = 2; break;
+		case GL_RGBA16F: texelBytes = 8; break;
+		case GL_RG32UI: texelBytes = 8; break;
+		default: texelBytes = 4; break;
+	}
+	return (size_t)desc.width * desc.height * texelBytes;
+}
+
+static bool sameDesc(const GraphTextureDesc& a, const GraphTextureDesc& b) {
+	return a.width == b.width && a.height == b.height && a.format == b.format;
+}
+
+/////////////////////
+// RenderPassBuilder
+
+RenderPassBuilder::RenderPassBuilder(RenderGraph& graph, int pass) : graph(graph), pass(pass) {
+}
+
+GraphTexture RenderPassBuilder::read(GraphTexture texture) {
+	this->graph.versions[texture.version].readers.push_back(this->pass);
+	this->graph.passes[this->pass].reads.push_back(texture.version);
+	return texture;
+}
+
+GraphTexture RenderPassBuilder::write(GraphTexture texture) {
+	int resource = this->graph.versions[texture.version].resource;
+	int written = this->graph.addVersion(resource, this->pass, texture.version);
+
+	RenderGraph::Pass& pass = this->graph.passes[this->pass];
+	pass.writes.push_back(written);
+	pass.colorAttachments.push_back(resource);
+	return GraphTexture{ written };
+}
+
+GraphTexture RenderPassBuilder::depth(GraphTexture texture, bool writeDepth) {
+	int resource = this->graph.versions[texture.version].resource;
+	this->graph.passes[this->pass].depthAttachment = resource;
+
+	if (!writeDepth)
+		return read(texture);
+
+	int written = this->graph.addVersion(resource, this->pass, texture.version);
+	this->graph.passes[this->pass].writes.push_back(written);
+	return GraphTexture{ written };
+}
+
+void RenderPassBuilder::keepAlive() {
+	this->graph.passes[this->pass].keepAlive = true;
+}
+
+void RenderPassBuilder::setGpuSection(const char* name) {
+	this->graph.passes[this->pass].gpuSection = name;
+}
+
+/////////////////////
+// RenderPassContext
+
+RenderPassContext::RenderPassContext(RenderGraph& graph, int width, int height) : graph(graph), width(width), height(height) {
+}
+
+GLuint RenderPassContext::getTexture(GraphTexture texture) const {
+	return this->graph.resources[this->graph.versions[texture.version].resource].texture;
+}
+
+GLuint RenderPassContext::getFramebuffer(GraphTexture texture) const {
+	const RenderGraph::Resource& resource = this->graph.resources[this->graph.versions[texture.version].resource];
+	if (resource.texture == 0)
+		return 0;
+
+	const RenderTarget* target = this->graph.findFramebuffer({ resource.texture }, 0, resource.desc.width, resource.desc.height);
+	return target->getFramebuffer();
+}
+
+int RenderPassContext::getWidth() const {
+	return this->width;
+}
+
+int RenderPassContext::getHeight() const {
+	return this->height;
+}
+
+///////////////
+// RenderGraph
+
+RenderGraph::RenderGraph() {
+}
+
+RenderGraph::~RenderGraph() {
+	this->framebuffers.clear();
+	for (PooledTexture& pooled : this->pool)
+		glDeleteTextures(1, &pooled.texture);
+}
+
+void RenderGraph::reset() {
+	this->resources.clear();
+	this->versions.clear();
+	this->passes.clear();
+	this->order.clear();
+	this->frame++;
+}
+
+GraphTexture RenderGraph::createTexture(const char* name, const GraphTextureDesc& desc) {
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	this->resources.push_back(resource);
+	return GraphTexture{ addVersion((int)this->resources.size() - 1, -1, -1) };
+}
+
+GraphTexture RenderGraph::importTexture(const char* name, GLuint texture, const GraphTextureDesc& desc) {
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	resource.texture = texture;
+	resource.imported = true;
+	this->resources.push_back(resource);
+	return GraphTexture{ addVersion((int)this->resources.size() - 1, -1, -1) };
+}
+
+const GraphTextureDesc& RenderGraph::getDesc(GraphTexture texture) const {
+	return this->resources[this->versions[texture.version].resource].desc;
+}
+
+int RenderGraph::addVersion(int resource, int producer, int previous) {
+	Version version;
+	version.resource = resource;
+	version.producer = producer;
+	version.previous = previous;
+	this->versions.push_back(version);
+	return (int)this->versions.size() - 1;
+}
+
+void RenderGraph::addPass(const char* name, const Setup& setup, const Execute& execute) {
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	this->passes.push_back(pass);
+
+	RenderPassBuilder builder(*this, (int)this->passes.size() - 1);
+	setup(builder);
+}
+
+void RenderGraph::markOutput(GraphTexture texture) {
+	this->versions[texture.version].output = true;
+}
+
+void RenderGraph::compile() {
+	size_t passCount = this->passes.size();
+
+	// Culling: walking back from the outputs, a pass is needed if it
+	// made what a needed pass reads or draws over
+	vector<int> needed;
+	for (Pass& pass : this->passes)
+		pass.culled = true;
+	for (size_t i = 0; i < passCount; i++) {
+		if (this->passes[i].keepAlive)
+			needed.push_back((int)i);
+	}
+	for (const Version& version : this->versions) {
+		if (version.output && version.producer >= 0)
+			needed.push_back(version.producer);
+	}
+
+	while (!needed.empty()) {
+		Pass& pass = this->passes[needed.back()];
+		needed.pop_back();
+		if (!pass.culled)
+			continue;
+		pass.culled = false;
+
+		for (int read : pass.reads) {
+			if (this->versions[read].producer >= 0)
+				needed.push_back(this->versions[read].producer);
+		}
+		for (int written : pass.writes) {
+			int previous = this->versions[written].previous;
+			if (previous >= 0 && this->versions[previous].producer >= 0)
+				needed.push_back(this->versions[previous].producer);
+		}
+	}
+
+	// Ordering: after the producers of whatever a pass reads or draws
+	// over, and after everyone reading what it draws over. Ties go to
+	// the pass declared first.
+	vector<vector<int>> successors(passCount);
+	vector<int> predecessorCount(passCount, 0);
+	auto addEdge = [&](int from, int to) {
+		if (from < 0 || from == to || this->passes[from].culled)
+			return;
+		successors[from].push_back(to);
+		predecessorCount[to]++;
+	};
+
+	for (size_t i = 0; i < passCount; i++) {
+		if (this->passes[i].culled)
+			continue;
+
+		for (int read : this->passes[i].reads)
+			addEdge(this->versions[read].producer, (int)i);
+		for (int written : this->passes[i].writes) {
+			int previous = this->versions[written].previous;
+			if (previous < 0)
+				continue;
+			addEdge(this->versions[previous].producer, (int)i);
+			for (int reader : this->versions[previous].readers)
+				addEdge(reader, (int)i);
+		}
+	}
+
+	vector<bool> scheduled(passCount, false);
+	while (true) {
+		int next = -1;
+		for (size_t i = 0; i < passCount && next < 0; i++) {
+			if (!this->passes[i].culled && !scheduled[i] && predecessorCount[i] == 0)
+				next = (int)i;
+		}
+		if (next < 0)
+			break;
+
+		scheduled[next] = true;
+		this->order.push_back(next);
+		for (int successor : successors[next])
+			predecessorCount[successor]--;
+	}
+
+	for (size_t i = 0; i < passCount; i++) {
+		if (!this->passes[i].culled && !scheduled[i]) {
+			// Only possible when passes were declared in a cycle
+			cout << "Render graph cycle through " << this->passes[i].name << ", running it in declaration order" << endl;
+			this->order.push_back((int)i);
+		}
+	}
+
+	// Lifetimes, from the first to the last pass touching a texture
+	for (size_t position = 0; position < this->order.size(); position++) {
+		const Pass& pass = this->passes[this->order[position]];
+		for (const vector<int>* list : { &pass.reads, &pass.writes }) {
+			for (int version : *list) {
+				Resource& resource = this->resources[this->versions[version].resource];
+				if (resource.firstPass < 0)
+					resource.firstPass = (int)position;
+				resource.lastPass = (int)position;
+			}
+		}
+	}
+
+	// Aliasing: transients take a pooled texture when first used and
+	// give it back after their last use, so later ones can take it
+	for (PooledTexture& pooled : this->pool)
+		pooled.inUse = false;
+	this->unaliasedBytes = 0;
+
+	for (size_t position = 0; position < this->order.size(); position++) {
+		for (Resource& resource : this->resources) {
+			if (!resource.imported && resource.firstPass == (int)position) {
+				resource.texture = acquire(resource.desc);
+				this->unaliasedBytes += textureBytes(resource.desc);
+			}
+		}
+		for (const Resource& resource : this->resources) {
+			if (resource.imported || resource.lastPass != (int)position)
+				continue;
+			for (PooledTexture& pooled : this->pool) {
+				if (pooled.texture == resource.texture)
+					pooled.inUse = false;
+			}
+		}
+	}
+
+	collectGarbage();
+}
+
+GLuint RenderGraph::acquire(const GraphTextureDesc& desc) {
+	for (PooledTexture& pooled : this->pool) {
+		if (!pooled.inUse && sameDesc(pooled.desc, desc)) {
+			pooled.inUse = true;
+			pooled.lastFrame = this->frame;
+			return pooled.texture;
+		}
+	}
+
+	PooledTexture pooled;
+	pooled.desc = desc;
+	pooled.texture = createRenderTexture(desc.width, desc.height, desc.format);
+	pooled.inUse = true;
+	pooled.lastFrame = this->frame;
+	this->pool.push_back(pooled);
+	return pooled.texture;
+}
+
+void RenderGraph::collectGarbage() {
+	for (size_t i = 0; i < this->pool.size();) {
+		if (this->frame - this->pool[i].lastFrame <= RENDER_GRAPH_POOL_FRAMES) {
+			i++;
+			continue;
+		}
+
+		GLuint texture = this->pool[i].texture;
+		dropFramebuffers(texture);
+		glDeleteTextures(1, &texture);
+		this->pool.erase(this->pool.begin() + i);
+	}
+
+	// Those of imported textures are only dropped here, unless released
+	for (auto framebuffer = this->framebuffers.begin(); framebuffer != this->framebuffers.end();) {
+		if (this->frame - framebuffer->second.lastFrame > RENDER_GRAPH_POOL_FRAMES)
+			framebuffer = this->framebuffers.erase(framebuffer);
+		else
+			++framebuffer;
+	}
+}
+
+void RenderGraph::dropFramebuffers(GLuint texture) {
+	for (auto framebuffer = this->framebuffers.begin(); framebuffer != this->framebuffers.end();) {
+		const vector<GLuint>& attachments = framebuffer->first;
+		if (find(attachments.begin(), attachments.end(), texture) != attachments.end())
+			framebuffer = this->framebuffers.erase(framebuffer);
+		else
+			++framebuffer;
+	}
+}
+
+void RenderGraph::releaseTexture(GLuint texture) {
+	if (texture != 0)
+		dropFramebuffers(texture);
+}
+
+const RenderTarget* RenderGraph::findFramebuffer(const vector<GLuint>& colors, GLuint depth, int width, int height) {
+	vector<GLuint> key = colors;
+	key.push_back(depth);
+
+	CachedFramebuffer& cached = this->framebuffers[key];
+	if (!cached.target) {
+		cached.target.reset(new RenderTarget());
+		cached.target->wrap(width, height, colors, depth);
+	}
+	cached.lastFrame = this->frame;
+	return cached.target.get();
+}
+
+void RenderGraph::execute(FrameStats* stats) {
+	const char* openSection = nullptr;
+
+	for (int index : this->order) {
+		const Pass& pass = this->passes[index];
+
+		vector<GLuint> colors;
+		for (int resource : pass.colorAttachments)
+			colors.push_back(this->resources[resource].texture);
+		GLuint depth = pass.depthAttachment >= 0 ? this->resources[pass.depthAttachment].texture : 0;
+
+		int first = !pass.colorAttachments.empty() ? pass.colorAttachments[0] : pass.depthAttachment;
+		int width = first >= 0 ? this->resources[first].desc.width : 0;
+		int height = first >= 0 ? this->resources[first].desc.height : 0;
+
+		if (first >= 0) {
+			bool window = find(colors.begin(), colors.end(), 0u) != colors.end() || (pass.depthAttachment >= 0 && depth == 0);
+			if (window) {
+				bindDefaultFramebuffer(width, height);
+			}
+			else {
+				const RenderTarget* target = findFramebuffer(colors, depth, width, height);
+				if (!target->isValid())
+					continue;
+				target->bind();
+			}
+		}
+
+		if (stats && pass.gpuSection != openSection) {
+			if (openSection)
+				stats->endGpu();
+			if (pass.gpuSection)
+				stats->beginGpu(pass.gpuSection);
+			openSection = pass.gpuSection;
+		}
+
+		if (getProfiler().isRunning())
+			setProfilerPhase(internProfilerPhase(pass.name));
+		pass.execute(RenderPassContext(*this, width, height));
+	}
+
+	if (stats && openSection)
+		stats->endGpu();
+	if (hasFramebuffers())
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+size_t RenderGraph::getPassCount() const {
+	return this->passes.size();
+}
+
+size_t RenderGraph::getCulledPassCount() const {
+	return this->passes.size() - this->order.size();
+}
+
+size_t RenderGraph::getPooledBytes() const {
+	size_t bytes = 0;
+	for (const PooledTexture& pooled : this->pool)
+		bytes += textureBytes(pooled.desc);
+	return bytes;
+}
+
+size_t RenderGraph::getUnaliasedBytes() const {
+	return this->unaliasedBytes;
+}
+
+string RenderGraph::describe() const {
+	string text;
+	for (const Pass& pass : this->passes) {
+		if (!text.empty())
+			text += " ";
+		text += pass.culled ? "[" + pass.name + "]" : pass.name;
+	}
+	return text;
+}
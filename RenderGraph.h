@@ -0,0 +1,183 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "GLExtensions.h"
+#include "RenderTarget.h"
+#include "FrameStats.h"
+
+// Frames a pooled texture or cached framebuffer may go unused before it is deleted
+#define RENDER_GRAPH_POOL_FRAMES 8
+
+struct GraphTextureDesc {
+	int width = 0, height = 0;
+	GLenum format = 0;
+};
+
+// One version of a texture in the graph. Writing to a texture gives
+// back a new version, so readers name exactly the contents they need.
+struct GraphTexture {
+	int version = -1;
+
+	bool isValid() const {
+		return this->version >= 0;
+	}
+};
+
+class RenderGraph;
+
+// Handed to a pass' setup to declare what it reads and writes
+class RenderPassBuilder {
+public:
+	// Sampled by the pass
+	GraphTexture read(GraphTexture texture);
+	// Drawn into as the next color attachment, keeping what was there
+	GraphTexture write(GraphTexture texture);
+	// Attached as depth, tested against and only written when writeDepth
+	GraphTexture depth(GraphTexture texture, bool writeDepth);
+	// Never culled, for passes whose effect lies outside the graph
+	void keepAlive();
+	// GPU time of the pass goes to this FrameStats section. Consecutive
+	// passes in the same section are timed together.
+	void setGpuSection(const char* name);
+
+private:
+	friend class RenderGraph;
+	RenderPassBuilder(RenderGraph& graph, int pass);
+
+	RenderGraph& graph;
+	int pass;
+};
+
+// Handed to a pass when it runs, its attachments already bound
+class RenderPassContext {
+public:
+	GLuint getTexture(GraphTexture texture) const;
+	// Framebuffer with just this texture attached, to blit from
+	GLuint getFramebuffer(GraphTexture texture) const;
+	int getWidth() const;
+	int getHeight() const;
+
+private:
+	friend class RenderGraph;
+	RenderPassContext(RenderGraph& graph, int width, int height);
+
+	RenderGraph& graph;
+	int width, height;
+};
+
+// Frame graph (O'Donnell 2017). Every frame the passes are declared
+// with the textures they read and write, then compile() orders them by
+// those dependencies, culls passes nothing needs, and gives each
+// transient texture a pooled one whose previous user has finished by
+// then. Textures of culled passes are never allocated, and pooled ones
+// left unused for a while are freed, so toggled off features cost no
+// memory. Texture 0 stands for the window's framebuffer.
+class RenderGraph {
+public:
+	typedef std::function<void(RenderPassBuilder&)> Setup;
+	typedef std::function<void(const RenderPassContext&)> Execute;
+
+	RenderGraph();
+	~RenderGraph();
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	// Forgets the previous frame's passes, keeping the pooled textures
+	void reset();
+
+	// Texture living within this frame, allocated only if used
+	GraphTexture createTexture(const char* name, const GraphTextureDesc& desc);
+	// Texture owned outside the graph, such as history kept across frames
+	GraphTexture importTexture(const char* name, GLuint texture, const GraphTextureDesc& desc);
+	// Drops the framebuffers cached for an imported texture, to be called
+	// before deleting it: GL may give its name to the next texture made
+	void releaseTexture(GLuint texture);
+	const GraphTextureDesc& getDesc(GraphTexture texture) const;
+
+	// Runs setup right away; execute runs later if the pass survives
+	void addPass(const char* name, const Setup& setup, const Execute& execute);
+	// The contents of texture are needed after the frame
+	void markOutput(GraphTexture texture);
+
+	void compile();
+	void execute(FrameStats* stats);
+
+	size_t getPassCount() const;
+	size_t getCulledPassCount() const;
+	// Memory of the pooled textures, and what the transients would
+	// take if each had its own
+	size_t getPooledBytes() const;
+	size_t getUnaliasedBytes() const;
+
+	// Culled passes in brackets, such as "opaque ssao [debug] present"
+	std::string describe() const;
+
+private:
+	friend class RenderPassBuilder;
+	friend class RenderPassContext;
+
+	struct Resource {
+		std::string name;
+		GraphTextureDesc desc;
+		GLuint texture = 0; // Imported, or assigned by compile
+		bool imported = false;
+		int firstPass = -1, lastPass = -1; // Execution order, -1 if unused
+	};
+
+	struct Version {
+		int resource;
+		int producer; // -1 for the initial contents
+		int previous; // Version this one was written over, -1 if none
+		std::vector<int> readers;
+		bool output = false;
+	};
+
+	struct Pass {
+		std::string name;
+		Execute execute;
+		std::vector<int> reads, writes; // Versions
+		std::vector<int> colorAttachments; // Resources
+		int depthAttachment = -1;
+		const char* gpuSection = nullptr;
+		bool keepAlive = false;
+		bool culled = false;
+	};
+
+	struct CachedFramebuffer {
+		std::unique_ptr<RenderTarget> target;
+		unsigned lastFrame = 0;
+	};
+
+	struct PooledTexture {
+		GraphTextureDesc desc;
+		GLuint texture = 0;
+		bool inUse = false;
+		unsigned lastFrame = 0;
+	};
+
+	int addVersion(int resource, int producer, int previous);
+	GLuint acquire(const GraphTextureDesc& desc);
+	const RenderTarget* findFramebuffer(const std::vector<GLuint>& colors, GLuint depth, int width, int height);
+	void collectGarbage();
+	void dropFramebuffers(GLuint texture);
+
+	std::vector<Resource> resources;
+	std::vector<Version> versions;
+	std::vector<Pass> passes;
+	std::vector<int> order; // Surviving passes, in execution order
+
+	std::vector<PooledTexture> pool;
+	// Framebuffers by attachments, the depth texture last
+	std::map<std::vector<GLuint>, CachedFramebuffer> framebuffers;
+	unsigned frame = 0;
+	size_t unaliasedBytes = 0;
+};
@@ -0,0 +1,169 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "RenderTarget.h"
+
+#include <iostream>
+#include "FrameStats.h"
+
+using namespace std;
+
+GLuint createRenderTexture(int width, int height, GLenum internalFormat) {
+	bool depth = internalFormat == GL_DEPTH_COMPONENT24 || internalFormat == GL_DEPTH_COMPONENT32F;
+	bool oneChannel = internalFormat == GL_R8 || internalFormat == GL_R16F || internalFormat == GL_R32F;
+	bool twoChannels = internalFormat == GL_RG16F;
+	bool integer = internalFormat == GL_RG32UI;
+	GLenum format = depth ? GL_DEPTH_COMPONENT : oneChannel ? GL_RED : twoChannels ? GL_RG : integer ? GL_RG_INTEGER : GL_RGBA;
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, integer ? GL_UNSIGNED_INT : GL_FLOAT, nullptr);
+
+	// Depth and integers are never filtered, color may be read between texels
+	GLint filter = depth || integer ? GL_NEAREST : GL_LINEAR;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return texture;
+}
+
+RenderTarget::RenderTarget() {
+}
+
+RenderTarget::~RenderTarget() {
+	destroy();
+}
+
+bool RenderTarget::create(int width, int height, const vector<GLenum>& colorFormats, GLenum depthFormat, GLuint sharedDepth) {
+	destroy();
+	if (!hasFramebuffers() || width <= 0 || height <= 0)
+		return false;
+
+	this->width = width;
+	this->height = height;
+
+	for (GLenum format : colorFormats)
+		this->colorTextures.push_back(createRenderTexture(width, height, format));
+	this->ownedTextures = this->colorTextures;
+
+	if (depthFormat != 0) {
+		this->depthTexture = createRenderTexture(width, height, depthFormat);
+		this->ownedTextures.push_back(this->depthTexture);
+	}
+	else {
+		this->depthTexture = sharedDepth;
+	}
+
+	return attach();
+}
+
+bool RenderTarget::wrap(int width, int height, const vector<GLuint>& colorTextures, GLuint depthTexture) {
+	destroy();
+	if (!hasFramebuffers() || width <= 0 || height <= 0)
+		return false;
+
+	this->width = width;
+	this->height = height;
+	this->colorTextures = colorTextures;
+	this->depthTexture = depthTexture;
+	return attach();
+}
+
+bool RenderTarget::attach() {
+	glGenFramebuffers(1, &this->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+
+	for (size_t i = 0; i < this->colorTextures.size(); i++)
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (GLenum)i, GL_TEXTURE_2D, this->colorTextures[i], 0);
+	if (this->depthTexture != 0)
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, this->depthTexture, 0);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		cout << "Incomplete framebuffer: 0x" << hex << status << dec << endl;
+		destroy();
+		return false;
+	}
+
+	return true;
+}
+
+void RenderTarget::destroy() {
+	if (!this->ownedTextures.empty())
+		glDeleteTextures((GLsizei)this->ownedTextures.size(), this->ownedTextures.data());
+	if (this->framebuffer != 0)
+		glDeleteFramebuffers(1, &this->framebuffer);
+
+	this->colorTextures.clear();
+	this->ownedTextures.clear();
+	this->depthTexture = 0;
+	this->framebuffer = 0;
+	this->width = this->height = 0;
+}
+
+void RenderTarget::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+	glViewport(0, 0, this->width, this->height);
+
+	GLenum buffers[8];
+	size_t count = this->colorTextures.size() < 8 ? this->colorTextures.size() : 8;
+	for (size_t i = 0; i < count; i++)
+		buffers[i] = GL_COLOR_ATTACHMENT0 + (GLenum)i;
+
+	if (count > 0) {
+		glDrawBuffers((GLsizei)count, buffers);
+	}
+	else {
+		// Depth only
+		glDrawBuffer(GL_NONE);
+	}
+}
+
+bool RenderTarget::isValid() const {
+	return this->framebuffer != 0;
+}
+
+int RenderTarget::getWidth() const {
+	return this->width;
+}
+
+int RenderTarget::getHeight() const {
+	return this->height;
+}
+
+GLuint RenderTarget::getFramebuffer() const {
+	return this->framebuffer;
+}
+
+GLuint RenderTarget::getColorTexture(size_t index) const {
+	return index < this->colorTextures.size() ? this->colorTextures[index] : 0;
+}
+
+GLuint RenderTarget::getDepthTexture() const {
+	return this->depthTexture;
+}
+
+void bindDefaultFramebuffer(int width, int height) {
+	if (hasFramebuffers())
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDrawBuffer(GL_BACK);
+	glViewport(0, 0, width, height);
+}
+
+void drawFullscreenQuad() {
+	glBegin(GL_QUADS);
+	glVertex2f(-1, -1);
+	glVertex2f(1, -1);
+	glVertex2f(1, 1);
+	glVertex2f(-1, 1);
+	glEnd();
+	countDrawCalls();
+}
@@ -0,0 +1,58 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <vector>
+#include "GLExtensions.h"
+
+// Framebuffer object whose attachments are all textures,
+// so later passes can sample anything an earlier one wrote
+class RenderTarget {
+public:
+	RenderTarget();
+	~RenderTarget();
+	RenderTarget(const RenderTarget&) = delete;
+	RenderTarget& operator=(const RenderTarget&) = delete;
+
+	// (Re)creates the target with one color texture per format.
+	// depthFormat 0 leaves it without a depth texture of its own; a
+	// sharedDepth texture from another target can be attached instead.
+	bool create(int width, int height, const std::vector<GLenum>& colorFormats, GLenum depthFormat, GLuint sharedDepth = 0);
+	// Framebuffer over textures owned by another target, such as its
+	// color without its depth, to draw there while sampling the depth
+	bool wrap(int width, int height, const std::vector<GLuint>& colorTextures, GLuint depthTexture);
+	void destroy();
+
+	// Binds the framebuffer, its draw buffers and a matching viewport
+	void bind() const;
+
+	bool isValid() const;
+	int getWidth() const;
+	int getHeight() const;
+	GLuint getFramebuffer() const;
+	GLuint getColorTexture(size_t index) const;
+	GLuint getDepthTexture() const;
+
+private:
+	bool attach();
+
+	GLuint framebuffer = 0;
+	std::vector<GLuint> colorTextures;
+	GLuint depthTexture = 0;
+	std::vector<GLuint> ownedTextures; // Those created here, not shared or wrapped
+	int width = 0, height = 0;
+};
+
+// Texture that can be attached to a RenderTarget, clamped at its
+// edges and filtered unless it holds depth
+GLuint createRenderTexture(int width, int height, GLenum internalFormat);
+
+// Back to the window's framebuffer, with a viewport covering it
+void bindDefaultFramebuffer(int width, int height);
+
+// Covers the viewport with a quad at clip space corners, for
+// shaders that pass gl_Vertex straight to gl_Position
+void drawFullscreenQuad();
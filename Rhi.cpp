@@ -0,0 +1,150 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Rhi.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "GpuMesh.h"
+#include "JobSystem.h"
+
+using namespace std;
+
+#define RHI_BENCH_GRID 28 // Cubes per side, RHI_BENCH_GRID^3 draws in all
+#define RHI_BENCH_FRAMES 20
+#define RHI_BENCH_WIDTH 800
+#define RHI_BENCH_HEIGHT 600
+
+typedef chrono::steady_clock Clock;
+
+static double millisecondsSince(Clock::time_point start) {
+	return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// Unit cube as 6 quads, position then normal
+static vector<float> buildCube() {
+	static const float faces[6][3] = {
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }
+	};
+
+	vector<float> vertices;
+	for (const float* normal : faces) {
+		// Two axes spanning the face
+		int axis = normal[0] != 0 ? 0 : normal[1] != 0 ? 1 : 2;
+		int u = (axis + 1) % 3, v = (axis + 2) % 3;
+		static const float corners[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+		for (const float* corner : corners) {
+			float position[3];
+			position[axis] = normal[axis] * 0.5f;
+			position[u] = corner[0] * 0.5f;
+			position[v] = corner[1] * 0.5f;
+			vertices.insert(vertices.end(), position, position + 3);
+			vertices.insert(vertices.end(), normal, normal + 3);
+		}
+	}
+	return vertices;
+}
+
+// Perspective looking down -z, as gluPerspective would build it
+static void perspective(float fovY, float aspect, float zNear, float zFar, float out[16]) {
+	float f = 1.0f / tan(fovY * 0.5f * 3.14159265f / 180.0f);
+	fill(out, out + 16, 0.0f);
+	out[0] = f / aspect;
+	out[5] = f;
+	out[10] = (zFar + zNear) / (zNear - zFar);
+	out[11] = -1;
+	out[14] = 2 * zFar * zNear / (zNear - zFar);
+}
+
+struct BenchResult {
+	double record = 0, submit = 0, wait = 0;
+};
+
+static BenchResult benchmark(RenderDevice& device, RhiBuffer cube, unsigned threads) {
+	const size_t side = RHI_BENCH_GRID, drawCount = side * side * side;
+	const size_t grain = (drawCount + threads - 1) / threads;
+
+	float projection[16];
+	perspective(60, (float)RHI_BENCH_WIDTH / RHI_BENCH_HEIGHT, 1, 200, projection);
+
+	BenchResult result;
+	// One frame to warm up pipelines and allocations, then the timed ones
+	for (int frame = 0; frame <= RHI_BENCH_FRAMES; frame++) {
+		device.beginFrame(threads, RHI_BENCH_WIDTH, RHI_BENCH_HEIGHT);
+
+		Clock::time_point start = Clock::now();
+		getJobSystem().parallelFor(drawCount, grain, [&](size_t begin, size_t end, unsigned) {
+			RhiCommandList& list = device.getCommandList((unsigned)(begin / grain));
+			list.bindVertexBuffer(cube);
+			for (size_t i = begin; i < end; i++) {
+				// Projection times a translation only changes the last column
+				float x = (float)(i % side) * 2 - side, y = (float)(i / side % side) * 2 - side;
+				float z = -(float)(i / (side * side)) * 2 - 10;
+				float transform[16];
+				copy(projection, projection + 16, transform);
+				for (int row = 0; row < 4; row++)
+					transform[12 + row] = projection[row] * x + projection[4 + row] * y + projection[8 + row] * z + projection[12 + row];
+				list.setTransform(transform);
+
+				float color[4] = { (float)(i % side) / side, (float)(i / side % side) / side, 0.5f, 1 };
+				list.setColor(color);
+				list.drawQuads(0, 24);
+			}
+		});
+		double record = millisecondsSince(start);
+
+		start = Clock::now();
+		device.endFrame();
+		double submit = millisecondsSince(start);
+
+		start = Clock::now();
+		device.waitIdle();
+		double wait = millisecondsSince(start);
+
+		if (frame > 0) {
+			result.record += record / RHI_BENCH_FRAMES;
+			result.submit += submit / RHI_BENCH_FRAMES;
+			result.wait += wait / RHI_BENCH_FRAMES;
+		}
+	}
+	return result;
+}
+
+void runRhiBenchmark() {
+	vector<unique_ptr<RenderDevice>> devices;
+	devices.push_back(createGLRenderDevice());
+	unique_ptr<RenderDevice> vulkan = createVulkanRenderDevice();
+	if (vulkan)
+		devices.push_back(move(vulkan));
+	else
+		printf("Vulkan backend unavailable, benchmarking OpenGL only\n");
+
+	vector<unsigned> threadCounts = { 1 };
+	if (getJobSystem().getThreadCount() > 1)
+		threadCounts.push_back(getJobSystem().getThreadCount());
+
+	vector<float> cube = buildCube();
+	const size_t drawCount = RHI_BENCH_GRID * RHI_BENCH_GRID * RHI_BENCH_GRID;
+	printf("%zu draws of %zu vertices, ms per frame over %d frames\n", drawCount, cube.size() / GPU_VERTEX_FLOATS, RHI_BENCH_FRAMES);
+	// Wide enough for device names such as "Vulkan (SwiftShader Device (Subzero))"
+	int nameWidth = 10;
+	for (unique_ptr<RenderDevice>& device : devices)
+		nameWidth = max(nameWidth, (int)strlen(device->getName()));
+	printf("%-*s %8s %10s %10s %10s %10s\n", nameWidth, "backend", "threads", "record", "submit", "gpu wait", "total");
+
+	for (unique_ptr<RenderDevice>& device : devices) {
+		RhiBuffer buffer = device->createVertexBuffer(cube.data(), cube.size() / GPU_VERTEX_FLOATS);
+		for (unsigned threads : threadCounts) {
+			BenchResult result = benchmark(*device, buffer, threads);
+			printf("%-*s %8u %10.2f %10.2f %10.2f %10.2f\n", nameWidth, device->getName(), threads,
+				result.record, result.submit, result.wait, result.record + result.submit + result.wait);
+		}
+		device->destroyBuffer(buffer);
+	}
+}
@@ -0,0 +1,74 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// Render hardware interface: mesh submission written once against
+// RenderDevice, running on OpenGL or Vulkan underneath.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Builds the Vulkan backend, which needs the Vulkan headers and loader
+// (vulkan-1 on Windows, libvulkan elsewhere). The project defines it
+// where the Vulkan SDK is installed, see MezzanineVulkan. Without a GPU,
+// a CPU driver such as Mesa's lavapipe or SwiftShader runs it.
+#ifndef MEZZANINE_VULKAN
+#define MEZZANINE_VULKAN 0
+#endif
+
+// Buffer owned by a RenderDevice, 0 for none
+typedef uint32_t RhiBuffer;
+
+// Draws recorded for one frame. Each list is only ever touched by one
+// thread at a time, but different lists may be recorded on different
+// threads at once.
+class RhiCommandList {
+public:
+	virtual ~RhiCommandList() {}
+
+	// Projection times modelview, column major, with OpenGL's clip space
+	virtual void setTransform(const float transform[16]) = 0;
+	virtual void setColor(const float color[4]) = 0;
+	// Vertices laid out as in GpuMesh: position, then normal
+	virtual void bindVertexBuffer(RhiBuffer buffer) = 0;
+	// Quads of the bound buffer, count being a multiple of 4
+	virtual void drawQuads(uint32_t first, uint32_t count) = 0;
+};
+
+class RenderDevice {
+public:
+	virtual ~RenderDevice() {}
+
+	virtual const char* getName() const = 0;
+
+	// Up to GPU_BLOCK_VERTICES vertices of GPU_VERTEX_FLOATS floats
+	virtual RhiBuffer createVertexBuffer(const float* vertices, size_t vertexCount) = 0;
+	virtual void destroyBuffer(RhiBuffer buffer) = 0;
+
+	// Starts a frame of listCount command lists drawing into a cleared
+	// width x height target. Waits for the previous frame if needed.
+	virtual void beginFrame(unsigned listCount, int width, int height) = 0;
+	virtual RhiCommandList& getCommandList(unsigned index) = 0;
+	// Submits the lists in order, without waiting for the GPU
+	virtual void endFrame() = 0;
+	// Waits until the GPU has finished the submitted frame
+	virtual void waitIdle() = 0;
+};
+
+// Draws into whatever framebuffer is bound when a frame ends. Lists are
+// recorded into memory and replayed on the thread calling endFrame(),
+// which must be the one owning the GL context.
+std::unique_ptr<RenderDevice> createGLRenderDevice();
+
+// Headless, drawing into an image of its own. nullptr when built without
+// MEZZANINE_VULKAN or when no Vulkan device is present.
+std::unique_ptr<RenderDevice> createVulkanRenderDevice();
+
+// Records and submits the same draws on every backend available, over
+// one thread and then all of the job system's, and prints the CPU time
+// each step takes. Needs a current GL context.
+void runRhiBenchmark();
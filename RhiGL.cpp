@@ -0,0 +1,198 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Rhi.h"
+
+#include <cstring>
+#include <map>
+#include <vector>
+#include "GLExtensions.h"
+#include "GpuMesh.h"
+#include "FrameStats.h"
+
+using namespace std;
+
+#define VERTEX_BYTES (GPU_VERTEX_FLOATS * sizeof(float))
+
+// OpenGL calls can only come from the context's thread, so lists are
+// plain arrays of commands that endFrame() replays there
+class GLCommandList : public RhiCommandList {
+public:
+	enum class Type {
+		Transform,
+		Color,
+		Bind,
+		Draw
+	};
+
+	struct Command {
+		Type type;
+		uint32_t first, count; // Or the buffer, for Bind
+		float values[16];
+	};
+
+	void setTransform(const float transform[16]) override {
+		Command command = { Type::Transform, 0, 0, {} };
+		memcpy(command.values, transform, sizeof(command.values));
+		this->commands.push_back(command);
+	}
+
+	void setColor(const float color[4]) override {
+		Command command = { Type::Color, 0, 0, {} };
+		memcpy(command.values, color, 4 * sizeof(float));
+		this->commands.push_back(command);
+	}
+
+	void bindVertexBuffer(RhiBuffer buffer) override {
+		Command command = { Type::Bind, buffer, 0, {} };
+		this->commands.push_back(command);
+	}
+
+	void drawQuads(uint32_t first, uint32_t count) override {
+		Command command = { Type::Draw, first, count, {} };
+		this->commands.push_back(command);
+	}
+
+	vector<Command> commands;
+};
+
+class GLRenderDevice : public RenderDevice {
+public:
+	~GLRenderDevice() {
+		for (auto& buffer : this->buffers) {
+			if (buffer.second.buffer != 0)
+				glDeleteBuffers(1, &buffer.second.buffer);
+		}
+	}
+
+	const char* getName() const override {
+		return "OpenGL";
+	}
+
+	RhiBuffer createVertexBuffer(const float* vertices, size_t vertexCount) override {
+		Buffer buffer;
+		if (hasBufferObjects()) {
+			glGenBuffers(1, &buffer.buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, buffer.buffer);
+			glBufferData(GL_ARRAY_BUFFER, vertexCount * VERTEX_BYTES, vertices, GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		else {
+			buffer.clientVertices.assign(vertices, vertices + vertexCount * GPU_VERTEX_FLOATS);
+		}
+
+		RhiBuffer id = this->nextBuffer++;
+		this->buffers[id] = move(buffer);
+		return id;
+	}
+
+	void destroyBuffer(RhiBuffer id) override {
+		auto buffer = this->buffers.find(id);
+		if (buffer == this->buffers.end())
+			return;
+		if (buffer->second.buffer != 0)
+			glDeleteBuffers(1, &buffer->second.buffer);
+		this->buffers.erase(buffer);
+	}
+
+	void beginFrame(unsigned listCount, int width, int height) override {
+		if (this->lists.size() < listCount)
+			this->lists.resize(listCount);
+		for (unsigned i = 0; i < listCount; i++)
+			this->lists[i].commands.clear();
+		this->listCount = listCount;
+		this->width = width;
+		this->height = height;
+	}
+
+	RhiCommandList& getCommandList(unsigned index) override {
+		return this->lists[index];
+	}
+
+	void endFrame() override {
+		glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_VIEWPORT_BIT);
+		glViewport(0, 0, this->width, this->height);
+		glClearColor(0, 0, 0, 1);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glEnable(GL_DEPTH_TEST);
+		glDisable(GL_LIGHTING);
+
+		// The transform goes into the projection, the modelview stays identity
+		glMatrixMode(GL_MODELVIEW);
+		glPushMatrix();
+		glLoadIdentity();
+		glMatrixMode(GL_PROJECTION);
+		glPushMatrix();
+
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+
+		for (unsigned i = 0; i < this->listCount; i++) {
+			for (const GLCommandList::Command& command : this->lists[i].commands) {
+				switch (command.type) {
+					case GLCommandList::Type::Transform:
+						glLoadMatrixf(command.values);
+						break;
+					case GLCommandList::Type::Color:
+						glColor4fv(command.values);
+						break;
+					case GLCommandList::Type::Bind:
+						bind(command.first);
+						break;
+					case GLCommandList::Type::Draw:
+						glDrawArrays(GL_QUADS, (GLint)command.first, (GLsizei)command.count);
+						countDrawCalls();
+						break;
+				}
+			}
+		}
+
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		if (hasBufferObjects())
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glPopMatrix();
+		glMatrixMode(GL_MODELVIEW);
+		glPopMatrix();
+		glPopAttrib();
+		glFlush();
+	}
+
+	void waitIdle() override {
+		glFinish();
+	}
+
+private:
+	struct Buffer {
+		GLuint buffer = 0;
+		vector<float> clientVertices;
+	};
+
+	void bind(RhiBuffer id) {
+		auto buffer = this->buffers.find(id);
+		if (buffer == this->buffers.end())
+			return;
+
+		const float* base = nullptr;
+		if (buffer->second.buffer != 0)
+			glBindBuffer(GL_ARRAY_BUFFER, buffer->second.buffer);
+		else
+			base = buffer->second.clientVertices.data();
+
+		glVertexPointer(3, GL_FLOAT, VERTEX_BYTES, base);
+		glNormalPointer(GL_FLOAT, VERTEX_BYTES, base + 3);
+	}
+
+	map<RhiBuffer, Buffer> buffers;
+	RhiBuffer nextBuffer = 1;
+	vector<GLCommandList> lists;
+	unsigned listCount = 0;
+	int width = 0, height = 0;
+};
+
+unique_ptr<RenderDevice> createGLRenderDevice() {
+	return unique_ptr<RenderDevice>(new GLRenderDevice());
+}
@@ -0,0 +1,820 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Rhi.h"
+
+#if MEZZANINE_VULKAN
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "GpuMesh.h"
+
+using namespace std;
+
+// Size of each block of device memory the arenas carve up
+#define VULKAN_ARENA_BYTES (64 << 20)
+
+// Where pipelines compiled by one run are kept for the next
+#define VULKAN_PIPELINE_CACHE "pipeline_cache.bin"
+
+#define COLOR_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+#define DEPTH_FORMAT VK_FORMAT_D32_SFLOAT
+
+// Push constants shared by both stages
+struct PushConstants {
+	float transform[16];
+	float color[4];
+};
+
+///////////
+// Shaders
+// SPIR-V for the equivalent of:
+//   layout(push_constant) uniform PushConstants { mat4 transform; vec4 color; };
+//   vertex:   layout(location = 0) in vec3 position;
+//             gl_Position = transform * vec4(position, 1.0);
+//   fragment: layout(location = 0) out vec4 fragColor;
+//             fragColor = color;
+
+static const uint32_t vertexSpirv[] = {
+	0x07230203, 0x00010000, 0x00000000, 0x00000019, 0x00000000, 0x00020011, 0x00000001, 0x0003000e,
+	0x00000000, 0x00000001, 0x0007000f, 0x00000000, 0x00000012, 0x6e69616d, 0x00000000, 0x0000000e,
+	0x00000010, 0x00030047, 0x00000007, 0x00000002, 0x00050048, 0x00000007, 0x00000000, 0x00000023,
+	0x00000000, 0x00040048, 0x00000007, 0x00000000, 0x00000005, 0x00050048, 0x00000007, 0x00000000,
+	0x00000007, 0x00000010, 0x00050048, 0x00000007, 0x00000001, 0x00000023, 0x00000040, 0x00040047,
+	0x0000000e, 0x0000001e, 0x00000000, 0x00040047, 0x00000010, 0x0000000b, 0x00000000, 0x00020013,
+	0x00000001, 0x00030021, 0x00000002, 0x00000001, 0x00030016, 0x00000003, 0x00000020, 0x00040017,
+	0x00000004, 0x00000003, 0x00000004, 0x00040018, 0x00000005, 0x00000004, 0x00000004, 0x00040017,
+	0x00000006, 0x00000003, 0x00000003, 0x0004001e, 0x00000007, 0x00000005, 0x00000004, 0x00040020,
+	0x00000008, 0x00000009, 0x00000007, 0x0004003b, 0x00000008, 0x00000009, 0x00000009, 0x00040015,
+	0x0000000a, 0x00000020, 0x00000001, 0x0004002b, 0x0000000a, 0x0000000b, 0x00000000, 0x00040020,
+	0x0000000c, 0x00000009, 0x00000005, 0x00040020, 0x0000000d, 0x00000001, 0x00000006, 0x0004003b,
+	0x0000000d, 0x0000000e, 0x00000001, 0x00040020, 0x0000000f, 0x00000003, 0x00000004, 0x0004003b,
+	0x0000000f, 0x00000010, 0x00000003, 0x0004002b, 0x00000003, 0x00000011, 0x3f800000, 0x00050036,
+	0x00000001, 0x00000012, 0x00000000, 0x00000002, 0x000200f8, 0x00000013, 0x00050041, 0x0000000c,
+	0x00000014, 0x00000009, 0x0000000b, 0x0004003d, 0x00000005, 0x00000015, 0x00000014, 0x0004003d,
+	0x00000006, 0x00000016, 0x0000000e, 0x00050050, 0x00000004, 0x00000017, 0x00000016, 0x00000011,
+	0x00050091, 0x00000004, 0x00000018, 0x00000015, 0x00000017, 0x0003003e, 0x00000010, 0x00000018,
+	0x000100fd, 0x00010038,
+};
+
+static const uint32_t fragmentSpirv[] = {
+	0x07230203, 0x00010000, 0x00000000, 0x00000016, 0x00000000, 0x00020011, 0x00000001, 0x0003000e,
+	0x00000000, 0x00000001, 0x0006000f, 0x00000004, 0x00000012, 0x6e69616d, 0x00000000, 0x0000000e,
+	0x00030010, 0x00000012, 0x00000007, 0x00030047, 0x00000007, 0x00000002, 0x00050048, 0x00000007,
+	0x00000000, 0x00000023, 0x00000000, 0x00040048, 0x00000007, 0x00000000, 0x00000005, 0x00050048,
+	0x00000007, 0x00000000, 0x00000007, 0x00000010, 0x00050048, 0x00000007, 0x00000001, 0x00000023,
+	0x00000040, 0x00040047, 0x0000000e, 0x0000001e, 0x00000000, 0x00020013, 0x00000001, 0x00030021,
+	0x00000002, 0x00000001, 0x00030016, 0x00000003, 0x00000020, 0x00040017, 0x00000004, 0x00000003,
+	0x00000004, 0x00040018, 0x00000005, 0x00000004, 0x00000004, 0x00040017, 0x00000006, 0x00000003,
+	0x00000003, 0x0004001e, 0x00000007, 0x00000005, 0x00000004, 0x00040020, 0x00000008, 0x00000009,
+	0x00000007, 0x0004003b, 0x00000008, 0x00000009, 0x00000009, 0x00040015, 0x0000000a, 0x00000020,
+	0x00000001, 0x0004002b, 0x0000000a, 0x0000000b, 0x00000001, 0x00040020, 0x0000000c, 0x00000009,
+	0x00000004, 0x00040020, 0x0000000d, 0x00000003, 0x00000004, 0x0004003b, 0x0000000d, 0x0000000e,
+	0x00000003, 0x00050036, 0x00000001, 0x00000012, 0x00000000, 0x00000002, 0x000200f8, 0x00000013,
+	0x00050041, 0x0000000c, 0x00000014, 0x00000009, 0x0000000b, 0x0004003d, 0x00000004, 0x00000015,
+	0x00000014, 0x0003003e, 0x0000000e, 0x00000015, 0x000100fd, 0x00010038,
+};
+
+static bool check(VkResult result, const char* what) {
+	if (result == VK_SUCCESS)
+		return true;
+	cout << "Vulkan: " << what << " failed (" << (int)result << ")" << endl;
+	return false;
+}
+
+///////////////
+// VulkanArena
+// Device memory taken from the driver in big blocks and handed out
+// linearly. Nothing goes back until the arena is reset or destroyed,
+// which suits buffers living as long as the device and render targets
+// that are always recreated together.
+
+class VulkanArena {
+public:
+	void init(VkDevice device, const VkPhysicalDeviceMemoryProperties& properties, VkMemoryPropertyFlags flags) {
+		this->device = device;
+		this->properties = properties;
+		this->flags = flags;
+	}
+
+	// Where a resource with these requirements goes, and its mapping
+	// if the arena is host visible
+	bool allocate(const VkMemoryRequirements& requirements, VkDeviceMemory& memory, VkDeviceSize& offset, void** mapped) {
+		for (Block& block : this->blocks) {
+			VkDeviceSize aligned = (block.used + requirements.alignment - 1) / requirements.alignment * requirements.alignment;
+			if ((requirements.memoryTypeBits & (1u << block.type)) && aligned + requirements.size <= block.size) {
+				block.used = aligned + requirements.size;
+				return place(block, aligned, memory, offset, mapped);
+			}
+		}
+
+		uint32_t type = 0;
+		while (type < this->properties.memoryTypeCount
+			&& !((requirements.memoryTypeBits & (1u << type)) && (this->properties.memoryTypes[type].propertyFlags & this->flags) == this->flags))
+			type++;
+		if (type == this->properties.memoryTypeCount) {
+			cout << "Vulkan: no suitable memory type" << endl;
+			return false;
+		}
+
+		Block block;
+		block.type = type;
+		block.size = requirements.size > VULKAN_ARENA_BYTES ? requirements.size : VULKAN_ARENA_BYTES;
+
+		VkMemoryAllocateInfo allocateInfo = {};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocateInfo.allocationSize = block.size;
+		allocateInfo.memoryTypeIndex = type;
+		if (!check(vkAllocateMemory(this->device, &allocateInfo, nullptr, &block.memory), "vkAllocateMemory"))
+			return false;
+		if (this->flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+			vkMapMemory(this->device, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped);
+
+		block.used = requirements.size;
+		this->blocks.push_back(block);
+		return place(this->blocks.back(), 0, memory, offset, mapped);
+	}
+
+	// Everything allocated so far is free again
+	void reset() {
+		for (Block& block : this->blocks)
+			block.used = 0;
+	}
+
+	void destroy() {
+		for (Block& block : this->blocks) {
+			if (block.mapped)
+				vkUnmapMemory(this->device, block.memory);
+			vkFreeMemory(this->device, block.memory, nullptr);
+		}
+		this->blocks.clear();
+	}
+
+private:
+	struct Block {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0, used = 0;
+		uint32_t type = 0;
+		void* mapped = nullptr;
+	};
+
+	static bool place(const Block& block, VkDeviceSize at, VkDeviceMemory& memory, VkDeviceSize& offset, void** mapped) {
+		memory = block.memory;
+		offset = at;
+		if (mapped)
+			*mapped = block.mapped ? (char*)block.mapped + at : nullptr;
+		return true;
+	}
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties properties = {};
+	VkMemoryPropertyFlags flags = 0;
+	vector<Block> blocks;
+};
+
+/////////////////////
+// VulkanCommandList
+// A secondary command buffer with a pool of its own, so threads never
+// share a pool while recording
+
+class VulkanCommandList : public RhiCommandList {
+public:
+	void setTransform(const float transform[16]) override {
+		// OpenGL's clip space to Vulkan's: y flipped, z from [-1, 1] to [0, 1]
+		float converted[16];
+		for (int column = 0; column < 4; column++) {
+			const float* in = transform + column * 4;
+			float* out = converted + column * 4;
+			out[0] = in[0];
+			out[1] = -in[1];
+			out[2] = 0.5f * (in[2] + in[3]);
+			out[3] = in[3];
+		}
+		vkCmdPushConstants(this->commands, this->layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			offsetof(PushConstants, transform), sizeof(converted), converted);
+	}
+
+	void setColor(const float color[4]) override {
+		vkCmdPushConstants(this->commands, this->layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			offsetof(PushConstants, color), 4 * sizeof(float), color);
+	}
+
+	void bindVertexBuffer(RhiBuffer buffer) override {
+		if (buffer == 0 || buffer > this->buffers->size())
+			return;
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(this->commands, 0, 1, &(*this->buffers)[buffer - 1], &offset);
+	}
+
+	void drawQuads(uint32_t first, uint32_t count) override {
+		// Two triangles per quad, through the shared quad index buffer
+		vkCmdDrawIndexed(this->commands, count / 4 * 6, 1, first / 4 * 6, 0, 0);
+	}
+
+	VkCommandPool pool = VK_NULL_HANDLE;
+	VkCommandBuffer commands = VK_NULL_HANDLE;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	const vector<VkBuffer>* buffers = nullptr;
+};
+
+//////////////////////
+// VulkanRenderDevice
+
+class VulkanRenderDevice : public RenderDevice {
+public:
+	~VulkanRenderDevice() {
+		if (this->device == VK_NULL_HANDLE) {
+			if (this->instance != VK_NULL_HANDLE)
+				vkDestroyInstance(this->instance, nullptr);
+			return;
+		}
+
+		vkDeviceWaitIdle(this->device);
+		savePipelineCache();
+
+		for (auto& list : this->lists)
+			vkDestroyCommandPool(this->device, list->pool, nullptr);
+		destroyTargets();
+		for (VkBuffer buffer : this->buffers) {
+			if (buffer != VK_NULL_HANDLE)
+				vkDestroyBuffer(this->device, buffer, nullptr);
+		}
+		if (this->quadIndices != VK_NULL_HANDLE)
+			vkDestroyBuffer(this->device, this->quadIndices, nullptr);
+
+		vkDestroyFence(this->device, this->fence, nullptr);
+		vkDestroyCommandPool(this->device, this->primaryPool, nullptr);
+		vkDestroyPipeline(this->device, this->pipeline, nullptr);
+		vkDestroyPipelineLayout(this->device, this->pipelineLayout, nullptr);
+		vkDestroyPipelineCache(this->device, this->pipelineCache, nullptr);
+		vkDestroyRenderPass(this->device, this->renderPass, nullptr);
+		this->bufferArena.destroy();
+		this->imageArena.destroy();
+		vkDestroyDevice(this->device, nullptr);
+		vkDestroyInstance(this->instance, nullptr);
+	}
+
+	bool init() {
+		VkApplicationInfo applicationInfo = {};
+		applicationInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+		applicationInfo.pApplicationName = "Mezzanine";
+		applicationInfo.apiVersion = VK_API_VERSION_1_0;
+
+		VkInstanceCreateInfo instanceInfo = {};
+		instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+		instanceInfo.pApplicationInfo = &applicationInfo;
+		if (!check(vkCreateInstance(&instanceInfo, nullptr, &this->instance), "vkCreateInstance"))
+			return false;
+
+		// The first device with a graphics queue, which is a CPU driver
+		// on machines without a GPU
+		uint32_t count = 0;
+		vkEnumeratePhysicalDevices(this->instance, &count, nullptr);
+		vector<VkPhysicalDevice> physicalDevices(count);
+		vkEnumeratePhysicalDevices(this->instance, &count, physicalDevices.data());
+
+		for (VkPhysicalDevice candidate : physicalDevices) {
+			uint32_t familyCount = 0;
+			vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, nullptr);
+			vector<VkQueueFamilyProperties> families(familyCount);
+			vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, families.data());
+
+			for (uint32_t i = 0; i < familyCount && this->physicalDevice == VK_NULL_HANDLE; i++) {
+				if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+					this->physicalDevice = candidate;
+					this->queueFamily = i;
+				}
+			}
+		}
+		if (this->physicalDevice == VK_NULL_HANDLE) {
+			cout << "Vulkan: no device with a graphics queue" << endl;
+			return false;
+		}
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(this->physicalDevice, &properties);
+		this->name = string("Vulkan (") + properties.deviceName + ")";
+
+		float priority = 1;
+		VkDeviceQueueCreateInfo queueInfo = {};
+		queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueInfo.queueFamilyIndex = this->queueFamily;
+		queueInfo.queueCount = 1;
+		queueInfo.pQueuePriorities = &priority;
+
+		VkDeviceCreateInfo deviceInfo = {};
+		deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		deviceInfo.queueCreateInfoCount = 1;
+		deviceInfo.pQueueCreateInfos = &queueInfo;
+		if (!check(vkCreateDevice(this->physicalDevice, &deviceInfo, nullptr, &this->device), "vkCreateDevice"))
+			return false;
+		vkGetDeviceQueue(this->device, this->queueFamily, 0, &this->queue);
+
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(this->physicalDevice, &memoryProperties);
+		this->bufferArena.init(this->device, memoryProperties, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		this->imageArena.init(this->device, memoryProperties, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (!createRenderPass() || !createPipeline())
+			return false;
+
+		// Shared by every draw: each run of 4 vertices is two triangles
+		vector<uint32_t> indices(GPU_BLOCK_VERTICES / 4 * 6);
+		for (uint32_t quad = 0; quad < GPU_BLOCK_VERTICES / 4; quad++) {
+			const uint32_t corners[6] = { 0, 1, 2, 0, 2, 3 };
+			for (int i = 0; i < 6; i++)
+				indices[quad * 6 + i] = quad * 4 + corners[i];
+		}
+		this->quadIndices = createBuffer(indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.data());
+		if (this->quadIndices == VK_NULL_HANDLE)
+			return false;
+
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = this->queueFamily;
+		if (!check(vkCreateCommandPool(this->device, &poolInfo, nullptr, &this->primaryPool), "vkCreateCommandPool"))
+			return false;
+
+		VkCommandBufferAllocateInfo allocateInfo = {};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocateInfo.commandPool = this->primaryPool;
+		allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocateInfo.commandBufferCount = 1;
+		if (!check(vkAllocateCommandBuffers(this->device, &allocateInfo, &this->primary), "vkAllocateCommandBuffers"))
+			return false;
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		return check(vkCreateFence(this->device, &fenceInfo, nullptr, &this->fence), "vkCreateFence");
+	}
+
+	const char* getName() const override {
+		return this->name.c_str();
+	}
+
+	RhiBuffer createVertexBuffer(const float* vertices, size_t vertexCount) override {
+		VkBuffer buffer = createBuffer(vertexCount * GPU_VERTEX_FLOATS * sizeof(float), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertices);
+		if (buffer == VK_NULL_HANDLE)
+			return 0;
+		this->buffers.push_back(buffer);
+		return (RhiBuffer)this->buffers.size();
+	}
+
+	void destroyBuffer(RhiBuffer buffer) override {
+		// The memory itself stays in the arena until the device goes
+		if (buffer == 0 || buffer > this->buffers.size() || this->buffers[buffer - 1] == VK_NULL_HANDLE)
+			return;
+		waitIdle();
+		vkDestroyBuffer(this->device, this->buffers[buffer - 1], nullptr);
+		this->buffers[buffer - 1] = VK_NULL_HANDLE;
+	}
+
+	void beginFrame(unsigned listCount, int width, int height) override {
+		waitIdle();
+		if (width != this->width || height != this->height)
+			createTargets(width, height);
+
+		while (this->lists.size() < listCount) {
+			unique_ptr<VulkanCommandList> list(new VulkanCommandList());
+			list->layout = this->pipelineLayout;
+			list->buffers = &this->buffers;
+
+			VkCommandPoolCreateInfo poolInfo = {};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			poolInfo.queueFamilyIndex = this->queueFamily;
+			check(vkCreateCommandPool(this->device, &poolInfo, nullptr, &list->pool), "vkCreateCommandPool");
+
+			VkCommandBufferAllocateInfo allocateInfo = {};
+			allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocateInfo.commandPool = list->pool;
+			allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocateInfo.commandBufferCount = 1;
+			check(vkAllocateCommandBuffers(this->device, &allocateInfo, &list->commands), "vkAllocateCommandBuffers");
+
+			this->lists.push_back(move(list));
+		}
+		this->listCount = listCount;
+
+		// Begun here so each list only needs its own thread from now on
+		VkCommandBufferInheritanceInfo inheritance = {};
+		inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritance.renderPass = this->renderPass;
+		inheritance.subpass = 0;
+		inheritance.framebuffer = this->framebuffer;
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritance;
+
+		VkViewport viewport = { 0, 0, (float)width, (float)height, 0, 1 };
+		VkRect2D scissor = { { 0, 0 }, { (uint32_t)width, (uint32_t)height } };
+
+		for (unsigned i = 0; i < listCount; i++) {
+			VulkanCommandList& list = *this->lists[i];
+			vkResetCommandPool(this->device, list.pool, 0);
+			vkBeginCommandBuffer(list.commands, &beginInfo);
+			vkCmdBindPipeline(list.commands, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipeline);
+			vkCmdSetViewport(list.commands, 0, 1, &viewport);
+			vkCmdSetScissor(list.commands, 0, 1, &scissor);
+			vkCmdBindIndexBuffer(list.commands, this->quadIndices, 0, VK_INDEX_TYPE_UINT32);
+		}
+	}
+
+	RhiCommandList& getCommandList(unsigned index) override {
+		return *this->lists[index];
+	}
+
+	void endFrame() override {
+		vector<VkCommandBuffer> secondaries;
+		for (unsigned i = 0; i < this->listCount; i++) {
+			vkEndCommandBuffer(this->lists[i]->commands);
+			secondaries.push_back(this->lists[i]->commands);
+		}
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(this->primary, &beginInfo);
+
+		VkClearValue clearValues[2];
+		clearValues[0].color.float32[0] = 0;
+		clearValues[0].color.float32[1] = 0;
+		clearValues[0].color.float32[2] = 0;
+		clearValues[0].color.float32[3] = 1;
+		clearValues[1].depthStencil.depth = 1;
+		clearValues[1].depthStencil.stencil = 0;
+
+		VkRenderPassBeginInfo passInfo = {};
+		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		passInfo.renderPass = this->renderPass;
+		passInfo.framebuffer = this->framebuffer;
+		passInfo.renderArea.extent.width = (uint32_t)this->width;
+		passInfo.renderArea.extent.height = (uint32_t)this->height;
+		passInfo.clearValueCount = 2;
+		passInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(this->primary, &passInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		if (!secondaries.empty())
+			vkCmdExecuteCommands(this->primary, (uint32_t)secondaries.size(), secondaries.data());
+		vkCmdEndRenderPass(this->primary);
+		vkEndCommandBuffer(this->primary);
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &this->primary;
+		this->submitted = check(vkQueueSubmit(this->queue, 1, &submitInfo, this->fence), "vkQueueSubmit");
+	}
+
+	void waitIdle() override {
+		if (!this->submitted)
+			return;
+		vkWaitForFences(this->device, 1, &this->fence, VK_TRUE, UINT64_MAX);
+		vkResetFences(this->device, 1, &this->fence);
+		this->submitted = false;
+	}
+
+private:
+	bool createRenderPass() {
+		VkAttachmentDescription attachments[2] = {};
+		attachments[0].format = COLOR_FORMAT;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		attachments[1].format = DEPTH_FORMAT;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorReference;
+		subpass.pDepthStencilAttachment = &depthReference;
+
+		VkRenderPassCreateInfo passInfo = {};
+		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		passInfo.attachmentCount = 2;
+		passInfo.pAttachments = attachments;
+		passInfo.subpassCount = 1;
+		passInfo.pSubpasses = &subpass;
+		return check(vkCreateRenderPass(this->device, &passInfo, nullptr, &this->renderPass), "vkCreateRenderPass");
+	}
+
+	bool createPipeline() {
+		// Pipelines compiled by earlier runs come back from disk
+		vector<char> cacheData;
+		FILE* file = fopen(VULKAN_PIPELINE_CACHE, "rb");
+		if (file) {
+			char chunk[4096];
+			size_t read;
+			while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+				cacheData.insert(cacheData.end(), chunk, chunk + read);
+			fclose(file);
+		}
+
+		VkPipelineCacheCreateInfo cacheInfo = {};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = cacheData.size();
+		cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+		if (vkCreatePipelineCache(this->device, &cacheInfo, nullptr, &this->pipelineCache) != VK_SUCCESS) {
+			// Data from another driver or version, start over
+			cacheInfo.initialDataSize = 0;
+			cacheInfo.pInitialData = nullptr;
+			if (!check(vkCreatePipelineCache(this->device, &cacheInfo, nullptr, &this->pipelineCache), "vkCreatePipelineCache"))
+				return false;
+		}
+
+		VkPushConstantRange pushConstants = { VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants) };
+		VkPipelineLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstants;
+		if (!check(vkCreatePipelineLayout(this->device, &layoutInfo, nullptr, &this->pipelineLayout), "vkCreatePipelineLayout"))
+			return false;
+
+		VkShaderModule vertexModule = createShaderModule(vertexSpirv, sizeof(vertexSpirv));
+		VkShaderModule fragmentModule = createShaderModule(fragmentSpirv, sizeof(fragmentSpirv));
+
+		VkPipelineShaderStageCreateInfo stages[2] = {};
+		stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		stages[0].module = vertexModule;
+		stages[0].pName = "main";
+		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		stages[1].module = fragmentModule;
+		stages[1].pName = "main";
+
+		// GpuMesh's layout, of which only the position is used
+		VkVertexInputBindingDescription binding = { 0, GPU_VERTEX_FLOATS * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX };
+		VkVertexInputAttributeDescription position = { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 };
+		VkPipelineVertexInputStateCreateInfo vertexInput = {};
+		vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInput.vertexBindingDescriptionCount = 1;
+		vertexInput.pVertexBindingDescriptions = &binding;
+		vertexInput.vertexAttributeDescriptionCount = 1;
+		vertexInput.pVertexAttributeDescriptions = &position;
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+		VkPipelineViewportStateCreateInfo viewport = {};
+		viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewport.viewportCount = 1;
+		viewport.scissorCount = 1;
+
+		VkPipelineRasterizationStateCreateInfo rasterization = {};
+		rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterization.cullMode = VK_CULL_MODE_NONE;
+		rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		rasterization.lineWidth = 1;
+
+		VkPipelineMultisampleStateCreateInfo multisample = {};
+		multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencil.depthTestEnable = VK_TRUE;
+		depthStencil.depthWriteEnable = VK_TRUE;
+		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+		VkPipelineColorBlendAttachmentState blendAttachment = {};
+		blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		VkPipelineColorBlendStateCreateInfo blend = {};
+		blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		blend.attachmentCount = 1;
+		blend.pAttachments = &blendAttachment;
+
+		VkDynamicState dynamicStates[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamic = {};
+		dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamic.dynamicStateCount = 2;
+		dynamic.pDynamicStates = dynamicStates;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = stages;
+		pipelineInfo.pVertexInputState = &vertexInput;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pViewportState = &viewport;
+		pipelineInfo.pRasterizationState = &rasterization;
+		pipelineInfo.pMultisampleState = &multisample;
+		pipelineInfo.pDepthStencilState = &depthStencil;
+		pipelineInfo.pColorBlendState = &blend;
+		pipelineInfo.pDynamicState = &dynamic;
+		pipelineInfo.layout = this->pipelineLayout;
+		pipelineInfo.renderPass = this->renderPass;
+		pipelineInfo.subpass = 0;
+
+		bool created = vertexModule != VK_NULL_HANDLE && fragmentModule != VK_NULL_HANDLE
+			&& check(vkCreateGraphicsPipelines(this->device, this->pipelineCache, 1, &pipelineInfo, nullptr, &this->pipeline), "vkCreateGraphicsPipelines");
+
+		vkDestroyShaderModule(this->device, vertexModule, nullptr);
+		vkDestroyShaderModule(this->device, fragmentModule, nullptr);
+		return created;
+	}
+
+	VkShaderModule createShaderModule(const uint32_t* code, size_t bytes) {
+		VkShaderModuleCreateInfo moduleInfo = {};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = bytes;
+		moduleInfo.pCode = code;
+
+		VkShaderModule module = VK_NULL_HANDLE;
+		check(vkCreateShaderModule(this->device, &moduleInfo, nullptr, &module), "vkCreateShaderModule");
+		return module;
+	}
+
+	void savePipelineCache() {
+		size_t size = 0;
+		if (this->pipelineCache == VK_NULL_HANDLE || vkGetPipelineCacheData(this->device, this->pipelineCache, &size, nullptr) != VK_SUCCESS)
+			return;
+
+		vector<char> data(size);
+		if (vkGetPipelineCacheData(this->device, this->pipelineCache, &size, data.data()) != VK_SUCCESS)
+			return;
+
+		FILE* file = fopen(VULKAN_PIPELINE_CACHE, "wb");
+		if (file) {
+			fwrite(data.data(), 1, size, file);
+			fclose(file);
+		}
+	}
+
+	// Host visible buffer holding a copy of data
+	VkBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const void* data) {
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer buffer;
+		if (!check(vkCreateBuffer(this->device, &bufferInfo, nullptr, &buffer), "vkCreateBuffer"))
+			return VK_NULL_HANDLE;
+
+		VkMemoryRequirements requirements;
+		vkGetBufferMemoryRequirements(this->device, buffer, &requirements);
+
+		VkDeviceMemory memory;
+		VkDeviceSize offset;
+		void* mapped;
+		if (!this->bufferArena.allocate(requirements, memory, offset, &mapped)) {
+			vkDestroyBuffer(this->device, buffer, nullptr);
+			return VK_NULL_HANDLE;
+		}
+
+		vkBindBufferMemory(this->device, buffer, memory, offset);
+		memcpy(mapped, data, (size_t)size);
+		return buffer;
+	}
+
+	VkImageView createImage(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, VkImage& image) {
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = format;
+		imageInfo.extent.width = (uint32_t)this->width;
+		imageInfo.extent.height = (uint32_t)this->height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = usage;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		check(vkCreateImage(this->device, &imageInfo, nullptr, &image), "vkCreateImage");
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(this->device, image, &requirements);
+		VkDeviceMemory memory;
+		VkDeviceSize offset;
+		this->imageArena.allocate(requirements, memory, offset, nullptr);
+		vkBindImageMemory(this->device, image, memory, offset);
+
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange.aspectMask = aspect;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		VkImageView view = VK_NULL_HANDLE;
+		check(vkCreateImageView(this->device, &viewInfo, nullptr, &view), "vkCreateImageView");
+		return view;
+	}
+
+	void createTargets(int width, int height) {
+		destroyTargets();
+		this->width = width;
+		this->height = height;
+
+		this->colorView = createImage(COLOR_FORMAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT, this->colorImage);
+		this->depthView = createImage(DEPTH_FORMAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, this->depthImage);
+
+		VkImageView views[2] = { this->colorView, this->depthView };
+		VkFramebufferCreateInfo framebufferInfo = {};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = this->renderPass;
+		framebufferInfo.attachmentCount = 2;
+		framebufferInfo.pAttachments = views;
+		framebufferInfo.width = (uint32_t)width;
+		framebufferInfo.height = (uint32_t)height;
+		framebufferInfo.layers = 1;
+		check(vkCreateFramebuffer(this->device, &framebufferInfo, nullptr, &this->framebuffer), "vkCreateFramebuffer");
+	}
+
+	void destroyTargets() {
+		vkDeviceWaitIdle(this->device);
+		if (this->framebuffer != VK_NULL_HANDLE)
+			vkDestroyFramebuffer(this->device, this->framebuffer, nullptr);
+		if (this->colorView != VK_NULL_HANDLE)
+			vkDestroyImageView(this->device, this->colorView, nullptr);
+		if (this->depthView != VK_NULL_HANDLE)
+			vkDestroyImageView(this->device, this->depthView, nullptr);
+		if (this->colorImage != VK_NULL_HANDLE)
+			vkDestroyImage(this->device, this->colorImage, nullptr);
+		if (this->depthImage != VK_NULL_HANDLE)
+			vkDestroyImage(this->device, this->depthImage, nullptr);
+
+		// Targets are the only thing in the image arena
+		this->imageArena.reset();
+		this->framebuffer = VK_NULL_HANDLE;
+		this->colorView = this->depthView = VK_NULL_HANDLE;
+		this->colorImage = this->depthImage = VK_NULL_HANDLE;
+		this->width = this->height = 0;
+	}
+
+	string name;
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	uint32_t queueFamily = 0;
+	VulkanArena bufferArena, imageArena;
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	VkImage colorImage = VK_NULL_HANDLE, depthImage = VK_NULL_HANDLE;
+	VkImageView colorView = VK_NULL_HANDLE, depthView = VK_NULL_HANDLE;
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	int width = 0, height = 0;
+
+	VkBuffer quadIndices = VK_NULL_HANDLE;
+	vector<VkBuffer> buffers; // RhiBuffer n is buffers[n - 1]
+
+	VkCommandPool primaryPool = VK_NULL_HANDLE;
+	VkCommandBuffer primary = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	bool submitted = false;
+	vector<unique_ptr<VulkanCommandList>> lists;
+	unsigned listCount = 0;
+};
+
+unique_ptr<RenderDevice> createVulkanRenderDevice() {
+	unique_ptr<VulkanRenderDevice> device(new VulkanRenderDevice());
+	if (!device->init())
+		return nullptr;
+	return device;
+}
+
+#else
+
+std::unique_ptr<RenderDevice> createVulkanRenderDevice() {
+	return nullptr;
+}
+
+#endif
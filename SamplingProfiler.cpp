@@ -0,0 +1,254 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "SamplingProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/time.h>
+#endif
+
+using namespace std;
+
+// Frames of the signal handler and the kernel's return trampoline
+#define PROFILER_SKIPPED_FRAMES 2
+
+struct Sample {
+	atomic<bool> ready;
+	const char* phase;
+	const char* thread;
+	int depth;
+	void* frames[PROFILER_MAX_DEPTH];
+};
+
+// Shared with the signal handler, so only atomics and plain pointers
+static Sample* samples = nullptr;
+static atomic<size_t> nextSample{ 0 };
+static atomic<size_t> droppedSamples{ 0 };
+static atomic<bool> collecting{ false };
+static atomic<int> handlersRunning{ 0 };
+static atomic<const char*> framePhase{ "none" };
+static thread_local const char* threadName = "thread";
+
+static bool running = false;
+
+SamplingProfiler& getProfiler() {
+	static SamplingProfiler profiler;
+	return profiler;
+}
+
+void setProfilerPhase(const char* phase) {
+	framePhase.store(phase, memory_order_relaxed);
+}
+
+const char* internProfilerPhase(const string& name) {
+	static mutex internMutex;
+	static set<string> names;
+	lock_guard<mutex> lock(internMutex);
+	// Elements of a set never move
+	return names.insert(name).first->c_str();
+}
+
+void setProfilerThreadName(const char* name) {
+	threadName = name;
+}
+
+#ifndef _WIN32
+
+static void handleProfilingSignal(int signal, siginfo_t* info, void* context) {
+	int savedErrno = errno;
+
+	// Counted before checking, so a writer that stopped collecting can
+	// wait for every handler that might still be filling a slot
+	handlersRunning.fetch_add(1);
+	if (collecting.load()) {
+		size_t index = nextSample.fetch_add(1, memory_order_relaxed);
+		if (index < PROFILER_MAX_SAMPLES) {
+			Sample& sample = samples[index];
+			sample.depth = backtrace(sample.frames, PROFILER_MAX_DEPTH);
+			sample.phase = framePhase.load(memory_order_relaxed);
+			sample.thread = threadName;
+			sample.ready.store(true, memory_order_release);
+		}
+		else
+			droppedSamples.fetch_add(1, memory_order_relaxed);
+	}
+	handlersRunning.fetch_sub(1);
+
+	errno = savedErrno;
+}
+
+static bool setTimer(int hz) {
+	itimerval timer = {};
+	if (hz > 0) {
+		timer.it_interval.tv_usec = max(1, 1000000 / hz);
+		timer.it_value = timer.it_interval;
+	}
+	return setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+}
+
+static void pauseSampling() {
+	collecting.store(false);
+	while (handlersRunning.load() != 0)
+		this_thread::yield();
+}
+
+// The function's name without its parameters, or where it lies in its module
+static string symbolize(void* address) {
+	Dl_info info;
+	if (!dladdr(address, &info)) {
+		stringstream text;
+		text << address;
+		return text.str();
+	}
+
+	if (!info.dli_sname) {
+		string module = info.dli_fname ? info.dli_fname : "?";
+		module = module.substr(module.find_last_of("/\\") + 1);
+		stringstream text;
+		text << module << "+0x" << hex << (uintptr_t)address - (uintptr_t)info.dli_fbase;
+		return text.str();
+	}
+
+	int status = 0;
+	char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+	string name = status == 0 && demangled ? demangled : info.dli_sname;
+	free(demangled);
+
+	// Cut the parameter list, matching parentheses back from the end
+	// so operator() keeps its own
+	if (!name.empty() && name.back() == ')') {
+		int depth = 0;
+		for (size_t i = name.size(); i-- > 0;) {
+			depth += name[i] == ')' ? 1 : name[i] == '(' ? -1 : 0;
+			if (depth == 0) {
+				name.resize(i);
+				break;
+			}
+		}
+	}
+	replace(name.begin(), name.end(), ';', ':');
+	return name;
+}
+
+bool SamplingProfiler::start(int hz) {
+	if (running || hz <= 0)
+		return false;
+
+	if (!samples)
+		samples = new Sample[PROFILER_MAX_SAMPLES]();
+
+	// The first backtrace loads the unwinder, which must not happen in the handler
+	void* warmUp[4];
+	backtrace(warmUp, 4);
+
+	// Left installed after stopping: the default action for a SIGPROF
+	// still pending would end the process
+	struct sigaction action = {};
+	action.sa_sigaction = handleProfilingSignal;
+	action.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGPROF, &action, nullptr) != 0)
+		return false;
+
+	collecting.store(true);
+	if (!setTimer(hz)) {
+		collecting.store(false);
+		return false;
+	}
+	running = true;
+	return true;
+}
+
+void SamplingProfiler::stop() {
+	if (!running)
+		return;
+	setTimer(0);
+	pauseSampling();
+	running = false;
+}
+
+bool SamplingProfiler::writeFolded(const string& filename) {
+	if (!samples)
+		return false;
+	pauseSampling();
+
+	size_t count = min(nextSample.load(), (size_t)PROFILER_MAX_SAMPLES);
+	map<string, size_t> stacks;
+	map<void*, string> names;
+	for (size_t i = 0; i < count; i++) {
+		Sample& sample = samples[i];
+		if (!sample.ready.load(memory_order_acquire))
+			continue;
+
+		string stack = string(sample.phase) + ";" + sample.thread;
+		for (int frame = sample.depth - 1; frame >= PROFILER_SKIPPED_FRAMES; frame--) {
+			// Callers' addresses are where they return to, possibly the
+			// next function, so they are looked up a byte earlier
+			void* address = sample.frames[frame];
+			if (frame > PROFILER_SKIPPED_FRAMES)
+				address = (char*)address - 1;
+			auto name = names.find(address);
+			if (name == names.end())
+				name = names.insert({ address, symbolize(address) }).first;
+			stack += ";" + name->second;
+		}
+		stacks[stack]++;
+		sample.ready.store(false, memory_order_relaxed);
+	}
+
+	nextSample.store(0);
+	droppedSamples.store(0);
+	collecting.store(running);
+
+	ofstream file(filename, ofstream::out | ofstream::trunc);
+	if (!file.is_open())
+		return false;
+	for (const auto& stack : stacks)
+		file << stack.first << " " << stack.second << "\n";
+	return (bool)file;
+}
+
+#else
+
+bool SamplingProfiler::start(int hz) {
+	return false;
+}
+
+void SamplingProfiler::stop() {
+}
+
+bool SamplingProfiler::writeFolded(const string& filename) {
+	return false;
+}
+
+#endif
+
+bool SamplingProfiler::isRunning() const {
+	return running;
+}
+
+size_t SamplingProfiler::getSampleCount() const {
+	return min(nextSample.load(), (size_t)PROFILER_MAX_SAMPLES);
+}
+
+size_t SamplingProfiler::getDroppedCount() const {
+	return droppedSamples.load();
+}
@@ -0,0 +1,52 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#define PROFILER_DEFAULT_HZ 1000
+// Samples kept between two writes, later ones are counted and dropped
+#define PROFILER_MAX_SAMPLES (1 << 15)
+#define PROFILER_MAX_DEPTH 32
+
+// In-process sampling profiler, for machines perf cannot be attached to.
+// A CPU time interval timer (SIGPROF) interrupts whichever thread is
+// running; the handler copies its call stack, the current frame phase
+// and the thread's name into a preallocated slot claimed with one
+// atomic increment, so it never locks or allocates. Writing aggregates
+// the slots into folded stacks for flamegraph.pl or speedscope.
+// The kernel checks the timer on its scheduler tick, so rates above
+// CONFIG_HZ per core come out lower than asked for.
+// POSIX only: start() returns false on Windows.
+class SamplingProfiler {
+public:
+	// Returns false where unsupported or if already running
+	bool start(int hz);
+	void stop();
+	bool isRunning() const;
+
+	// Writes every sample taken since start or the last write, one
+	// "phase;thread;outermost;...;innermost count" line per distinct
+	// stack, and clears them. Sampling pauses while writing. Functions
+	// the dynamic linker has no name for are written as module+offset,
+	// for addr2line; linking with -rdynamic names them all.
+	bool writeFolded(const std::string& filename);
+
+	size_t getSampleCount() const;
+	size_t getDroppedCount() const;
+};
+
+SamplingProfiler& getProfiler();
+
+// What the frame is doing, such as a render graph pass, given to every
+// sample from now on whichever thread it lands on. phase must outlive
+// the profiler: a literal or a string from internProfilerPhase().
+void setProfilerPhase(const char* phase);
+// A copy of name kept for good, the same pointer for equal names
+const char* internProfilerPhase(const std::string& name);
+// The calling thread's name in its samples, a literal. Defaults to "thread".
+void setProfilerThreadName(const char* name);
@@ -0,0 +1,107 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Shader.h"
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+static string getShaderLog(GLuint shader) {
+	GLint length = 0;
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+	string log(length > 0 ? length : 1, '\0');
+	glGetShaderInfoLog(shader, (GLsizei)log.size(), nullptr, &log[0]);
+	return log;
+}
+
+static string getProgramLog(GLuint program) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+	string log(length > 0 ? length : 1, '\0');
+	glGetProgramInfoLog(program, (GLsizei)log.size(), nullptr, &log[0]);
+	return log;
+}
+
+static GLuint compile(const char* name, GLenum type, const char* source) {
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+
+	GLint compiled = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+	if (!compiled) {
+		cout << "Shader " << name << " (" << (type == GL_VERTEX_SHADER ? "vertex" : "fragment")
+			<< ") failed to compile:" << endl << getShaderLog(shader) << endl;
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+Shader::Shader() {
+}
+
+Shader::~Shader() {
+	if (this->program != 0)
+		glDeleteProgram(this->program);
+}
+
+bool Shader::build(const char* name, const char* vertexSource, const char* fragmentSource, const vector<const char*>& attributes) {
+	if (!hasShaders())
+		return false;
+
+	GLuint vertex = compile(name, GL_VERTEX_SHADER, vertexSource);
+	GLuint fragment = compile(name, GL_FRAGMENT_SHADER, fragmentSource);
+	if (vertex == 0 || fragment == 0) {
+		if (vertex != 0)
+			glDeleteShader(vertex);
+		if (fragment != 0)
+			glDeleteShader(fragment);
+		return false;
+	}
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	for (size_t i = 0; i < attributes.size(); i++)
+		glBindAttribLocation(program, (GLuint)i, attributes[i]);
+	glLinkProgram(program);
+
+	// The program keeps them alive while it needs them
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		cout << "Shader " << name << " failed to link:" << endl << getProgramLog(program) << endl;
+		glDeleteProgram(program);
+		return false;
+	}
+
+	if (this->program != 0)
+		glDeleteProgram(this->program);
+	this->program = program;
+	return true;
+}
+
+void Shader::use() const {
+	glUseProgram(this->program);
+}
+
+GLint Shader::uniform(const char* name) const {
+	return glGetUniformLocation(this->program, name);
+}
+
+bool Shader::isValid() const {
+	return this->program != 0;
+}
+
+GLuint Shader::getProgram() const {
+	return this->program;
+}
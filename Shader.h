@@ -0,0 +1,34 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <vector>
+#include "GLExtensions.h"
+
+// GLSL program made of one vertex and one fragment shader.
+// Shaders target GLSL 1.30 in the compatibility profile, so they can
+// read the fixed function state (matrices, lights, gl_Vertex...) that
+// the rest of the renderer sets up.
+class Shader {
+public:
+	Shader();
+	~Shader();
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+
+	// Compiles and links, printing the driver's log under name on failure.
+	// Vertex attributes named in attributes get locations 0, 1, 2...
+	bool build(const char* name, const char* vertexSource, const char* fragmentSource, const std::vector<const char*>& attributes = {});
+
+	void use() const;
+	GLint uniform(const char* name) const;
+
+	bool isValid() const;
+	GLuint getProgram() const;
+
+private:
+	GLuint program = 0;
+};
@@ -0,0 +1,55 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread
+// and one consumer thread. Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class SpscQueue {
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	// Producer side. Returns false if the queue is full.
+	bool tryPush(T&& value) {
+		size_t tail = this->tail.load(std::memory_order_relaxed);
+		if (tail - this->head.load(std::memory_order_acquire) == Capacity)
+			return false;
+
+		this->items[tail & (Capacity - 1)] = std::move(value);
+		this->tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side. Returns false if the queue is empty.
+	bool tryPop(T& value) {
+		size_t head = this->head.load(std::memory_order_relaxed);
+		if (head == this->tail.load(std::memory_order_acquire))
+			return false;
+
+		value = std::move(this->items[head & (Capacity - 1)]);
+		this->head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Approximate when called while the other side is active
+	size_t size() const {
+		return this->tail.load(std::memory_order_acquire) - this->head.load(std::memory_order_acquire);
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+private:
+	// Kept on separate cache lines so both threads don't fight over them
+	alignas(64) std::atomic<size_t> head{ 0 };
+	alignas(64) std::atomic<size_t> tail{ 0 };
+	T items[Capacity];
+};
@@ -0,0 +1,135 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Streaming.h"
+
+#include <algorithm>
+#include <cmath>
+#include "Tunables.h"
+
+using namespace std;
+
+Tunable<int> streamingUploadFaces("streaming.upload_faces", STREAMING_UPLOAD_FACES, 1, 1 << 24,
+	"Faces uploaded per frame, at least one batch going up regardless");
+
+////////////////////
+// CameraPredictor
+void CameraPredictor::addPortal(const Bounds& trigger, const Point3& destination) {
+	this->portals.push_back({ trigger, destination });
+}
+
+void CameraPredictor::update(const Point3& eye, const Point3& forward, float deltaSeconds) {
+	if (this->hasEye && deltaSeconds > 0) {
+		Point3 moved = eye - this->eye;
+		if (length(moved) > STREAMING_TELEPORT_DISTANCE) {
+			this->velocity = Point3();
+		}
+		else {
+			float blend = 1 - expf(-deltaSeconds / STREAMING_VELOCITY_SMOOTHING);
+			this->velocity = this->velocity + (moved * (1 / deltaSeconds) - this->velocity) * blend;
+		}
+	}
+	this->eye = eye;
+	this->forward = normalize(forward);
+	this->hasEye = true;
+
+	// Steps along the velocity, jumping through any trigger crossed
+	// the way teleportIfNecessary() moves the camera
+	this->path.clear();
+	this->path.push_back(eye);
+	Point3 predicted = eye;
+	Point3 step = this->velocity * (STREAMING_PREDICT_SECONDS / STREAMING_PREDICT_STEPS);
+	for (int i = 0; i < STREAMING_PREDICT_STEPS; i++) {
+		predicted = predicted + step;
+		for (const Portal& portal : this->portals) {
+			if (contains(portal.trigger, predicted)) {
+				predicted = portal.destination;
+				break;
+			}
+		}
+		this->path.push_back(predicted);
+	}
+}
+
+const vector<Point3>& CameraPredictor::getPath() const {
+	return this->path;
+}
+
+const Point3& CameraPredictor::getForward() const {
+	return this->forward;
+}
+
+const Point3& CameraPredictor::getVelocity() const {
+	return this->velocity;
+}
+
+float CameraPredictor::score(const Bounds& bounds) const {
+	if (this->path.empty())
+		return 0;
+
+	Point3 center = bounds.getCenter();
+	float best = INFINITY;
+	bool inFront = false;
+	for (const Point3& eye : this->path) {
+		Point3 lookedAt = eye + this->forward * STREAMING_LOOK_DISTANCE;
+		for (const Point3& point : { eye, lookedAt }) {
+			// Distance to the box, 0 inside it
+			Point3 outside(
+				max(max(bounds.min.x - point.x, point.x - bounds.max.x), 0.0f),
+				max(max(bounds.min.y - point.y, point.y - bounds.max.y), 0.0f),
+				max(max(bounds.min.z - point.z, point.z - bounds.max.z), 0.0f));
+			best = min(best, length(outside));
+		}
+		if (dot(center - eye, this->forward) >= 0 || contains(bounds, eye))
+			inFront = true;
+	}
+	return inFront ? best : best + STREAMING_BEHIND_PENALTY;
+}
+
+bool CameraPredictor::contains(const Bounds& bounds, const Point3& point) {
+	return point.x >= bounds.min.x && point.x <= bounds.max.x
+		&& point.y >= bounds.min.y && point.y <= bounds.max.y
+		&& point.z >= bounds.min.z && point.z <= bounds.max.z;
+}
+
+///////////////////////
+// StreamingScheduler
+void StreamingScheduler::addLoader(ProgressiveLoader* loader) {
+	this->loaders.push_back(loader);
+}
+
+bool StreamingScheduler::update(const CameraPredictor& predictor) {
+	bool parsing = false;
+	for (ProgressiveLoader* loader : this->loaders) {
+		this->received.clear();
+		if (loader->receivePending(this->received))
+			parsing = true;
+		for (ProgressiveLoader::Batch& batch : this->received)
+			this->pending.push_back({ loader, move(batch), 0 });
+	}
+
+	// The prediction moves every frame, so every request is rescored
+	for (Request& request : this->pending)
+		request.score = predictor.score(request.batch.bounds);
+
+	// Most urgent last, so uploaded ones come off the back
+	sort(this->pending.begin(), this->pending.end(), [](const Request& a, const Request& b) {
+		return a.score > b.score;
+	});
+
+	size_t faces = 0;
+	while (!this->pending.empty() && faces < (size_t)streamingUploadFaces) {
+		Request& request = this->pending.back();
+		request.loader->upload(request.batch);
+		faces += request.batch.positions.size() / 4;
+		this->pending.pop_back();
+	}
+
+	return parsing || !this->pending.empty();
+}
+
+size_t StreamingScheduler::getPendingCount() const {
+	return this->pending.size();
+}
@@ -0,0 +1,85 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <vector>
+#include "GeometryStreams.h"
+#include "ProgressiveLoader.h"
+
+// How far ahead the camera is predicted, and in how many steps
+#define STREAMING_PREDICT_SECONDS 0.4f
+#define STREAMING_PREDICT_STEPS 4
+// Time constant of the velocity smoothing, in seconds
+#define STREAMING_VELOCITY_SMOOTHING 0.25f
+// Moves longer than this in one update are teleports, not velocity
+#define STREAMING_TELEPORT_DISTANCE 3.0f
+// How far along the look direction each predicted eye is looking
+#define STREAMING_LOOK_DISTANCE 4.0f
+// Extra distance given to geometry behind every predicted view
+#define STREAMING_BEHIND_PENALTY 8.0f
+// Faces uploaded per frame by default, tunable as streaming.upload_faces
+#define STREAMING_UPLOAD_FACES (4 * PROGRESSIVE_BATCH_FACES)
+
+// Guesses where the camera will be a moment from now from how fast it
+// has been moving and where it looks. Walking into one of the stairs'
+// teleport triggers carries the prediction over to the other floor.
+class CameraPredictor {
+public:
+	// Eye positions within trigger end up at destination
+	void addPortal(const Bounds& trigger, const Point3& destination);
+
+	// Once a frame, with the world space eye and look direction
+	void update(const Point3& eye, const Point3& forward, float deltaSeconds);
+
+	// The eye now, then STREAMING_PREDICT_STEPS predicted positions
+	const std::vector<Point3>& getPath() const;
+	const Point3& getForward() const;
+	const Point3& getVelocity() const;
+
+	// Lower is needed sooner: distance from the box to the closest
+	// predicted eye or point looked at, penalized if behind all of them
+	float score(const Bounds& bounds) const;
+
+private:
+	struct Portal {
+		Bounds trigger;
+		Point3 destination;
+	};
+
+	static bool contains(const Bounds& bounds, const Point3& point);
+
+	std::vector<Portal> portals;
+	std::vector<Point3> path;
+	Point3 eye, forward, velocity;
+	bool hasEye = false;
+};
+
+// Uploads what the loaders have parsed in the order the camera is going
+// to need it instead of the order it sits in the files. Batches waiting
+// for upload are rescored every frame, so they follow the prediction as
+// it changes, and only the most urgent go up within the frame's budget.
+class StreamingScheduler {
+public:
+	void addLoader(ProgressiveLoader* loader);
+
+	// Render thread, once a frame. Returns true while there is still
+	// more to parse or upload.
+	bool update(const CameraPredictor& predictor);
+
+	// Batches parsed but not uploaded yet
+	size_t getPendingCount() const;
+
+private:
+	struct Request {
+		ProgressiveLoader* loader;
+		ProgressiveLoader::Batch batch;
+		float score;
+	};
+
+	std::vector<ProgressiveLoader*> loaders;
+	std::vector<Request> pending;
+	std::vector<ProgressiveLoader::Batch> received;
+};
@@ -0,0 +1,282 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Transparency.h"
+
+#include <cmath>
+#include "FrameStats.h"
+
+using namespace std;
+
+#define PANEL_VERTEX_BYTES (PANEL_VERTEX_FLOATS * sizeof(float))
+
+/////////////////////
+// TransparentPanels
+
+TransparentPanels::TransparentPanels() {
+}
+
+TransparentPanels::~TransparentPanels() {
+	if (this->buffer != 0)
+		glDeleteBuffers(1, &this->buffer);
+}
+
+void TransparentPanels::addPanel(const Point3& a, const Point3& b, const Point3& c, const Point3& d, const float color[4]) {
+	// Flat normal from the diagonals
+	Point3 u(c.x - a.x, c.y - a.y, c.z - a.z);
+	Point3 v(d.x - b.x, d.y - b.y, d.z - b.z);
+	Point3 normal(u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x);
+	float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+	if (length > 0)
+		normal = Point3(normal.x / length, normal.y / length, normal.z / length);
+
+	for (const Point3* corner : { &a, &b, &c, &d }) {
+		float vertex[PANEL_VERTEX_FLOATS] = {
+			corner->x, corner->y, corner->z,
+			normal.x, normal.y, normal.z,
+			color[0], color[1], color[2], color[3]
+		};
+		this->vertices.insert(this->vertices.end(), vertex, vertex + PANEL_VERTEX_FLOATS);
+	}
+
+	this->dirty = true;
+}
+
+void TransparentPanels::clear() {
+	this->vertices.clear();
+	this->uploadedVertices = 0;
+	this->dirty = true;
+}
+
+void TransparentPanels::upload() {
+	if (!this->dirty || !hasBufferObjects())
+		return;
+
+	if (this->buffer == 0)
+		glGenBuffers(1, &this->buffer);
+
+	size_t vertexCount = this->vertices.size() / PANEL_VERTEX_FLOATS;
+	glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * PANEL_VERTEX_BYTES, this->vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	this->uploadedVertices = vertexCount;
+	this->dirty = false;
+}
+
+void TransparentPanels::draw() const {
+	const float* base = nullptr;
+	size_t vertexCount;
+
+	if (this->buffer != 0 && !this->dirty) {
+		glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+		vertexCount = this->uploadedVertices;
+	}
+	else {
+		// Not uploaded yet, or no buffer objects at all
+		base = this->vertices.data();
+		vertexCount = this->vertices.size() / PANEL_VERTEX_FLOATS;
+	}
+
+	if (vertexCount == 0)
+		return;
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+
+	glVertexPointer(3, GL_FLOAT, PANEL_VERTEX_BYTES, base);
+	glNormalPointer(GL_FLOAT, PANEL_VERTEX_BYTES, base + 3);
+	glColorPointer(4, GL_FLOAT, PANEL_VERTEX_BYTES, base + 6);
+	glDrawArrays(GL_QUADS, 0, (GLsizei)vertexCount);
+	countDrawCalls();
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	if (base == nullptr)
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+size_t TransparentPanels::getPanelCount() const {
+	return this->vertices.size() / (PANEL_VERTEX_FLOATS * 4);
+}
+
+//////////////////////
+// WeightedBlendedOIT
+
+// Lit like the opaque geometry: light 0 and the scene's ambient term
+static const char* accumulateVertex = R"(
+#version 130
+out vec3 eyePosition;
+out vec3 eyeNormal;
+out vec4 color;
+void main() {
+	vec4 position = gl_ModelViewMatrix * gl_Vertex;
+	eyePosition = position.xyz;
+	eyeNormal = gl_NormalMatrix * gl_Normal;
+	color = gl_Color;
+	gl_Position = gl_ProjectionMatrix * position;
+}
+)";
+
+static const char* accumulateFragment = R"(
+#version 130
+in vec3 eyePosition;
+in vec3 eyeNormal;
+in vec4 color;
+void main() {
+	vec3 n = normalize(eyeNormal);
+	if (!gl_FrontFacing)
+		n = -n;
+
+	vec3 l = normalize(gl_LightSource[0].position.xyz - eyePosition * gl_LightSource[0].position.w);
+	vec3 v = normalize(-eyePosition);
+	vec3 h = normalize(l + v);
+	float diffuse = max(dot(n, l), 0.0);
+	float specular = diffuse > 0.0 ? pow(max(dot(n, h), 0.0), 60.0) : 0.0;
+
+	vec3 lit = color.rgb * (gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb + gl_LightSource[0].diffuse.rgb * diffuse)
+		+ gl_LightSource[0].specular.rgb * specular;
+
+	// Depth weight from the paper's equation 7, favoring near surfaces
+	float z = -eyePosition.z;
+	float a = color.a;
+	float w = a * clamp(10.0 / (1e-5 + pow(z / 5.0, 2.0) + pow(z / 200.0, 6.0)), 1e-2, 3e3);
+
+	gl_FragData[0] = vec4(lit * a * w, a);
+	gl_FragData[1] = vec4(a * w);
+}
+)";
+
+static const char* compositeVertex = R"(
+#version 130
+void main() {
+	gl_Position = gl_Vertex;
+}
+)";
+
+static const char* compositeFragment = R"(
+#version 130
+uniform sampler2D accumulation;
+uniform sampler2D weights;
+void main() {
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	vec4 accum = texelFetch(accumulation, texel, 0);
+	float revealage = accum.a;
+	if (revealage >= 1.0)
+		discard;
+
+	float weightSum = texelFetch(weights, texel, 0).r;
+	gl_FragColor = vec4(accum.rgb / max(weightSum, 1e-5), 1.0 - revealage);
+}
+)";
+
+WeightedBlendedOIT::WeightedBlendedOIT() {
+}
+
+bool WeightedBlendedOIT::init() {
+	this->supported = hasFramebuffers() && hasShaders()
+		&& this->accumulateShader.build("oit accumulate", accumulateVertex, accumulateFragment)
+		&& this->compositeShader.build("oit composite", compositeVertex, compositeFragment);
+
+	if (this->supported) {
+		this->compositeShader.use();
+		glUniform1i(this->compositeShader.uniform("accumulation"), 0);
+		glUniform1i(this->compositeShader.uniform("weights"), 1);
+		glUseProgram(0);
+	}
+
+	return this->supported;
+}
+
+GraphTexture WeightedBlendedOIT::addPasses(RenderGraph& graph, const TransparentPanels& panels, GraphTexture sceneColor, GraphTexture sceneDepth) {
+	if (panels.getPanelCount() == 0)
+		return sceneColor;
+
+	if (!this->supported) {
+		// Unsorted blending: wrong where panels overlap, but visible
+		graph.addPass("transparency", [&](RenderPassBuilder& pass) {
+			sceneColor = pass.write(sceneColor);
+			pass.depth(sceneDepth, false);
+			pass.setGpuSection("transparency");
+		}, [&panels](const RenderPassContext& context) {
+			glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_ENABLE_BIT);
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glDepthMask(GL_FALSE);
+			panels.draw();
+			glPopAttrib();
+		});
+		return sceneColor;
+	}
+
+	// Color sum with revealage in alpha, and the weight sum
+	GraphTextureDesc desc = graph.getDesc(sceneColor);
+	desc.format = GL_RGBA16F;
+	GraphTexture accumulation = graph.createTexture("oit accumulation", desc);
+	desc.format = GL_R16F;
+	GraphTexture weights = graph.createTexture("oit weights", desc);
+
+	// Depth tested against the opaque pass but never written
+	graph.addPass("oit accumulate", [&](RenderPassBuilder& pass) {
+		accumulation = pass.write(accumulation);
+		weights = pass.write(weights);
+		pass.depth(sceneDepth, false);
+		pass.setGpuSection("transparency");
+	}, [this, &panels](const RenderPassContext& context) {
+		glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_ENABLE_BIT | GL_LIGHTING_BIT);
+		glClearColor(0, 0, 0, 1);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		glEnable(GL_DEPTH_TEST);
+		glDepthMask(GL_FALSE);
+		glDisable(GL_CULL_FACE);
+		glEnable(GL_BLEND);
+		// Color and weights add up, revealage multiplies by (1 - alpha)
+		glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+
+		this->accumulateShader.use();
+		panels.draw();
+		glUseProgram(0);
+		glPopAttrib();
+	});
+
+	// Composite over the opaque image
+	graph.addPass("oit composite", [&](RenderPassBuilder& pass) {
+		pass.read(accumulation);
+		pass.read(weights);
+		sceneColor = pass.write(sceneColor);
+		pass.setGpuSection("transparency");
+	}, [=](const RenderPassContext& context) {
+		glPushAttrib(GL_COLOR_BUFFER_BIT | GL_ENABLE_BIT);
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		glActiveTexture(GL_TEXTURE0 + 1);
+		glBindTexture(GL_TEXTURE_2D, context.getTexture(weights));
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, context.getTexture(accumulation));
+
+		this->compositeShader.use();
+		drawFullscreenQuad();
+		glUseProgram(0);
+
+		glActiveTexture(GL_TEXTURE0 + 1);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glPopAttrib();
+	});
+
+	return sceneColor;
+}
+
+bool WeightedBlendedOIT::isSupported() const {
+	return this->supported;
+}
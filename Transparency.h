@@ -0,0 +1,68 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <vector>
+#include "GLExtensions.h"
+#include "Point3.h"
+#include "RenderGraph.h"
+#include "Shader.h"
+
+// Floats per vertex: position, normal, then color with alpha
+#define PANEL_VERTEX_FLOATS 10
+
+// Flat translucent quads, such as glass balustrades and partitions
+class TransparentPanels {
+public:
+	TransparentPanels();
+	~TransparentPanels();
+	TransparentPanels(const TransparentPanels&) = delete;
+	TransparentPanels& operator=(const TransparentPanels&) = delete;
+
+	// Corners in drawing order, all sharing one RGBA color
+	void addPanel(const Point3& a, const Point3& b, const Point3& c, const Point3& d, const float color[4]);
+	void clear();
+
+	// Sends the panels added since the last upload to the GPU
+	void upload();
+	void draw() const;
+
+	size_t getPanelCount() const;
+
+private:
+	std::vector<float> vertices;
+	GLuint buffer = 0;
+	size_t uploadedVertices = 0;
+	bool dirty = false;
+};
+
+// Weighted blended order-independent transparency (McGuire and Bavoil 2013).
+// Transparent surfaces are accumulated in any order into a weighted color
+// sum and a revealage product, then resolved over the opaque image by a
+// single fullscreen composite, so nothing is ever sorted per frame and
+// intersecting panels blend correctly. Without framebuffer objects or
+// shaders it falls back to plain unsorted alpha blending.
+class WeightedBlendedOIT {
+public:
+	WeightedBlendedOIT();
+	WeightedBlendedOIT(const WeightedBlendedOIT&) = delete;
+	WeightedBlendedOIT& operator=(const WeightedBlendedOIT&) = delete;
+
+	// Builds the shaders, returning false if the fallback will be used
+	bool init();
+
+	// Adds the passes drawing the panels over sceneColor, tested against
+	// sceneDepth, and returns sceneColor's new version. Their GPU time
+	// goes to the "transparency" section.
+	GraphTexture addPasses(RenderGraph& graph, const TransparentPanels& panels, GraphTexture sceneColor, GraphTexture sceneDepth);
+
+	bool isSupported() const;
+
+private:
+	Shader accumulateShader;
+	Shader compositeShader;
+	bool supported = false;
+};
@@ -0,0 +1,263 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "Tunables.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+static string trim(const string& text) {
+	size_t begin = text.find_first_not_of(" \t\r\n");
+	if (begin == string::npos)
+		return "";
+	size_t end = text.find_last_not_of(" \t\r\n");
+	return text.substr(begin, end - begin + 1);
+}
+
+///////////////
+// TunableBase
+
+TunableBase::TunableBase(const char* name, const char* description) : name(name), description(description) {
+	getTunables().add(this);
+}
+
+TunableBase::~TunableBase() {
+	getTunables().remove(this);
+}
+
+const string& TunableBase::getName() const {
+	return this->name;
+}
+
+const string& TunableBase::getDescription() const {
+	return this->description;
+}
+
+void TunableBase::addListener(const function<void()>& listener) {
+	this->listeners.push_back(listener);
+}
+
+void TunableBase::notify() {
+	for (const auto& listener : this->listeners)
+		listener();
+}
+
+///////////
+// Tunable
+
+static bool parseValue(const string& text, int& value) {
+	char* end;
+	errno = 0;
+	long parsed = strtol(text.c_str(), &end, 10);
+	if (text.empty() || *end != '\0' || errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX)
+		return false;
+	value = (int)parsed;
+	return true;
+}
+
+// Rejects "nan" and "inf", which strtof takes
+static bool parseValue(const string& text, float& value) {
+	char* end;
+	value = strtof(text.c_str(), &end);
+	return !text.empty() && *end == '\0' && isfinite(value);
+}
+
+static bool parseValue(const string& text, bool& value) {
+	value = text == "1" || text == "true" || text == "on";
+	return value || text == "0" || text == "false" || text == "off";
+}
+
+template <typename T>
+static string formatValue(T value) {
+	stringstream text;
+	text << value;
+	return text.str();
+}
+
+static string formatValue(bool value) {
+	return value ? "true" : "false";
+}
+
+template <typename T>
+bool Tunable<T>::parse(const string& text) {
+	T parsed;
+	if (!parseValue(text, parsed))
+		return false;
+	set(parsed);
+	return true;
+}
+
+template <typename T>
+string Tunable<T>::toString() const {
+	return formatValue(get());
+}
+
+template <typename T>
+string Tunable<T>::getRange() const {
+	return "[" + formatValue(this->min) + ", " + formatValue(this->max) + "]";
+}
+
+template class Tunable<int>;
+template class Tunable<float>;
+template class Tunable<bool>;
+
+///////////////////
+// TunableRegistry
+
+TunableRegistry& getTunables() {
+	static TunableRegistry registry;
+	return registry;
+}
+
+void TunableRegistry::add(TunableBase* tunable) {
+	this->tunables.push_back(tunable);
+}
+
+void TunableRegistry::remove(TunableBase* tunable) {
+	this->tunables.erase(std::remove(this->tunables.begin(), this->tunables.end(), tunable), this->tunables.end());
+}
+
+TunableBase* TunableRegistry::find(const string& name) const {
+	for (TunableBase* tunable : this->tunables) {
+		if (tunable->getName() == name)
+			return tunable;
+	}
+	return nullptr;
+}
+
+vector<TunableBase*> TunableRegistry::getAll() const {
+	vector<TunableBase*> sorted = this->tunables;
+	sort(sorted.begin(), sorted.end(), [](const TunableBase* a, const TunableBase* b) {
+		return a->getName() < b->getName();
+	});
+	return sorted;
+}
+
+bool TunableRegistry::set(const string& name, const string& value, string& error) {
+	TunableBase* tunable = find(name);
+	if (!tunable) {
+		error = "No tunable named " + name;
+		return false;
+	}
+	if (!tunable->parse(value)) {
+		error = "Invalid value for " + name + ": " + value + ", expected " + tunable->getRange();
+		return false;
+	}
+	return true;
+}
+
+bool TunableRegistry::setAssignment(const string& assignment, string& error) {
+	size_t equals = assignment.find('=');
+	if (equals == string::npos) {
+		error = "Expected name=value: " + assignment;
+		return false;
+	}
+	return set(trim(assignment.substr(0, equals)), trim(assignment.substr(equals + 1)), error);
+}
+
+bool TunableRegistry::loadFile(const string& filename) {
+	ifstream file(filename);
+	if (!file.is_open())
+		return false;
+
+	string line, error;
+	for (int number = 1; getline(file, line); number++) {
+		line = trim(line.substr(0, line.find('#')));
+		if (!line.empty() && !setAssignment(line, error))
+			cout << filename << ":" << number << ": " << error << endl;
+	}
+	return true;
+}
+
+vector<string> TunableRegistry::execute(const string& command) {
+	stringstream words(command);
+	string name, value;
+	words >> name;
+	getline(words, value);
+	value = trim(value);
+
+	if (name.empty())
+		return {};
+	if (name == "list") {
+		vector<string> lines;
+		for (TunableBase* tunable : getAll()) {
+			if (tunable->getName().compare(0, value.size(), value) == 0)
+				lines.push_back(tunable->getName() + " = " + tunable->toString());
+		}
+		return lines;
+	}
+
+	TunableBase* tunable = find(name);
+	if (!tunable)
+		return { "No tunable named " + name + ", try list" };
+	string error;
+	if (!value.empty() && !set(name, value, error))
+		return { error };
+	return { name + " = " + tunable->toString() + "  " + tunable->getRange() + " " + tunable->getDescription() };
+}
+
+//////////////////
+// TunableConsole
+
+bool TunableConsole::isOpen() const {
+	return this->open;
+}
+
+void TunableConsole::toggle() {
+	this->open = !this->open;
+	this->line.clear();
+}
+
+bool TunableConsole::handleKey(unsigned char key) {
+	if (!this->open)
+		return false;
+
+	switch (key) {
+		case '`':
+		case 27: // Escape
+			toggle();
+			break;
+		case '\r':
+		case '\n':
+			print("> " + this->line);
+			for (const string& output : getTunables().execute(this->line))
+				print(output);
+			this->line.clear();
+			break;
+		case 8: // Backspace
+		case 127:
+			if (!this->line.empty())
+				this->line.pop_back();
+			break;
+		default:
+			if (key >= ' ' && key < 127)
+				this->line += (char)key;
+			break;
+	}
+	return true;
+}
+
+const string& TunableConsole::getLine() const {
+	return this->line;
+}
+
+const vector<string>& TunableConsole::getOutput() const {
+	return this->output;
+}
+
+void TunableConsole::print(const string& line) {
+	cout << line << endl;
+	this->output.push_back(line);
+	if (this->output.size() > TUNABLES_CONSOLE_LINES)
+		this->output.erase(this->output.begin());
+}
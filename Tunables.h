@@ -0,0 +1,132 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Read at startup, then overridden by --config and --set
+#define TUNABLES_DEFAULT_CONFIG "mezzanine.cfg"
+// Lines of output the console keeps on screen
+#define TUNABLES_CONSOLE_LINES 8
+
+// A named value that can be changed while running, from the command
+// line, a config file or the console. Names are dotted by subsystem,
+// such as "camera.far". Each one registers itself on construction, so
+// they are declared as globals next to the code reading them.
+class TunableBase {
+public:
+	TunableBase(const char* name, const char* description);
+	virtual ~TunableBase();
+	TunableBase(const TunableBase&) = delete;
+	TunableBase& operator=(const TunableBase&) = delete;
+
+	const std::string& getName() const;
+	const std::string& getDescription() const;
+
+	// Returns false, leaving the value alone, if text is not a valid value
+	virtual bool parse(const std::string& text) = 0;
+	virtual std::string toString() const = 0;
+	// Such as "[0.01, 10]", for the console
+	virtual std::string getRange() const = 0;
+
+	// Called after every change, on the thread making it
+	void addListener(const std::function<void()>& listener);
+
+protected:
+	void notify();
+
+private:
+	std::string name, description;
+	std::vector<std::function<void()>> listeners;
+};
+
+// Values are clamped to [min, max], and NaN is ignored. Reading one is a relaxed atomic load,
+// the same instruction as reading a plain global, so hot loops can keep
+// reading them on any thread.
+template <typename T>
+class Tunable : public TunableBase {
+public:
+	Tunable(const char* name, T value, T min, T max, const char* description)
+		: TunableBase(name, description), value(value), min(min), max(max) {
+	}
+
+	T get() const {
+		return this->value.load(std::memory_order_relaxed);
+	}
+	operator T() const {
+		return get();
+	}
+
+	void set(T value) {
+		if (value != value) // NaN, which no comparison clamps
+			return;
+		value = value < this->min ? this->min : value > this->max ? this->max : value;
+		if (this->value.exchange(value, std::memory_order_relaxed) != value)
+			notify();
+	}
+
+	bool parse(const std::string& text) override;
+	std::string toString() const override;
+	std::string getRange() const override;
+
+private:
+	std::atomic<T> value;
+	T min, max;
+};
+
+extern template class Tunable<int>;
+extern template class Tunable<float>;
+extern template class Tunable<bool>;
+
+class TunableRegistry {
+public:
+	void add(TunableBase* tunable);
+	void remove(TunableBase* tunable);
+	TunableBase* find(const std::string& name) const;
+	// Sorted by name
+	std::vector<TunableBase*> getAll() const;
+
+	// Sets one value, explaining in error why it could not
+	bool set(const std::string& name, const std::string& value, std::string& error);
+	// "name=value" as given to --set
+	bool setAssignment(const std::string& assignment, std::string& error);
+	// Lines of name = value, # starting comments. Returns false if the
+	// file cannot be read; bad lines are reported and skipped.
+	bool loadFile(const std::string& filename);
+
+	// A console command: "name value" sets, "name" shows one value,
+	// "list [prefix]" shows them all. Returns its output lines.
+	std::vector<std::string> execute(const std::string& command);
+
+private:
+	std::vector<TunableBase*> tunables;
+};
+
+TunableRegistry& getTunables();
+
+// The line editor of the in-app console. Keys go to it while open.
+class TunableConsole {
+public:
+	bool isOpen() const;
+	void toggle();
+	// Returns false for keys it does not take, when closed
+	bool handleKey(unsigned char key);
+
+	// The command being typed
+	const std::string& getLine() const;
+	// The last TUNABLES_CONSOLE_LINES lines of output, oldest first
+	const std::vector<std::string>& getOutput() const;
+
+private:
+	void print(const std::string& line);
+
+	bool open = false;
+	std::string line;
+	std::vector<std::string> output;
+};
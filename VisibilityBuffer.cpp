@@ -0,0 +1,520 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "VisibilityBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <gl/glut.h>
+
+using namespace std;
+
+// Texels per vertex (position, normal) and per instance (offset and
+// scale, color) in the texture buffers
+#define VERTEX_TEXELS 2
+#define INSTANCE_TEXELS 2
+
+///////////
+// Shaders
+// Fixed function matrices are the camera, and instances are placed in
+// world space, so the modelview inverse holds the eye.
+
+// Prepended to every shader
+static const char* shaderCommon = R"(
+#version 150 compatibility
+uniform samplerBuffer vertices;
+uniform samplerBuffer instances;
+vec3 instancePosition(int instance, int vertex) {
+	vec4 placement = texelFetch(instances, instance * 2);
+	return texelFetch(vertices, vertex * 2).xyz * placement.w + placement.xyz;
+}
+vec3 vertexNormal(int vertex) {
+	return texelFetch(vertices, vertex * 2 + 1).xyz;
+}
+vec3 instanceColor(int instance) {
+	return texelFetch(instances, instance * 2 + 1).rgb;
+}
+)";
+
+// Blinn-Phong under many point lights spiralling over the scene, as a
+// stand in for expensive material shading
+static const char* shadingCommon = R"(
+const int LIGHT_COUNT = 32;
+vec3 shade(vec3 position, vec3 normal, vec3 albedo) {
+	vec3 toEye = normalize(gl_ModelViewMatrixInverse[3].xyz - position);
+	vec3 color = albedo * 0.05;
+	for (int i = 0; i < LIGHT_COUNT; i++) {
+		float angle = float(i) * 2.39996323;
+		float radius = 2.0 + float(i) * 0.5;
+		vec3 light = vec3(cos(angle) * radius, 4.0 + float(i % 4), sin(angle) * radius);
+		vec3 lightColor = 0.5 + 0.5 * cos(vec3(0.0, 2.0, 4.0) + float(i));
+
+		vec3 toLight = light - position;
+		float distance2 = dot(toLight, toLight);
+		toLight *= inversesqrt(distance2);
+		float diffuse = max(dot(normal, toLight), 0.0);
+		float specular = pow(max(dot(normal, normalize(toLight + toEye)), 0.0), 64.0);
+		color += lightColor * (albedo * diffuse + specular) * (4.0 / (1.0 + distance2));
+	}
+	return color;
+}
+)";
+
+static const char* visibilityVertex = R"(
+flat out int instance;
+void main() {
+	instance = gl_InstanceID;
+	gl_Position = gl_ModelViewProjectionMatrix * vec4(instancePosition(gl_InstanceID, gl_VertexID), 1.0);
+}
+)";
+
+static const char* visibilityFragment = R"(
+flat in int instance;
+out uvec2 ids;
+void main() {
+	ids = uvec2(uint(gl_PrimitiveID), uint(instance));
+}
+)";
+
+static const char* fullscreenVertex = R"(
+void main() {
+	gl_Position = gl_Vertex;
+}
+)";
+
+// Pixels the depth left at the far plane keep the cleared color
+static const char* resolveFragment = R"(
+uniform usampler2D ids;
+uniform sampler2D depth;
+void main() {
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	if (texelFetch(depth, texel, 0).r >= 1.0)
+		discard;
+	uvec2 id = texelFetch(ids, texel, 0).rg;
+	int first = int(id.x) * 3, instance = int(id.y);
+	vec3 p0 = instancePosition(instance, first);
+	vec3 p1 = instancePosition(instance, first + 1);
+	vec3 p2 = instancePosition(instance, first + 2);
+
+	// The pixel's ray, from the near plane through its center
+	vec2 ndc = gl_FragCoord.xy / vec2(textureSize(ids, 0)) * 2.0 - 1.0;
+	vec4 near = gl_ModelViewProjectionMatrixInverse * vec4(ndc, -1.0, 1.0);
+	vec4 far = gl_ModelViewProjectionMatrixInverse * vec4(ndc, 1.0, 1.0);
+	vec3 origin = near.xyz / near.w;
+	vec3 direction = far.xyz / far.w - origin;
+
+	// Moller-Trumbore barycentrics, which are perspective correct as
+	// they come from the ray. Misses need no handling, the rasterizer
+	// already found this triangle under the pixel.
+	vec3 e1 = p1 - p0, e2 = p2 - p0;
+	vec3 pv = cross(direction, e2);
+	float inverseDet = 1.0 / dot(e1, pv);
+	vec3 tv = origin - p0;
+	vec3 qv = cross(tv, e1);
+	float u = dot(tv, pv) * inverseDet, v = dot(direction, qv) * inverseDet;
+	float t = dot(e2, qv) * inverseDet;
+
+	vec3 normal = normalize(vertexNormal(first) * (1.0 - u - v) + vertexNormal(first + 1) * u + vertexNormal(first + 2) * v);
+	gl_FragColor = vec4(shade(origin + direction * t, normal, instanceColor(instance)), 1.0);
+}
+)";
+
+static const char* forwardVertex = R"(
+out vec3 position;
+out vec3 normal;
+flat out vec3 albedo;
+void main() {
+	position = instancePosition(gl_InstanceID, gl_VertexID);
+	normal = vertexNormal(gl_VertexID);
+	albedo = instanceColor(gl_InstanceID);
+	gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 1.0);
+}
+)";
+
+static const char* forwardFragment = R"(
+in vec3 position;
+in vec3 normal;
+flat in vec3 albedo;
+void main() {
+	gl_FragColor = vec4(shade(position, normalize(normal), albedo), 1.0);
+}
+)";
+
+//////////////////////
+// InstancedTriangles
+
+InstancedTriangles::InstancedTriangles() {
+}
+
+InstancedTriangles::~InstancedTriangles() {
+	if (this->vertexTexture != 0)
+		glDeleteTextures(1, &this->vertexTexture);
+	if (this->instanceTexture != 0)
+		glDeleteTextures(1, &this->instanceTexture);
+	if (this->vertexBuffer != 0)
+		glDeleteBuffers(1, &this->vertexBuffer);
+	if (this->instanceBuffer != 0)
+		glDeleteBuffers(1, &this->instanceBuffer);
+}
+
+void InstancedTriangles::setMesh(const vector<float>& vertices) {
+	// Padded to whole RGBA32F texels
+	this->vertices.clear();
+	for (size_t i = 0; i + 6 <= vertices.size(); i += 6) {
+		const float* vertex = vertices.data() + i;
+		this->vertices.insert(this->vertices.end(), { vertex[0], vertex[1], vertex[2], 1, vertex[3], vertex[4], vertex[5], 0 });
+	}
+}
+
+void InstancedTriangles::addInstance(const Point3& offset, float scale, const Point3& color) {
+	this->instances.insert(this->instances.end(), { offset.x, offset.y, offset.z, scale, color.x, color.y, color.z, 1 });
+}
+
+static void uploadTextureBuffer(const vector<float>& data, GLuint& buffer, GLuint& texture) {
+	if (buffer == 0)
+		glGenBuffers(1, &buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(float), data.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	if (texture == 0)
+		glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+bool InstancedTriangles::upload() {
+	if (!hasShaders() || !hasInstancing() || !hasTextureBuffers())
+		return false;
+
+	uploadTextureBuffer(this->vertices, this->vertexBuffer, this->vertexTexture);
+	uploadTextureBuffer(this->instances, this->instanceBuffer, this->instanceTexture);
+	return true;
+}
+
+void InstancedTriangles::bind() const {
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_BUFFER, this->vertexTexture);
+	glActiveTexture(GL_TEXTURE0 + 1);
+	glBindTexture(GL_TEXTURE_BUFFER, this->instanceTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void InstancedTriangles::unbind() const {
+	glActiveTexture(GL_TEXTURE0 + 1);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void InstancedTriangles::draw() const {
+	size_t vertexCount = this->vertices.size() / (VERTEX_TEXELS * 4);
+	size_t instanceCount = this->instances.size() / (INSTANCE_TEXELS * 4);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, (GLsizei)vertexCount, (GLsizei)instanceCount);
+	countDrawCalls();
+}
+
+size_t InstancedTriangles::getTriangleCount() const {
+	return this->vertices.size() / (VERTEX_TEXELS * 4) / 3;
+}
+
+size_t InstancedTriangles::getInstanceCount() const {
+	return this->instances.size() / (INSTANCE_TEXELS * 4);
+}
+
+////////////////////
+// VisibilityBuffer
+
+VisibilityBuffer::VisibilityBuffer() {
+}
+
+static bool buildShader(Shader& shader, const char* name, const char* vertex, const char* fragment, bool shading) {
+	string common = shaderCommon;
+	string fragmentSource = common + (shading ? shadingCommon : "") + fragment;
+	if (!shader.build(name, (common + vertex).c_str(), fragmentSource.c_str()))
+		return false;
+
+	shader.use();
+	glUniform1i(shader.uniform("vertices"), 0);
+	glUniform1i(shader.uniform("instances"), 1);
+	glUniform1i(shader.uniform("ids"), 2);
+	glUniform1i(shader.uniform("depth"), 3);
+	glUseProgram(0);
+	return true;
+}
+
+bool VisibilityBuffer::init() {
+	this->supported = hasFramebuffers() && hasShaders() && hasInstancing() && hasTextureBuffers()
+		&& buildShader(this->visibilityShader, "visibility", visibilityVertex, visibilityFragment, false)
+		&& buildShader(this->resolveShader, "visibility resolve", fullscreenVertex, resolveFragment, true)
+		&& buildShader(this->forwardShader, "forward", forwardVertex, forwardFragment, true);
+	return this->supported;
+}
+
+// Geometry passes test and write depth, without fixed function lighting
+static void beginScenePass(const Shader& shader, const InstancedTriangles& scene) {
+	glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_ENABLE_BIT);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_CULL_FACE);
+	shader.use();
+	scene.bind();
+}
+
+static void endScenePass(const InstancedTriangles& scene) {
+	scene.unbind();
+	glUseProgram(0);
+	glPopAttrib();
+}
+
+GraphTexture VisibilityBuffer::addPasses(RenderGraph& graph, const InstancedTriangles& scene, GraphTexture sceneColor, GraphTexture& sceneDepth) {
+	if (!this->supported)
+		return sceneColor;
+
+	const GraphTextureDesc& colorDesc = graph.getDesc(sceneColor);
+	GraphTexture ids = graph.createTexture("visibility ids", { colorDesc.width, colorDesc.height, GL_RG32UI });
+
+	// Triangle and instance of every pixel. The ids are never cleared,
+	// pixels still at the far plane are skipped instead.
+	graph.addPass("visibility", [&](RenderPassBuilder& pass) {
+		ids = pass.write(ids);
+		sceneDepth = pass.depth(sceneDepth, true);
+		pass.setGpuSection("visibility");
+	}, [this, &scene](const RenderPassContext& context) {
+		beginScenePass(this->visibilityShader, scene);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		scene.draw();
+		endScenePass(scene);
+	});
+
+	// Every covered pixel shaded once
+	GraphTexture depth = sceneDepth;
+	graph.addPass("visibility resolve", [&](RenderPassBuilder& pass) {
+		pass.read(ids);
+		pass.read(depth);
+		sceneColor = pass.write(sceneColor);
+		pass.setGpuSection("visibility");
+	}, [this, &scene, ids, depth](const RenderPassContext& context) {
+		glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_ENABLE_BIT);
+		glDisable(GL_DEPTH_TEST);
+		glDepthMask(GL_FALSE);
+		glDisable(GL_BLEND);
+		glDisable(GL_LIGHTING);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		this->resolveShader.use();
+		scene.bind();
+		glActiveTexture(GL_TEXTURE0 + 2);
+		glBindTexture(GL_TEXTURE_2D, context.getTexture(ids));
+		glActiveTexture(GL_TEXTURE0 + 3);
+		glBindTexture(GL_TEXTURE_2D, context.getTexture(depth));
+		drawFullscreenQuad();
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glActiveTexture(GL_TEXTURE0 + 2);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		scene.unbind();
+		glUseProgram(0);
+		glPopAttrib();
+	});
+
+	return sceneColor;
+}
+
+GraphTexture VisibilityBuffer::addForwardPass(RenderGraph& graph, const InstancedTriangles& scene, GraphTexture sceneColor, GraphTexture& sceneDepth) {
+	if (!this->supported)
+		return sceneColor;
+
+	graph.addPass("forward", [&](RenderPassBuilder& pass) {
+		sceneColor = pass.write(sceneColor);
+		sceneDepth = pass.depth(sceneDepth, true);
+		pass.setGpuSection("forward");
+	}, [this, &scene](const RenderPassContext& context) {
+		beginScenePass(this->forwardShader, scene);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		scene.draw();
+		endScenePass(scene);
+	});
+
+	return sceneColor;
+}
+
+bool VisibilityBuffer::isSupported() const {
+	return this->supported;
+}
+
+/////////////
+// Benchmark
+
+// Unit sphere as a triangle list of positions and normals
+static void subdivide(const Point3& a, const Point3& b, const Point3& c, int depth, vector<float>& vertices) {
+	if (depth == 0) {
+		for (const Point3& p : { a, b, c })
+			vertices.insert(vertices.end(), { p.x, p.y, p.z, p.x, p.y, p.z });
+		return;
+	}
+
+	Point3 ab = normalize(a + b), bc = normalize(b + c), ca = normalize(c + a);
+	subdivide(a, ab, ca, depth - 1, vertices);
+	subdivide(ab, b, bc, depth - 1, vertices);
+	subdivide(ca, bc, c, depth - 1, vertices);
+	subdivide(ab, bc, ca, depth - 1, vertices);
+}
+
+static vector<float> buildIcosphere(int subdivisions) {
+	const float t = 1.6180339887f;
+	Point3 corners[12] = {
+		Point3(-1, t, 0), Point3(1, t, 0), Point3(-1, -t, 0), Point3(1, -t, 0),
+		Point3(0, -1, t), Point3(0, 1, t), Point3(0, -1, -t), Point3(0, 1, -t),
+		Point3(t, 0, -1), Point3(t, 0, 1), Point3(-t, 0, -1), Point3(-t, 0, 1)
+	};
+	const int faces[20][3] = {
+		{ 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+		{ 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+		{ 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+		{ 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+	};
+
+	vector<float> vertices;
+	for (const int* face : faces)
+		subdivide(normalize(corners[face[0]]), normalize(corners[face[1]]), normalize(corners[face[2]]), subdivisions, vertices);
+	return vertices;
+}
+
+struct PathResult {
+	double milliseconds = 0;
+	double shadedPixels = 0; // Forward: fragments passing the depth test
+};
+
+void runVisibilityBenchmark(int width, int height) {
+	VisibilityBuffer renderer;
+	InstancedTriangles scene;
+	if (!renderer.init()) {
+		printf("Visibility buffer unavailable: it needs GLSL 1.50, instancing and texture buffers\n");
+		return;
+	}
+
+	// Spheres of varied sizes overlapping in depth, drawn in a shuffled
+	// order as an unsorted scene would be
+	scene.setMesh(buildIcosphere(VISBUFFER_BENCH_SUBDIVISIONS));
+	mt19937 random(1234);
+	uniform_real_distribution<float> unit(0, 1);
+	vector<int> order(VISBUFFER_BENCH_GRID * VISBUFFER_BENCH_GRID);
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = (int)i;
+	shuffle(order.begin(), order.end(), random);
+	for (int cell : order) {
+		float x = (cell % VISBUFFER_BENCH_GRID - (VISBUFFER_BENCH_GRID - 1) * 0.5f) * 1.5f;
+		float z = (cell / VISBUFFER_BENCH_GRID - (VISBUFFER_BENCH_GRID - 1) * 0.5f) * 1.5f;
+		Point3 color(0.3f + 0.7f * unit(random), 0.3f + 0.7f * unit(random), 0.3f + 0.7f * unit(random));
+		scene.addInstance(Point3(x, 1, z), 0.6f + 0.4f * unit(random), color);
+	}
+	scene.upload();
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	gluPerspective(45, (double)width / height, 0.1, 500);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	gluLookAt(0, 6, 16, 0, 0, 0, 0, 1, 0);
+
+	printf("%zu triangles (%zu instances of %zu) at %dx%d, ms per frame over %d frames\n",
+		scene.getTriangleCount() * scene.getInstanceCount(), scene.getInstanceCount(), scene.getTriangleCount(),
+		width, height, VISBUFFER_BENCH_FRAMES);
+	printf("%-12s %10s %14s %12s\n", "path", "gpu", "pixels shaded", "per pixel");
+
+	GLuint timer = 0, samples = 0;
+	if (hasTimerQueries())
+		glGenQueries(1, &timer);
+	glGenQueries(1, &samples);
+
+	RenderGraph graph;
+	PathResult results[2];
+	for (int path = 0; path < 2; path++) {
+		// The first frames allocate the graph's textures
+		for (int frame = -2; frame < VISBUFFER_BENCH_FRAMES; frame++) {
+			graph.reset();
+			GraphTexture color = graph.createTexture("scene color", { width, height, GL_RGBA8 });
+			GraphTexture depth = graph.createTexture("scene depth", { width, height, GL_DEPTH_COMPONENT24 });
+			if (path == 0)
+				color = renderer.addForwardPass(graph, scene, color, depth);
+			else
+				color = renderer.addPasses(graph, scene, color, depth);
+			graph.markOutput(color);
+			graph.compile();
+
+			// Forward shades every fragment passing the depth test, counted
+			// here; the resolve shades each covered pixel, counted below
+			glFinish();
+			auto start = chrono::steady_clock::now();
+			if (timer != 0)
+				glBeginQuery(GL_TIME_ELAPSED, timer);
+			if (path == 0)
+				glBeginQuery(GL_SAMPLES_PASSED, samples);
+			graph.execute(nullptr);
+			if (path == 0)
+				glEndQuery(GL_SAMPLES_PASSED);
+			if (timer != 0)
+				glEndQuery(GL_TIME_ELAPSED);
+			glFinish();
+			double wall = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+			if (frame < 0)
+				continue;
+			if (timer != 0) {
+				GLuint64 nanoseconds = 0;
+				glGetQueryObjectui64v(timer, GL_QUERY_RESULT, &nanoseconds);
+				results[path].milliseconds += nanoseconds / 1e6 / VISBUFFER_BENCH_FRAMES;
+			}
+			else {
+				results[path].milliseconds += wall / VISBUFFER_BENCH_FRAMES;
+			}
+			if (path == 0) {
+				GLint passed = 0;
+				glGetQueryObjectiv(samples, GL_QUERY_RESULT, &passed);
+				results[path].shadedPixels += (double)passed / VISBUFFER_BENCH_FRAMES;
+			}
+		}
+	}
+
+	// Covered pixels, from the depth the visibility pass leaves
+	graph.reset();
+	GraphTexture color = graph.createTexture("scene color", { width, height, GL_RGBA8 });
+	GraphTexture depth = graph.createTexture("scene depth", { width, height, GL_DEPTH_COMPONENT24 });
+	color = renderer.addPasses(graph, scene, color, depth);
+	size_t covered = 0;
+	graph.addPass("coverage", [&](RenderPassBuilder& pass) {
+		pass.read(depth);
+		pass.keepAlive();
+	}, [&](const RenderPassContext& context) {
+		vector<float> depths((size_t)width * height);
+		glBindTexture(GL_TEXTURE_2D, context.getTexture(depth));
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, GL_FLOAT, depths.data());
+		glBindTexture(GL_TEXTURE_2D, 0);
+		for (float d : depths)
+			covered += d < 1;
+	});
+	graph.compile();
+	graph.execute(nullptr);
+	results[1].shadedPixels = (double)covered;
+
+	const char* names[2] = { "forward", "visibility" };
+	for (int path = 0; path < 2; path++) {
+		printf("%-12s %10.2f %14.0f %12.2f\n", names[path], results[path].milliseconds, results[path].shadedPixels,
+			results[path].shadedPixels / max(covered, (size_t)1));
+	}
+
+	if (timer != 0)
+		glDeleteQueries(1, &timer);
+	glDeleteQueries(1, &samples);
+}
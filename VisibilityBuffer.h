@@ -0,0 +1,86 @@
+//          Copyright Luca R. L. de Carvalho 2021.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <vector>
+#include "GLExtensions.h"
+#include "Point3.h"
+#include "RenderGraph.h"
+#include "Shader.h"
+
+// Benchmark scene: a grid of spheres, each subdivided this many times
+// from an icosahedron (20 * 4^n triangles)
+#define VISBUFFER_BENCH_SUBDIVISIONS 5
+#define VISBUFFER_BENCH_GRID 12
+#define VISBUFFER_BENCH_FRAMES 20
+
+// One triangle mesh drawn many times, each instance scaled, moved and
+// tinted. Vertices and instances live in texture buffers that shaders
+// fetch from by gl_VertexID and gl_InstanceID, so a pass can look any
+// triangle up again from its index alone.
+class InstancedTriangles {
+public:
+	InstancedTriangles();
+	~InstancedTriangles();
+	InstancedTriangles(const InstancedTriangles&) = delete;
+	InstancedTriangles& operator=(const InstancedTriangles&) = delete;
+
+	// Three vertices per triangle, each a position then a normal
+	void setMesh(const std::vector<float>& vertices);
+	void addInstance(const Point3& offset, float scale, const Point3& color);
+
+	// Copies the mesh and instances into their buffers. Returns false
+	// without shaders, instancing or texture buffers.
+	bool upload();
+	// Binds the vertices to unit 0 and instances to unit 1 as texture buffers
+	void bind() const;
+	void unbind() const;
+	// Every instance, with the shader using those buffers already current
+	void draw() const;
+
+	size_t getTriangleCount() const;
+	size_t getInstanceCount() const;
+
+private:
+	std::vector<float> vertices, instances;
+	GLuint vertexBuffer = 0, instanceBuffer = 0;
+	GLuint vertexTexture = 0, instanceTexture = 0;
+};
+
+// Visibility buffer shading (Burns and Hunt 2013). The first pass
+// rasterizes the triangles with an empty shader, storing only which
+// triangle of which instance covers each pixel. The second pass runs
+// once per pixel, fetches that triangle's vertices, intersects the
+// pixel's ray with it for barycentrics and interpolates the attributes
+// to shade. Shading cost no longer depends on overdraw or triangle size,
+// and the only target between the passes is 8 bytes per pixel. The
+// forward path shades the same way while rasterizing, for comparison.
+class VisibilityBuffer {
+public:
+	VisibilityBuffer();
+	VisibilityBuffer(const VisibilityBuffer&) = delete;
+	VisibilityBuffer& operator=(const VisibilityBuffer&) = delete;
+
+	// Builds the shaders, returning false if neither path is available
+	bool init();
+
+	// Adds the passes drawing scene into sceneColor and sceneDepth,
+	// and returns sceneColor's new version. Their GPU time goes to the
+	// "visibility" section.
+	GraphTexture addPasses(RenderGraph& graph, const InstancedTriangles& scene, GraphTexture sceneColor, GraphTexture& sceneDepth);
+	// The same image shaded while rasterizing, in the "forward" section
+	GraphTexture addForwardPass(RenderGraph& graph, const InstancedTriangles& scene, GraphTexture sceneColor, GraphTexture& sceneDepth);
+
+	bool isSupported() const;
+
+private:
+	Shader visibilityShader, resolveShader, forwardShader;
+	bool supported = false;
+};
+
+// Renders a high polygon scene offscreen with both paths and prints
+// their GPU time and fragments shaded. Needs a current context.
+void runVisibilityBenchmark(int width, int height);
@@ -9,160 +9,261 @@
 // moves arround it.
 
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <sstream>
 #include <cstdio>
+#include <cmath>
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <random>
+#include <future>
+#include <fstream>
 #include <gl/glut.h>
-
+#include "Point3.h"
+#include "Obj.h"
+#include "GLExtensions.h"
+#include "ProgressiveLoader.h"
+#include "Streaming.h"
+#include "RenderGraph.h"
+#include "Frustum.h"
+#include "IncrementalCulling.h"
+#include "Transparency.h"
+#include "Bvh.h"
+#include "Boundaries.h"
+#include "Collision.h"
+#include "Coverage.h"
+#include "DistanceField.h"
+#include "Pvs.h"
+#include "LightProbes.h"
+#include "DynamicProps.h"
+#include "JobSystem.h"
+#include "FrameStats.h"
+#include "AmbientOcclusion.h"
+#include "Hud.h"
+#include "DebugDraw.h"
+#include "Rhi.h"
+#include "VisibilityBuffer.h"
+#include "BenchmarkSuites.h"
+#include "Tunables.h"
+#include "Metrics.h"
+#include "SamplingProfiler.h"
+
+// Defaults of the window and camera tunables below
 #define WINDOW_W 800
 #define WINDOW_H 600
 #define MOUSE_SENSITIVITY 0.4
+#define CAMERA_FOV 45
+#define CAMERA_NEAR 0.1
+#define CAMERA_FAR 500
 
-using namespace std;
-
-///////////
-// Classes
+// Body colliding with the hulls: a capsule from this far below the eye
+// up to it, clearing the lowest stair step
+#define CAMERA_RADIUS 0.25
+#define CAMERA_KNEE_DEPTH 1.5
 
-class Point3 {
-public:
-	float x = 0, y = 0, z = 0;
-	
-	Point3(float x, float y, float z) {
-		this->x = x;
-		this->y = y;
-		this->z = z;
-	}
-	Point3() {
-	}
-};
-
-class Face {
-public:
-	int vertexIds[4];
-	int normalIds[4];
-};
-
-class Obj {
-public:
-	string name;
-	vector<Point3> vertices = vector<Point3>();
-	vector<Point3> normals = vector<Point3>();
-	vector<Face> faces = vector<Face>();
-
-	Obj(const char* filename) {
-		readFile(filename);
-	}
+// Parse the models in the background and draw them as they arrive,
+// instead of waiting for every file before opening the window.
+// Set to 0 to load synchronously and draw with Obj::toBuffer.
+#define PROGRESSIVE_LOADING 1
 
-	Obj() {
-	}
+// Random panels in the transparency benchmark scene ('g' toggles it)
+#define BENCHMARK_PANELS 5000
 
-	void readFile(const char* filename) {
-		// Reads a single object
-
-		string line;
-		ifstream file;
-
-		file.open(filename, ifstream::in);
-
-		while (getline(file, line)) {
-
-			// Ignore comments
-			if (line[0] == '#')
-				continue;
-			else if (line[0] == 'o') {
-				// name
-				this->name = line.substr(1);
-			}
-			else if (line[0] == 'v') {
-				Point3 point;
-				if (line[1] == 'n') {
-					// normal vector
-					sscanf_s(line.c_str(), "vn %f %f %f", &point.x, &point.y, &point.z);
-					this->normals.push_back(point);
-				}
-				else {
-					// vertex
-					sscanf_s(line.c_str(), "v %f %f %f", &point.x, &point.y, &point.z);
-					this->vertices.push_back(point);
-				}
-
-				cout << "v/vn: " << point.x << " " << point.y << " " << point.z << endl;
-			}
-			else if (line[0] == 'f') {
-				// face
-				Face face;
-				sscanf_s(line.c_str(), "f %d//%d %d//%d %d//%d %d//%d",
-					&face.vertexIds[0], &face.normalIds[0], &face.vertexIds[1], &face.normalIds[1],
-					&face.vertexIds[2], &face.normalIds[2], &face.vertexIds[3], &face.normalIds[3]);
-				this->faces.push_back(face);
-
-				cout << "f: " << face.vertexIds[0] << " " << face.vertexIds[1] << " " << face.vertexIds[2] << " " << face.vertexIds[3] << endl;
-			}
-			else {
-				cout << "Invalid syntax or unsupported parameter: " << line << endl;
-				//break;
-			}
-		}
+// Height of the camera above the floor it walks on
+#define CAMERA_EYE_HEIGHT 2.0
 
-		cout << this->name << endl;
-	}
+// Light probe grid over the scene, extended this far above it
+#define PROBE_SPACING 1.0
+#define PROBE_HEADROOM 2.5
 
-	void toBuffer() {
-		// Transfers the object to OpenGL's buffer
-
-		glBegin(GL_QUADS);
-		for (int i = 0; i < this->faces.size(); i++) {
-			for (int j = 0; j < 4; j++) {
-				Point3 vertex = this->vertices[this->faces[i].vertexIds[j] - 1];
-				Point3 normal = this->normals[this->faces[i].normalIds[j] - 1];
-				glNormal3f(normal.x, normal.y, normal.z);
-				glVertex3f(vertex.x, vertex.y, vertex.z);
-			}
-		}
-		glEnd();
-	}
-};
+using namespace std;
 
 ////////////////////
 // Global variables
-GLfloat fovY, fAspect, cameraRotationY;
+GLfloat fAspect, cameraRotationY;
 Obj* object;
-map<string, Obj> objects = map<string, Obj>();
+map<string, Obj> objects = map<string, Obj>(); // Fully loaded objects
+map<string, ProgressiveLoader*> loaders = map<string, ProgressiveLoader*>();
+CameraPredictor* cameraPredictor;
+StreamingScheduler* streaming; // Uploads the loaders' batches in the order the camera needs them
 Point3* cameraPos; // Actually, stores the inverted coordinates
 Point3* cameraLookAt;
 int timeSinceStart;
 float deltaTimeSec = 0;
+int windowWidth = WINDOW_W, windowHeight = WINDOW_H; // Of the window as it is, the tunables as asked
+RenderGraph* renderGraph; // Rebuilt every frame
+WeightedBlendedOIT* transparency;
+TransparentPanels* transparentPanels;
+bool showTransparencyBenchmark = false;
+Bvh* sceneBvh;
+CollisionWorld* collisionWorld; // Hulls of the objects loaded so far
+LightProbeGrid* lightProbes;
+future<void> probeBake; // Running while the probes are baked in the background
+DistanceField* distanceField;
+future<void> distanceBake; // Baked alongside the probes, uploaded once done
+bool distanceFieldUploaded = false;
+PotentiallyVisibleSet* pvs;
+future<void> pvsBake; // Clusters are only culled against it once done
+const VisibleTiles* visibleTiles = nullptr; // From the camera's cell, this frame
+IncrementalCulling* incrementalCulling; // 'c' switches it off, to compare with full culling
+DynamicProps* dynamicProps;
+bool probeLighting = true; // 'l' switches the props to the dynamic lights
+FrameStats* frameStats;
+ScreenSpaceAO* ambientOcclusion; // 'o' cycles its quality
+Hud* hud;
+bool showHud = true; // 'h' toggles it
+bool showBoundaries = false; // 'b' toggles them, in debug builds
+TunableConsole console; // '`' opens it
+
+// Set with --set name=value, mezzanine.cfg or the console
+Tunable<int> tunableWindowWidth("window.width", WINDOW_W, 64, 8192, "Window width in pixels");
+Tunable<int> tunableWindowHeight("window.height", WINDOW_H, 64, 8192, "Window height in pixels");
+Tunable<float> mouseSensitivity("input.mouse_sensitivity", MOUSE_SENSITIVITY, 0.01f, 10, "Degrees turned per pixel of mouse motion");
+Tunable<float> cameraFov("camera.fov", CAMERA_FOV, 10, 120, "Vertical field of view in degrees");
+Tunable<float> cameraNear("camera.near", CAMERA_NEAR, 0.001f, 10, "Near clipping plane in meters");
+Tunable<float> cameraFar("camera.far", CAMERA_FAR, 10, 10000, "Far clipping plane in meters");
+
+MetricsExporter* metricsExporter; // Serving when metrics.port or --metrics-file is given
+Tunable<int> metricsPort("metrics.port", 0, 0, 65535, "Port serving Prometheus metrics on localhost, 0 for none. Read at startup.");
+Tunable<float> metricsInterval("metrics.interval", METRICS_TEXTFILE_INTERVAL, 1, 3600, "Seconds between rewrites of --metrics-file");
+
+// 'p' writes what it sampled to profile_<n>.folded
+Tunable<bool> profilerEnabled("profiler.enabled", false, false, true, "Samples every thread's stack, for flamegraphs");
+Tunable<int> profilerHz("profiler.hz", PROFILER_DEFAULT_HZ, 1, 10000, "Samples per second of CPU time, read when the profiler starts");
 
 ///////////////////////
 // Function prototypes
 void init();
+void setupLighting();
 void draw();
 void idle();
 void reshapeWindow(GLsizei w, GLsizei h);
 void setVisualizationParameters();
+void drawObject(const char* name, const Frustum& frustum, const VisibleTiles* visible);
+void buildTransparentPanels(bool benchmark);
+void addGlassRailing(float x0, float z0, float x1, float z1);
+void bakeLightProbes();
+void addCollisionMesh(const string& name);
+vector<FloorPlan> getFloorPlans();
+void runCoverageAnalysis();
+SuiteScene getSuiteScene();
+bool lightProbesReady();
+bool pvsReady();
+void addStatsToHud();
+void addConsoleToHud();
+void recordFrameMetrics();
+void updateProfiler();
+void writeProfile();
+void drawBoundaries();
 void handleKeyboard(unsigned char key, int x, int y);
 void handleMouseMotion(int x, int y);
 Point3* getCameraForward();
 void correctForBoundaries();
 void teleportIfNecessary();
-float clampFloat(float value, float min, float max);
-bool between(float value, float min, float max);
 
 /////////////
 // Functions
-int main() {
+int main(int argc, char** argv) {
+	bool rhiBenchmark = false, visibilityBenchmark = false, microBenchmarks = false;
+	bool goldenImages = false, goldenUpdate = false;
+	BenchmarkSettings benchmarkSettings;
+	string benchmarkOutput = "benchmarks.json";
+	string metricsFile;
+	setProfilerThreadName("main");
+	getTunables().loadFile(TUNABLES_DEFAULT_CONFIG);
+	for (int i = 1; i < argc; i++) {
+		string argument = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (argument == "--rhi-bench")
+			rhiBenchmark = true;
+		else if (argument == "--vbuffer-bench")
+			visibilityBenchmark = true;
+		else if (argument == "--coverage") {
+			runCoverageAnalysis();
+			return 0;
+		}
+		// --bench [file.json] runs the microbenchmarks, --bench-compare
+		// base.json new.json fails if the second regressed
+		else if (argument == "--bench") {
+			microBenchmarks = true;
+			if (hasValue && argv[i + 1][0] != '-')
+				benchmarkOutput = argv[++i];
+		}
+		else if (argument == "--bench-filter" && hasValue)
+			benchmarkSettings.filter = argv[++i];
+		else if (argument == "--bench-reps" && hasValue)
+			benchmarkSettings.repetitions = max(2, atoi(argv[++i]));
+		else if (argument == "--bench-warmup" && hasValue)
+			benchmarkSettings.warmup = max(0, atoi(argv[++i]));
+		else if (argument == "--bench-cpu" && hasValue)
+			benchmarkSettings.cpu = atoi(argv[++i]);
+		// --golden compares every render path against the reference
+		// images, --golden-update first rewrites them
+		else if (argument == "--golden" || argument == "--golden-update") {
+			goldenImages = true;
+			goldenUpdate = argument == "--golden-update";
+		}
+		// Tunables, after those read from the default config
+		else if ((argument == "--set" || argument == "--config") && hasValue) {
+			string error;
+			if (argument == "--config" && !getTunables().loadFile(argv[++i]))
+				cout << "Could not read " << argv[i] << endl;
+			else if (argument == "--set" && !getTunables().setAssignment(argv[++i], error))
+				cout << error << endl;
+		}
+		// Prometheus metrics written to a textfile, as well as or
+		// instead of served on metrics.port
+		else if (argument == "--metrics-file" && hasValue)
+			metricsFile = argv[++i];
+		// --parse-check tests the float parser against strtof
+		else if (argument == "--parse-check")
+			return checkFloatParsing() ? 0 : 1;
+		else if (argument == "--bench-compare" && i + 2 < argc) {
+			bool passed = compareBenchmarks(argv[i + 1], argv[i + 2]);
+			return passed ? 0 : 1;
+		}
+	}
+
+	if (microBenchmarks || goldenImages) {
+		// These need a context, though not the scene
+		glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
+		glutInitWindowSize(tunableWindowWidth, tunableWindowHeight);
+		glutCreateWindow("Mezzanine - Tests");
+		loadGLExtensions();
+		if (goldenImages) {
+			setupLighting();
+			return runGoldenImages(getSuiteScene(), goldenUpdate) ? 0 : 1;
+		}
+		return runBenchmarks(getSuiteScene(), benchmarkSettings, benchmarkOutput) ? 0 : 1;
+	}
+
+#if PROGRESSIVE_LOADING
+	loaders.insert({ "bottom", new ProgressiveLoader("mezzanine_bottom.obj") });
+	loaders.insert({ "stairs", new ProgressiveLoader("mezzanine_stairs.obj") });
+	loaders.insert({ "top", new ProgressiveLoader("mezzanine_top.obj") });
+#else
 	objects.insert({ "bottom", Obj("mezzanine_bottom.obj") });
 	objects.insert({ "stairs", Obj("mezzanine_stairs.obj") });
 	objects.insert({ "top", Obj("mezzanine_top.obj") });
+#endif
 
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
 
-	glutInitWindowSize(WINDOW_W, WINDOW_H);
+	glutInitWindowSize(tunableWindowWidth, tunableWindowHeight);
 	glutCreateWindow("Mezzanine - Luca Carvalho");
 
+	if (rhiBenchmark) {
+		loadGLExtensions();
+		runRhiBenchmark();
+		return 0;
+	}
+	if (visibilityBenchmark) {
+		loadGLExtensions();
+		runVisibilityBenchmark(tunableWindowWidth, tunableWindowHeight);
+		return 0;
+	}
+
 	glutDisplayFunc(draw);
 	glutIdleFunc(idle);
 	glutReshapeFunc(reshapeWindow);
@@ -172,12 +273,16 @@ int main() {
 
 	init();
 
+	metricsExporter = new MetricsExporter();
+	if (!metricsExporter->start(metricsPort, metricsFile, metricsInterval))
+		cout << "Could not serve metrics on port " << metricsPort << endl;
+
 	glutMainLoop();
 	
 	return 0;
 }
 
-void init() {
+void setupLighting() {
 	GLfloat ambientLight[4] = { 0.2, 0.2, 0.2, 1.0 };
 	GLfloat diffuseLight[4] = { 0.7, 0.7, 0.7, 1.0 };
 	GLfloat specularLight[4] = { 1.0, 1.0, 1.0, 1.0 };
@@ -202,8 +307,56 @@ void init() {
 	glEnable(GL_LIGHTING);
 	glEnable(GL_LIGHT0);
 	glEnable(GL_DEPTH_TEST);
+}
 
-	fovY = 45;
+void init() {
+	setupLighting();
+
+	loadGLExtensions();
+
+	frameStats = new FrameStats();
+	renderGraph = new RenderGraph();
+	ambientOcclusion = new ScreenSpaceAO();
+	if (!ambientOcclusion->init())
+		cout << "Ambient occlusion unavailable" << endl;
+	transparency = new WeightedBlendedOIT();
+	if (!transparency->init())
+		cout << "Order-independent transparency unavailable, blending unsorted" << endl;
+	hud = new Hud();
+	if (!hud->init())
+		cout << "Batched HUD unavailable, drawing text with GLUT" << endl;
+	transparentPanels = new TransparentPanels();
+	buildTransparentPanels(false);
+
+	sceneBvh = new Bvh();
+	collisionWorld = new CollisionWorld();
+	for (auto& object : objects)
+		addCollisionMesh(object.first);
+	lightProbes = new LightProbeGrid();
+	distanceField = new DistanceField();
+	pvs = new PotentiallyVisibleSet();
+	incrementalCulling = new IncrementalCulling();
+	dynamicProps = new DynamicProps();
+
+	// The stairs' teleport triggers, as in teleportIfNecessary()
+	cameraPredictor = new CameraPredictor();
+	cameraPredictor->addPortal(Bounds(Point3(7.5, 0, 1.5), Point3(11.5, 2.01, 2.5)), Point3(-1.86, 7.54, 9.9));
+	cameraPredictor->addPortal(Bounds(Point3(2.32, 5.53, 7.5), Point3(3.32, 7.55, 10)), Point3(9.35, 2, 0));
+	streaming = new StreamingScheduler();
+	for (auto& loader : loaders)
+		streaming->addLoader(loader.second);
+
+	// Applied as they change, from the console or a reloaded config
+	cameraFov.addListener(setVisualizationParameters);
+	cameraNear.addListener(setVisualizationParameters);
+	cameraFar.addListener(setVisualizationParameters);
+	auto resize = []() {
+		glutReshapeWindow(tunableWindowWidth, tunableWindowHeight);
+	};
+	tunableWindowWidth.addListener(resize);
+	tunableWindowHeight.addListener(resize);
+	profilerEnabled.addListener(updateProfiler);
+	updateProfiler();
 
 	cameraPos = new Point3(0, -2, 0);
 	cameraLookAt = new Point3(0, 2, 20);
@@ -217,39 +370,451 @@ void init() {
 }
 
 void idle() {
-	/*float currentTime = glutGet(GLUT_ELAPSED_TIME);
-	
-	deltaTimeSec = (currentTime - timeSinceStart) / 1000;
+	setProfilerPhase("update");
+	int currentTime = glutGet(GLUT_ELAPSED_TIME);
+	deltaTimeSec = (currentTime - timeSinceStart) / 1000.0f;
 	timeSinceStart = currentTime;
 
+	// Upload what the loaders parsed so far, nearest the predicted path first.
+	// The view direction is the third row of the modelview, negated.
+	GLfloat modelview[16];
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	Point3 eye(-cameraPos->x, -cameraPos->y, -cameraPos->z);
+	cameraPredictor->update(eye, Point3(-modelview[2], -modelview[6], -modelview[10]), deltaTimeSec);
+
+	bool loading = streaming->update(*cameraPredictor);
+	for (auto& loader : loaders) {
+		if (loader.second->isFinished() && objects.find(loader.first) == objects.end()) {
+			objects.insert({ loader.first, loader.second->getObject() });
+			addCollisionMesh(loader.first);
+		}
+	}
+
+	// The probes need the whole scene
+	if (!loading && !probeBake.valid() && objects.size() == 3)
+		bakeLightProbes();
+
+	// For shaders to sample, once the bake is done
+	if (!distanceFieldUploaded && distanceBake.valid() && distanceBake.wait_for(chrono::seconds(0)) == future_status::ready) {
+		distanceFieldUploaded = true;
+		if (!distanceField->upload())
+			cout << "Distance field kept on the CPU, no 3D textures" << endl;
+	}
 
-	cout << deltaTimeSec << endl;*/
+	dynamicProps->update(glutGet(GLUT_ELAPSED_TIME) / 1000.0f);
+	glutPostRedisplay();
 }
 
 void draw() {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glColor3f(0.5, 0.5, 1);
-	objects.find("bottom")->second.toBuffer();
+	setProfilerPhase("frame setup");
+	frameStats->beginFrame();
+	recordFrameMetrics();
+
+	// Text from the stats and the debug drawing is gathered before
+	// the passes run, and drawn by the last one
+	hud->begin();
+	// Looked up before the stats, which count its tiles
+	Point3 eye(-cameraPos->x, -cameraPos->y, -cameraPos->z);
+	visibleTiles = pvsReady() ? pvs->find(eye) : nullptr;
+
+	if (showHud)
+		addStatsToHud();
+	if (console.isOpen())
+		addConsoleToHud();
+
+#if DEBUG_DRAW
+	if (showBoundaries)
+		drawBoundaries();
+#endif
+
+	renderGraph->reset();
+	GraphTextureDesc windowDesc = { windowWidth, windowHeight, 0 };
+	GraphTexture window = renderGraph->importTexture("window", 0, windowDesc);
+
+	// The opaque pass goes offscreen so later ones can sample its
+	// depth, or straight to the window without framebuffer objects
+	GraphTexture sceneColor = window;
+	GraphTexture sceneDepth = renderGraph->importTexture("window depth", 0, windowDesc);
+	if (hasFramebuffers()) {
+		sceneColor = renderGraph->createTexture("scene color", { windowWidth, windowHeight, GL_RGBA8 });
+		sceneDepth = renderGraph->createTexture("scene depth", { windowWidth, windowHeight, GL_DEPTH_COMPONENT24 });
+	}
 
-	glColor3f(0.5, 0.5, 0.5);
-	objects.find("stairs")->second.toBuffer();
+	renderGraph->addPass("opaque", [&](RenderPassBuilder& pass) {
+		sceneColor = pass.write(sceneColor);
+		sceneDepth = pass.depth(sceneDepth, true);
+	}, [](const RenderPassContext& context) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		Frustum frustum = Frustum::fromCurrentMatrices();
+		incrementalCulling->beginFrame(visibleTiles);
+
+		glColor3f(0.5, 0.5, 1);
+		drawObject("bottom", frustum, visibleTiles);
+
+		glColor3f(0.5, 0.5, 0.5);
+		drawObject("stairs", frustum, visibleTiles);
+
+		glColor3f(0.5, 1, 0.5);
+		drawObject("top", frustum, visibleTiles);
+
+		dynamicProps->draw(lightProbesReady() && probeLighting ? lightProbes : nullptr);
+
+		//glPushMatrix();
+		//glTranslatef(0, 0, 0);
+		//object->toBuffer();
+		//glPopMatrix();
+	});
+
+	sceneColor = ambientOcclusion->addPasses(*renderGraph, sceneColor, sceneDepth);
+	sceneColor = transparency->addPasses(*renderGraph, *transparentPanels, sceneColor, sceneDepth);
+
+#if DEBUG_DRAW
+	renderGraph->addPass("debug draw", [&](RenderPassBuilder& pass) {
+		sceneColor = pass.write(sceneColor);
+	}, [](const RenderPassContext& context) {
+		DEBUG_RENDER(*hud, context.getWidth(), context.getHeight());
+	});
+#endif
+
+	if (hasFramebuffers()) {
+		renderGraph->addPass("present", [&](RenderPassBuilder& pass) {
+			pass.read(sceneColor);
+			window = pass.write(window);
+		}, [=](const RenderPassContext& context) {
+			int width = context.getWidth(), height = context.getHeight();
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, context.getFramebuffer(sceneColor));
+			glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		});
+	}
+	else {
+		window = sceneColor;
+	}
 
-	glColor3f(0.5, 1, 0.5);
-	objects.find("top")->second.toBuffer();
+	renderGraph->addPass("hud", [&](RenderPassBuilder& pass) {
+		window = pass.write(window);
+		pass.setGpuSection("hud");
+	}, [](const RenderPassContext& context) {
+		hud->draw();
+	});
 
-	//glPushMatrix();
-	//glTranslatef(0, 0, 0);
-	//object->toBuffer();
-	//glPopMatrix();
+	renderGraph->markOutput(window);
+	renderGraph->compile();
+	renderGraph->execute(frameStats);
 
+	setProfilerPhase("swap");
 	glutSwapBuffers();
+	frameStats->endFrame();
+
+	// Once a second
+	static int lastReport = glutGet(GLUT_ELAPSED_TIME);
+	int now = glutGet(GLUT_ELAPSED_TIME);
+	if (now - lastReport >= 1000) {
+		cout << frameStats->format();
+		if (showTransparencyBenchmark)
+			cout << " | " << transparentPanels->getPanelCount() << " transparent panels";
+		cout << endl;
+		lastReport = now;
+	}
+}
+
+void addStatsToHud() {
+	// Text is refreshed 4 times a second, so its layout is reused in between
+	static string statsText;
+	static int lastUpdate = -1000;
+	int now = glutGet(GLUT_ELAPSED_TIME);
+	if (now - lastUpdate >= 250) {
+		ostringstream text;
+		text.setf(ios::fixed);
+		text.precision(2);
+
+		text << "frame " << frameStats->getFrameMilliseconds() << " ms  cpu " << frameStats->getCpuMilliseconds() << " ms\ngpu";
+		for (auto& section : frameStats->getGpuSections())
+			text << "  " << section.first << " " << section.second;
+		text.precision(1);
+		text << "\ndraw calls " << frameStats->getDrawCalls() << "  memory " << getResidentMemory() / 1e6 << " MB"
+			<< "  hulls " << collisionWorld->getLastTestCount() << "/" << collisionWorld->getHullCount();
+		text << "\nao " << aoQualityName(ambientOcclusion->getQuality()) << "  probes " << (lightProbesReady() ? lightProbes->getProbeCount() : 0)
+			<< "  panels " << transparentPanels->getPanelCount() << "  streaming " << streaming->getPendingCount();
+		text << "  pvs ";
+		if (visibleTiles)
+			text << visibleTiles->getVisibleCount() << "/" << visibleTiles->getTileCount();
+		else
+			text << "-";
+		text << "\ncull tests " << incrementalCulling->getTestCount() << "/" << incrementalCulling->getClusterCount()
+			<< (incrementalCulling->isEnabled() ? " incremental" : " full");
+		text << "\npasses " << renderGraph->getPassCount() - renderGraph->getCulledPassCount() << "/" << renderGraph->getPassCount()
+			<< "  targets " << renderGraph->getPooledBytes() / 1e6 << " MB (" << renderGraph->getUnaliasedBytes() / 1e6 << " MB unaliased)";
+
+		statsText = text.str();
+		lastUpdate = now;
+	}
+
+	const float background[4] = { 0, 0, 0, 0.5 };
+	const float white[4] = { 1, 1, 1, 1 };
+	const float graphColor[4] = { 0.3, 0.9, 0.3, 0.8 };
+	const float budgetColor[4] = { 1, 0.3, 0.3, 0.8 };
+
+	// Frame times up to 33 ms, with a line at 16.7 ms
+	float history[FRAME_STATS_HISTORY];
+	frameStats->getFrameHistory(history);
+
+	hud->rect(5, 5, 370, 163, background);
+	hud->text(10, 10, statsText, white);
+	hud->graph(10, 103, 360, 60, history, FRAME_STATS_HISTORY, 33.3, graphColor);
+	hud->rect(10, 133, 360, 1, budgetColor);
+}
+
+void addConsoleToHud() {
+	const float background[4] = { 0, 0, 0, 0.7 };
+	const float white[4] = { 1, 1, 1, 1 };
+	const float grey[4] = { 0.7, 0.7, 0.7, 1 };
+	const float lineHeight = 15;
+
+	string output;
+	for (const string& line : console.getOutput())
+		output += line + "\n";
+
+	// Along the bottom of the window, the line being typed last
+	float height = (TUNABLES_CONSOLE_LINES + 1) * lineHeight + 10;
+	float top = windowHeight - 5 - height;
+	hud->rect(5, top, windowWidth - 10, height, background);
+	hud->text(10, top + 5, output, grey);
+	hud->text(10, top + 5 + TUNABLES_CONSOLE_LINES * lineHeight, "> " + console.getLine() + "_", white);
+}
+
+void recordFrameMetrics() {
+	// Looked up once, leaving a few relaxed atomics per frame
+	static Histogram& frameSeconds = getMetrics().histogram("mezzanine_frame_seconds", "Time between frame starts",
+		{ 0.004, 0.008, 0.0125, 0.0167, 0.025, 0.0333, 0.05, 0.1, 0.25, 1 });
+	frameSeconds.observe(frameStats->getLastFrameMilliseconds() / 1000);
+
+	// The rest is sampled once a second
+	static int lastSample = -1000;
+	int now = glutGet(GLUT_ELAPSED_TIME);
+	if (now - lastSample < 1000)
+		return;
+	lastSample = now;
+
+	MetricsRegistry& metrics = getMetrics();
+	metrics.gauge("mezzanine_resident_memory_bytes", "Resident set size of the process").set((double)getResidentMemory());
+	metrics.gauge("mezzanine_render_target_bytes", "Memory pooled by the render graph for its targets").set((double)renderGraph->getPooledBytes());
+	metrics.gauge("mezzanine_streaming_queue_depth", "Parsed batches waiting to be uploaded").set((double)streaming->getPendingCount());
+	metrics.gauge("mezzanine_draw_calls", "Draw calls made by the last frame").set(frameStats->getDrawCalls());
+	metrics.gauge("mezzanine_frame_cpu_seconds", "Smoothed CPU time of a frame").set(frameStats->getCpuMilliseconds() / 1000);
+	for (auto& section : frameStats->getGpuSections()) {
+		metrics.gauge("mezzanine_frame_gpu_seconds", "Smoothed GPU time of each section of a frame",
+			metricLabel("section", section.first)).set(section.second / 1000);
+	}
+}
+
+void updateProfiler() {
+	if (profilerEnabled && !getProfiler().isRunning()) {
+		if (getProfiler().start(profilerHz))
+			cout << "Profiling at " << profilerHz << " Hz, 'p' writes the samples" << endl;
+		else
+			cout << "Sampling profiler unavailable on this platform" << endl;
+	}
+	else if (!profilerEnabled)
+		getProfiler().stop();
+}
+
+void writeProfile() {
+	static int written = 0;
+	size_t samples = getProfiler().getSampleCount(), dropped = getProfiler().getDroppedCount();
+	string filename = "profile_" + to_string(written++) + ".folded";
+	if (getProfiler().writeFolded(filename)) {
+		cout << samples << " samples written to " << filename;
+		if (dropped > 0)
+			cout << ", " << dropped << " dropped for want of space";
+		cout << endl;
+	}
+	else
+		cout << "No profile written, set profiler.enabled first" << endl;
+}
+
+void drawObject(const char* name, const Frustum& frustum, const VisibleTiles* visible) {
+#if PROGRESSIVE_LOADING
+	loaders.find(name)->second->draw(&frustum, visible, incrementalCulling);
+#else
+	objects.find(name)->second.toBuffer();
+#endif
+}
+
+void buildTransparentPanels(bool benchmark) {
+	transparentPanels->clear();
+
+	// Glass balustrade around the hole in the upper floor and its landing
+	addGlassRailing(-4.49, -4.49, 2.6, -4.49);
+	addGlassRailing(2.6, -4.49, 2.6, -11.71);
+	addGlassRailing(-4.49, -4.49, -4.49, 4.47);
+	addGlassRailing(-4.49, 4.47, 5.71, 4.47);
+	addGlassRailing(5.71, 4.47, 5.71, 7.57);
+
+	if (benchmark) {
+		// Randomly placed and oriented partitions, many of them
+		// intersecting, from a fixed seed so runs are comparable
+		mt19937 random(1234);
+		uniform_real_distribution<float> x(-11, 11), y(0.5, 10), z(-9.5, 9.5);
+		uniform_real_distribution<float> unit(0, 1);
+
+		for (int i = 0; i < BENCHMARK_PANELS; i++) {
+			Point3 center(x(random), y(random), z(random));
+			float angle = unit(random) * 6.2831853f;
+			float halfWidth = 0.25f + unit(random) * 0.75f;
+			float halfHeight = 0.25f + unit(random) * 0.5f;
+			float dx = cosf(angle) * halfWidth, dz = sinf(angle) * halfWidth;
+			float color[4] = { unit(random), unit(random), unit(random), 0.1f + unit(random) * 0.5f };
+
+			transparentPanels->addPanel(
+				Point3(center.x - dx, center.y - halfHeight, center.z - dz),
+				Point3(center.x + dx, center.y - halfHeight, center.z + dz),
+				Point3(center.x + dx, center.y + halfHeight, center.z + dz),
+				Point3(center.x - dx, center.y + halfHeight, center.z - dz),
+				color);
+		}
+	}
+
+	transparentPanels->upload();
+}
+
+void addGlassRailing(float x0, float z0, float x1, float z1) {
+	// One meter tall panes standing on the upper floor, with small gaps between them
+	const float bottom = 5.53, top = 6.53, maxWidth = 1.5, gap = 0.05;
+	const float glass[4] = { 0.6, 0.8, 0.9, 0.3 };
+
+	float length = sqrtf((x1 - x0) * (x1 - x0) + (z1 - z0) * (z1 - z0));
+	int count = (int)ceilf(length / maxWidth);
+	for (int i = 0; i < count; i++) {
+		float t0 = (i * length / count + gap / 2) / length;
+		float t1 = ((i + 1) * length / count - gap / 2) / length;
+		float ax = x0 + (x1 - x0) * t0, az = z0 + (z1 - z0) * t0;
+		float bx = x0 + (x1 - x0) * t1, bz = z0 + (z1 - z0) * t1;
+
+		transparentPanels->addPanel(Point3(ax, bottom, az), Point3(bx, bottom, bz), Point3(bx, top, bz), Point3(ax, top, az), glass);
+	}
+}
+
+void bakeLightProbes() {
+	// Same colors as draw() gives each object
+	sceneBvh->addObject(objects.find("bottom")->second, Point3(0.5, 0.5, 1));
+	sceneBvh->addObject(objects.find("stairs")->second, Point3(0.5, 0.5, 0.5));
+	sceneBvh->addObject(objects.find("top")->second, Point3(0.5, 1, 0.5));
+	sceneBvh->build();
+
+	// Light 0 as set up in init(). It is placed in eye space, 100 above
+	// the camera, which the bake approximates as 100 above the origin.
+	GLfloat diffuse[4], ambient[4], modelAmbient[4];
+	glGetLightfv(GL_LIGHT0, GL_DIFFUSE, diffuse);
+	glGetLightfv(GL_LIGHT0, GL_AMBIENT, ambient);
+	glGetFloatv(GL_LIGHT_MODEL_AMBIENT, modelAmbient);
+
+	ProbeBakeLight light;
+	light.position = Point3(0, 100, 0);
+	light.diffuse = Point3(diffuse[0], diffuse[1], diffuse[2]);
+	light.ambient = Point3(ambient[0] + modelAmbient[0], ambient[1] + modelAmbient[1], ambient[2] + modelAmbient[2]);
+
+	ProbeBakeSettings settings;
+	settings.spacing = PROBE_SPACING;
+
+	Bounds volume = sceneBvh->getBounds();
+	volume.max.y += PROBE_HEADROOM;
+
+	probeBake = getJobSystem().async([light, settings, volume]() {
+		lightProbes->bake(*sceneBvh, volume, light, settings);
+	});
+
+	distanceBake = getJobSystem().async([]() {
+		distanceField->bake(*sceneBvh, sceneBvh->getBounds(), DistanceFieldSettings());
+	});
+
+	// Cached next to the models, like the hulls
+	pvsBake = getJobSystem().async([]() {
+		pvs->loadOrBake(*sceneBvh, getFloorPlans(), CAMERA_EYE_HEIGHT, "mezzanine.pvs");
+	});
+}
+
+void addCollisionMesh(const string& name) {
+	// The hulls are cached next to the model and rebuilt when it changes
+	CollisionMesh mesh;
+	mesh.loadOrBuild(objects.find(name)->second, "mezzanine_" + name + ".hulls");
+	collisionWorld->addMesh(mesh);
+}
+
+vector<FloorPlan> getFloorPlans() {
+	// The walkable areas of correctForBoundaries(), in world coordinates
+	FloorPlan base;
+	base.name = "base";
+	base.height = 0.075;
+	base.areas.push_back(Bounds(Point3(-11.5, 0, -10), Point3(11.5, 0, 10)));
+
+	FloorPlan mezzanine;
+	mezzanine.name = "mezzanine";
+	mezzanine.height = 5.53;
+	mezzanine.areas.push_back(Bounds(Point3(-11.5, 0, 4.64), Point3(5.45, 0, 10)));
+	mezzanine.areas.push_back(Bounds(Point3(-11.5, 0, -10), Point3(2.6, 0, -4.76)));
+	mezzanine.areas.push_back(Bounds(Point3(-11.5, 0, -4.76), Point3(-4.5, 0, 4.64)));
+
+	return { base, mezzanine };
+}
+
+void runCoverageAnalysis() {
+	Bvh scene;
+	for (const char* filename : { "mezzanine_bottom.obj", "mezzanine_stairs.obj", "mezzanine_top.obj" })
+		scene.addObject(Obj(filename), Point3(1, 1, 1));
+	scene.build();
+
+	CoverageAnalysis analysis;
+	analysis.run(scene, getFloorPlans(), CoverageSettings());
+
+	cout << analysis.getViewpointCount() << " viewpoints, " << analysis.getRayCount() / 1e6 << " M rays in "
+		<< analysis.getSeconds() << " s on " << getJobSystem().getThreadCount() << " threads" << endl;
+	for (const FloorCoverage& floor : analysis.getFloors()) {
+		size_t cells = 0, unseen = 0;
+		for (int seenBy : floor.seenBy) {
+			cells += seenBy >= 0;
+			unseen += seenBy == 0;
+		}
+		float bestArea = *max_element(floor.isovistArea.begin(), floor.isovistArea.end());
+		cout << floor.name << ": " << cells << " cells, " << unseen << " seen from nowhere, best viewpoint sees "
+			<< bestArea << " m2" << endl;
+	}
+
+	if (!analysis.writeMaps(""))
+		cout << "Could not write the coverage maps" << endl;
+}
+
+SuiteScene getSuiteScene() {
+	SuiteScene scene;
+	scene.filenames = { "mezzanine_bottom.obj", "mezzanine_stairs.obj", "mezzanine_top.obj" };
+	scene.floors = getFloorPlans();
+	scene.eyeHeight = CAMERA_EYE_HEIGHT;
+	scene.kneeDepth = CAMERA_KNEE_DEPTH;
+	scene.radius = CAMERA_RADIUS;
+	scene.width = tunableWindowWidth;
+	scene.height = tunableWindowHeight;
+	return scene;
+}
+
+bool lightProbesReady() {
+	// Probes are only read once their bake has finished
+	return probeBake.valid() && probeBake.wait_for(chrono::seconds(0)) == future_status::ready;
+}
+
+bool pvsReady() {
+	return pvsBake.valid() && pvsBake.wait_for(chrono::seconds(0)) == future_status::ready;
 }
 
 void reshapeWindow(GLsizei w, GLsizei h) {
 	if (h == 0) h = 1;
 	glViewport(0, 0, w, h);
 
+	windowWidth = w;
+	windowHeight = h;
+	hud->resize(w, h);
+	ambientOcclusion->resize(w, h);
+	bindDefaultFramebuffer(w, h);
+
 	fAspect = (GLfloat)w / (GLfloat)h;
 
 	setVisualizationParameters();
@@ -258,10 +823,18 @@ void reshapeWindow(GLsizei w, GLsizei h) {
 void setVisualizationParameters() {
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
-	gluPerspective(fovY, fAspect, 0.1, 500);
+	gluPerspective(cameraFov, fAspect, cameraNear, cameraFar);
 }
 
 void handleKeyboard(unsigned char key, int x, int y) {
+	// While open, the console takes every key
+	if (console.isOpen() || key == '`') {
+		if (!console.handleKey(key))
+			console.toggle();
+		glutPostRedisplay();
+		return;
+	}
+
 	Point3* forward = getCameraForward();
 
 	glMatrixMode(GL_MODELVIEW);
@@ -287,6 +860,31 @@ void handleKeyboard(unsigned char key, int x, int y) {
 			cameraPos->z += forward->x;
 			glTranslatef(-forward->z, 0, +forward->x);
 			break;
+		case 'g':
+			showTransparencyBenchmark = !showTransparencyBenchmark;
+			buildTransparentPanels(showTransparencyBenchmark);
+			break;
+		case 'l':
+			probeLighting = !probeLighting;
+			cout << "Props lit by " << (probeLighting ? "light probes" : "dynamic lights") << endl;
+			break;
+		case 'o':
+			ambientOcclusion->setQuality((AoQuality)(((int)ambientOcclusion->getQuality() + 1) % 4));
+			cout << "Ambient occlusion: " << aoQualityName(ambientOcclusion->getQuality()) << endl;
+			break;
+		case 'c':
+			incrementalCulling->setEnabled(!incrementalCulling->isEnabled());
+			cout << "Culling: " << (incrementalCulling->isEnabled() ? "incremental" : "full") << endl;
+			break;
+		case 'h':
+			showHud = !showHud;
+			break;
+		case 'b':
+			showBoundaries = !showBoundaries;
+			break;
+		case 'p':
+			writeProfile();
+			break;
 		case 'q':
 			exit(0);
 		default:
@@ -315,7 +913,7 @@ void handleMouseMotion(int x, int y) {
 		cameraRotationY = cameraRotationY >= 359 ? 0 : cameraRotationY + 1;
 
 		glTranslatef(-cameraPos->x, -cameraPos->y, -cameraPos->z);
-		glRotatef(-MOUSE_SENSITIVITY, 0, 1, 0);
+		glRotatef(-mouseSensitivity, 0, 1, 0);
 		glTranslatef(cameraPos->x, cameraPos->y, cameraPos->z);
 	}
 	else {
@@ -323,7 +921,7 @@ void handleMouseMotion(int x, int y) {
 		cameraRotationY = cameraRotationY <= 0 ? 359 : cameraRotationY - 1;
 
 		glTranslatef(-cameraPos->x, -cameraPos->y, -cameraPos->z);
-		glRotatef(+MOUSE_SENSITIVITY, 0, 1, 0);
+		glRotatef(+mouseSensitivity, 0, 1, 0);
 		glTranslatef(cameraPos->x, cameraPos->y, cameraPos->z);
 	}
 
@@ -362,32 +960,13 @@ void correctForBoundaries() {
 	glMatrixMode(GL_MODELVIEW);
 	glTranslatef(-cameraPos->x, -cameraPos->y, -cameraPos->z);
 
-	// Base
-	cameraPos->x = clampFloat(cameraPos->x, -11.5, 11.5);
-	cameraPos->z = clampFloat(cameraPos->z, -10, 10);
+	*cameraPos = clampToWalkable(*cameraPos);
 
-	// Mezzanine
-	if (cameraPos->y < -7.53) {
-		if (between(cameraPos->z, -10, -4.64)) {
-			// in front of the stairs
-			cameraPos->x = clampFloat(cameraPos->x, -5.45, 11.5);
-			if (between(cameraPos->x, -5.45, 4.5)) {
-				// beside the hole
-				cameraPos->z = clampFloat(cameraPos->z, -10, -4.64);
-			}
-		}
-		else if (between(cameraPos->z, 4.76, 10)) {
-			// opposite to the first stretch
-			cameraPos->x = clampFloat(cameraPos->x, -2.6, 11.5);
-			if (between(cameraPos->x, -2.6, 4.5)) {
-				// beside the hole
-				cameraPos->z = clampFloat(cameraPos->z, 4.76, 10);
-			}
-		}
-		else if (between(cameraPos->z, -4.64, 4.76)) {
-			// in front of the hole
-			cameraPos->x = clampFloat(cameraPos->x, 4.5, 11.5);
-		}
+	// Stair blocks and anything else solid, through their hulls
+	Point3 knees(-cameraPos->x, -cameraPos->y - CAMERA_KNEE_DEPTH, -cameraPos->z);
+	if (collisionWorld->resolveCapsule(knees, CAMERA_KNEE_DEPTH, CAMERA_RADIUS)) {
+		cameraPos->x = -knees.x;
+		cameraPos->z = -knees.z;
 	}
 
 	glTranslatef(cameraPos->x, cameraPos->y, cameraPos->z);
@@ -398,37 +977,57 @@ void teleportIfNecessary() {
 
 	glTranslatef(-cameraPos->x, -cameraPos->y, -cameraPos->z);
 
-	// Lower stair step -> upper floor
-	if (between(cameraPos->x, -11.5, -7.5)
-		&& between(cameraPos->z, -2.5, -1.5)
-		&& between(cameraPos->y, -2.01, -1.99)) {
+	Point3 destination;
+	if (findTeleport(*cameraPos, destination))
+		*cameraPos = destination;
 
-		cameraPos->x = 1.86;
-		cameraPos->y = -7.54;
-		cameraPos->z = -9.9;
-	}
+	glTranslatef(cameraPos->x, cameraPos->y, cameraPos->z);
+}
 
-	// Upper stair step -> lower floor
-	if (between(cameraPos->x, -3.32, -2.32)
-		&& between(cameraPos->z, -10, -7.5)
-		&& between(cameraPos->y, -7.55, -7.53)) {
+#if DEBUG_DRAW
+void drawBoundaries() {
+	// The areas correctForBoundaries() keeps the camera in and the
+	// triggers of teleportIfNecessary(), from eye to floor height.
+	// Those work in camera coordinates, hence the negated x and z.
+	const Point3 walkable(0.3, 1, 0.3), trigger(1, 0.6, 0.1), camera(1, 1, 1);
 
-		cameraPos->x = -9.35;
-		cameraPos->y = -2;
-		cameraPos->z = 0;
-	}
+	// Base
+	DEBUG_BOX(Point3(-11.5, 0, -10), Point3(11.5, 2, 10), walkable);
+	DEBUG_TEXT(Point3(0, 2, 0), "base", walkable);
 
-	glTranslatef(cameraPos->x, cameraPos->y, cameraPos->z);
-}
+	// Mezzanine
+	DEBUG_BOX(Point3(-11.5, 5.53, 4.64), Point3(5.45, 7.53, 10), walkable);
+	DEBUG_TEXT(Point3(-3, 7.53, 7.3), "in front of the stairs", walkable);
+	DEBUG_BOX(Point3(-11.5, 5.53, -10), Point3(2.6, 7.53, -4.76), walkable);
+	DEBUG_TEXT(Point3(-4.5, 7.53, -7.4), "opposite to the first stretch", walkable);
+	DEBUG_BOX(Point3(-11.5, 5.53, -4.76), Point3(-4.5, 7.53, 4.64), walkable);
+	DEBUG_TEXT(Point3(-8, 7.53, 0), "in front of the hole", walkable);
 
-float clampFloat(float value, float min, float max) {
-	if (value < min)
-		return min;
-	if (value > max)
-		return max;
-	return value;
-}
+	// Lower stair step -> upper floor
+	Point3 upDestination(-1.86, 7.54, 9.9);
+	DEBUG_BOX(Point3(7.5, 0, 1.5), Point3(11.5, 2.01, 2.5), trigger);
+	DEBUG_LINE(Point3(9.5, 2, 2), upDestination, trigger);
+	DEBUG_SPHERE(upDestination, 0.2, trigger);
+	DEBUG_TEXT(Point3(9.5, 2.01, 2), "teleport up", trigger);
 
-bool between(float value, float min, float max) {
-	return value >= min && value <= max;
-}
\ No newline at end of file
+	// Upper stair step -> lower floor
+	Point3 downDestination(9.35, 2, 0);
+	DEBUG_BOX(Point3(2.32, 5.53, 7.5), Point3(3.32, 7.55, 10), trigger);
+	DEBUG_LINE(Point3(2.82, 7.54, 8.75), downDestination, trigger);
+	DEBUG_SPHERE(downDestination, 0.2, trigger);
+	DEBUG_TEXT(Point3(2.82, 7.55, 8.75), "teleport down", trigger);
+
+	// Where the camera is, projected onto the floor below it
+	Point3 eye(-cameraPos->x, -cameraPos->y, -cameraPos->z);
+	Point3 feet(eye.x, eye.y > 5 ? 5.53 : 0, eye.z);
+	DEBUG_LINE(eye, feet, camera);
+	DEBUG_SPHERE(feet, 0.25, camera);
+
+	// Where streaming expects it to be next
+	const vector<Point3>& path = cameraPredictor->getPath();
+	for (size_t i = 1; i < path.size(); i++) {
+		DEBUG_LINE(path[i - 1], path[i], camera);
+		DEBUG_SPHERE(path[i], 0.1, camera);
+	}
+}
+#endif